@@ -28,6 +28,7 @@ class RasterimageConan(ConanFile):
 			self.requires("libpng/[>=1.6.37]", transitive_headers=False)
 		
 		self.requires("libjpeg/[>=0.0.0]", transitive_headers=False)
+		self.requires("zlib/[>=1.2.11]", transitive_headers=False)
 	
 	def build_requirements(self):
 		self.tool_requires("prorab/[>=2.0.27]@cppfw/main")
@@ -0,0 +1,4 @@
+include $(config_dir)dev.mk
+
+# build as C++20 to also compile and test C++20 only features, e.g. co_await support of push_decoder
+this_cxxflags += -std=c++20
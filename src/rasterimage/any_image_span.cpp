@@ -0,0 +1,284 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "any_image_span.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+
+#include "operations.hpp"
+#include "parallel.hpp"
+
+using namespace rasterimage;
+
+namespace {
+// Row kernels of a pixel type. Pixels are accessed as typed vectors, since span data is aligned to channel size.
+template <format pixel_format, depth channel_depth>
+struct kernels_impl {
+	using channel_type = depth_type_t<channel_depth>;
+	constexpr static size_t num_channels = to_num_channels(pixel_format);
+	using pixel_type = r4::vector<channel_type, num_channels>;
+
+	constexpr static bool has_alpha = num_channels == 2 || num_channels == 4;
+
+	static pixel_type* pixels(uint8_t* p)
+	{
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		return reinterpret_cast<pixel_type*>(p);
+	}
+
+	static const pixel_type* pixels(const uint8_t* p)
+	{
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		return reinterpret_cast<const pixel_type*>(p);
+	}
+
+	static channel_type from_float(float c)
+	{
+		if constexpr (is_floating_point_v<channel_type>) {
+			return channel_type(c);
+		} else {
+			constexpr auto val_max = float(std::numeric_limits<channel_type>::max());
+			constexpr auto half = 0.5f;
+			return channel_type(std::clamp(c, 0.0f, 1.0f) * val_max + half);
+		}
+	}
+
+	static void to_rgba(const uint8_t* src, r4::vector4<float>* dst, size_t num_pixels)
+	{
+		auto s = utki::make_span(pixels(src), num_pixels);
+		std::transform(s.begin(), s.end(), dst, [](const pixel_type& px) {
+			auto p = to_canonical_order(pixel_format, px);
+			if constexpr (is_floating_point_v<channel_type>) {
+				return get_rgba(p.template to<float>());
+			} else {
+				return get_rgba(to_float<float>(p));
+			}
+		});
+	}
+
+	static void from_rgba(const r4::vector4<float>* src, uint8_t* dst, size_t num_pixels)
+	{
+		auto s = utki::make_span(src, num_pixels);
+		std::transform(s.begin(), s.end(), pixels(dst), [](const r4::vector4<float>& px) {
+			auto grey = [&px]() {
+				// keep grey values exact
+				if (px.r() == px.g() && px.g() == px.b()) {
+					return px.r();
+				}
+				// same coefficients as rasterimage::luminance() uses
+				constexpr auto red_coeff = 0.2126f;
+				constexpr auto green_coeff = 0.7152f;
+				constexpr auto blue_coeff = 0.0722f;
+				return px.r() * red_coeff + px.g() * green_coeff + px.b() * blue_coeff;
+			};
+
+			pixel_type p;
+			if constexpr (num_channels == 1) {
+				p = {from_float(grey())};
+			} else if constexpr (num_channels == 2) {
+				p = {from_float(grey()), from_float(px.a())};
+			} else if constexpr (num_channels == 3) {
+				p = {from_float(px.r()), from_float(px.g()), from_float(px.b())};
+			} else {
+				p = {from_float(px.r()), from_float(px.g()), from_float(px.b()), from_float(px.a())};
+			}
+			return from_canonical_order(pixel_format, p);
+		});
+	}
+
+	static void flip_horizontal(uint8_t* data, size_t num_pixels)
+	{
+		auto p = pixels(data);
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		std::reverse(p, p + num_pixels);
+	}
+
+	template <typename function_type>
+	static void for_each_color_and_alpha(uint8_t* data, size_t num_pixels, function_type func)
+	{
+		for (auto& px : utki::make_span(pixels(data), num_pixels)) {
+			auto p = to_canonical_order(pixel_format, px);
+			auto& a = p[num_channels - 1];
+			for (size_t i = 0; i != num_channels - 1; ++i) {
+				p[i] = func(p[i], a);
+			}
+			px = from_canonical_order(pixel_format, p);
+		}
+	}
+
+	static void premultiply_alpha(uint8_t* data, size_t num_pixels)
+	{
+		if constexpr (has_alpha) {
+			for_each_color_and_alpha(data, num_pixels, [](channel_type c, channel_type a) {
+				if constexpr (is_floating_point_v<channel_type>) {
+					return channel_type(float(c) * float(a));
+				} else {
+					return multiply(c, a);
+				}
+			});
+		}
+	}
+
+	static void unpremultiply_alpha(uint8_t* data, size_t num_pixels)
+	{
+		if constexpr (has_alpha) {
+			for_each_color_and_alpha(data, num_pixels, [](channel_type c, channel_type a) {
+				if (a == value<channel_type>(0) || a == value<channel_type>(1)) {
+					return c;
+				}
+				if constexpr (is_floating_point_v<channel_type>) {
+					return channel_type(float(c) / float(a));
+				} else {
+					return divide(c, a);
+				}
+			});
+		}
+	}
+
+	constexpr static pixel_kernels make()
+	{
+		return {
+			pixel_format,
+			channel_depth,
+			sizeof(pixel_type),
+			&to_rgba,
+			&from_rgba,
+			&flip_horizontal,
+			&premultiply_alpha,
+			&unpremultiply_alpha
+		};
+	}
+};
+
+// index of the table is same as image_variant's variant index: depth * format::enum_size + format
+template <size_t... index>
+constexpr std::array<pixel_kernels, sizeof...(index)> make_kernels_table(std::index_sequence<index...>)
+{
+	return {kernels_impl<
+		format(index % size_t(format::enum_size)),
+		depth(index / size_t(format::enum_size))>::make()...};
+}
+
+constexpr auto kernels_table =
+	make_kernels_table(std::make_index_sequence<size_t(format::enum_size) * size_t(depth::enum_size)>());
+} // namespace
+
+const pixel_kernels& rasterimage::get_pixel_kernels(format pixel_format, depth channel_depth)
+{
+	if (pixel_format >= format::enum_size || channel_depth >= depth::enum_size) {
+		throw std::invalid_argument("get_pixel_kernels(): invalid pixel format or channel depth");
+	}
+
+	auto i = size_t(channel_depth) * size_t(format::enum_size) + size_t(pixel_format);
+	ASSERT(i < kernels_table.size())
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+	const auto& ret = kernels_table[i];
+	ASSERT(ret.pixel_format == pixel_format && ret.channel_depth == channel_depth)
+	return ret;
+}
+
+void rasterimage::clear(any_image_span span)
+{
+	for (uint32_t y = 0; y != span.dims().y(); ++y) {
+		auto row = span[y];
+		std::fill(row.begin(), row.end(), 0);
+	}
+}
+
+void rasterimage::flip_vertical(any_image_span span)
+{
+	if (span.empty()) {
+		return;
+	}
+	for (uint32_t upper = 0, lower = span.dims().y() - 1; upper < lower; ++upper, --lower) {
+		auto u = span[upper];
+		std::swap_ranges(u.begin(), u.end(), span[lower].begin());
+	}
+}
+
+namespace {
+template <typename kernel_type>
+void for_each_row(any_image_span span, kernel_type kernel)
+{
+	for (uint32_t y = 0; y != span.dims().y(); ++y) {
+		kernel(span[y].data(), size_t(span.dims().x()));
+	}
+}
+} // namespace
+
+void rasterimage::flip_horizontal(any_image_span span)
+{
+	for_each_row(span, get_pixel_kernels(span.get_format(), span.get_depth()).flip_horizontal);
+}
+
+void rasterimage::premultiply_alpha(any_image_span span)
+{
+	for_each_row(span, get_pixel_kernels(span.get_format(), span.get_depth()).premultiply_alpha);
+}
+
+void rasterimage::unpremultiply_alpha(any_image_span span)
+{
+	for_each_row(span, get_pixel_kernels(span.get_format(), span.get_depth()).unpremultiply_alpha);
+}
+
+void rasterimage::convert(const_any_image_span src, any_image_span dst, unsigned num_threads)
+{
+	if (src.dims() != dst.dims()) {
+		throw std::invalid_argument("convert(): source and destination dimensions differ");
+	}
+
+	if (src.empty()) {
+		return;
+	}
+
+	if (src.get_format() == dst.get_format() && src.get_depth() == dst.get_depth()) {
+		for (uint32_t y = 0; y != src.dims().y(); ++y) {
+			auto row = src[y];
+			std::memcpy(dst[y].data(), row.data(), row.size_bytes());
+		}
+		return;
+	}
+
+	const auto& src_kernels = get_pixel_kernels(src.get_format(), src.get_depth());
+	const auto& dst_kernels = get_pixel_kernels(dst.get_format(), dst.get_depth());
+
+	auto width = size_t(src.dims().x());
+
+	internal::band_partition bands(src.dims().y(), width, num_threads);
+
+	bands.for_each([&](size_t, size_t begin_row, size_t end_row) {
+		std::vector<r4::vector4<float>> rgba_row(width);
+		for (auto y = uint32_t(begin_row); y != uint32_t(end_row); ++y) {
+			src_kernels.to_rgba(src[y].data(), rgba_row.data(), width);
+			dst_kernels.from_rgba(rgba_row.data(), dst[y].data(), width);
+		}
+	});
+}
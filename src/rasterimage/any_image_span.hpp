@@ -0,0 +1,395 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include <r4/rectangle.hpp>
+#include <r4/vector.hpp>
+#include <utki/debug.hpp>
+#include <utki/span.hpp>
+
+#include "dimensioned.hpp"
+#include "format.hpp"
+#include "image_span.hpp"
+
+namespace rasterimage {
+
+/**
+ * @brief Non-owning view of image pixels with pixel type described at runtime.
+ * Unlike image_span, the pixel format and channel depth are not template parameters,
+ * so the span can describe any memory holding image pixels, e.g. shared memory, memory mapped files
+ * or images of other libraries, and operations on it are dispatched at runtime via pixel_kernels,
+ * without instantiating templates for every pixel type.
+ * The pixel data must be aligned to the channel size, rows must be stride_bytes() apart.
+ * @tparam is_const_span - whether the pixels are read-only.
+ */
+template <bool is_const_span = false>
+class basic_any_image_span : public dimensioned
+{
+public:
+	using byte_type = std::conditional_t<is_const_span, const uint8_t, uint8_t>;
+
+private:
+	byte_type* buffer = nullptr;
+	size_t stride = 0;
+	format pixel_format = format::rgba;
+	depth channel_depth = depth::uint_8_bit;
+
+public:
+	basic_any_image_span() :
+		dimensioned({0, 0})
+	{}
+
+	/**
+	 * @brief Construct span of pixels in memory.
+	 * @param dimensions - image dimensions in pixels.
+	 * @param stride_bytes - distance between starts of two consecutive rows in bytes.
+	 * @param pixel_format - pixel format.
+	 * @param channel_depth - channel depth.
+	 * @param data - pointer to the first pixel of the first row.
+	 * @throw std::invalid_argument - in case the stride is less than row size, pixel format or depth is invalid,
+	 *                                or data or stride is not aligned to the channel size.
+	 */
+	basic_any_image_span(
+		dimensions_type dimensions, //
+		size_t stride_bytes,
+		format pixel_format,
+		depth channel_depth,
+		byte_type* data
+	) :
+		dimensioned(dimensions),
+		buffer(data),
+		stride(stride_bytes),
+		pixel_format(pixel_format),
+		channel_depth(channel_depth)
+	{
+		if (pixel_format >= format::enum_size || channel_depth >= depth::enum_size) {
+			throw std::invalid_argument("any_image_span: invalid pixel format or channel depth");
+		}
+		if (dimensions.is_any_zero()) {
+			return;
+		}
+		if (data == nullptr) {
+			throw std::invalid_argument("any_image_span: null data for non-empty span");
+		}
+		if (stride_bytes < size_t(dimensions.x()) * this->pixel_size()) {
+			throw std::invalid_argument("any_image_span: stride is less than row size");
+		}
+		auto channel_size = to_channel_size(channel_depth);
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		if (reinterpret_cast<uintptr_t>(data) % channel_size != 0 || stride_bytes % channel_size != 0) {
+			throw std::invalid_argument("any_image_span: data is not aligned to channel size");
+		}
+	}
+
+	/**
+	 * @brief Construct span viewing typed image span.
+	 * @param span - image span to view.
+	 * @param pixel_format - pixel format of the span's pixels, must have same number of channels as the span.
+	 * @throw std::invalid_argument - in case the pixel format has different number of channels.
+	 */
+	template <typename channel_type, size_t num_channels, bool is_other_const_span>
+	basic_any_image_span(
+		image_span<channel_type, num_channels, is_other_const_span> span,
+		format pixel_format = to_format(num_channels)
+	) :
+		basic_any_image_span(
+			span.dims(),
+			span.stride_bytes(),
+			pixel_format,
+			to_depth<channel_type>(),
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			reinterpret_cast<byte_type*>(span.data())
+		)
+	{
+		static_assert(is_const_span || !is_other_const_span, "cannot create non-const span of const pixels");
+		if (to_num_channels(pixel_format) != num_channels) {
+			throw std::invalid_argument("any_image_span: pixel format does not match number of channels");
+		}
+	}
+
+	/**
+	 * @brief Conversion constructor from non-const span to const span.
+	 */
+	template <bool is_other_const_span, std::enable_if_t<is_const_span && !is_other_const_span, bool> = true>
+	basic_any_image_span(const basic_any_image_span<is_other_const_span>& s) :
+		dimensioned(s.dims()),
+		buffer(s.data()),
+		stride(s.stride_bytes()),
+		pixel_format(s.get_format()),
+		channel_depth(s.get_depth())
+	{}
+
+	byte_type* data() const noexcept
+	{
+		return this->buffer;
+	}
+
+	size_t stride_bytes() const noexcept
+	{
+		return this->stride;
+	}
+
+	format get_format() const noexcept
+	{
+		return this->pixel_format;
+	}
+
+	depth get_depth() const noexcept
+	{
+		return this->channel_depth;
+	}
+
+	size_t num_channels() const noexcept
+	{
+		return to_num_channels(this->pixel_format);
+	}
+
+	/**
+	 * @brief Get pixel size in bytes.
+	 */
+	size_t pixel_size() const noexcept
+	{
+		return this->num_channels() * to_channel_size(this->channel_depth);
+	}
+
+	bool empty() const noexcept
+	{
+		return this->dims().is_any_zero();
+	}
+
+	/**
+	 * @brief Get row bytes.
+	 * @param row_index - index of the row.
+	 * @return Bytes of the row's pixels, without the padding up to the stride.
+	 */
+	utki::span<byte_type> operator[](uint32_t row_index) const noexcept
+	{
+		ASSERT(row_index < this->dims().y())
+		return utki::make_span(
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			this->buffer + size_t(row_index) * this->stride,
+			size_t(this->dims().x()) * this->pixel_size()
+		);
+	}
+
+	basic_any_image_span subspan(r4::rectangle<uint32_t> rect) const
+	{
+		ASSERT(r4::rectangle<uint32_t>({0, 0}, this->dims()).contains(rect), [&](auto& o) {
+			o << "requested subspan is out of the span, this->dims() = " << this->dims() << ", rect = " << rect;
+		})
+
+		if (rect.d.is_any_zero()) {
+			return {rect.d, this->stride, this->pixel_format, this->channel_depth, nullptr};
+		}
+
+		return {
+			rect.d,
+			this->stride,
+			this->pixel_format,
+			this->channel_depth,
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			(*this)[rect.p.y()].data() + size_t(rect.p.x()) * this->pixel_size()
+		};
+	}
+
+	/**
+	 * @brief Get typed image span.
+	 * Only channel type and number of channels are checked, typed span does not know the order of channels.
+	 * @return Typed image span of the same pixels.
+	 * @throw std::invalid_argument - in case the span's pixel type is different,
+	 *                                or the stride is not a multiple of the pixel size.
+	 */
+	template <typename channel_type, size_t num_channels>
+	image_span<channel_type, num_channels, is_const_span> get() const
+	{
+		using pixel_type = r4::vector<channel_type, num_channels>;
+		if (to_depth<channel_type>() != this->channel_depth || num_channels != this->num_channels()) {
+			throw std::invalid_argument("any_image_span::get(): pixel type does not match");
+		}
+		if (this->stride % sizeof(pixel_type) != 0) {
+			throw std::invalid_argument("any_image_span::get(): stride is not a multiple of pixel size");
+		}
+		return image_span<channel_type, num_channels, is_const_span>(
+			this->dims(),
+			this->stride / sizeof(pixel_type),
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			reinterpret_cast<std::conditional_t<is_const_span, const pixel_type, pixel_type>*>(this->buffer)
+		);
+	}
+};
+
+using any_image_span = basic_any_image_span<false>;
+using const_any_image_span = basic_any_image_span<true>;
+
+namespace internal {
+template <typename channel_type, typename function_type, bool is_const_span>
+decltype(auto) visit_channels(function_type&& func, const basic_any_image_span<is_const_span>& span)
+{
+	switch (span.num_channels()) {
+		case 1:
+			return func(span.template get<channel_type, 1>());
+		case 2:
+			return func(span.template get<channel_type, 2>());
+		case 3:
+			return func(span.template get<channel_type, 3>());
+		default:
+			ASSERT(span.num_channels() == max_num_channels)
+			return func(span.template get<channel_type, max_num_channels>());
+	}
+}
+} // namespace internal
+
+/**
+ * @brief Call function with typed image span of the span's pixels.
+ * This is for code which is templated on the pixel type, the function is instantiated for all pixel types.
+ * Note, that typed image span does not know the order of channels, use get_format() to find it out.
+ * @param func - function to call. Signature: result_type(image_span<channel_type, num_channels, is_const_span>).
+ * @param span - span to call the function for.
+ * @return Value returned by the function.
+ */
+template <typename function_type, bool is_const_span>
+decltype(auto) visit(function_type&& func, const basic_any_image_span<is_const_span>& span)
+{
+	switch (span.get_depth()) {
+		case depth::uint_8_bit:
+			return internal::visit_channels<uint8_t>(std::forward<function_type>(func), span);
+		case depth::uint_16_bit:
+			return internal::visit_channels<uint16_t>(std::forward<function_type>(func), span);
+		case depth::float_16_bit:
+			return internal::visit_channels<float16>(std::forward<function_type>(func), span);
+		default:
+			ASSERT(span.get_depth() == depth::float_32_bit)
+			return internal::visit_channels<float>(std::forward<function_type>(func), span);
+	}
+}
+
+/**
+ * @brief Row kernels for one pixel type.
+ * Each kernel processes a run of pixels of a single row. Pixel pointers must be aligned to the channel size.
+ * Conversion between pixel types goes through RGBA pixels of single precision floating point channels
+ * in canonical order, so that each pixel type needs only two conversion kernels.
+ */
+struct pixel_kernels {
+	format pixel_format;
+	depth channel_depth;
+
+	/**
+	 * @brief Pixel size in bytes.
+	 */
+	size_t pixel_size;
+
+	/**
+	 * @brief Convert pixels to floating point RGBA.
+	 * Integral channels are normalized to [0:1] range, missing alpha is opaque,
+	 * grey value is replicated to RGB channels.
+	 */
+	void (*to_rgba)(const uint8_t* src, r4::vector4<float>* dst, size_t num_pixels);
+
+	/**
+	 * @brief Convert floating point RGBA pixels to this pixel type.
+	 * Integral channels are rounded to nearest value. Grey value is luminance of RGB channels.
+	 * Alpha is dropped for formats without alpha channel.
+	 */
+	void (*from_rgba)(const r4::vector4<float>* src, uint8_t* dst, size_t num_pixels);
+
+	/**
+	 * @brief Reverse order of pixels.
+	 */
+	void (*flip_horizontal)(uint8_t* pixels, size_t num_pixels);
+
+	/**
+	 * @brief Premultiply color channels by alpha.
+	 * Does nothing for formats without alpha channel.
+	 */
+	void (*premultiply_alpha)(uint8_t* pixels, size_t num_pixels);
+
+	/**
+	 * @brief Unpremultiply color channels by alpha.
+	 * Does nothing for formats without alpha channel.
+	 */
+	void (*unpremultiply_alpha)(uint8_t* pixels, size_t num_pixels);
+};
+
+/**
+ * @brief Get row kernels for pixel type.
+ * The kernels are looked up in a table indexed by format and depth.
+ * @param pixel_format - pixel format.
+ * @param channel_depth - channel depth.
+ * @return Kernels for the pixel type.
+ */
+const pixel_kernels& get_pixel_kernels(format pixel_format, depth channel_depth);
+
+/**
+ * @brief Set all bytes of the pixels to zero.
+ * I.e. transparent black for formats with alpha channel.
+ * @param span - span to clear.
+ */
+void clear(any_image_span span);
+
+/**
+ * @brief Flip image vertically.
+ * @param span - span to flip.
+ */
+void flip_vertical(any_image_span span);
+
+/**
+ * @brief Flip image horizontally.
+ * @param span - span to flip.
+ */
+void flip_horizontal(any_image_span span);
+
+/**
+ * @brief Premultiply color channels by alpha.
+ * @param span - span to premultiply. Nothing is done for formats without alpha.
+ */
+void premultiply_alpha(any_image_span span);
+
+/**
+ * @brief Unpremultiply color channels by alpha.
+ * @param span - span to unpremultiply. Nothing is done for formats without alpha.
+ */
+void unpremultiply_alpha(any_image_span span);
+
+/**
+ * @brief Convert pixels to another pixel type.
+ * Spans of same pixel type are copied row by row, otherwise pixels are converted
+ * via floating point RGBA rows, see pixel_kernels.
+ * @param src - span to convert.
+ * @param dst - span to write converted pixels to. Must have same dimensions as the source.
+ *              Must not overlap with the source.
+ * @param num_threads - maximal number of threads to use. 0 means use number of threads supported by hardware.
+ * @throw std::invalid_argument - in case source and destination dimensions differ.
+ */
+void convert(const_any_image_span src, any_image_span dst, unsigned num_threads = 1);
+
+} // namespace rasterimage
@@ -0,0 +1,252 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "batch_decoder.hpp"
+
+#include <memory>
+
+#include <fsif/memory_file.hpp>
+
+using namespace rasterimage;
+
+struct batch_decoder::batch_state {
+	const callback_type& callback;
+
+	// decode limits of the thread which called decode()
+	const decode_limits limits;
+
+	// serializes callback calls
+	std::mutex callback_mutex;
+	std::exception_ptr callback_error;
+
+	// guarded by batch_decoder::mutex
+	size_t num_remaining;
+	std::condition_variable done_cv;
+
+	batch_state(const callback_type& callback, size_t num_items) :
+		callback(callback),
+		limits(get_decode_limits()),
+		num_remaining(num_items)
+	{}
+};
+
+batch_decoder::batch_decoder(unsigned num_threads, size_t memory_budget_bytes) :
+	memory_budget_bytes(memory_budget_bytes)
+{
+	if (num_threads == 0) {
+		num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	this->threads.reserve(num_threads);
+	try {
+		for (unsigned i = 0; i != num_threads; ++i) {
+			this->threads.emplace_back([this]() {
+				this->worker_thread_func();
+			});
+		}
+	} catch (...) {
+		// destructor will not be called, so stop already started threads here
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->quit = true;
+		}
+		this->jobs_cv.notify_all();
+		for (auto& t : this->threads) {
+			t.join();
+		}
+		throw;
+	}
+}
+
+batch_decoder::~batch_decoder()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		ASSERT(this->jobs.empty())
+		this->quit = true;
+	}
+	this->jobs_cv.notify_all();
+
+	for (auto& t : this->threads) {
+		t.join();
+	}
+}
+
+void batch_decoder::worker_thread_func()
+{
+	for (;;) {
+		job j{};
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->jobs_cv.wait(lock, [this]() {
+				return this->quit || !this->jobs.empty();
+			});
+
+			if (this->jobs.empty()) {
+				ASSERT(this->quit)
+				return;
+			}
+
+			j = this->jobs.front();
+			this->jobs.pop_front();
+		}
+
+		this->process(j);
+	}
+}
+
+void batch_decoder::acquire_budget(size_t num_bytes)
+{
+	if (this->memory_budget_bytes == 0) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->budget_cv.wait(lock, [this, num_bytes]() {
+		// item which exceeds the budget alone is allowed to go when nothing else is in flight
+		return this->in_flight_bytes == 0 || this->in_flight_bytes + num_bytes <= this->memory_budget_bytes;
+	});
+	this->in_flight_bytes += num_bytes;
+}
+
+void batch_decoder::release_budget(size_t num_bytes)
+{
+	if (this->memory_budget_bytes == 0 || num_bytes == 0) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		ASSERT(this->in_flight_bytes >= num_bytes)
+		this->in_flight_bytes -= num_bytes;
+	}
+	this->budget_cv.notify_all();
+}
+
+void batch_decoder::process(const job& j)
+{
+	ASSERT(j.fi)
+	ASSERT(j.batch)
+
+	result r{j.index, image_variant(), nullptr};
+
+	size_t reserved_bytes = 0;
+
+	scoped_decode_limits limits(j.batch->limits);
+
+	try {
+		r.image = internal::read(*j.fi, [this, &reserved_bytes](const image_info& info) {
+			// reject images exceeding the limits before waiting for the memory budget
+			internal::check_decode_limits(info);
+
+			reserved_bytes = info.buffer_size_bytes();
+			this->acquire_budget(reserved_bytes);
+		});
+	} catch (...) {
+		r.error = std::current_exception();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(j.batch->callback_mutex);
+		try {
+			j.batch->callback(std::move(r));
+		} catch (...) {
+			if (!j.batch->callback_error) {
+				j.batch->callback_error = std::current_exception();
+			}
+		}
+	}
+
+	this->release_budget(reserved_bytes);
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		ASSERT(j.batch->num_remaining != 0)
+		--j.batch->num_remaining;
+		if (j.batch->num_remaining == 0) {
+			// notify under the lock, since the batch state object is destroyed right after waking up
+			j.batch->done_cv.notify_all();
+		}
+	}
+}
+
+void batch_decoder::decode(utki::span<const fsif::file* const> files, const callback_type& callback)
+{
+	if (files.empty()) {
+		return;
+	}
+
+	batch_state batch(callback, files.size());
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		for (size_t i = 0; i != files.size(); ++i) {
+			this->jobs.push_back(job{files[i], i, &batch});
+		}
+	}
+	this->jobs_cv.notify_all();
+
+	{
+		std::unique_lock<std::mutex> lock(this->mutex);
+		batch.done_cv.wait(lock, [&batch]() {
+			return batch.num_remaining == 0;
+		});
+	}
+
+	if (batch.callback_error) {
+		std::rethrow_exception(batch.callback_error);
+	}
+}
+
+void batch_decoder::decode(std::vector<std::vector<uint8_t>> buffers, const callback_type& callback)
+{
+	std::vector<std::unique_ptr<fsif::memory_file>> files;
+	files.reserve(buffers.size());
+	for (auto& b : buffers) {
+		files.push_back(std::make_unique<fsif::memory_file>(std::move(b)));
+	}
+
+	std::vector<const fsif::file*> file_ptrs;
+	file_ptrs.reserve(files.size());
+	for (const auto& f : files) {
+		file_ptrs.push_back(f.get());
+	}
+
+	this->decode(file_ptrs, callback);
+}
+
+std::vector<batch_decoder::result> batch_decoder::decode(utki::span<const fsif::file* const> files)
+{
+	std::vector<result> ret;
+	ret.reserve(files.size());
+
+	this->decode(files, [&ret](result&& r) {
+		ret.push_back(std::move(r));
+	});
+
+	return ret;
+}
@@ -0,0 +1,172 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <fsif/file.hpp>
+#include <utki/span.hpp>
+
+#include "image_variant.hpp"
+
+namespace rasterimage {
+
+/**
+ * @brief Decoder of image batches.
+ * Decodes images on an internal pool of worker threads. The pool is created once, in the constructor,
+ * and is reused by all the decode() calls. Several threads can call decode() concurrently, in this case
+ * the batches share the worker threads and the memory budget.
+ *
+ * Once a worker has read the image header it knows size of the decoded pixel buffer. Before allocating the buffer
+ * it waits until the buffer fits into the memory budget together with the images which are currently being decoded
+ * and not yet delivered. An image which alone exceeds the budget is decoded when no other images are in flight.
+ * PNG and JPEG files are read in one pass, the decoding continues after the wait.
+ * Files of other formats are probed with probe() first and then read, so those files are opened twice.
+ *
+ * Images are decoded with the decode limits of the thread which called decode(), see set_decode_limits().
+ * Images exceeding the limits are rejected right after reading the header, without waiting for the memory budget.
+ */
+class batch_decoder
+{
+public:
+	/**
+	 * @brief Result of decoding of one batch item.
+	 */
+	struct result {
+		/**
+		 * @brief Index of the item in the batch.
+		 */
+		size_t index;
+
+		/**
+		 * @brief Decoded image.
+		 * Empty image in case of error.
+		 */
+		image_variant image;
+
+		/**
+		 * @brief Decoding error.
+		 * Null if the item was decoded successfully.
+		 */
+		std::exception_ptr error;
+
+		bool ok() const noexcept
+		{
+			return !this->error;
+		}
+	};
+
+	/**
+	 * @brief Result callback.
+	 * Called from worker threads in order of completion of the items. Calls are serialized, i.e. the callback
+	 * is never called concurrently for the same batch.
+	 */
+	using callback_type = std::function<void(result&&)>;
+
+private:
+	struct batch_state;
+
+	struct job {
+		const fsif::file* fi;
+		size_t index;
+		batch_state* batch;
+	};
+
+	const size_t memory_budget_bytes;
+
+	std::mutex mutex;
+	std::condition_variable jobs_cv;
+	std::condition_variable budget_cv;
+	std::deque<job> jobs;
+	size_t in_flight_bytes = 0;
+	bool quit = false;
+
+	std::vector<std::thread> threads;
+
+	void worker_thread_func();
+	void process(const job& j);
+
+	void acquire_budget(size_t num_bytes);
+	void release_budget(size_t num_bytes);
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param num_threads - number of worker threads. 0 means use number of threads supported by hardware.
+	 * @param memory_budget_bytes - maximal total size of pixel buffers of images being decoded and not yet
+	 *                              delivered to the callback. 0 means no limit.
+	 */
+	batch_decoder(unsigned num_threads = 0, size_t memory_budget_bytes = 0);
+
+	batch_decoder(const batch_decoder&) = delete;
+	batch_decoder& operator=(const batch_decoder&) = delete;
+
+	batch_decoder(batch_decoder&&) = delete;
+	batch_decoder& operator=(batch_decoder&&) = delete;
+
+	/**
+	 * @brief Destructor.
+	 * Must not be called while there are ongoing decode() calls.
+	 */
+	~batch_decoder();
+
+	/**
+	 * @brief Decode batch of image files.
+	 * Returns after all the items are decoded and delivered to the callback.
+	 * Errors of decoding of the items are reported through result::error and do not abort the batch.
+	 * If the callback throws, the batch is still completed, and then the first exception thrown by the callback
+	 * is re-thrown from this function.
+	 * @param files - image files to decode. Files must not be opened. Image file format is detected same way as
+	 *                read() does.
+	 * @param callback - callback to deliver the results to.
+	 */
+	void decode(utki::span<const fsif::file* const> files, const callback_type& callback);
+
+	/**
+	 * @brief Decode batch of in-memory image files.
+	 * Same as decode() for files, but takes image file contents.
+	 * @param buffers - image file contents.
+	 * @param callback - callback to deliver the results to.
+	 */
+	void decode(std::vector<std::vector<uint8_t>> buffers, const callback_type& callback);
+
+	/**
+	 * @brief Decode batch of image files.
+	 * @param files - image files to decode. Files must not be opened.
+	 * @return Results in order of completion.
+	 */
+	std::vector<result> decode(utki::span<const fsif::file* const> files);
+};
+
+} // namespace rasterimage
@@ -0,0 +1,77 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "compare.hpp"
+
+#include "image_variant.hpp"
+
+using namespace rasterimage;
+
+comparison rasterimage::compare(
+	const image_variant& a, //
+	const image_variant& b,
+	const compare_options& options
+)
+{
+	if (a.variant.index() != b.variant.index()) {
+		throw std::invalid_argument("rasterimage::compare(): images have different format or depth");
+	}
+
+	return std::visit(
+		[&](const auto& image_a, const auto& image_b) -> comparison {
+			if constexpr (std::is_same_v<decltype(image_a), decltype(image_b)>) {
+				return compare(image_a.span(), image_b.span(), options);
+			} else {
+				// same variant index means same image type
+				utki::assert(false, SL);
+				return {};
+			}
+		},
+		a.variant,
+		b.variant
+	);
+}
+
+comparison rasterimage::compare(
+	const_any_image_span a, //
+	const_any_image_span b,
+	const compare_options& options
+)
+{
+	if (a.get_format() != b.get_format() || a.get_depth() != b.get_depth()) {
+		throw std::invalid_argument("rasterimage::compare(): images have different format or depth");
+	}
+
+	return visit(
+		[&](const auto& span_a) {
+			using span_type = std::remove_cv_t<std::remove_reference_t<decltype(span_a)>>;
+			using channel_type = typename span_type::pixel_type::value_type;
+			return compare(span_a, b.get<channel_type, span_type::num_channels>(), options);
+		},
+		a
+	);
+}
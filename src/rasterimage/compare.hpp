@@ -0,0 +1,435 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <r4/rectangle.hpp>
+
+#include "any_image_span.hpp"
+#include "image_span.hpp"
+#include "parallel.hpp"
+
+namespace rasterimage {
+
+class image_variant;
+
+/**
+ * @brief Result of comparison of two images.
+ */
+struct comparison {
+	/**
+	 * @brief Number of pixels which differ in at least one channel.
+	 */
+	size_t num_different_pixels = 0;
+
+	/**
+	 * @brief Maximal absolute difference of channel values.
+	 * In units of channel values, i.e. from [0:255] range for 8 bit channels.
+	 */
+	double max_abs_error = 0;
+
+	/**
+	 * @brief Bounding box of differing pixels.
+	 * Zero rectangle if images are identical.
+	 */
+	r4::rectangle<uint32_t> diff_bounding_box = {0, 0};
+
+	/**
+	 * @brief Peak signal-to-noise ratio in decibels.
+	 * Calculated over all channels. Infinity if images are identical.
+	 */
+	double psnr = std::numeric_limits<double>::infinity();
+
+	/**
+	 * @brief Mean structural similarity index.
+	 * Averaged over all 8x8 windows and all channels.
+	 * NaN if SSIM calculation was not requested.
+	 */
+	double ssim = std::numeric_limits<double>::quiet_NaN();
+
+	bool identical() const noexcept
+	{
+		return this->num_different_pixels == 0;
+	}
+};
+
+struct compare_options {
+	/**
+	 * @brief Whether to calculate SSIM.
+	 * SSIM is several times more expensive to calculate than the rest of the metrics.
+	 */
+	bool ssim = false;
+
+	/**
+	 * @brief Maximal number of threads to use.
+	 * 0 means number of threads supported by hardware.
+	 * Small images are always processed on the calling thread.
+	 */
+	unsigned num_threads = 1;
+};
+
+namespace internal {
+
+template <typename value_type>
+constexpr double channel_value_max() noexcept
+{
+	if constexpr (std::is_integral_v<value_type>) {
+		return double(std::numeric_limits<value_type>::max());
+	} else {
+		return 1.0;
+	}
+}
+
+struct difference_accumulator {
+	size_t num_different_pixels = 0;
+	double max_abs_error = 0;
+	double sum_squared_error = 0;
+	uint32_t min_x = std::numeric_limits<uint32_t>::max();
+	uint32_t max_x = 0;
+	uint32_t min_y = std::numeric_limits<uint32_t>::max();
+	uint32_t max_y = 0;
+
+	void merge(const difference_accumulator& a) noexcept
+	{
+		using std::max;
+		using std::min;
+
+		this->num_different_pixels += a.num_different_pixels;
+		this->max_abs_error = max(this->max_abs_error, a.max_abs_error);
+		this->sum_squared_error += a.sum_squared_error;
+		this->min_x = min(this->min_x, a.min_x);
+		this->max_x = max(this->max_x, a.max_x);
+		this->min_y = min(this->min_y, a.min_y);
+		this->max_y = max(this->max_y, a.max_y);
+	}
+};
+
+/**
+ * @brief Accumulate differences of two rows.
+ * Channel differences are calculated over flat arrays of channel values and the per channel loop
+ * has no branches, so that it can be vectorized. The per pixel statistics are updated only for different pixels.
+ */
+template <typename value_type, size_t num_channels>
+void accumulate_row_difference(
+	const value_type* a, //
+	const value_type* b,
+	uint32_t width,
+	uint32_t y,
+	difference_accumulator& acc
+)
+{
+	// 16 bit difference squared does not fit into 32 bits,
+	// wider integral differences squared do not fit into 64 bits, so those are calculated in floating point
+	using diff_type = std::conditional_t<
+		std::is_integral_v<value_type> && sizeof(value_type) == 1,
+		int32_t,
+		std::conditional_t<std::is_integral_v<value_type> && sizeof(value_type) == 2, int64_t, double>>;
+	using square_sum_type = std::conditional_t<std::is_integral_v<diff_type>, uint64_t, double>;
+
+	// integral sum of squared 16 bit differences of this many pixels fits into 64 bits
+	constexpr uint32_t max_chunk_width = 1 << 16;
+
+	double sum_squared_error = 0;
+	diff_type max_abs = 0;
+	size_t num_different = 0;
+	uint32_t min_x = width;
+	uint32_t max_x = 0;
+
+	// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	for (uint32_t x = 0; x != width;) {
+		auto chunk_end = x + std::min(width - x, max_chunk_width);
+		square_sum_type sum_squared = 0;
+		for (; x != chunk_end; ++x, a += num_channels, b += num_channels) {
+			diff_type pixel_max_abs = 0;
+			for (size_t c = 0; c != num_channels; ++c) {
+				auto d = diff_type(a[c]) - diff_type(b[c]);
+				auto abs_d = d < 0 ? -d : d;
+				pixel_max_abs = abs_d > pixel_max_abs ? abs_d : pixel_max_abs;
+				sum_squared += square_sum_type(d * d);
+			}
+			if (pixel_max_abs != 0) {
+				++num_different;
+				min_x = std::min(min_x, x);
+				max_x = x;
+				max_abs = std::max(max_abs, pixel_max_abs);
+			}
+		}
+		sum_squared_error += double(sum_squared);
+	}
+	// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+	if (num_different == 0) {
+		return;
+	}
+
+	acc.num_different_pixels += num_different;
+	acc.max_abs_error = std::max(acc.max_abs_error, double(max_abs));
+	acc.sum_squared_error += sum_squared_error;
+	acc.min_x = std::min(acc.min_x, min_x);
+	acc.max_x = std::max(acc.max_x, max_x);
+	acc.min_y = std::min(acc.min_y, y);
+	acc.max_y = std::max(acc.max_y, y);
+}
+
+/**
+ * @brief Calculate sum of SSIM values over windows of a band of window rows.
+ */
+template <typename value_type, size_t num_channels, bool is_a_const, bool is_b_const>
+double sum_ssim(
+	const image_span<value_type, num_channels, is_a_const>& a,
+	const image_span<value_type, num_channels, is_b_const>& b,
+	r4::vector2<uint32_t> window_size,
+	uint32_t window_step,
+	size_t begin_window_row,
+	size_t end_window_row,
+	size_t num_window_columns
+)
+{
+	constexpr double value_max = channel_value_max<value_type>();
+	constexpr double c1 = (0.01 * value_max) * (0.01 * value_max);
+	constexpr double c2 = (0.03 * value_max) * (0.03 * value_max);
+
+	const double num_window_pixels = double(window_size.x()) * double(window_size.y());
+
+	double ret = 0;
+
+	for (size_t wy = begin_window_row; wy != end_window_row; ++wy) {
+		auto y0 = uint32_t(wy * window_step);
+		for (size_t wx = 0; wx != num_window_columns; ++wx) {
+			auto x0 = uint32_t(wx * window_step);
+
+			std::array<double, num_channels> sum_a{};
+			std::array<double, num_channels> sum_b{};
+			std::array<double, num_channels> sum_aa{};
+			std::array<double, num_channels> sum_bb{};
+			std::array<double, num_channels> sum_ab{};
+
+			for (uint32_t y = y0; y != y0 + window_size.y(); ++y) {
+				auto row_a = a[y];
+				auto row_b = b[y];
+				for (uint32_t x = x0; x != x0 + window_size.x(); ++x) {
+					const auto& pa = row_a[x];
+					const auto& pb = row_b[x];
+					for (size_t c = 0; c != num_channels; ++c) {
+						auto va = double(pa[c]);
+						auto vb = double(pb[c]);
+						// NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+						sum_a[c] += va;
+						sum_b[c] += vb;
+						sum_aa[c] += va * va;
+						sum_bb[c] += vb * vb;
+						sum_ab[c] += va * vb;
+						// NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+					}
+				}
+			}
+
+			for (size_t c = 0; c != num_channels; ++c) {
+				// NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+				double mean_a = sum_a[c] / num_window_pixels;
+				double mean_b = sum_b[c] / num_window_pixels;
+				double var_a = sum_aa[c] / num_window_pixels - mean_a * mean_a;
+				double var_b = sum_bb[c] / num_window_pixels - mean_b * mean_b;
+				double cov_ab = sum_ab[c] / num_window_pixels - mean_a * mean_b;
+				// NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+
+				ret += ((2 * mean_a * mean_b + c1) * (2 * cov_ab + c2)) /
+					((mean_a * mean_a + mean_b * mean_b + c1) * (var_a + var_b + c2));
+			}
+		}
+	}
+
+	return ret;
+}
+
+} // namespace internal
+
+/**
+ * @brief Compare two images.
+ * Rows which are bytewise identical are skipped with memcmp(), so comparison of
+ * identical images costs about as much as reading them.
+ * @param a - first image span.
+ * @param b - second image span.
+ * @param options - comparison options.
+ * @return Comparison result.
+ * @throw std::invalid_argument - if image spans are of different dimensions.
+ */
+template <typename channel_type, size_t number_of_channels, bool is_a_const, bool is_b_const>
+comparison compare(
+	const image_span<channel_type, number_of_channels, is_a_const>& a,
+	const image_span<channel_type, number_of_channels, is_b_const>& b,
+	const compare_options& options = {}
+)
+{
+	if (a.dims() != b.dims()) {
+		throw std::invalid_argument("rasterimage::compare(): images have different dimensions");
+	}
+
+	comparison ret;
+
+	const auto& dims = a.dims();
+
+	if (dims.is_any_zero()) {
+		if (options.ssim) {
+			ret.ssim = 1;
+		}
+		return ret;
+	}
+
+	{
+		internal::band_partition bands(dims.y(), dims.x(), options.num_threads);
+
+		std::vector<internal::difference_accumulator> partials(bands.size());
+
+		const size_t row_bytes = size_t(dims.x()) * sizeof(typename std::remove_reference_t<decltype(a)>::pixel_type);
+
+		bands.for_each([&](size_t band_index, size_t begin_row, size_t end_row) {
+			auto& acc = partials[band_index];
+			for (auto y = uint32_t(begin_row); y != end_row; ++y) {
+				auto row_a = a[y];
+				auto row_b = b[y];
+
+				if (std::memcmp(row_a.data(), row_b.data(), row_bytes) == 0) {
+					continue;
+				}
+
+				internal::accumulate_row_difference<channel_type, number_of_channels>(
+					// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+					reinterpret_cast<const channel_type*>(row_a.data()),
+					// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+					reinterpret_cast<const channel_type*>(row_b.data()),
+					dims.x(),
+					y,
+					acc
+				);
+			}
+		});
+
+		auto& total = partials.front();
+		for (auto i = std::next(partials.begin()); i != partials.end(); ++i) {
+			total.merge(*i);
+		}
+
+		if (total.num_different_pixels != 0) {
+			ret.num_different_pixels = total.num_different_pixels;
+			ret.max_abs_error = total.max_abs_error;
+			ret.diff_bounding_box = r4::rectangle<uint32_t>(
+				{total.min_x, total.min_y}, //
+				{total.max_x - total.min_x + 1, total.max_y - total.min_y + 1}
+			);
+
+			double mse = total.sum_squared_error / (double(dims.x()) * double(dims.y()) * double(number_of_channels));
+			constexpr double value_max = internal::channel_value_max<channel_type>();
+			constexpr double decibels_multiplier = 10;
+			ret.psnr = decibels_multiplier * std::log10(value_max * value_max / mse);
+		}
+	}
+
+	if (options.ssim) {
+		if (ret.identical()) {
+			ret.ssim = 1;
+			return ret;
+		}
+
+		constexpr uint32_t ssim_window_size = 8;
+		constexpr uint32_t ssim_window_step = 4;
+
+		// for images smaller than the window, use the whole image as a single window
+		r4::vector2<uint32_t> window_size = {
+			std::min(ssim_window_size, dims.x()), //
+			std::min(ssim_window_size, dims.y())
+		};
+
+		size_t num_window_columns = (dims.x() - window_size.x()) / ssim_window_step + 1;
+		size_t num_window_rows = (dims.y() - window_size.y()) / ssim_window_step + 1;
+
+		internal::band_partition bands(
+			num_window_rows,
+			num_window_columns * ssim_window_step * ssim_window_step,
+			options.num_threads
+		);
+
+		std::vector<double> partials(bands.size(), 0);
+
+		bands.for_each([&](size_t band_index, size_t begin_row, size_t end_row) {
+			partials[band_index] = internal::sum_ssim(
+				a,
+				b,
+				window_size,
+				ssim_window_step,
+				begin_row,
+				end_row,
+				num_window_columns
+			);
+		});
+
+		double sum = 0;
+		for (auto s : partials) {
+			sum += s;
+		}
+
+		ret.ssim = sum / (double(num_window_columns) * double(num_window_rows) * double(number_of_channels));
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Compare two images.
+ * @param a - first image.
+ * @param b - second image.
+ * @param options - comparison options.
+ * @return Comparison result.
+ * @throw std::invalid_argument - if images are of different dimensions, format or depth.
+ */
+comparison compare(
+	const image_variant& a, //
+	const image_variant& b,
+	const compare_options& options = {}
+);
+
+/**
+ * @brief Compare two images.
+ * @param a - first image span.
+ * @param b - second image span.
+ * @param options - comparison options.
+ * @return Comparison result.
+ * @throw std::invalid_argument - if image spans are of different dimensions, format or depth,
+ *                                or stride of an image span is not a multiple of the pixel size.
+ */
+comparison compare(
+	const_any_image_span a, //
+	const_any_image_span b,
+	const compare_options& options = {}
+);
+
+} // namespace rasterimage
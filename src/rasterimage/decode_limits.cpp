@@ -0,0 +1,89 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "decode_limits.hpp"
+
+#include <sstream>
+
+using namespace rasterimage;
+
+namespace {
+thread_local decode_limits thread_limits;
+
+[[noreturn]] void throw_exceeded(const char* what, uint64_t value, uint64_t limit)
+{
+	std::stringstream ss;
+	ss << "rasterimage: image " << what << " of " << value << " exceeds decode limit of " << limit;
+	throw size_limit_error(ss.str());
+}
+} // namespace
+
+decode_limits rasterimage::set_decode_limits(const decode_limits& limits) noexcept
+{
+	auto ret = thread_limits;
+	thread_limits = limits;
+	return ret;
+}
+
+const decode_limits& rasterimage::get_decode_limits() noexcept
+{
+	return thread_limits;
+}
+
+void internal::check_decode_limits(const r4::vector2<uint32_t>& dims, size_t pixel_size)
+{
+	const auto& limits = thread_limits;
+
+	if (dims.x() > limits.max_width) {
+		throw_exceeded("width", dims.x(), limits.max_width);
+	}
+	if (dims.y() > limits.max_height) {
+		throw_exceeded("height", dims.y(), limits.max_height);
+	}
+
+	// product of two 32 bit values always fits into 64 bits
+	auto num_pixels = uint64_t(dims.x()) * uint64_t(dims.y());
+	if (num_pixels > limits.max_pixels) {
+		throw_exceeded("number of pixels", num_pixels, limits.max_pixels);
+	}
+
+	auto num_bytes = checked_mul(num_pixels, pixel_size);
+	if (num_bytes > limits.max_bytes) {
+		throw_exceeded("size in bytes", num_bytes, limits.max_bytes);
+	}
+
+	// make sure the buffer size is addressable
+	to_size(num_bytes);
+}
+
+void internal::check_inflate_limit(uint64_t num_bytes)
+{
+	const auto& limits = thread_limits;
+	if (num_bytes > limits.max_inflate_bytes) {
+		throw_exceeded("decompressed data size", num_bytes, limits.max_inflate_bytes);
+	}
+}
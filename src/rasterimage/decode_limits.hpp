@@ -0,0 +1,198 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include <r4/vector.hpp>
+
+namespace rasterimage {
+
+/**
+ * @brief Limits on images accepted by decoders.
+ * Decoders check the limits right after the image header is read, before any pixel buffer is allocated,
+ * so that a malicious or broken file which declares huge image dimensions cannot make the process
+ * allocate huge amounts of memory.
+ * Limits are per thread, see set_decode_limits().
+ */
+struct decode_limits {
+	/**
+	 * @brief Maximal image width in pixels.
+	 */
+	uint32_t max_width = 1'000'000; // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+
+	/**
+	 * @brief Maximal image height in pixels.
+	 */
+	uint32_t max_height = 1'000'000; // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+
+	/**
+	 * @brief Maximal number of pixels, i.e. width multiplied by height.
+	 */
+	uint64_t max_pixels = uint64_t(1) << 28; // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+
+	/**
+	 * @brief Maximal size of decoded pixel buffer in bytes.
+	 */
+	uint64_t max_bytes = uint64_t(1) << 31; // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+
+	/**
+	 * @brief Maximal number of bytes produced by zlib decompression while decoding one image.
+	 * Applies to PNG image data and to compressed raw image containers.
+	 */
+	uint64_t max_inflate_bytes = uint64_t(1) << 32; // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+
+	/**
+	 * @brief Limits which accept any image.
+	 * Image sizes are still checked for arithmetic overflow.
+	 */
+	static decode_limits unlimited() noexcept
+	{
+		return {
+			std::numeric_limits<uint32_t>::max(),
+			std::numeric_limits<uint32_t>::max(),
+			std::numeric_limits<uint64_t>::max(),
+			std::numeric_limits<uint64_t>::max(),
+			std::numeric_limits<uint64_t>::max()
+		};
+	}
+};
+
+/**
+ * @brief Image size exceeds decode limits or is not representable.
+ * Thrown by decoders when the image header declares an image which exceeds the decode limits,
+ * and by image size calculations which would overflow.
+ */
+class size_limit_error : public std::length_error
+{
+public:
+	size_limit_error(const std::string& message) :
+		std::length_error(message)
+	{}
+};
+
+/**
+ * @brief Set decode limits for the calling thread.
+ * Threads start with default constructed decode_limits.
+ * Decoding threads of batch_decoder use the limits of the thread which submitted the job.
+ * @param limits - limits to set.
+ * @return Previously set limits.
+ */
+decode_limits set_decode_limits(const decode_limits& limits) noexcept;
+
+/**
+ * @brief Get decode limits of the calling thread.
+ */
+const decode_limits& get_decode_limits() noexcept;
+
+/**
+ * @brief Set decode limits for the calling thread while the object exists.
+ * Previous limits are restored on destruction.
+ * Objects must be destroyed in reverse order of creation.
+ */
+class scoped_decode_limits
+{
+	decode_limits previous_limits;
+
+public:
+	scoped_decode_limits(const decode_limits& limits) noexcept :
+		previous_limits(set_decode_limits(limits))
+	{}
+
+	scoped_decode_limits(const scoped_decode_limits&) = delete;
+	scoped_decode_limits& operator=(const scoped_decode_limits&) = delete;
+
+	scoped_decode_limits(scoped_decode_limits&&) = delete;
+	scoped_decode_limits& operator=(scoped_decode_limits&&) = delete;
+
+	~scoped_decode_limits()
+	{
+		set_decode_limits(this->previous_limits);
+	}
+};
+
+namespace internal {
+
+/**
+ * @brief Multiply sizes.
+ * @throw size_limit_error - in case the result does not fit into 64 bits.
+ */
+inline uint64_t checked_mul(uint64_t a, uint64_t b)
+{
+	if (a != 0 && b > std::numeric_limits<uint64_t>::max() / a) {
+		throw size_limit_error("rasterimage: image size calculation overflow");
+	}
+	return a * b;
+}
+
+/**
+ * @brief Add sizes.
+ * @throw size_limit_error - in case the result does not fit into 64 bits.
+ */
+inline uint64_t checked_add(uint64_t a, uint64_t b)
+{
+	if (b > std::numeric_limits<uint64_t>::max() - a) {
+		throw size_limit_error("rasterimage: image size calculation overflow");
+	}
+	return a + b;
+}
+
+/**
+ * @brief Convert size to size_t.
+ * @throw size_limit_error - in case the size is not addressable on this platform.
+ */
+inline size_t to_size(uint64_t size)
+{
+	if (size > std::numeric_limits<size_t>::max()) {
+		throw size_limit_error("rasterimage: image size is not addressable");
+	}
+	return size_t(size);
+}
+
+/**
+ * @brief Check image dimensions against decode limits of the calling thread.
+ * To be called by decoders after the image header is read and before the pixel buffer is allocated.
+ * @param dims - image dimensions declared by the image header.
+ * @param pixel_size - size of decoded pixel in bytes.
+ * @throw size_limit_error - in case the image exceeds the limits.
+ */
+void check_decode_limits(const r4::vector2<uint32_t>& dims, size_t pixel_size);
+
+/**
+ * @brief Check number of bytes to be decompressed against decode limits of the calling thread.
+ * @param num_bytes - number of bytes the zlib decompression will produce.
+ * @throw size_limit_error - in case the number exceeds the limit.
+ */
+void check_inflate_limit(uint64_t num_bytes);
+
+} // namespace internal
+
+} // namespace rasterimage
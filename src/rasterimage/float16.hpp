@@ -0,0 +1,355 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#if defined(__F16C__)
+#	include <immintrin.h>
+#endif
+
+#include <utki/debug.hpp>
+#include <utki/span.hpp>
+
+namespace rasterimage {
+
+namespace internal {
+
+// Conversions between float and IEEE 754 half precision bits, rounding to nearest even.
+// The software versions give same results as F16C instructions, except for NaN payloads.
+
+inline uint16_t software_float_to_half_bits(float f) noexcept
+{
+	// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+	constexpr uint32_t float_infinity = uint32_t(255) << 23;
+	constexpr uint32_t half_overflow = uint32_t(127 + 16) << 23;
+	constexpr uint32_t half_min_normal = uint32_t(127 - 14) << 23;
+	constexpr uint32_t denorm_magic_bits = uint32_t((127 - 15) + (23 - 10) + 1) << 23;
+
+	uint32_t u = 0;
+	std::memcpy(&u, &f, sizeof(u));
+
+	uint32_t sign = u & 0x80000000;
+	u ^= sign;
+
+	uint32_t ret = 0;
+	if (u >= half_overflow) {
+		// infinity or NaN, NaN becomes quiet NaN
+		ret = u > float_infinity ? 0x7e00 : 0x7c00;
+	} else if (u < half_min_normal) {
+		// subnormal or zero, align mantissa bits by adding a magic number,
+		// the addition rounds to nearest even
+		float denorm_magic = 0;
+		std::memcpy(&denorm_magic, &denorm_magic_bits, sizeof(denorm_magic));
+		float a = 0;
+		std::memcpy(&a, &u, sizeof(a));
+		a += denorm_magic;
+		std::memcpy(&u, &a, sizeof(u));
+		ret = u - denorm_magic_bits;
+	} else {
+		uint32_t mantissa_odd = (u >> 13) & 1;
+		// rebias exponent and round, overflow of mantissa correctly carries to exponent
+		u += (uint32_t(15 - 127) << 23) + 0xfff + mantissa_odd;
+		ret = u >> 13;
+	}
+
+	return uint16_t(ret | (sign >> 16));
+	// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+}
+
+inline float software_half_bits_to_float(uint16_t h) noexcept
+{
+	// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+	constexpr uint32_t shifted_exponent = uint32_t(0x7c00) << 13;
+	constexpr uint32_t magic_bits = uint32_t(127 - 14) << 23;
+
+	uint32_t u = uint32_t(h & 0x7fff) << 13;
+	uint32_t exponent = u & shifted_exponent;
+	u += uint32_t(127 - 15) << 23;
+
+	if (exponent == shifted_exponent) {
+		// infinity or NaN
+		u += uint32_t(128 - 16) << 23;
+	} else if (exponent == 0) {
+		// zero or subnormal, renormalize
+		u += uint32_t(1) << 23;
+		float magic = 0;
+		std::memcpy(&magic, &magic_bits, sizeof(magic));
+		float a = 0;
+		std::memcpy(&a, &u, sizeof(a));
+		a -= magic;
+		std::memcpy(&u, &a, sizeof(u));
+	}
+
+	u |= uint32_t(h & 0x8000) << 16;
+
+	float ret = 0;
+	std::memcpy(&ret, &u, sizeof(ret));
+	return ret;
+	// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+}
+
+inline uint16_t float_to_half_bits(float f) noexcept
+{
+#if defined(__F16C__)
+	return uint16_t(_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT));
+#else
+	return software_float_to_half_bits(f);
+#endif
+}
+
+inline float half_bits_to_float(uint16_t h) noexcept
+{
+#if defined(__F16C__)
+	return _cvtsh_ss(h);
+#else
+	return software_half_bits_to_float(h);
+#endif
+}
+
+} // namespace internal
+
+/**
+ * @brief IEEE 754 half precision floating point value.
+ * Storage only type, arithmetic is done in single precision by implicit conversion to float,
+ * results are rounded back to half precision when assigned to float16.
+ * Conversions use F16C instructions when compiled for CPU which has them.
+ */
+class float16
+{
+	uint16_t bits;
+
+	struct bits_tag {};
+
+	constexpr float16(uint16_t bits, bits_tag) :
+		bits(bits)
+	{}
+
+public:
+	float16() = default;
+
+	// NOLINTNEXTLINE(google-explicit-constructor, hicpp-explicit-conversions)
+	float16(float f) noexcept :
+		bits(internal::float_to_half_bits(f))
+	{}
+
+	// NOLINTNEXTLINE(google-explicit-constructor, hicpp-explicit-conversions)
+	operator float() const noexcept
+	{
+		return internal::half_bits_to_float(this->bits);
+	}
+
+	/**
+	 * @brief Construct value from its binary representation.
+	 * @param bits - IEEE 754 half precision bits.
+	 * @return Value with given binary representation.
+	 */
+	static constexpr float16 from_bits(uint16_t bits) noexcept
+	{
+		return {bits, bits_tag{}};
+	}
+
+	/**
+	 * @brief Get binary representation of the value.
+	 * @return IEEE 754 half precision bits.
+	 */
+	constexpr uint16_t to_bits() const noexcept
+	{
+		return this->bits;
+	}
+
+	float16& operator+=(float16 v) noexcept
+	{
+		return *this = float(*this) + float(v);
+	}
+
+	float16& operator-=(float16 v) noexcept
+	{
+		return *this = float(*this) - float(v);
+	}
+
+	float16& operator*=(float16 v) noexcept
+	{
+		return *this = float(*this) * float(v);
+	}
+
+	float16& operator/=(float16 v) noexcept
+	{
+		return *this = float(*this) / float(v);
+	}
+};
+
+static_assert(sizeof(float16) == sizeof(uint16_t), "float16 has padding");
+static_assert(std::is_trivially_copyable_v<float16>, "float16 must be trivially copyable");
+
+/**
+ * @brief Check if channel type is floating point.
+ * Same as std::is_floating_point_v, but also true for float16.
+ */
+template <typename value_type>
+constexpr bool is_floating_point_v = std::is_floating_point_v<value_type> || std::is_same_v<value_type, float16>;
+
+/**
+ * @brief Convert single precision values to half precision.
+ * Uses 8-wide F16C conversion when available.
+ * @param src - values to convert.
+ * @param dst - destination for converted values. Must have same size as source.
+ */
+inline void convert(utki::span<const float> src, utki::span<float16> dst) noexcept
+{
+	ASSERT(src.size() == dst.size())
+
+	size_t i = 0;
+#if defined(__F16C__)
+	constexpr size_t simd_size = 8;
+	// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+	for (; i + simd_size <= src.size(); i += simd_size) {
+		__m256 v = _mm256_loadu_ps(std::next(src.data(), ptrdiff_t(i)));
+		_mm_storeu_si128(
+			reinterpret_cast<__m128i*>(std::next(dst.data(), ptrdiff_t(i))),
+			_mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT)
+		);
+	}
+	// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+#endif
+	for (; i != src.size(); ++i) {
+		dst[i] = src[i];
+	}
+}
+
+/**
+ * @brief Convert half precision values to single precision.
+ * Uses 8-wide F16C conversion when available.
+ * @param src - values to convert.
+ * @param dst - destination for converted values. Must have same size as source.
+ */
+inline void convert(utki::span<const float16> src, utki::span<float> dst) noexcept
+{
+	ASSERT(src.size() == dst.size())
+
+	size_t i = 0;
+#if defined(__F16C__)
+	constexpr size_t simd_size = 8;
+	// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+	for (; i + simd_size <= src.size(); i += simd_size) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(std::next(src.data(), ptrdiff_t(i))));
+		_mm256_storeu_ps(std::next(dst.data(), ptrdiff_t(i)), _mm256_cvtph_ps(v));
+	}
+	// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+#endif
+	for (; i != src.size(); ++i) {
+		dst[i] = src[i];
+	}
+}
+
+} // namespace rasterimage
+
+// specializing std::numeric_limits for user defined type is allowed
+namespace std {
+template <>
+class numeric_limits<rasterimage::float16>
+{
+	using float16 = rasterimage::float16;
+
+public:
+	static constexpr bool is_specialized = true;
+	static constexpr bool is_signed = true;
+	static constexpr bool is_integer = false;
+	static constexpr bool is_exact = false;
+	static constexpr bool has_infinity = true;
+	static constexpr bool has_quiet_NaN = true;
+	static constexpr bool has_signaling_NaN = true;
+	static constexpr std::float_denorm_style has_denorm = std::denorm_present;
+	static constexpr bool has_denorm_loss = false;
+	static constexpr std::float_round_style round_style = std::round_to_nearest;
+	static constexpr bool is_iec559 = true;
+	static constexpr bool is_bounded = true;
+	static constexpr bool is_modulo = false;
+	static constexpr int digits = 11;
+	static constexpr int digits10 = 3;
+	static constexpr int max_digits10 = 5;
+	static constexpr int radix = 2;
+	static constexpr int min_exponent = -13;
+	static constexpr int min_exponent10 = -4;
+	static constexpr int max_exponent = 16;
+	static constexpr int max_exponent10 = 4;
+	static constexpr bool traps = false;
+	static constexpr bool tinyness_before = false;
+
+	// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+	static constexpr float16 min() noexcept
+	{
+		return float16::from_bits(0x0400);
+	}
+
+	static constexpr float16 lowest() noexcept
+	{
+		return float16::from_bits(0xfbff);
+	}
+
+	static constexpr float16 max() noexcept
+	{
+		return float16::from_bits(0x7bff);
+	}
+
+	static constexpr float16 epsilon() noexcept
+	{
+		return float16::from_bits(0x1400);
+	}
+
+	static constexpr float16 round_error() noexcept
+	{
+		return float16::from_bits(0x3800);
+	}
+
+	static constexpr float16 infinity() noexcept
+	{
+		return float16::from_bits(0x7c00);
+	}
+
+	static constexpr float16 quiet_NaN() noexcept
+	{
+		return float16::from_bits(0x7e00);
+	}
+
+	static constexpr float16 signaling_NaN() noexcept
+	{
+		return float16::from_bits(0x7d00);
+	}
+
+	static constexpr float16 denorm_min() noexcept
+	{
+		return float16::from_bits(0x0001);
+	}
+
+	// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+};
+} // namespace std
@@ -0,0 +1,172 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "float16.hpp"
+
+namespace rasterimage {
+
+enum class depth {
+	uint_8_bit,
+	uint_16_bit,
+	float_32_bit,
+	float_16_bit,
+
+	enum_size
+};
+
+template <depth depth_enum>
+using depth_type_t = std::conditional_t<
+	depth_enum == depth::uint_8_bit,
+	uint8_t,
+	std::conditional_t<
+		depth_enum == depth::uint_16_bit,
+		uint16_t,
+		std::conditional_t<
+			depth_enum == depth::float_32_bit,
+			float,
+			std::conditional_t<depth_enum == depth::float_16_bit, float16, void>>>>;
+
+/**
+ * @brief Get size of a channel value in bytes.
+ * @param d - depth to get channel value size of.
+ * @return Size of a channel value in bytes.
+ */
+inline constexpr size_t to_channel_size(depth d)
+{
+	switch (d) {
+		case depth::uint_8_bit:
+			return sizeof(uint8_t);
+		case depth::uint_16_bit:
+			return sizeof(uint16_t);
+		case depth::float_32_bit:
+			return sizeof(float);
+		case depth::float_16_bit:
+			return sizeof(float16);
+		case depth::enum_size:
+			break;
+	}
+	return 0;
+}
+
+/**
+ * @brief Get depth corresponding to channel value type.
+ * @tparam channel_type - channel value type.
+ * @return Depth corresponding to the channel value type.
+ */
+template <typename channel_type>
+constexpr depth to_depth()
+{
+	if constexpr (std::is_same_v<channel_type, uint8_t>) {
+		return depth::uint_8_bit;
+	} else if constexpr (std::is_same_v<channel_type, uint16_t>) {
+		return depth::uint_16_bit;
+	} else if constexpr (std::is_same_v<channel_type, float16>) {
+		return depth::float_16_bit;
+	} else {
+		static_assert(std::is_same_v<channel_type, float>, "unsupported channel type");
+		return depth::float_32_bit;
+	}
+}
+
+/**
+ * @brief Pixel format.
+ * Formats with the same number of channels have the same pixel type, they only differ in the order of channels.
+ * The grey, greya, rgb and rgba formats are the canonical ones, i.e. channels are in the order which
+ * image operations assume, e.g. see get_rgba().
+ */
+enum class format {
+	grey,
+	gray = grey,
+	greya,
+	graya = greya,
+	rgb,
+	rgba,
+	bgr,
+	bgra,
+	argb,
+
+	enum_size
+};
+
+/**
+ * @brief Maximal number of channels of a pixel format.
+ */
+constexpr size_t max_num_channels = 4;
+
+inline constexpr size_t to_num_channels(format f)
+{
+	switch (f) {
+		case format::grey:
+			return 1;
+		case format::greya:
+			return 2;
+		case format::rgb:
+		case format::bgr:
+			return 3;
+		case format::rgba:
+		case format::bgra:
+		case format::argb:
+			return max_num_channels;
+		case format::enum_size:
+			break;
+	}
+	return 0;
+}
+
+/**
+ * @brief Get canonical pixel format for the number of channels.
+ * @param num_channels - number of channels, from [1:4] range.
+ * @return One of grey, greya, rgb or rgba formats.
+ */
+inline constexpr format to_format(unsigned num_channels)
+{
+#ifdef DEBUG
+	if (num_channels < 1 || max_num_channels < num_channels) {
+		throw std::logic_error("num_channels out of range");
+	}
+#endif
+	return format(num_channels - 1);
+}
+
+/**
+ * @brief Get canonical pixel format with the same number of channels.
+ * @param f - pixel format.
+ * @return One of grey, greya, rgb or rgba formats.
+ */
+inline constexpr format to_canonical(format f)
+{
+	return to_format(unsigned(to_num_channels(f)));
+}
+
+} // namespace rasterimage
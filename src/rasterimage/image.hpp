@@ -30,8 +30,10 @@ SOFTWARE.
 #include <utki/debug.hpp>
 #include <utki/span.hpp>
 
+#include "decode_limits.hpp"
 #include "dimensioned.hpp"
 #include "image_span.hpp"
+#include "memory.hpp"
 #include "operations.hpp"
 
 // TODO: doxygen
@@ -56,16 +58,48 @@ public:
 	);
 
 private:
+	// must be initialized before the buffer, so that the soft memory limit is checked before allocation
+	internal::memory_ticket ticket;
+
 	std::vector<pixel_type> buffer;
 
+	// number of pixels of the image, checks that the pixel buffer size in bytes is representable
+	static size_t to_num_pixels(dimensions_type dimensions)
+	{
+		// product of two 32 bit values always fits into 64 bits
+		auto num_pixels = uint64_t(dimensions.x()) * uint64_t(dimensions.y());
+		internal::to_size(internal::checked_mul(num_pixels, sizeof(pixel_type)));
+		return size_t(num_pixels);
+	}
+
+	static internal::memory_ticket make_ticket(size_t num_pixels)
+	{
+		return {
+			num_pixels * sizeof(pixel_type), //
+			internal::memory_bucket_index<channel_type, num_channels>()
+		};
+	}
+
+	struct num_pixels_tag {};
+
+	// the number of pixels is passed separately, so that it is calculated only once
+	image(
+		dimensions_type dimensions, //
+		size_t num_pixels,
+		num_pixels_tag
+	) :
+		dimensioned(dimensions),
+		ticket(make_ticket(num_pixels)),
+		buffer(num_pixels)
+	{}
+
 public:
 	image() :
 		image(dimensions_type{0, 0})
 	{}
 
 	image(dimensions_type dimensions) :
-		dimensioned(dimensions),
-		buffer(dimensions.x() * dimensions.y())
+		image(dimensions, to_num_pixels(dimensions), num_pixels_tag{})
 	{}
 
 	image(
@@ -82,9 +116,10 @@ public:
 		decltype(buffer) buffer
 	) :
 		dimensioned(dimensions),
+		ticket(make_ticket(buffer.size())),
 		buffer(std::move(buffer))
 	{
-		ASSERT(this->dims().x() * this->dims().y() == this->pixels().size(), [this](auto& o) {
+		ASSERT(size_t(this->dims().x()) * size_t(this->dims().y()) == this->pixels().size(), [this](auto& o) {
 			o << "rasterimage::image::image(dims, buffer): dimensions do not match with pixels array size"
 			  << "\n";
 			o << "\t"
@@ -119,12 +154,12 @@ public:
 
 	utki::span<pixel_type> operator[](uint32_t line_index) noexcept
 	{
-		return utki::make_span(&this->buffer[this->dims().x() * line_index], this->dims().x());
+		return utki::make_span(&this->buffer[size_t(this->dims().x()) * line_index], this->dims().x());
 	}
 
 	utki::span<const pixel_type> operator[](uint32_t line_index) const noexcept
 	{
-		return utki::make_span(&this->buffer[this->dims().x() * line_index], this->dims().x());
+		return utki::make_span(&this->buffer[size_t(this->dims().x()) * line_index], this->dims().x());
 	}
 
 	static image make(
@@ -134,12 +169,12 @@ public:
 	)
 	{
 		if (stride_in_values == 0) {
-			stride_in_values = dims.x() * num_channels;
+			stride_in_values = size_t(dims.x()) * num_channels;
 		}
 
 		image im(dims);
 
-		auto num_values_per_row = im.dims().x() * num_channels;
+		auto num_values_per_row = size_t(im.dims().x()) * num_channels;
 
 		auto src_row = data;
 
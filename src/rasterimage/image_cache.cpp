@@ -0,0 +1,255 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "image_cache.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+#include <fsif/memory_file.hpp>
+#include <fsif/native_file.hpp>
+#include <utki/debug.hpp>
+
+using namespace rasterimage;
+
+image_cache::image_cache(size_t memory_budget_bytes, size_t num_shards) :
+	shard_budget_bytes([&]() {
+		if (num_shards == 0) {
+			throw std::invalid_argument("image_cache: number of shards must be greater than zero");
+		}
+		return memory_budget_bytes / num_shards;
+	}())
+{
+	this->shards.reserve(num_shards);
+	for (size_t i = 0; i != num_shards; ++i) {
+		this->shards.push_back(std::make_unique<shard>());
+	}
+}
+
+image_cache::key_type image_cache::make_file_key(const std::string& path)
+{
+	auto size = std::filesystem::file_size(path);
+	auto mtime = std::filesystem::last_write_time(path).time_since_epoch().count();
+
+	std::stringstream ss;
+	ss << path << '\n' << size << '\n' << mtime;
+	return ss.str();
+}
+
+image_cache::key_type image_cache::make_content_key(utki::span<const uint8_t> data)
+{
+	// 64 bit FNV-1a hash
+	constexpr uint64_t fnv_offset_basis = 0xcbf29ce484222325;
+	constexpr uint64_t fnv_prime = 0x100000001b3;
+
+	uint64_t hash = fnv_offset_basis;
+	for (auto b : data) {
+		hash ^= b;
+		hash *= fnv_prime;
+	}
+
+	std::stringstream ss;
+	ss << std::hex << std::setw(sizeof(hash) * 2) << std::setfill('0') << hash << std::dec << ':' << data.size();
+	return ss.str();
+}
+
+image_cache::shard& image_cache::get_shard(const key_type& key)
+{
+	ASSERT(!this->shards.empty())
+	return *this->shards[std::hash<key_type>()(key) % this->shards.size()];
+}
+
+shared_image image_cache::get(const key_type& key, const decoder_type& decoder)
+{
+	return this->get(key, decoder, {});
+}
+
+shared_image image_cache::get(const key_type& key, const decoder_type& decoder, utki::span<const uint8_t> content)
+{
+	auto& s = this->get_shard(key);
+
+	std::promise<shared_image> promise;
+	std::shared_future<shared_image> future;
+	bool is_decoding = false;
+
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+
+		auto i = s.entries.find(key);
+		if (i == s.entries.end()) {
+			++this->num_misses;
+			future = promise.get_future().share();
+			auto& e = s.entries[key];
+			e.image = future;
+			e.content.assign(content.begin(), content.end());
+			is_decoding = true;
+		} else if (!std::equal(i->second.content.begin(), i->second.content.end(), content.begin(), content.end())) {
+			// key collision, decode without caching
+			++this->num_misses;
+		} else {
+			++this->num_hits;
+			auto& e = i->second;
+			if (e.decoded) {
+				s.lru.splice(s.lru.begin(), s.lru, e.lru_pos);
+			} else {
+				++this->num_coalesced;
+			}
+			future = e.image;
+		}
+	}
+
+	if (!is_decoding) {
+		if (!future.valid()) {
+			return shared_image(decoder());
+		}
+		// waits in case the image is being decoded by another request
+		return future.get();
+	}
+
+	// decode outside of the lock, so that other images of the shard can be served meanwhile
+	shared_image im;
+	try {
+		im = shared_image(decoder());
+	} catch (...) {
+		{
+			std::lock_guard<std::mutex> lock(s.mutex);
+			s.entries.erase(key);
+		}
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+		this->insert(s, key, im);
+	}
+
+	promise.set_value(im);
+
+	return im;
+}
+
+void image_cache::insert(shard& s, const key_type& key, const shared_image& im)
+{
+	auto i = s.entries.find(key);
+	ASSERT(i != s.entries.end())
+	auto& e = i->second;
+	ASSERT(!e.decoded)
+
+	auto span = im.span();
+	size_t size_bytes = size_t(span.dims().x()) * size_t(span.dims().y()) * span.pixel_size() + e.content.size();
+
+	if (size_bytes > this->shard_budget_bytes) {
+		// too big to be cached, coalesced requests still get the image through the future
+		s.entries.erase(i);
+		return;
+	}
+
+	e.decoded = true;
+	e.size_bytes = size_bytes;
+	s.lru.push_front(key);
+	e.lru_pos = s.lru.begin();
+	s.size_bytes += size_bytes;
+
+	while (s.size_bytes > this->shard_budget_bytes) {
+		// the inserted image fits the budget, so it is never evicted here
+		ASSERT(s.lru.size() > 1)
+		this->evict(s);
+	}
+}
+
+void image_cache::evict(shard& s)
+{
+	ASSERT(!s.lru.empty())
+
+	auto i = s.entries.find(s.lru.back());
+	ASSERT(i != s.entries.end())
+	ASSERT(i->second.decoded)
+
+	ASSERT(s.size_bytes >= i->second.size_bytes)
+	s.size_bytes -= i->second.size_bytes;
+
+	s.entries.erase(i);
+	s.lru.pop_back();
+
+	++this->num_evictions;
+}
+
+shared_image image_cache::read(const std::string& path)
+{
+	return this->get(make_file_key(path), [&path]() {
+		return rasterimage::read(fsif::native_file(path));
+	});
+}
+
+shared_image image_cache::read(const fsif::file& fi)
+{
+	auto data = fi.load();
+	auto key = make_content_key(data);
+	return this->get(
+		key,
+		[&data]() {
+			// the contents are copied to the cache entry before decoding, so the data can be moved
+			return rasterimage::read(fsif::memory_file(std::move(data)));
+		},
+		data
+	);
+}
+
+void image_cache::clear()
+{
+	for (auto& s : this->shards) {
+		std::lock_guard<std::mutex> lock(s->mutex);
+		for (const auto& key : s->lru) {
+			s->entries.erase(key);
+		}
+		s->lru.clear();
+		s->size_bytes = 0;
+	}
+}
+
+image_cache::metrics image_cache::get_metrics()
+{
+	metrics ret{
+		this->num_hits.load(),
+		this->num_misses.load(),
+		this->num_coalesced.load(),
+		this->num_evictions.load(),
+		0,
+		0
+	};
+
+	for (auto& s : this->shards) {
+		std::lock_guard<std::mutex> lock(s->mutex);
+		ret.num_images += s->lru.size();
+		ret.size_bytes += s->size_bytes;
+	}
+
+	return ret;
+}
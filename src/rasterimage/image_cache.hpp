@@ -0,0 +1,219 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fsif/file.hpp>
+
+#include "shared_image.hpp"
+
+namespace rasterimage {
+
+/**
+ * @brief In-process cache of decoded images.
+ * Images are kept until the total size of their pixel buffers exceeds the memory budget,
+ * then least recently used images are evicted.
+ * The cache is split into shards by key, each shard has its own lock and its own part of the memory budget,
+ * so that threads requesting different images rarely contend.
+ * Concurrent requests of the same image which is not in the cache are coalesced,
+ * i.e. the image is decoded only once, by the first request, and the other requests wait for it.
+ * All member functions are thread-safe.
+ */
+class image_cache
+{
+public:
+	using key_type = std::string;
+
+	/**
+	 * @brief Function which decodes the image on cache miss.
+	 */
+	using decoder_type = std::function<image_variant()>;
+
+	/**
+	 * @brief Cache statistics.
+	 */
+	struct metrics {
+		/**
+		 * @brief Number of requests served without decoding, including coalesced ones.
+		 */
+		uint64_t hits;
+
+		/**
+		 * @brief Number of requests which decoded the image.
+		 */
+		uint64_t misses;
+
+		/**
+		 * @brief Number of requests which waited for the image being decoded by another request.
+		 */
+		uint64_t coalesced;
+
+		/**
+		 * @brief Number of images evicted to fit the memory budget.
+		 */
+		uint64_t evictions;
+
+		/**
+		 * @brief Number of images in the cache.
+		 */
+		size_t num_images;
+
+		/**
+		 * @brief Total size of pixel buffers of images in the cache in bytes,
+		 * including file contents kept for images cached by contents.
+		 */
+		size_t size_bytes;
+	};
+
+private:
+	struct entry {
+		std::shared_future<shared_image> image;
+
+		// position in LRU list, only decoded images are in the list
+		std::list<key_type>::iterator lru_pos;
+		bool decoded = false;
+
+		// file contents for images cached by make_content_key(), compared on each hit
+		std::vector<uint8_t> content;
+
+		size_t size_bytes = 0;
+	};
+
+	struct shard {
+		std::mutex mutex;
+
+		std::unordered_map<key_type, entry> entries;
+
+		// most recently used keys first
+		std::list<key_type> lru;
+
+		size_t size_bytes = 0;
+	};
+
+	const size_t shard_budget_bytes;
+
+	std::vector<std::unique_ptr<shard>> shards;
+
+	std::atomic<uint64_t> num_hits{0};
+	std::atomic<uint64_t> num_misses{0};
+	std::atomic<uint64_t> num_coalesced{0};
+	std::atomic<uint64_t> num_evictions{0};
+
+	shard& get_shard(const key_type& key);
+
+	shared_image get(const key_type& key, const decoder_type& decoder, utki::span<const uint8_t> content);
+
+	void insert(shard& s, const key_type& key, const shared_image& im);
+	void evict(shard& s);
+
+public:
+	/**
+	 * @brief Constructor.
+	 * @param memory_budget_bytes - maximal total size of pixel buffers of images in the cache.
+	 *                              Images bigger than the budget's share of one shard are not cached.
+	 * @param num_shards - number of shards. Must be greater than zero.
+	 * @throw std::invalid_argument - in case num_shards is zero.
+	 */
+	image_cache(size_t memory_budget_bytes, size_t num_shards = 16);
+
+	image_cache(const image_cache&) = delete;
+	image_cache& operator=(const image_cache&) = delete;
+
+	image_cache(image_cache&&) = delete;
+	image_cache& operator=(image_cache&&) = delete;
+
+	~image_cache() = default;
+
+	/**
+	 * @brief Make key identifying file by its path, size and modification time.
+	 * Modified file gets other key, so stale images are not returned, they are evicted eventually.
+	 * @param path - path to file in the native file system.
+	 * @return Key of the file.
+	 * @throw std::filesystem::filesystem_error - in case file status could not be obtained.
+	 */
+	static key_type make_file_key(const std::string& path);
+
+	/**
+	 * @brief Make key identifying file by its contents.
+	 * The hash is not collision resistant, different contents can be crafted to have the same key.
+	 * So, the key alone must not be used to identify untrusted contents, read(const fsif::file&)
+	 * compares the contents on each hit in addition to the key.
+	 * @param data - file contents.
+	 * @return Key of the file contents, a 64 bit hash and size of the contents.
+	 */
+	static key_type make_content_key(utki::span<const uint8_t> data);
+
+	/**
+	 * @brief Get image from the cache, decode it on cache miss.
+	 * In case the decoder throws, the exception is re-thrown from this function, also to all the coalesced
+	 * requests, and nothing is cached, so that next request tries to decode the image again.
+	 * @param key - image key.
+	 * @param decoder - function which decodes the image in case it is not in the cache.
+	 * @return The image.
+	 */
+	shared_image get(const key_type& key, const decoder_type& decoder);
+
+	/**
+	 * @brief Read image file from native file system through the cache.
+	 * The file is identified by make_file_key().
+	 * @param path - path to the image file.
+	 * @return The image, as read() returns it.
+	 */
+	shared_image read(const std::string& path);
+
+	/**
+	 * @brief Read image file through the cache.
+	 * The file is loaded to memory and identified by make_content_key(), so it is
+	 * read on each request, but only decoded on cache miss.
+	 * The cache keeps the file contents along with the image and compares them on each hit,
+	 * in case of a key collision the file is decoded and the image is not cached.
+	 * @param fi - image file. Must not be opened.
+	 * @return The image, as read() returns it.
+	 */
+	shared_image read(const fsif::file& fi);
+
+	/**
+	 * @brief Remove all decoded images from the cache.
+	 * Images being decoded are not affected.
+	 */
+	void clear();
+
+	metrics get_metrics();
+};
+
+} // namespace rasterimage
@@ -26,6 +26,8 @@ SOFTWARE.
 
 #pragma once
 
+#include <algorithm>
+
 #include <r4/rectangle.hpp>
 #include <utki/views.hpp>
 
@@ -163,7 +165,7 @@ private:
 
 		iterator_internal& operator+=(difference_type d) noexcept
 		{
-			this->line = utki::make_span(this->line.data() + d * this->stride_px, this->line.size());
+			this->line = utki::make_span(this->line.data() + d * difference_type(this->stride_px), this->line.size());
 
 			return *this;
 		}
@@ -286,9 +288,9 @@ public:
 		return this->buffer;
 	}
 
-	unsigned stride_pixels() const noexcept
+	size_t stride_pixels() const noexcept
 	{
-		return unsigned(this->stride_px);
+		return this->stride_px;
 	}
 
 	size_t stride_bytes() const noexcept
@@ -357,7 +359,7 @@ public:
 
 	utki::span<const pixel_type> operator[](uint32_t line_index) const noexcept
 	{
-		return *utki::next(this->begin(), line_index);
+		return *utki::next(this->cbegin(), line_index);
 	}
 
 	image_span subspan(r4::rectangle<uint32_t> rect) noexcept
@@ -483,6 +485,15 @@ public:
 			}
 		}
 	}
+
+	void flip_horizontal() noexcept
+	{
+		static_assert(!is_const_span, "image_span is const, cannot flip horizontal");
+
+		for (auto l : *this) {
+			std::reverse(l.begin(), l.end());
+		}
+	}
 };
 
 template <
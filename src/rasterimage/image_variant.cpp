@@ -26,18 +26,13 @@ SOFTWARE.
 
 #include "image_variant.hpp"
 
+#include <cctype>
 #include <stdexcept>
 #include <string>
 
-// JPEG lib does not have 'extern "C"{}' :-(, so we put it outside of their .h
-// or will have linking problems otherwise because
-// of "_" symbol in front of C-function names
-extern "C" {
-#include <jpeglib.h>
-}
-
-#include <png.h>
-#include <utki/config.hpp>
+#include "pnm.hpp"
+#include "qoi.hpp"
+#include "raw.hpp"
 
 using namespace std::string_literals;
 
@@ -55,13 +50,6 @@ std::array<factory_type, sizeof...(index)> make_factories_array(std::index_seque
 	}...};
 }
 
-size_t image_variant::to_variant_index(format pixel_format, depth channel_depth)
-{
-	auto ret = size_t(channel_depth) * size_t(format::enum_size) + size_t(pixel_format);
-	ASSERT(ret < std::variant_size_v<image_variant::variant_type>)
-	return ret;
-}
-
 image_variant::image_variant(const r4::vector2<uint32_t>& dimensions, format pixel_format, depth channel_depth) :
 	variant([&]() {
 		const static auto factories_array =
@@ -130,531 +118,342 @@ size_t image_variant::buffer_size() const noexcept
 	}
 }
 
-namespace {
-void png_write_callback(png_structp png_ptr, png_bytep data, png_size_t length)
+any_image_span image_variant::span() noexcept
 {
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-	auto fi = reinterpret_cast<fsif::file*>(png_get_io_ptr(png_ptr));
-	ASSERT(fi)
-
-	ASSERT(fi->is_open())
-
-	// TODO: check return value
-	fi->write(utki::make_span(data, length));
+	try {
+		ASSERT(!this->variant.valueless_by_exception())
+		return std::visit(
+			[this](auto& im) {
+				return any_image_span(im.span(), this->get_format());
+			},
+			this->variant
+		);
+	} catch (std::bad_variant_access&) {
+		// this->variant must never be valueless_by_exeception,
+		// so should never reach here
+		ASSERT(false)
+		abort();
+	}
 }
 
-void png_flush_callback(png_structp /* png_ptr */)
+const_any_image_span image_variant::span() const noexcept
 {
-	// do nothing
+	return const_cast<image_variant*>(this)->span(); // NOLINT(cppcoreguidelines-pro-type-const-cast)
 }
-} // namespace
 
-void image_variant::write_png(const fsif::file& fi) const
+namespace {
+enum class image_file_format {
+	unknown,
+	png,
+	jpeg,
+	raw,
+	qoi,
+	pnm
+};
+
+image_file_format detect_file_format(const fsif::file& fi)
 {
-	if (this->get_depth() != rasterimage::depth::uint_8_bit) {
-		// TODO: add support for writing 16 bit images
-		throw std::logic_error("writing of only 8 bit images is currently supported");
+	auto suffix = fi.suffix();
+
+	if (suffix == "png") {
+		return image_file_format::png;
+	} else if (suffix == "jpg" || suffix == "jpeg") {
+		return image_file_format::jpeg;
+	} else if (suffix == "rimg") {
+		return image_file_format::raw;
+	} else if (suffix == "qoi") {
+		return image_file_format::qoi;
+	} else if (suffix == "pgm" || suffix == "ppm" || suffix == "pam" || suffix == "pnm") {
+		return image_file_format::pnm;
 	}
 
-	if (this->get_format() != rasterimage::format::rgba) {
-		// TODO: support writing of non-RGBA images
-		throw std::logic_error("writing of non RGBA iamges is currently not supported");
+	// unknown suffix, e.g. memory file, detect by file signature
+
+	constexpr size_t png_sig_size = 8;
+	std::array<uint8_t, png_sig_size> sig = {0};
+
+	size_t num_bytes_read = 0;
+	{
+		fsif::file::guard file_guard(fi);
+		num_bytes_read = fi.read(utki::make_span(sig));
 	}
 
-	fsif::file::guard file_guard(
-		fi, //
-		fsif::mode::create
-	);
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+	constexpr std::array<uint8_t, png_sig_size> png_sig = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	if (num_bytes_read == png_sig_size && sig == png_sig) {
+		return image_file_format::png;
+	}
 
-	png_structp png_ptr = nullptr;
-	png_infop info_ptr = nullptr;
+	// JPEG file starts with SOI marker followed by another marker
+	constexpr uint8_t jpeg_marker_prefix = 0xff;
+	constexpr uint8_t jpeg_soi_marker = 0xd8;
+	if (num_bytes_read >= 3 && sig[0] == jpeg_marker_prefix && sig[1] == jpeg_soi_marker &&
+		sig[2] == jpeg_marker_prefix)
+	{
+		return image_file_format::jpeg;
+	}
 
-	// Initialize write structure
-	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-	if (png_ptr == nullptr) {
-		throw std::runtime_error("Could not allocate PNG write struct");
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+	constexpr std::array<uint8_t, png_sig_size> raw_sig = {0x89, 'R', 'I', 'M', 'G', '\r', '\n', 0x1a};
+	if (num_bytes_read == png_sig_size && sig == raw_sig) {
+		return image_file_format::raw;
 	}
-	utki::scope_exit png_scope_exit([&png_ptr]() {
-		png_destroy_write_struct(&png_ptr, nullptr);
-	});
-
-	// Initialize info structure
-	info_ptr = png_create_info_struct(png_ptr);
-	if (info_ptr == nullptr) {
-		throw std::runtime_error("Could not allocate PNG info struct");
+
+	constexpr std::array<uint8_t, 4> qoi_sig = {'q', 'o', 'i', 'f'};
+	if (num_bytes_read >= qoi_sig.size() && std::equal(qoi_sig.begin(), qoi_sig.end(), sig.begin())) {
+		return image_file_format::qoi;
 	}
-	utki::scope_exit info_scope_exit([&png_ptr, &info_ptr]() {
-		png_free_data(png_ptr, info_ptr, PNG_FREE_ALL, -1);
-	});
-
-	auto dims = this->dims();
-
-	png_set_write_fn(
-		png_ptr,
-		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
-		const_cast<fsif::file*>(&fi), // png_set_write_fn() expects non-const void*
-		&png_write_callback,
-		&png_flush_callback
-	);
-
-	// write header (8 bit color depth)
-	png_set_IHDR(
-		png_ptr,
-		info_ptr,
-		dims.x(),
-		dims.y(),
-		// get bits per channel
-		std::visit(
-			[](const auto& im) -> int {
-				using value_type = typename std::remove_reference_t<decltype(im)>::pixel_type::value_type;
-				if constexpr (!std::is_same_v<value_type, uint8_t> && !std::is_same_v<value_type, uint16_t>) {
-					throw std::invalid_argument("write_png(): PNG supports only 8 bit or 16 bit per channel images");
-				} else {
-					return int(sizeof(value_type) * utki::byte_bits);
-				}
-			},
-			this->variant
-		),
-		// get PNG color format
-		[this]() {
-			switch (this->get_format()) {
-				case rasterimage::format::enum_size:
-					utki::assert(false, SL);
-					[[fallthrough]];
-				case rasterimage::format::grey:
-					return PNG_COLOR_TYPE_GRAY;
-				case rasterimage::format::greya:
-					return PNG_COLOR_TYPE_GRAY_ALPHA;
-				case rasterimage::format::rgb:
-					return PNG_COLOR_TYPE_RGB;
-				case rasterimage::format::rgba:
-					return PNG_COLOR_TYPE_RGB_ALPHA;
-			}
-			utki::assert(false, SL);
-			return PNG_COLOR_TYPE_GRAY;
-		}(),
-		PNG_INTERLACE_NONE,
-		PNG_COMPRESSION_TYPE_BASE,
-		PNG_FILTER_TYPE_BASE
-	);
-
-	png_write_info(png_ptr, info_ptr);
-
-	// write image data
-	auto p = std::visit(
-		[](const auto& im) {
-			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-			return reinterpret_cast<png_const_bytep>(im.pixels().data());
-		},
-		this->variant
-	);
-	auto stride = std::visit(
-		[](const auto& im) {
-			return sizeof(typename std::remove_reference_t<decltype(im)>::pixel_type) * im.dims().x();
-		},
-		this->variant
-	);
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-	for (uint32_t y = 0; y != dims.y(); ++y, p += stride) {
-		png_write_row(png_ptr, p);
+
+	// binary PGM, PPM or PAM magic followed by whitespace
+	if (num_bytes_read >= 3 && sig[0] == 'P' && '5' <= sig[1] && sig[1] <= '7' && std::isspace(sig[2])) {
+		return image_file_format::pnm;
 	}
 
-	png_write_end(png_ptr, nullptr);
+	return image_file_format::unknown;
 }
 
-image_variant rasterimage::read(const fsif::file& fi)
+// raw and QOI images are decoded as is, so conversions are done after decoding
+image_variant convert_decoded(image_variant im, format pixel_format, depth channel_depth)
 {
-	auto suffix = fi.suffix();
-
-	if (suffix == "png") {
-		return rasterimage::read_png(fi);
-	} else if (suffix == "jpg") {
-		return rasterimage::read_jpeg(fi);
-	} else {
-		throw std::invalid_argument("rasterimage::read(): unknown image file format, suffix = "s + suffix);
+	if (im.get_format() == pixel_format && im.get_depth() == channel_depth) {
+		return im;
 	}
+	image_variant ret(im.dims(), pixel_format, channel_depth);
+	convert(im.span(), ret.span());
+	return ret;
 }
 
-namespace {
-void png_read_callback(png_structp png_ptr, png_bytep data, png_size_t length)
+void convert_decoded(const image_variant& im, any_image_span dst)
 {
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-	auto fi = reinterpret_cast<const fsif::file*>(png_get_io_ptr(png_ptr));
-	ASSERT(fi)
-
-	// TODO: get number of bytes read and check for EOF, rise error if needed
-	fi->read(utki::make_span(data, length));
+	if (im.dims() != dst.dims()) {
+		throw std::invalid_argument("destination image span dimensions do not match image dimensions");
+	}
+	convert(im.span(), dst);
 }
-} // namespace
 
-image_variant rasterimage::read_png(const fsif::file& fi)
+image_variant crop_decoded(const image_variant& im, const r4::rectangle<uint32_t>& roi)
 {
-	ASSERT(!fi.is_open())
-
-	// open file
-	fsif::file::guard file_guard(fi);
-
-	static const unsigned png_sig_size = 8; // the size of PNG signature
-
-	{
-		std::array<png_byte, png_sig_size> sig = {0};
-		auto span = utki::make_span(sig);
-
-		auto num_bytes_read = fi.read(span);
-		if (num_bytes_read != span.size_bytes()) {
-			throw std::invalid_argument("rasterimage::read_png(): could not read file signature");
-		}
-
-		// check that it is a PNG file
-		if (png_sig_cmp(span.data(), 0, span.size_bytes()) != 0) {
-			throw std::invalid_argument("rasterimage::read_png(): not a PNG file");
-		}
+	if (!r4::rectangle<uint32_t>({0, 0}, im.dims()).contains(roi)) {
+		throw std::invalid_argument("rasterimage::read(): region of interest is out of the image");
 	}
+	image_variant ret(roi.d, im.get_format(), im.get_depth());
+	convert(im.span().subspan(roi), ret.span());
+	return ret;
+}
 
-	// create internal PNG-structure to work with PNG file
-	// (no warning and error callbacks)
-	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
-	utki::scope_exit png_scope_exit([&png_ptr]() {
-		png_destroy_read_struct(&png_ptr, nullptr, nullptr);
-	});
-
-	// NOTE: the memory freed by png_destroy_read_struct()
-	png_infop info_ptr = png_create_info_struct(png_ptr);
-	utki::scope_exit info_scope_exit([&png_ptr, &info_ptr] {
-		png_destroy_info_struct(png_ptr, &info_ptr);
-	});
-
-	png_set_sig_bytes(png_ptr, png_sig_size); // we've already read png_sig_size bytes
-
-	png_set_read_fn(
-		png_ptr,
-		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
-		const_cast<fsif::file*>(&fi), // png_set_read_fn() expects non-const void*
-		png_read_callback
-	);
-
-	// read in all information about file
-	png_read_info(png_ptr, info_ptr);
-
-	// get information from info_ptr
-	png_uint_32 width = 0;
-	png_uint_32 height = 0;
-	int bit_depth = 0;
-	int color_format = 0;
-	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_format, nullptr, nullptr, nullptr);
-
-	// we want to convert tRNS transparency (e.g. single color treated as transparent) to proper alpha channel
-	png_set_tRNS_to_alpha(png_ptr);
-
-	// convert paletted PNG to rgb image
-	if (color_format == PNG_COLOR_TYPE_PALETTE) {
-		png_set_palette_to_rgb(png_ptr);
-	}
+bool is_qoi_pixel_type(format pixel_format, depth channel_depth)
+{
+	return channel_depth == depth::uint_8_bit && (pixel_format == format::rgb || pixel_format == format::rgba);
+}
 
-	// convert grayscale PNG to 8bit greyscale PNG
-	if (color_format == PNG_COLOR_TYPE_GRAY && bit_depth < utki::byte_bits) {
-		png_set_expand_gray_1_2_4_to_8(png_ptr);
+image_variant read_qoi_converted(const fsif::file& fi, format pixel_format, depth channel_depth)
+{
+	if (!is_qoi_pixel_type(pixel_format, channel_depth)) {
+		return convert_decoded(read_qoi(fi), pixel_format, channel_depth);
 	}
 
-#if CFG_ENDIANNESS == CFG_ENDIANNESS_LITTLE
-	// PNG stores 16 bit images in network order (big endian),
-	// so we ask libpng to convert it to little endian
-	png_set_swap(png_ptr);
-#endif
-
-	// set gamma information
-	double gamma = 0.0f;
-
-	constexpr auto screen_gamma = 2.2;
+	// QOI decoder produces both RGB and RGBA pixels directly
+	image_variant ret(probe_qoi(fi).dims, pixel_format, channel_depth);
+	read_qoi(fi, ret.span());
+	return ret;
+}
 
-	// if there's gamma info in the file, set it to screen_gamma
-	if (png_get_gAMA(png_ptr, info_ptr, &gamma)) {
-		png_set_gamma(png_ptr, screen_gamma, gamma);
-	} else {
-		constexpr auto default_gamma = 0.45455; // good guess for GIF images on PCs
-		png_set_gamma(png_ptr, screen_gamma, default_gamma);
+void read_qoi_converted(const fsif::file& fi, any_image_span dst)
+{
+	if (!is_qoi_pixel_type(dst.get_format(), dst.get_depth())) {
+		convert_decoded(read_qoi(fi), dst);
+		return;
 	}
+	read_qoi(fi, dst);
+}
 
-	// update info after all transformations
-	png_read_update_info(png_ptr, info_ptr);
-
-	// get all dimensions and color info again
-	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_format, nullptr, nullptr, nullptr);
-
-	depth image_depth = [&bit_depth]() {
-		if (bit_depth == sizeof(uint16_t) * utki::byte_bits) {
-			return depth::uint_16_bit;
-		} else {
-			ASSERT(bit_depth == utki::byte_bits)
-			return depth::uint_8_bit;
-		}
-	}();
-
-	// set image type
-	format image_format = [&color_format]() {
-		switch (color_format) {
-			case PNG_COLOR_TYPE_GRAY:
-				return format::grey;
-			case PNG_COLOR_TYPE_GRAY_ALPHA:
-				return format::greya;
-			case PNG_COLOR_TYPE_RGB:
-				return format::rgb;
-			case PNG_COLOR_TYPE_RGB_ALPHA:
-				return format::rgba;
-			default:
-				throw std::invalid_argument("rasterimage::read_png(): unknown color_format");
-		}
-	}();
+// PNM reader reorders channels while reading, other conversions are done after reading
+image_variant read_pnm_converted(const fsif::file& fi, format pixel_format, depth channel_depth)
+{
+	auto info = probe_pnm(fi);
+	if (to_canonical(pixel_format) != info.pixel_format || channel_depth != info.channel_depth) {
+		return convert_decoded(read_pnm(fi), pixel_format, channel_depth);
+	}
 
-	image_variant im({width, height}, image_format, image_depth);
+	// probing does not check the limits, check them before allocating the image
+	internal::check_decode_limits(info);
 
-	// get PNG bytes per row
-	png_size_t num_bytes_per_row = png_get_rowbytes(png_ptr, info_ptr);
+	image_variant ret(info.dims, pixel_format, channel_depth);
+	read_pnm(fi, ret.span());
+	return ret;
+}
 
-	// check that our expectations are correct
-	if (num_bytes_per_row != png_size_t(im.dims().x()) * png_size_t(im.num_channels())) {
-		throw std::runtime_error("rasterimage::read_png(): number of bytes per row does not match expected value");
+void read_pnm_converted(const fsif::file& fi, any_image_span dst)
+{
+	auto info = probe_pnm(fi);
+	if (to_canonical(dst.get_format()) != info.pixel_format || dst.get_depth() != info.channel_depth) {
+		convert_decoded(read_pnm(fi), dst);
+		return;
 	}
-
-	std::visit(
-		[&](auto&& image) {
-			using image_type = std::remove_reference_t<decltype(image)>;
-			using depth_type = typename image_type::pixel_type::value_type;
-			if constexpr ( //
-				!std::is_same_v<depth_type, uint8_t> && //
-				!std::is_same_v<depth_type, uint16_t> //
-			)
-			{
-				// only 8 or 16 bit images are supported
-				throw std::invalid_argument("rasterimage::read_png(): unsupported image depth");
-			} else {
-				ASSERT((num_bytes_per_row * height) == image.pixels().size_bytes())
-				ASSERT(image.dims().y() != 0 && image.pixels().size() != 0)
-
-				// make an array of row pointers
-				std::vector<png_bytep> rows(image.dims().y());
-				std::generate( //
-					rows.begin(),
-					rows.end(),
-					[
-#ifdef DEBUG
-						&image,
-#endif
-						i = image.span().begin()]() mutable {
-						ASSERT(i != image.span().end())
-						auto ret = i->data();
-						++i;
-						// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-						return reinterpret_cast<decltype(rows)::value_type>(ret);
-					}
-				);
-
-				// read in image data
-				png_read_image(png_ptr, rows.data());
-			}
-		},
-		im.variant
-	);
-
-	return im;
+	read_pnm(fi, dst);
 }
+} // namespace
 
-namespace {
-constexpr size_t jpeg_input_buffer_size = 4096;
-
-struct data_manager_jpeg_source {
-	jpeg_source_mgr pub;
-	const fsif::file* fi;
-	JOCTET* buffer;
-	bool sof; // true if the file was just opened
-};
-
-void jpeg_init_source_callback(j_decompress_ptr cinfo)
+image_variant rasterimage::read(const fsif::file& fi)
 {
-	ASSERT(cinfo)
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-	auto src = reinterpret_cast<data_manager_jpeg_source*>(cinfo->src);
-	ASSERT(src)
-	src->sof = true;
+	switch (detect_file_format(fi)) {
+		case image_file_format::png:
+			return rasterimage::read_png(fi);
+		case image_file_format::jpeg:
+			return rasterimage::read_jpeg(fi);
+		case image_file_format::raw:
+			return rasterimage::read_raw(fi);
+		case image_file_format::qoi:
+			return rasterimage::read_qoi(fi);
+		case image_file_format::pnm:
+			return rasterimage::read_pnm(fi);
+		case image_file_format::unknown:
+			break;
+	}
+	throw std::invalid_argument("rasterimage::read(): unknown image file format, suffix = "s + fi.suffix());
 }
 
-// This function is calld when variable "bytes_in_buffer" reaches 0 and
-// the necessarity in new portion of information appears.
-// RETURNS: TRUE if the buffer is successfuly filled.
-//          FALSE if i/o error occured
-boolean jpeg_callback_fill_input_buffer(j_decompress_ptr cinfo)
+image_variant rasterimage::read(const fsif::file& fi, format pixel_format, depth channel_depth)
 {
-	ASSERT(cinfo)
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-	auto src = reinterpret_cast<data_manager_jpeg_source*>(cinfo->src);
-	ASSERT(src)
-
-	// read in JPEGINPUTBUFFERSIZE JOCTET's
-	size_t nbytes = 0;
-
-	try {
-		auto buf_wrapper = utki::make_span(src->buffer, sizeof(JOCTET) * jpeg_input_buffer_size);
-		ASSERT(src->fi)
-		nbytes = src->fi->read(buf_wrapper);
-	} catch (std::runtime_error&) {
-		if (src->sof) {
-			return FALSE; // the specified file is empty
-		}
-		// we read the data before. Insert End Of File info into the buffer
-		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-		src->buffer[0] = (JOCTET)(std::numeric_limits<uint8_t>::max()); // 0xff
-		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-		src->buffer[1] = (JOCTET)(JPEG_EOI);
-		nbytes = 2;
-	} catch (...) {
-		return FALSE; // error
+	switch (detect_file_format(fi)) {
+		case image_file_format::png:
+			return rasterimage::read_png(fi, pixel_format, channel_depth);
+		case image_file_format::jpeg:
+			return rasterimage::read_jpeg(fi, pixel_format, channel_depth);
+		case image_file_format::raw:
+			return convert_decoded(rasterimage::read_raw(fi), pixel_format, channel_depth);
+		case image_file_format::qoi:
+			return read_qoi_converted(fi, pixel_format, channel_depth);
+		case image_file_format::pnm:
+			return read_pnm_converted(fi, pixel_format, channel_depth);
+		case image_file_format::unknown:
+			break;
 	}
-
-	// Set next input byte for JPEG and number of bytes read
-	src->pub.next_input_byte = src->buffer;
-	src->pub.bytes_in_buffer = nbytes;
-	src->sof = false; // the file is not empty since we read some data
-	return TRUE; // operation successful
+	throw std::invalid_argument("rasterimage::read(): unknown image file format, suffix = "s + fi.suffix());
 }
 
-// skip num_bytes (seek forward)
-void jpeg_callback_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
+void rasterimage::read(const fsif::file& fi, any_image_span dst)
 {
-	ASSERT(cinfo)
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-	auto src = reinterpret_cast<data_manager_jpeg_source*>(cinfo->src);
-	ASSERT(src)
-	if (num_bytes <= 0) {
-		// nothing to skip
-		return;
+	switch (detect_file_format(fi)) {
+		case image_file_format::png:
+			rasterimage::read_png(fi, dst);
+			return;
+		case image_file_format::jpeg:
+			rasterimage::read_jpeg(fi, dst);
+			return;
+		case image_file_format::raw:
+			convert_decoded(rasterimage::read_raw(fi), dst);
+			return;
+		case image_file_format::qoi:
+			read_qoi_converted(fi, dst);
+			return;
+		case image_file_format::pnm:
+			read_pnm_converted(fi, dst);
+			return;
+		case image_file_format::unknown:
+			break;
 	}
+	throw std::invalid_argument("rasterimage::read(): unknown image file format, suffix = "s + fi.suffix());
+}
 
-	// read "num_bytes" bytes and waste them away
-	while (num_bytes > long(src->pub.bytes_in_buffer)) {
-		num_bytes -= long(src->pub.bytes_in_buffer);
-		jpeg_callback_fill_input_buffer(cinfo);
+image_variant rasterimage::read(const fsif::file& fi, const r4::rectangle<uint32_t>& roi)
+{
+	switch (detect_file_format(fi)) {
+		case image_file_format::png:
+			return rasterimage::read_png(fi, roi);
+		case image_file_format::jpeg:
+			return rasterimage::read_jpeg(fi, roi);
+		case image_file_format::raw:
+			return crop_decoded(rasterimage::read_raw(fi), roi);
+		case image_file_format::qoi:
+			return crop_decoded(rasterimage::read_qoi(fi), roi);
+		case image_file_format::pnm:
+			return crop_decoded(rasterimage::read_pnm(fi), roi);
+		case image_file_format::unknown:
+			break;
 	}
-
-	// update current JPEG read position
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-	src->pub.next_input_byte += size_t(num_bytes);
-	src->pub.bytes_in_buffer -= size_t(num_bytes);
+	throw std::invalid_argument("rasterimage::read(): unknown image file format, suffix = "s + fi.suffix());
 }
 
-// terminate source when decompress is finished
-// (nothing to do in this function in our case)
-void jpeg_callback_term_source(j_decompress_ptr /* cinfo */) {}
-
-} // namespace
-
-image_variant rasterimage::read_jpeg(const fsif::file& fi)
+image_info rasterimage::probe(const fsif::file& fi)
 {
-	utki::assert(!fi.is_open(), SL);
-
-	fsif::file::guard file_guard(fi);
-
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
-	jpeg_decompress_struct cinfo; // decompression object
-
-	// set error manager before calling to jpeg_create_*()
-	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
-	jpeg_error_mgr jerr;
-	cinfo.err = jpeg_std_error(&jerr);
+	switch (detect_file_format(fi)) {
+		case image_file_format::png:
+			return rasterimage::probe_png(fi);
+		case image_file_format::jpeg:
+			return rasterimage::probe_jpeg(fi);
+		case image_file_format::raw:
+			return rasterimage::probe_raw(fi);
+		case image_file_format::qoi:
+			return rasterimage::probe_qoi(fi);
+		case image_file_format::pnm:
+			return rasterimage::probe_pnm(fi);
+		case image_file_format::unknown:
+			break;
+	}
+	throw std::invalid_argument("rasterimage::probe(): unknown image file format, suffix = "s + fi.suffix());
+}
 
-	jpeg_create_decompress(&cinfo); // creat decompress object
+image_variant internal::read(const fsif::file& fi, const header_handler& on_header)
+{
+	image_variant im;
+	auto get_destination = [&im, &on_header](const image_info& info) {
+		on_header(info);
+		im = image_variant(info.dims, info.pixel_format, info.channel_depth);
+		return im.span();
+	};
+
+	switch (detect_file_format(fi)) {
+		case image_file_format::png:
+			internal::read_png(fi, get_destination);
+			return im;
+		case image_file_format::jpeg:
+			internal::read_jpeg(fi, get_destination);
+			return im;
+		default:
+			break;
+	}
 
-	utki::scope_exit cinfo_scope_exit([&cinfo]() {
-		jpeg_destroy_decompress(&cinfo); // clean decompression object
-	});
+	// decoders of other formats allocate the image themselves
+	on_header(rasterimage::probe(fi));
+	return rasterimage::read(fi);
+}
 
-	data_manager_jpeg_source* src = nullptr;
+internal::destination_getter internal::make_roi_destination_getter(
+	const r4::rectangle<uint32_t>& roi,
+	any_image_span dst
+)
+{
+	if (dst.dims() != roi.d) {
+		throw std::invalid_argument("destination image span dimensions do not match region of interest dimensions");
+	}
 
-	// check if memory for JPEG-decompressor manager is allocated,
-	// it is possible that several libraries accessing the source
-	if (cinfo.src == nullptr) {
-		// Allocate memory for our manager and set a pointer of global library
-		// structure to it. We use JPEG library memory manager, this means that
-		// the library will take care of memory freeing for us.
-		// JPOOL_PERMANENT means that the memory is allocated for a whole
-		// time  of working with the library.
-		cinfo.src = static_cast<jpeg_source_mgr*>(
-			(cinfo.mem->alloc_small)(j_common_ptr(&cinfo), JPOOL_PERMANENT, sizeof(data_manager_jpeg_source))
-		);
-		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-		src = reinterpret_cast<data_manager_jpeg_source*>(cinfo.src);
-		if (!src) {
-			throw std::bad_alloc();
+	return [dst](const image_info& info) {
+		if (info.pixel_format != dst.get_format() || info.channel_depth != dst.get_depth()) {
+			throw std::invalid_argument("destination image span pixel type does not match the image file pixel type");
 		}
+		return dst;
+	};
+}
 
-		// allocate memory for read data
-		src->buffer = static_cast<JOCTET*>(
-			(cinfo.mem->alloc_small)(j_common_ptr(&cinfo), JPOOL_PERMANENT, jpeg_input_buffer_size * sizeof(JOCTET))
-		);
-
-		if (!src->buffer) {
-			throw std::bad_alloc();
+internal::destination_getter internal::make_destination_getter(any_image_span dst)
+{
+	return [dst](const image_info& info) {
+		if (info.dims != dst.dims()) {
+			throw std::invalid_argument("destination image span dimensions do not match image dimensions");
 		}
-	} else {
-		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-		src = reinterpret_cast<data_manager_jpeg_source*>(cinfo.src);
-	}
+		ASSERT(info.pixel_format == dst.get_format() && info.channel_depth == dst.get_depth())
+		return dst;
+	};
+}
 
-	// set handler functions
-	src->pub.init_source = &jpeg_init_source_callback;
-	src->pub.fill_input_buffer = &jpeg_callback_fill_input_buffer;
-	src->pub.skip_input_data = &jpeg_callback_skip_input_data;
-	src->pub.resync_to_restart = &jpeg_resync_to_restart; // use default func
-	src->pub.term_source = &jpeg_callback_term_source;
-	// set the fields of our structure
-	src->fi = &fi;
-	// set pointers to the buffers
-	src->pub.bytes_in_buffer = 0; // forces fill_input_buffer on first read
-	src->pub.next_input_byte = nullptr; // until buffer loaded
-
-	jpeg_read_header(&cinfo, TRUE); // read parametrs of a JPEG file
-
-	jpeg_start_decompress(&cinfo); // start decompression
-
-	utki::scope_exit decompress_scope_exit([&cinfo]() {
-		jpeg_finish_decompress(&cinfo); // finish file decompression
-	});
-
-	format image_format = to_format(cinfo.output_components);
-
-	image_variant im({cinfo.output_width, cinfo.output_height}, image_format, depth::uint_8_bit);
-
-	// calculate the size of a row in bytes
-	auto num_bytes_in_row = JDIMENSION(im.dims().x() * im.num_channels());
-
-	// Allocate memory for one row. It is an array of rows which
-	// contains only one row. JPOOL_IMAGE means that the memory is allocated
-	// only for time of this image reading. So, no need to free the memory explicitly.
-	JSAMPARRAY buffer = (cinfo.mem->alloc_sarray)(j_common_ptr(&cinfo), JPOOL_IMAGE, num_bytes_in_row, 1);
-
-	std::visit(
-		[&cinfo, &buffer, num_bytes_in_row](auto&& image) {
-#ifdef DEBUG
-			using image_type = std::remove_reference_t<decltype(image)>;
-			using depth_type = typename image_type::pixel_type::value_type;
-			ASSERT(std::is_same_v<depth_type, uint8_t>)
-#endif
-			auto i = image.span().begin();
-			for (int y = 0; cinfo.output_scanline < image.dims().y(); ++y, ++i) {
-				// read the string into buffer
-				jpeg_read_scanlines(&cinfo, buffer, 1);
-
-				ASSERT(num_bytes_in_row == i->size_bytes())
-
-				std::copy(
-					*buffer,
-					*buffer + num_bytes_in_row,
-					// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
-					reinterpret_cast<uint8_t*>(i->data())
-				);
-			}
-		},
-		im.variant
-	);
-
-	return im;
+internal::destination_getter internal::make_roi_destination_getter(
+	const r4::rectangle<uint32_t>& roi,
+	image_variant& im
+)
+{
+	return [&roi, &im](const image_info& info) {
+		im = image_variant(roi.d, info.pixel_format, info.channel_depth);
+		return im.span();
+	};
 }
@@ -26,79 +26,84 @@ SOFTWARE.
 
 #pragma once
 
+#include <functional>
+#include <stdexcept>
+#include <utility>
 #include <variant>
 
 #include <fsif/file.hpp>
 
+#include "any_image_span.hpp"
+#include "decode_limits.hpp"
+#include "format.hpp"
 #include "image.hpp"
 
 namespace rasterimage {
 
-enum class depth {
-	uint_8_bit,
-	uint_16_bit,
-	float_32_bit,
-
-	enum_size
-};
-
-template <depth depth_enum>
-using depth_type_t = std::conditional_t<
-	depth_enum == depth::uint_8_bit,
-	uint8_t,
-	std::conditional_t<
-		depth_enum == depth::uint_16_bit,
-		uint16_t,
-		std::conditional_t<depth_enum == depth::float_32_bit, float, void>>>;
-
-enum class format {
-	grey,
-	gray = grey,
-	greya,
-	graya = greya,
-	rgb,
-	rgba,
-
-	enum_size
-};
-
-inline constexpr size_t to_num_channels(format f)
-{
-	return size_t(f) + 1;
-}
-
-inline constexpr format to_format(unsigned num_channels)
-{
-#ifdef DEBUG
-	if (num_channels < 1 || 4 < num_channels) {
-		throw std::logic_error("num_channels out of range");
-	}
-#endif
-	return format(num_channels - 1);
-}
-
 // TODO: doxygen
 class image_variant
 {
 public:
+	/**
+	 * @brief Variant of all image types.
+	 * Alternative index is depth * format::enum_size + format.
+	 * Formats with the same number of channels, e.g. rgba and bgra, have the same image type,
+	 * so the variant has duplicate alternative types and alternatives must be accessed by index,
+	 * std::get<type>() does not compile for such types. Use image_variant::get() or std::visit().
+	 */
 	using variant_type = std::variant<
 		image<uint8_t, 1>,
 		image<uint8_t, 2>,
 		image<uint8_t, 3>,
 		image<uint8_t, 4>,
+		image<uint8_t, 3>,
+		image<uint8_t, 4>,
+		image<uint8_t, 4>,
 		image<uint16_t, 1>,
 		image<uint16_t, 2>,
 		image<uint16_t, 3>,
 		image<uint16_t, 4>,
+		image<uint16_t, 3>,
+		image<uint16_t, 4>,
+		image<uint16_t, 4>,
 		image<float, 1>,
 		image<float, 2>,
 		image<float, 3>,
-		image<float, 4>>;
+		image<float, 4>,
+		image<float, 3>,
+		image<float, 4>,
+		image<float, 4>,
+		image<float16, 1>,
+		image<float16, 2>,
+		image<float16, 3>,
+		image<float16, 4>,
+		image<float16, 3>,
+		image<float16, 4>,
+		image<float16, 4>>;
 
 	variant_type variant;
 
+	static constexpr size_t to_variant_index(format pixel_format, depth channel_depth)
+	{
+		return size_t(channel_depth) * size_t(format::enum_size) + size_t(pixel_format);
+	}
+
 private:
-	static size_t to_variant_index(format pixel_format, depth channel_depth);
+	// construct variant holding the image at the alternative of given index
+	template <size_t index = 0, typename image_type>
+	static variant_type make_variant(image_type&& im, size_t variant_index)
+	{
+		if constexpr (index == std::variant_size_v<variant_type>) {
+			throw std::invalid_argument("image_variant: pixel format does not match the image's pixel type");
+		} else {
+			if constexpr (std::is_same_v<std::variant_alternative_t<index, variant_type>, image_type>) {
+				if (index == variant_index) {
+					return variant_type(std::in_place_index<index>, std::move(im));
+				}
+			}
+			return make_variant<index + 1>(std::move(im), variant_index);
+		}
+	}
 
 public:
 	image_variant(
@@ -107,14 +112,32 @@ public:
 		depth channel_depth = depth::uint_8_bit
 	);
 
+	/**
+	 * @brief Construct image variant holding the image of canonical format.
+	 * @param im - image to move into the variant.
+	 */
 	template <typename channel_type, size_t num_channels>
 	image_variant(image<channel_type, num_channels>&& im) :
-		variant(std::move(im))
+		variant(
+			std::in_place_index<to_variant_index(to_format(num_channels), to_depth<channel_type>())>, //
+			std::move(im)
+		)
+	{}
+
+	/**
+	 * @brief Construct image variant holding the image of given format.
+	 * @param im - image to move into the variant.
+	 * @param pixel_format - pixel format of the image, e.g. bgra for 4 channel image.
+	 * @throw std::invalid_argument - in case the format's number of channels does not match the image's one.
+	 */
+	template <typename channel_type, size_t num_channels>
+	image_variant(image<channel_type, num_channels>&& im, format pixel_format) :
+		variant(make_variant(std::move(im), to_variant_index(pixel_format, to_depth<channel_type>())))
 	{}
 
 	size_t num_channels() const noexcept
 	{
-		auto ret = size_t(this->get_format()) + 1;
+		auto ret = to_num_channels(this->get_format());
 		ASSERT(
 			std::visit(
 				[](const auto& sfi) {
@@ -130,12 +153,12 @@ public:
 	{
 		auto ret = format(this->variant.index() % size_t(rasterimage::format::enum_size));
 		ASSERT(
-			format(std::visit(
+			std::visit(
 				[](const auto& sfi) {
-					return sfi.num_channels - 1;
+					return sfi.num_channels;
 				},
 				this->variant
-			)) == ret
+			) == to_num_channels(ret)
 		)
 		return ret;
 	}
@@ -157,18 +180,38 @@ public:
 	 */
 	size_t buffer_size() const noexcept;
 
+	/**
+	 * @brief Get image of the given format and depth.
+	 * @throw std::bad_variant_access - in case the image variant holds image of other format or depth.
+	 */
 	template <format components_enum, depth depth_enum = depth::uint_8_bit>
 	image<depth_type_t<depth_enum>, to_num_channels(components_enum)>& get()
 	{
-		return std::get<image<depth_type_t<depth_enum>, to_num_channels(components_enum)>>(this->variant);
+		return std::get<to_variant_index(components_enum, depth_enum)>(this->variant);
 	}
 
+	/**
+	 * @brief Get image of the given format and depth.
+	 * @throw std::bad_variant_access - in case the image variant holds image of other format or depth.
+	 */
 	template <format components_enum, depth depth_enum = depth::uint_8_bit>
 	const image<depth_type_t<depth_enum>, to_num_channels(components_enum)>& get() const
 	{
-		return std::get<image<depth_type_t<depth_enum>, to_num_channels(components_enum)>>(this->variant);
+		return std::get<to_variant_index(components_enum, depth_enum)>(this->variant);
 	}
 
+	/**
+	 * @brief Get type-erased span of the image pixels.
+	 * @return Span of the image pixels.
+	 */
+	any_image_span span() noexcept;
+
+	/**
+	 * @brief Get type-erased span of the image pixels.
+	 * @return Span of the image pixels.
+	 */
+	const_any_image_span span() const noexcept;
+
 	/**
 	 * @brief Write image to PNG file.
 	 *
@@ -176,28 +219,314 @@ public:
 	 *             Exisitng file will be overwritten.
 	 */
 	void write_png(const fsif::file& fi) const;
+
+	/**
+	 * @brief Write image to PNG file using multiple threads.
+	 * Image rows are split into horizontal bands which are filtered and compressed in parallel,
+	 * the compressed bands are then joined into a single zlib stream.
+	 * Supports 8 and 16 bit per channel images of all formats.
+	 *
+	 * @param fi - file interface for writing the file. Must not be opened.
+	 *             Exisitng file will be overwritten.
+	 * @param num_threads - maximal number of threads to use.
+	 *                      0 means use number of threads supported by hardware.
+	 * @throw std::invalid_argument - in case the image has floating point channels of any depth.
+	 */
+	void write_png(const fsif::file& fi, unsigned num_threads) const;
 };
 
+/**
+ * @brief Image properties which can be obtained without decoding the image.
+ */
+struct image_info {
+	dimensioned::dimensions_type dims;
+	format pixel_format;
+	depth channel_depth;
+
+	/**
+	 * @brief Size of decoded image pixel buffer in bytes.
+	 * @throw size_limit_error - in case the size is not representable.
+	 */
+	size_t buffer_size_bytes() const
+	{
+		return internal::to_size(internal::checked_mul(
+			uint64_t(this->dims.x()) * uint64_t(this->dims.y()),
+			to_num_channels(this->pixel_format) * to_channel_size(this->channel_depth)
+		));
+	}
+};
+
+/**
+ * @brief Read PNG image header.
+ * Only reads the file header, pixel data is not decoded.
+ * @param fi - file to read the image header from. File must not be opened.
+ * @return Properties of the image which read_png() would return for the file.
+ */
+image_info probe_png(const fsif::file& fi);
+
+/**
+ * @brief Read JPEG image header.
+ * Only reads the file header, pixel data is not decoded.
+ * @param fi - file to read the image header from. File must not be opened.
+ * @return Properties of the image which read_jpeg() would return for the file.
+ */
+image_info probe_jpeg(const fsif::file& fi);
+
+/**
+ * @brief Read image header.
+ * Automatically detects the image file format, same way as read() does.
+ * @param fi - file to read the image header from. File must not be opened.
+ * @return Properties of the image which read() would return for the file.
+ */
+image_info probe(const fsif::file& fi);
+
 /**
  * @brief Read PNG image from file.
  * @param fi - file to read the image from. File must not be opened.
  * @return Image read from the file.
+ * @throw size_limit_error - in case the image exceeds decode limits, see set_decode_limits().
  */
 image_variant read_png(const fsif::file& fi);
 
+/**
+ * @brief Read PNG image from file converting it to the requested pixel type.
+ * The conversion is done by libpng while decoding, so the image is decoded to the
+ * requested pixel type directly, without intermediate image.
+ * Greyscale is converted to RGB by replicating the grey value, RGB to greyscale by luminance,
+ * which libpng calculates in linear light.
+ * Missing alpha channel is added as opaque, excess alpha channel is dropped.
+ * Floating point channels are produced from 16 bit ones, the conversion is done in place.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param pixel_format - pixel format of the resulting image.
+ * @param channel_depth - channel depth of the resulting image.
+ * @return Image read from the file.
+ */
+image_variant read_png(const fsif::file& fi, format pixel_format, depth channel_depth);
+
+/**
+ * @brief Read PNG image from file into existing memory.
+ * The image is decoded to the destination's pixel type same way as read_png(fi, pixel_format, channel_depth) does,
+ * decoded rows are written directly to the destination.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param dst - span to write the image to. Must have same dimensions as the image, see probe_png().
+ * @throw std::invalid_argument - in case the destination dimensions do not match the image dimensions.
+ */
+void read_png(const fsif::file& fi, any_image_span dst);
+
 /**
  * @brief Read JPEG image from file.
  * @param fi - file to read the image from. File must not be opened.
  * @return Image read from the file.
+ * @throw size_limit_error - in case the image exceeds decode limits, see set_decode_limits().
  */
 image_variant read_jpeg(const fsif::file& fi);
 
+/**
+ * @brief Read JPEG image from file converting it to the requested pixel type.
+ * Color conversion is done by libjpeg while decoding, using libjpeg-turbo's extended
+ * output color spaces when available. Greyscale is produced from luma channel of the image.
+ * Pixels which libjpeg cannot produce directly, e.g. greyscale with alpha or 16 bit ones,
+ * are converted from the decoded row, so no intermediate image is allocated.
+ * Alpha channel is opaque.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param pixel_format - pixel format of the resulting image.
+ * @param channel_depth - channel depth of the resulting image.
+ * @return Image read from the file.
+ */
+image_variant read_jpeg(const fsif::file& fi, format pixel_format, depth channel_depth);
+
+/**
+ * @brief Read JPEG image from file into existing memory.
+ * The image is decoded to the destination's pixel type same way as read_jpeg(fi, pixel_format, channel_depth) does,
+ * decoded rows are written directly to the destination.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param dst - span to write the image to. Must have same dimensions as the image, see probe_jpeg().
+ * @throw std::invalid_argument - in case the destination dimensions do not match the image dimensions.
+ */
+void read_jpeg(const fsif::file& fi, any_image_span dst);
+
+/**
+ * @brief Read JPEG image from file using multiple threads.
+ * Entropy coded data of JPEG images with restart markers is split at the restart markers
+ * into horizontal bands which are decoded in parallel.
+ * Falls back to single-threaded decoding for images without restart markers and for progressive images.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param num_threads - maximal number of threads to use.
+ *                      0 means use number of threads supported by hardware.
+ * @return Image read from the file.
+ */
+image_variant read_jpeg(const fsif::file& fi, unsigned num_threads);
+
+namespace internal {
+// gets destination of the decoded pixels, called once the image header is read
+using destination_getter = std::function<any_image_span(const image_info& info)>;
+
+void read_png(const fsif::file& fi, const r4::rectangle<uint32_t>& roi, const destination_getter& get_destination);
+void read_jpeg(const fsif::file& fi, const r4::rectangle<uint32_t>& roi, const destination_getter& get_destination);
+
+// decode whole image without pixel type conversion to the destination returned by the getter
+void read_png(const fsif::file& fi, const destination_getter& get_destination);
+void read_jpeg(const fsif::file& fi, const destination_getter& get_destination);
+
+// called once the image header is read, before the pixel buffer is allocated
+using header_handler = std::function<void(const image_info& info)>;
+
+// read whole image, PNG and JPEG files are read in one pass, files of other formats are probed before reading
+image_variant read(const fsif::file& fi, const header_handler& on_header);
+
+// getter which checks that the destination span matches the region and the image file pixel type
+destination_getter make_roi_destination_getter(const r4::rectangle<uint32_t>& roi, any_image_span dst);
+
+// getter which checks that the destination span matches the image dimensions, used for decoding whole image
+// converted to the destination pixel type
+destination_getter make_destination_getter(any_image_span dst);
+
+// check decode limits for the image to be decoded, called once the image header is read
+inline void check_decode_limits(const image_info& info)
+{
+	check_decode_limits(info.dims, to_num_channels(info.pixel_format) * to_channel_size(info.channel_depth));
+}
+
+// getter which allocates the region image in the image_variant
+destination_getter make_roi_destination_getter(const r4::rectangle<uint32_t>& roi, image_variant& im);
+} // namespace internal
+
+/**
+ * @brief Read region of PNG image from file.
+ * Rows below the region are not decoded.
+ * Only the region is kept in memory, except for interlaced images where rows of the region are buffered in full width.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param roi - region of interest. Must be within the image.
+ * @return Image of the region of interest.
+ * @throw std::invalid_argument - in case the region of interest is out of the image.
+ */
+image_variant read_png(const fsif::file& fi, const r4::rectangle<uint32_t>& roi);
+
+/**
+ * @brief Read region of PNG image from file into existing image span.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param roi - region of interest. Must be within the image.
+ * @param dst - image span to write the region to. Must have same dimensions as the region
+ *              and same pixel type as the image file is decoded to, see probe_png().
+ * @throw std::invalid_argument - in case the region of interest is out of the image
+ *                                or the destination does not match the region.
+ */
+template <typename channel_type, size_t num_channels>
+void read_png(
+	const fsif::file& fi, //
+	const r4::rectangle<uint32_t>& roi,
+	image_span<channel_type, num_channels> dst
+)
+{
+	internal::read_png(fi, roi, internal::make_roi_destination_getter(roi, any_image_span(dst)));
+}
+
+/**
+ * @brief Read region of PNG image from file into existing memory.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param roi - region of interest. Must be within the image.
+ * @param dst - span to write the region to. Must have same dimensions as the region
+ *              and same pixel type as the image file is decoded to, see probe_png().
+ * @throw std::invalid_argument - in case the region of interest is out of the image
+ *                                or the destination does not match the region.
+ */
+void read_png(const fsif::file& fi, const r4::rectangle<uint32_t>& roi, any_image_span dst);
+
+/**
+ * @brief Read region of JPEG image from file.
+ * Uses libjpeg-turbo's scanline cropping and skipping, so that most of the data outside of the region
+ * is not fully decoded. Rows below the region are not decoded at all.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param roi - region of interest. Must be within the image.
+ * @return Image of the region of interest.
+ * @throw std::invalid_argument - in case the region of interest is out of the image.
+ */
+image_variant read_jpeg(const fsif::file& fi, const r4::rectangle<uint32_t>& roi);
+
+/**
+ * @brief Read region of JPEG image from file into existing image span.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param roi - region of interest. Must be within the image.
+ * @param dst - image span to write the region to. Must have same dimensions as the region
+ *              and same pixel type as the image file is decoded to, see probe_jpeg().
+ * @throw std::invalid_argument - in case the region of interest is out of the image
+ *                                or the destination does not match the region.
+ */
+template <typename channel_type, size_t num_channels>
+void read_jpeg(
+	const fsif::file& fi, //
+	const r4::rectangle<uint32_t>& roi,
+	image_span<channel_type, num_channels> dst
+)
+{
+	internal::read_jpeg(fi, roi, internal::make_roi_destination_getter(roi, any_image_span(dst)));
+}
+
+/**
+ * @brief Read region of JPEG image from file into existing memory.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param roi - region of interest. Must be within the image.
+ * @param dst - span to write the region to. Must have same dimensions as the region
+ *              and same pixel type as the image file is decoded to, see probe_jpeg().
+ * @throw std::invalid_argument - in case the region of interest is out of the image
+ *                                or the destination does not match the region.
+ */
+void read_jpeg(const fsif::file& fi, const r4::rectangle<uint32_t>& roi, any_image_span dst);
+
+/**
+ * @brief Read coarse preview of JPEG image from file.
+ * For progressive JPEG images only the first scans are decoded and the image is reconstructed from them.
+ * The rest of the file is not read. Each subsequent scan refines the image, so the number of scans
+ * acts as the preview quality level. For typical progressive JPEG encoders the first scan holds DC
+ * coefficients only, i.e. the image at 1/8 of the resolution, and the image is close to the final one
+ * once all the scans of the first spectral pass are decoded.
+ * Non-progressive images have only one scan and are decoded completely.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param num_scans - maximum number of scans to decode. Must be greater than zero.
+ * @return Preview image. Dimensions and pixel type are same as of the completely decoded image.
+ * @throw std::invalid_argument - in case num_scans is zero.
+ */
+image_variant read_jpeg_preview(const fsif::file& fi, unsigned num_scans);
+
 /**
  * @brief Read image from file.
  * Automatically detects the image file format by filename suffix.
+ * In case the suffix is not known, e.g. for memory files, the format is detected by file signature.
  * @param fi - file to read the image from. File must not be opened.
  * @return Image read from file.
+ * @throw size_limit_error - in case the image exceeds decode limits, see set_decode_limits().
  */
 image_variant read(const fsif::file& fi);
 
+/**
+ * @brief Read image from file converting it to the requested pixel type.
+ * Automatically detects the image file format, same way as read() does.
+ * See read_png() and read_jpeg() for details of the conversion.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param pixel_format - pixel format of the resulting image.
+ * @param channel_depth - channel depth of the resulting image.
+ * @return Image read from the file.
+ */
+image_variant read(const fsif::file& fi, format pixel_format, depth channel_depth);
+
+/**
+ * @brief Read image from file into existing memory.
+ * Automatically detects the image file format, same way as read() does.
+ * See read_png() and read_jpeg() for details of the conversion to the destination's pixel type.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param dst - span to write the image to. Must have same dimensions as the image, see probe().
+ * @throw std::invalid_argument - in case the destination dimensions do not match the image dimensions.
+ */
+void read(const fsif::file& fi, any_image_span dst);
+
+/**
+ * @brief Read region of image from file.
+ * Automatically detects the image file format, same way as read() does.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param roi - region of interest. Must be within the image.
+ * @return Image of the region of interest.
+ * @throw std::invalid_argument - in case the region of interest is out of the image.
+ */
+image_variant read(const fsif::file& fi, const r4::rectangle<uint32_t>& roi);
+
 } // namespace rasterimage
@@ -0,0 +1,59 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "instrumentation.hpp"
+
+using namespace rasterimage::instrumentation;
+
+namespace {
+thread_local sink_type thread_sink;
+} // namespace
+
+sink_type rasterimage::instrumentation::set_sink(sink_type sink)
+{
+	std::swap(thread_sink, sink);
+	return sink;
+}
+
+const sink_type* rasterimage::instrumentation::internal::get_sink() noexcept
+{
+	if (!thread_sink) {
+		return nullptr;
+	}
+	return &thread_sink;
+}
+
+collector::collector() :
+	previous_sink(set_sink([this](const codec_stats& s) {
+		this->stats.push_back(s);
+	}))
+{}
+
+collector::~collector()
+{
+	set_sink(std::move(this->previous_sink));
+}
@@ -0,0 +1,282 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace rasterimage::instrumentation {
+
+/**
+ * @brief Codec operation.
+ */
+enum class operation {
+	read_png,
+	read_jpeg,
+	write_png,
+	read_raw,
+	write_raw,
+	read_qoi,
+	write_qoi,
+	read_pnm,
+	write_pnm,
+
+	enum_size
+};
+
+/**
+ * @brief Phase of a codec operation.
+ * Pixel transformations done by the codec library on the fly, like gamma correction or
+ * byte swapping of 16 bit PNG values, are part of decode phase, since they cannot be measured separately.
+ */
+enum class phase {
+	/**
+	 * @brief Reading or writing of the image file header.
+	 */
+	header,
+
+	/**
+	 * @brief Allocation of the image buffer.
+	 */
+	allocation,
+
+	/**
+	 * @brief Decoding of pixel data, including file reading.
+	 */
+	decode,
+
+	/**
+	 * @brief Encoding of pixel data, including file writing.
+	 */
+	encode,
+
+	/**
+	 * @brief Finishing the operation after all pixel rows are processed.
+	 */
+	post_process,
+
+	enum_size
+};
+
+/**
+ * @brief Statistics of one codec operation.
+ */
+struct codec_stats {
+	operation op;
+
+	/**
+	 * @brief Durations of operation phases.
+	 * Indexed by phase. Phases which the operation does not have are zero.
+	 */
+	std::array<std::chrono::nanoseconds, size_t(phase::enum_size)> phase_durations{};
+
+	uint64_t num_bytes_read = 0;
+	uint64_t num_bytes_written = 0;
+
+	/**
+	 * @brief Number of file read and write calls.
+	 */
+	uint64_t num_io_calls = 0;
+
+	/**
+	 * @brief Number of pixel rows decoded or encoded.
+	 */
+	uint64_t num_rows = 0;
+
+	std::chrono::nanoseconds duration(phase p) const noexcept
+	{
+		return this->phase_durations[size_t(p)];
+	}
+
+	std::chrono::nanoseconds total_duration() const noexcept
+	{
+		std::chrono::nanoseconds ret{0};
+		for (const auto& d : this->phase_durations) {
+			ret += d;
+		}
+		return ret;
+	}
+};
+
+/**
+ * @brief Instrumentation sink.
+ * Called on the thread which performed the codec operation after the operation has successfully finished.
+ */
+using sink_type = std::function<void(const codec_stats&)>;
+
+/**
+ * @brief Set instrumentation sink for the calling thread.
+ * Codec operations are only instrumented when the sink is set, otherwise no timestamps are taken
+ * and no counters are updated.
+ * In case the library is built with RASTERIMAGE_NO_INSTRUMENTATION defined, the instrumentation code is
+ * compiled out completely and the sink is never called.
+ * @param sink - sink to set. Empty function disables instrumentation.
+ * @return Previously set sink.
+ */
+sink_type set_sink(sink_type sink);
+
+/**
+ * @brief Collector of codec statistics of the calling thread.
+ * Sets the instrumentation sink which stores statistics of every codec operation done by
+ * the calling thread while the collector object exists. Previous sink is restored on destruction.
+ * Collector objects must be destroyed in reverse order of creation.
+ */
+class collector
+{
+	sink_type previous_sink;
+
+public:
+	std::vector<codec_stats> stats;
+
+	collector();
+
+	collector(const collector&) = delete;
+	collector& operator=(const collector&) = delete;
+
+	collector(collector&&) = delete;
+	collector& operator=(collector&&) = delete;
+
+	~collector();
+};
+
+namespace internal {
+
+const sink_type* get_sink() noexcept;
+
+#ifdef RASTERIMAGE_NO_INSTRUMENTATION
+
+class recorder
+{
+public:
+	recorder(operation) {}
+
+	void start(phase) {}
+
+	void add_read(size_t) noexcept {}
+
+	void add_written(size_t) noexcept {}
+
+	void add_rows(size_t) noexcept {}
+
+	void finish() {}
+};
+
+#else
+
+/**
+ * @brief Records statistics of one codec operation.
+ * All methods do nothing if no sink is set at the time of the recorder construction.
+ */
+class recorder
+{
+	using clock_type = std::chrono::steady_clock;
+
+	const sink_type* sink;
+
+	codec_stats stats;
+
+	phase current_phase = phase::enum_size;
+	clock_type::time_point phase_start;
+
+	void end_phase()
+	{
+		auto now = clock_type::now();
+		if (this->current_phase != phase::enum_size) {
+			this->stats.phase_durations[size_t(this->current_phase)] += now - this->phase_start;
+		}
+		this->phase_start = now;
+	}
+
+public:
+	recorder(operation op) :
+		sink(get_sink())
+	{
+		this->stats.op = op;
+	}
+
+	/**
+	 * @brief Start new phase.
+	 * Ends current phase, if any.
+	 */
+	void start(phase p)
+	{
+		if (!this->sink) {
+			return;
+		}
+		this->end_phase();
+		this->current_phase = p;
+	}
+
+	void add_read(size_t num_bytes) noexcept
+	{
+		if (!this->sink) {
+			return;
+		}
+		this->stats.num_bytes_read += num_bytes;
+		++this->stats.num_io_calls;
+	}
+
+	void add_written(size_t num_bytes) noexcept
+	{
+		if (!this->sink) {
+			return;
+		}
+		this->stats.num_bytes_written += num_bytes;
+		++this->stats.num_io_calls;
+	}
+
+	void add_rows(size_t num_rows) noexcept
+	{
+		if (!this->sink) {
+			return;
+		}
+		this->stats.num_rows += num_rows;
+	}
+
+	/**
+	 * @brief End current phase and report statistics to the sink.
+	 */
+	void finish()
+	{
+		if (!this->sink) {
+			return;
+		}
+		this->end_phase();
+		this->current_phase = phase::enum_size;
+		(*this->sink)(this->stats);
+	}
+};
+
+#endif
+
+} // namespace internal
+
+} // namespace rasterimage::instrumentation
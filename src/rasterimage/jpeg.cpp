@@ -0,0 +1,1481 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "image_variant.hpp"
+
+#include <csetjmp>
+#include <numeric>
+#include <optional>
+
+#include <fsif/memory_file.hpp>
+
+// JPEG lib does not have 'extern "C"{}' :-(, so we put it outside of their .h
+// or will have linking problems otherwise because
+// of "_" symbol in front of C-function names
+extern "C" {
+#include <jpeglib.h>
+// for ERREXIT() and WARNMS() macros
+#include <jerror.h>
+}
+
+#include "instrumentation.hpp"
+#include "operations.hpp"
+#include "parallel.hpp"
+#include "push_decoder.hpp"
+
+using namespace std::string_literals;
+
+using namespace rasterimage;
+
+namespace {
+constexpr size_t jpeg_input_buffer_size = 4096;
+
+struct data_manager_jpeg_source {
+	jpeg_source_mgr pub;
+	const fsif::file* fi;
+	instrumentation::internal::recorder* rec;
+	JOCTET* buffer;
+	bool sof; // true if the file was just opened
+};
+
+void jpeg_init_source_callback(j_decompress_ptr cinfo)
+{
+	ASSERT(cinfo)
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	auto src = reinterpret_cast<data_manager_jpeg_source*>(cinfo->src);
+	ASSERT(src)
+	src->sof = true;
+}
+
+// This function is calld when variable "bytes_in_buffer" reaches 0 and
+// the necessarity in new portion of information appears.
+// RETURNS: TRUE if the buffer is successfuly filled.
+//          FALSE if i/o error occured
+boolean jpeg_callback_fill_input_buffer(j_decompress_ptr cinfo)
+{
+	ASSERT(cinfo)
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	auto src = reinterpret_cast<data_manager_jpeg_source*>(cinfo->src);
+	ASSERT(src)
+
+	// read in JPEGINPUTBUFFERSIZE JOCTET's
+	size_t nbytes = 0;
+
+	try {
+		auto buf_wrapper = utki::make_span(src->buffer, sizeof(JOCTET) * jpeg_input_buffer_size);
+		ASSERT(src->fi)
+		nbytes = src->fi->read(buf_wrapper);
+		src->rec->add_read(nbytes);
+	} catch (std::runtime_error&) {
+		// treat read error as end of file
+		nbytes = 0;
+	} catch (...) {
+		return FALSE; // error
+	}
+
+	// NOTE: ERREXIT() makes longjmp, so no non-trivially destructible objects are allowed at this point
+	if (nbytes == 0) {
+		if (src->sof) {
+			// the specified file is empty
+			ERREXIT(cinfo, JERR_INPUT_EMPTY);
+		}
+		// we read the data before, the data is truncated, insert End Of File info into the buffer,
+		// libjpeg will fill the missing part of the image
+		WARNMS(cinfo, JWRN_JPEG_EOF);
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		src->buffer[0] = (JOCTET)(std::numeric_limits<uint8_t>::max()); // 0xff
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		src->buffer[1] = (JOCTET)(JPEG_EOI);
+		nbytes = 2;
+	}
+
+	// Set next input byte for JPEG and number of bytes read
+	src->pub.next_input_byte = src->buffer;
+	src->pub.bytes_in_buffer = nbytes;
+	src->sof = false; // the file is not empty since we read some data
+	return TRUE; // operation successful
+}
+
+// skip num_bytes (seek forward)
+void jpeg_callback_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+	ASSERT(cinfo)
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	auto src = reinterpret_cast<data_manager_jpeg_source*>(cinfo->src);
+	ASSERT(src)
+	if (num_bytes <= 0) {
+		// nothing to skip
+		return;
+	}
+
+	// read "num_bytes" bytes and waste them away
+	while (num_bytes > long(src->pub.bytes_in_buffer)) {
+		num_bytes -= long(src->pub.bytes_in_buffer);
+		jpeg_callback_fill_input_buffer(cinfo);
+	}
+
+	// update current JPEG read position
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	src->pub.next_input_byte += size_t(num_bytes);
+	src->pub.bytes_in_buffer -= size_t(num_bytes);
+}
+
+// terminate source when decompress is finished
+// (nothing to do in this function in our case)
+void jpeg_callback_term_source(j_decompress_ptr /* cinfo */) {}
+
+// JPEG reading state.
+// Constructor creates libjpeg decompression object, read_header() sets up the data source and reads the file header.
+// The file must be opened before calling read_header().
+// libjpeg reports errors via error_exit callback which longjmps back to call(), so all the libjpeg calls
+// which can fail are done via call().
+class jpeg_reader
+{
+	const fsif::file& fi;
+	instrumentation::internal::recorder& rec;
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+	std::jmp_buf jump_buffer;
+
+	std::array<char, JMSG_LENGTH_MAX> error_message = {0};
+
+	[[noreturn]] static void error_exit_callback(j_common_ptr cinfo)
+	{
+		ASSERT(cinfo)
+		auto r = static_cast<jpeg_reader*>(cinfo->client_data);
+		ASSERT(r)
+		(*cinfo->err->format_message)(cinfo, r->error_message.data());
+		std::longjmp(r->jump_buffer, 1);
+	}
+
+	// returns false in case of libjpeg error
+	template <typename func_type>
+	bool call_guarded(const func_type& func)
+	{
+		// NOTE: the function must not create non-trivially destructible objects,
+		//       because libjpeg error makes longjmp back to here
+		if (setjmp(this->jump_buffer)) {
+			return false;
+		}
+
+		func();
+
+		return true;
+	}
+
+public:
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+	jpeg_error_mgr jerr;
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+	jpeg_decompress_struct cinfo; // decompression object
+
+	jpeg_reader(const fsif::file& fi, instrumentation::internal::recorder& rec) :
+		fi(fi),
+		rec(rec)
+	{
+		// set error manager before calling to jpeg_create_*()
+		this->cinfo.err = jpeg_std_error(&this->jerr);
+		this->jerr.error_exit = &error_exit_callback;
+
+		// client data is kept by jpeg_create_*()
+		this->cinfo.client_data = this;
+
+		this->call([this]() {
+			jpeg_create_decompress(&this->cinfo); // creat decompress object
+		});
+	}
+
+	jpeg_reader(const jpeg_reader&) = delete;
+	jpeg_reader& operator=(const jpeg_reader&) = delete;
+
+	jpeg_reader(jpeg_reader&&) = delete;
+	jpeg_reader& operator=(jpeg_reader&&) = delete;
+
+	~jpeg_reader()
+	{
+		jpeg_destroy_decompress(&this->cinfo); // clean decompression object
+	}
+
+	void read_header();
+
+	/**
+	 * @brief Call the function which calls libjpeg.
+	 * libjpeg errors are thrown as std::invalid_argument.
+	 * Calls must not be nested.
+	 */
+	template <typename func_type>
+	void call(const func_type& func)
+	{
+		if (!this->call_guarded(func)) {
+			throw std::invalid_argument("rasterimage::read_jpeg(): "s + this->error_message.data());
+		}
+	}
+
+	/**
+	 * @brief Get properties of the image to be decoded.
+	 * Must be called after read_header().
+	 */
+	image_info get_info()
+	{
+		// calculate output_width, output_height and output_components according to decompression parameters
+		this->call([this]() {
+			jpeg_calc_output_dimensions(&this->cinfo);
+		});
+
+		return {
+			{this->cinfo.output_width, this->cinfo.output_height},
+			to_format(this->cinfo.output_components),
+			depth::uint_8_bit
+		};
+	}
+};
+
+void jpeg_reader::read_header()
+{
+	data_manager_jpeg_source* src = nullptr;
+
+	// check if memory for JPEG-decompressor manager is allocated,
+	// it is possible that several libraries accessing the source
+	if (this->cinfo.src == nullptr) {
+		// Allocate memory for our manager and set a pointer of global library
+		// structure to it. We use JPEG library memory manager, this means that
+		// the library will take care of memory freeing for us.
+		// JPOOL_PERMANENT means that the memory is allocated for a whole
+		// time  of working with the library.
+		this->cinfo.src = static_cast<jpeg_source_mgr*>(
+			(this->cinfo.mem->alloc_small)(j_common_ptr(&this->cinfo), JPOOL_PERMANENT, sizeof(data_manager_jpeg_source))
+		);
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		src = reinterpret_cast<data_manager_jpeg_source*>(this->cinfo.src);
+		if (!src) {
+			throw std::bad_alloc();
+		}
+
+		// allocate memory for read data
+		src->buffer = static_cast<JOCTET*>(
+			(this->cinfo.mem->alloc_small)(j_common_ptr(&this->cinfo), JPOOL_PERMANENT, jpeg_input_buffer_size * sizeof(JOCTET))
+		);
+
+		if (!src->buffer) {
+			throw std::bad_alloc();
+		}
+	} else {
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		src = reinterpret_cast<data_manager_jpeg_source*>(this->cinfo.src);
+	}
+
+	// set handler functions
+	src->pub.init_source = &jpeg_init_source_callback;
+	src->pub.fill_input_buffer = &jpeg_callback_fill_input_buffer;
+	src->pub.skip_input_data = &jpeg_callback_skip_input_data;
+	src->pub.resync_to_restart = &jpeg_resync_to_restart; // use default func
+	src->pub.term_source = &jpeg_callback_term_source;
+	// set the fields of our structure
+	src->fi = &this->fi;
+	src->rec = &this->rec;
+	// set pointers to the buffers
+	src->pub.bytes_in_buffer = 0; // forces fill_input_buffer on first read
+	src->pub.next_input_byte = nullptr; // until buffer loaded
+
+	this->call([this]() {
+		jpeg_read_header(&this->cinfo, TRUE); // read parametrs of a JPEG file
+	});
+}
+} // namespace
+
+image_info rasterimage::probe_jpeg(const fsif::file& fi)
+{
+	utki::assert(!fi.is_open(), SL);
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_jpeg);
+
+	fsif::file::guard file_guard(fi);
+
+	jpeg_reader reader(fi, rec);
+	reader.read_header();
+
+	return reader.get_info();
+}
+
+namespace {
+// Pixel type of decoded image requested by the caller.
+struct pixel_type_request {
+	format pixel_format;
+	depth channel_depth;
+};
+
+// Convert 8 bit pixel to another number of channels.
+template <size_t to_num_channels, size_t num_channels>
+r4::vector<uint8_t, to_num_channels> convert_channels(const r4::vector<uint8_t, num_channels>& px)
+{
+	if constexpr (to_num_channels == num_channels) {
+		return px;
+	} else {
+		auto rgba = get_rgba(px);
+		if constexpr (to_num_channels == 1) {
+			return {luminance(px)};
+		} else if constexpr (to_num_channels == 2) {
+			return {luminance(px), rgba.a()};
+		} else if constexpr (to_num_channels == 3) {
+			return {rgba.r(), rgba.g(), rgba.b()};
+		} else {
+			static_assert(to_num_channels == 4, "unexpected number of channels");
+			return rgba;
+		}
+	}
+}
+
+// Convert decoded row of 8 bit pixels in canonical channel order to destination pixel type.
+template <size_t src_num_channels, typename channel_type, size_t num_channels>
+void convert_row(const JSAMPLE* src, utki::span<r4::vector<channel_type, num_channels>> dst, format pixel_format)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	auto src_pixels = utki::make_span(reinterpret_cast<const r4::vector<uint8_t, src_num_channels>*>(src), dst.size());
+	if (to_canonical(pixel_format) == pixel_format) {
+		std::transform(src_pixels.begin(), src_pixels.end(), dst.begin(), [](const auto& px) {
+			return to<channel_type>(convert_channels<num_channels>(px));
+		});
+	} else {
+		std::transform(src_pixels.begin(), src_pixels.end(), dst.begin(), [pixel_format](const auto& px) {
+			return from_canonical_order(pixel_format, to<channel_type>(convert_channels<num_channels>(px)));
+		});
+	}
+}
+
+// Set libjpeg output color space closest to the requested pixel format,
+// so that the color conversion is done by libjpeg while decoding.
+void set_output_color_space(jpeg_decompress_struct& cinfo, format pixel_format)
+{
+	switch (cinfo.jpeg_color_space) {
+		case JCS_GRAYSCALE:
+		case JCS_YCbCr:
+		case JCS_RGB:
+			break;
+		default:
+			// e.g. CMYK, decode as is and convert the decoded pixels
+			return;
+	}
+
+	switch (pixel_format) {
+		case format::grey:
+		case format::greya:
+			cinfo.out_color_space = JCS_GRAYSCALE;
+			break;
+		case format::rgb:
+			cinfo.out_color_space = JCS_RGB;
+			break;
+		case format::rgba:
+#ifdef JCS_ALPHA_EXTENSIONS
+			// libjpeg-turbo fills alpha channel with opaque value
+			cinfo.out_color_space = JCS_EXT_RGBA;
+#else
+			cinfo.out_color_space = JCS_RGB;
+#endif
+			break;
+		case format::bgr:
+#ifdef JCS_EXTENSIONS
+			cinfo.out_color_space = JCS_EXT_BGR;
+#else
+			cinfo.out_color_space = JCS_RGB;
+#endif
+			break;
+		case format::bgra:
+#ifdef JCS_ALPHA_EXTENSIONS
+			cinfo.out_color_space = JCS_EXT_BGRA;
+#else
+			cinfo.out_color_space = JCS_RGB;
+#endif
+			break;
+		case format::argb:
+#ifdef JCS_ALPHA_EXTENSIONS
+			cinfo.out_color_space = JCS_EXT_ARGB;
+#else
+			cinfo.out_color_space = JCS_RGB;
+#endif
+			break;
+		case format::enum_size:
+			throw std::invalid_argument("rasterimage::read_jpeg(): invalid pixel format");
+	}
+}
+
+// Get pixel format of the rows produced by libjpeg, must be called after jpeg_start_decompress().
+format get_decoded_format(const jpeg_decompress_struct& cinfo)
+{
+	switch (cinfo.out_color_space) {
+#ifdef JCS_EXTENSIONS
+		case JCS_EXT_BGR:
+			return format::bgr;
+#endif
+#ifdef JCS_ALPHA_EXTENSIONS
+		case JCS_EXT_BGRA:
+			return format::bgra;
+		case JCS_EXT_ARGB:
+			return format::argb;
+#endif
+		default:
+			return to_format(cinfo.output_components);
+	}
+}
+
+// Decode JPEG image to the destination returned by the getter.
+// The getter is called once the image header is read, the destination must be of the decoded pixel type.
+void decode_jpeg(
+	const fsif::file& fi,
+	const std::optional<pixel_type_request>& request,
+	const internal::destination_getter& get_destination
+)
+{
+	utki::assert(!fi.is_open(), SL);
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_jpeg);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(fi);
+
+	jpeg_reader reader(fi, rec);
+	reader.read_header();
+
+	auto& cinfo = reader.cinfo;
+
+	if (request.has_value()) {
+		// libjpeg only reorders channels of 8 bit pixels, deeper pixels are converted from canonical order
+		set_output_color_space(
+			cinfo,
+			request->channel_depth == depth::uint_8_bit ? request->pixel_format : to_canonical(request->pixel_format)
+		);
+	}
+
+	// calculate output_width, output_height and output_components according to decompression parameters
+	reader.call([&cinfo]() {
+		jpeg_calc_output_dimensions(&cinfo);
+	});
+
+	image_info dst_info = {
+		{cinfo.output_width, cinfo.output_height},
+		request.has_value() ? request->pixel_format : to_format(cinfo.output_components),
+		request.has_value() ? request->channel_depth : depth::uint_8_bit
+	};
+
+	// check before starting decompression, since for multi-scan images it allocates coefficients of the whole image
+	internal::check_decode_limits(dst_info);
+
+	reader.call([&cinfo]() {
+		jpeg_start_decompress(&cinfo); // start decompression
+	});
+
+	rec.start(instrumentation::phase::allocation);
+
+	auto dst = get_destination(dst_info);
+
+	// calculate the size of a row in bytes
+	auto num_bytes_in_row = JDIMENSION(cinfo.output_width * JDIMENSION(cinfo.output_components));
+
+	// Allocate memory for one row. It is an array of rows which
+	// contains only one row. JPOOL_IMAGE means that the memory is allocated
+	// only for time of this image reading. So, no need to free the memory explicitly.
+	JSAMPARRAY buffer = nullptr;
+	reader.call([&cinfo, &buffer, num_bytes_in_row]() {
+		buffer = (cinfo.mem->alloc_sarray)(j_common_ptr(&cinfo), JPOOL_IMAGE, num_bytes_in_row, 1);
+	});
+
+	rec.start(instrumentation::phase::decode);
+
+	auto decoded_format = get_decoded_format(cinfo);
+	auto pixel_format = dst.get_format();
+
+	reader.call([&]() {
+		// decode directly to the destination in case the decoded pixel type is the destination's one
+		if (dst.get_depth() == depth::uint_8_bit && decoded_format == pixel_format) {
+			for (uint32_t y = 0; y != dst.dims().y(); ++y) {
+				JSAMPROW p = dst[y].data();
+				jpeg_read_scanlines(&cinfo, &p, 1);
+			}
+			return;
+		}
+
+		// rows are only reordered by libjpeg when decoding directly
+		ASSERT(to_canonical(decoded_format) == decoded_format)
+
+		rasterimage::visit(
+			[&cinfo, &buffer, pixel_format](auto span) {
+				for (auto row : span) {
+					jpeg_read_scanlines(&cinfo, buffer, 1);
+					switch (cinfo.output_components) {
+						case 1:
+							convert_row<1>(*buffer, row, pixel_format);
+							break;
+						case 2:
+							convert_row<2>(*buffer, row, pixel_format);
+							break;
+						case 3:
+							convert_row<3>(*buffer, row, pixel_format);
+							break;
+						case 4:
+							convert_row<4>(*buffer, row, pixel_format);
+							break;
+						default:
+							throw std::invalid_argument(
+								"rasterimage::read_jpeg(): unsupported number of color components"
+							);
+					}
+				}
+			},
+			dst
+		);
+	});
+	rec.add_rows(dst.dims().y());
+
+	rec.start(instrumentation::phase::post_process);
+
+	// NOTE: in case of exception the decompression is aborted by jpeg_destroy_decompress(),
+	//       so no need to finish it from the scope exit
+	reader.call([&cinfo]() {
+		jpeg_finish_decompress(&cinfo); // finish file decompression
+	});
+
+	rec.finish();
+}
+
+image_variant decode_jpeg(const fsif::file& fi, const std::optional<pixel_type_request>& request)
+{
+	image_variant im;
+	decode_jpeg(fi, request, [&im](const image_info& info) {
+		im = image_variant(info.dims, info.pixel_format, info.channel_depth);
+		return im.span();
+	});
+	return im;
+}
+} // namespace
+
+image_variant rasterimage::read_jpeg(const fsif::file& fi)
+{
+	return decode_jpeg(fi, std::nullopt);
+}
+
+image_variant rasterimage::read_jpeg(const fsif::file& fi, format pixel_format, depth channel_depth)
+{
+	return decode_jpeg(fi, pixel_type_request{pixel_format, channel_depth});
+}
+
+void rasterimage::read_jpeg(const fsif::file& fi, any_image_span dst)
+{
+	decode_jpeg(fi, pixel_type_request{dst.get_format(), dst.get_depth()}, internal::make_destination_getter(dst));
+}
+
+void internal::read_jpeg(const fsif::file& fi, const destination_getter& get_destination)
+{
+	decode_jpeg(fi, std::nullopt, get_destination);
+}
+
+namespace {
+// Layout of baseline JPEG file with restart markers.
+// Restart markers reset the entropy decoder state, so data between restart markers can be decoded independently.
+// To decode a horizontal band of the image, a separate JPEG stream is composed of the original file header
+// with image height adjusted to the band height, followed by the band's entropy coded segments.
+struct jpeg_restart_layout {
+	uint32_t width = 0;
+	uint32_t height = 0;
+
+	// offset of image height field in SOF segment
+	size_t sof_height_offset = 0;
+
+	// offset of entropy coded data, i.e. data right after SOS segment
+	size_t scan_data_offset = 0;
+
+	// offset of the marker which ends the entropy coded data
+	size_t scan_data_end = 0;
+
+	// offsets of entropy coded segments, each segment, except the first one, is preceded by RSTn marker
+	std::vector<size_t> segment_offsets;
+
+	// number of MCUs between restart markers
+	unsigned restart_interval = 0;
+
+	// MCU size in pixels
+	unsigned mcu_width = 0;
+	unsigned mcu_height = 0;
+
+	unsigned mcus_per_row = 0;
+	unsigned num_mcu_rows = 0;
+
+	// chroma upsampling of the pixel rows near MCU row boundary uses neighbouring MCU rows
+	bool needs_context_rows = false;
+};
+
+constexpr uint8_t jpeg_marker_prefix = 0xff;
+
+uint16_t read_jpeg_uint16(utki::span<const uint8_t> data, size_t offset)
+{
+	if (offset + 1 >= data.size()) {
+		throw std::invalid_argument("truncated JPEG data");
+	}
+	return uint16_t((unsigned(data[offset]) << utki::byte_bits) | unsigned(data[offset + 1]));
+}
+
+// Returns empty optional if the image cannot be decoded in parallel.
+std::optional<jpeg_restart_layout> parse_jpeg_restart_layout(utki::span<const uint8_t> data)
+{
+	// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+	constexpr uint8_t soi = 0xd8;
+	constexpr uint8_t eoi = 0xd9;
+	constexpr uint8_t sof0 = 0xc0; // baseline
+	constexpr uint8_t sof1 = 0xc1; // extended sequential, Huffman coding
+	constexpr uint8_t sof15 = 0xcf;
+	constexpr uint8_t dht = 0xc4;
+	constexpr uint8_t jpg = 0xc8;
+	constexpr uint8_t dac = 0xcc;
+	constexpr uint8_t dri = 0xdd;
+	constexpr uint8_t sos = 0xda;
+	constexpr uint8_t rst0 = 0xd0;
+	constexpr uint8_t rst7 = 0xd7;
+	constexpr unsigned block_size = 8;
+	constexpr unsigned sampling_factor_bits = 4;
+	constexpr unsigned sampling_factor_mask = 0xf;
+	// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+
+	if (data.size() < 2 || data[0] != jpeg_marker_prefix || data[1] != soi) {
+		return {};
+	}
+
+	jpeg_restart_layout l;
+
+	unsigned num_components = 0;
+	unsigned max_h = 1;
+	unsigned max_v = 1;
+	unsigned min_v = std::numeric_limits<unsigned>::max();
+
+	// parse markers up to the start of scan
+	for (size_t pos = 2;;) {
+		if (pos >= data.size() || data[pos] != jpeg_marker_prefix) {
+			return {};
+		}
+		// skip fill bytes
+		while (pos < data.size() && data[pos] == jpeg_marker_prefix) {
+			++pos;
+		}
+		if (pos >= data.size()) {
+			return {};
+		}
+		uint8_t marker = data[pos];
+		++pos;
+
+		size_t length = read_jpeg_uint16(data, pos);
+		if (length < 2 || pos + length > data.size()) {
+			return {};
+		}
+
+		if (marker == sof0 || marker == sof1) {
+			// precision, height, width, number of components, then 3 bytes per component
+			if (length < 8 || data[pos + 2] != utki::byte_bits) {
+				return {};
+			}
+			l.sof_height_offset = pos + 3;
+			l.height = read_jpeg_uint16(data, pos + 3);
+			l.width = read_jpeg_uint16(data, pos + 5);
+			num_components = data[pos + 7];
+			if (num_components == 0 || length != 8 + 3 * size_t(num_components)) {
+				return {};
+			}
+			for (unsigned i = 0; i != num_components; ++i) {
+				auto sampling_factors = data[pos + 8 + 3 * i + 1];
+				unsigned h = unsigned(sampling_factors >> sampling_factor_bits);
+				unsigned v = unsigned(sampling_factors & sampling_factor_mask);
+				max_h = std::max(max_h, h);
+				max_v = std::max(max_v, v);
+				min_v = std::min(min_v, v);
+			}
+		} else if (marker >= sof0 && marker <= sof15 && marker != dht && marker != jpg && marker != dac) {
+			// progressive, lossless or arithmetic coding
+			return {};
+		} else if (marker == dri) {
+			l.restart_interval = read_jpeg_uint16(data, pos + 2);
+		} else if (marker == sos) {
+			// only single interleaved scan of all components is supported
+			if (num_components == 0 || data[pos + 2] != num_components) {
+				return {};
+			}
+			l.scan_data_offset = pos + length;
+			break;
+		}
+
+		pos += length;
+	}
+
+	if (l.restart_interval == 0 || l.width == 0 || l.height == 0) {
+		return {};
+	}
+
+	if (num_components == 1) {
+		// non-interleaved scan, MCU is one block
+		l.mcu_width = block_size;
+		l.mcu_height = block_size;
+	} else {
+		l.mcu_width = block_size * max_h;
+		l.mcu_height = block_size * max_v;
+		l.needs_context_rows = min_v != max_v;
+	}
+
+	l.mcus_per_row = (l.width + l.mcu_width - 1) / l.mcu_width;
+	l.num_mcu_rows = (l.height + l.mcu_height - 1) / l.mcu_height;
+
+	// find restart markers
+	l.segment_offsets.push_back(l.scan_data_offset);
+	for (auto i = std::next(data.begin(), ptrdiff_t(l.scan_data_offset));;) {
+		i = std::find(i, data.end(), jpeg_marker_prefix);
+		if (i == data.end() || std::next(i) == data.end()) {
+			// truncated data
+			return {};
+		}
+		auto m = *std::next(i);
+		if (m == 0 || m == jpeg_marker_prefix) {
+			// stuffed zero byte or fill byte
+			++i;
+			continue;
+		}
+		if (m >= rst0 && m <= rst7) {
+			std::advance(i, 2);
+			l.segment_offsets.push_back(size_t(std::distance(data.begin(), i)));
+			continue;
+		}
+		if (m != eoi) {
+			// e.g. DNL marker
+			return {};
+		}
+		l.scan_data_end = size_t(std::distance(data.begin(), i));
+		break;
+	}
+
+	auto num_mcus = size_t(l.mcus_per_row) * size_t(l.num_mcu_rows);
+	if (l.segment_offsets.size() != (num_mcus + l.restart_interval - 1) / l.restart_interval) {
+		// corrupted data, let the serial decoder deal with it
+		return {};
+	}
+
+	return l;
+}
+
+// Compose JPEG stream for decoding MCU rows [begin_mcu_row, end_mcu_row).
+// The MCU rows must start at restart interval boundaries.
+std::vector<uint8_t> make_jpeg_band_stream(
+	utki::span<const uint8_t> data,
+	const jpeg_restart_layout& l,
+	unsigned begin_mcu_row,
+	unsigned end_mcu_row
+)
+{
+	auto begin_segment = size_t(begin_mcu_row) * l.mcus_per_row / l.restart_interval;
+	ASSERT(size_t(begin_mcu_row) * l.mcus_per_row % l.restart_interval == 0)
+
+	size_t end_segment = l.segment_offsets.size();
+	size_t scan_end = l.scan_data_end;
+	if (end_mcu_row != l.num_mcu_rows) {
+		ASSERT(size_t(end_mcu_row) * l.mcus_per_row % l.restart_interval == 0)
+		end_segment = size_t(end_mcu_row) * l.mcus_per_row / l.restart_interval;
+		// exclude RSTn marker preceding the end segment
+		scan_end = l.segment_offsets[end_segment] - 2;
+	}
+
+	auto band_height = std::min(end_mcu_row * l.mcu_height, l.height) - begin_mcu_row * l.mcu_height;
+
+	std::vector<uint8_t> ret;
+	ret.reserve(l.scan_data_offset + (scan_end - l.segment_offsets[begin_segment]) + 2);
+
+	ret.insert(ret.end(), data.begin(), std::next(data.begin(), ptrdiff_t(l.scan_data_offset)));
+	ret[l.sof_height_offset] = uint8_t(band_height >> utki::byte_bits);
+	ret[l.sof_height_offset + 1] = uint8_t(band_height & utki::byte_mask);
+
+	auto scan_start = ret.size();
+	ret.insert(
+		ret.end(),
+		std::next(data.begin(), ptrdiff_t(l.segment_offsets[begin_segment])),
+		std::next(data.begin(), ptrdiff_t(scan_end))
+	);
+
+	// decoder expects restart markers to be numbered sequentially starting from RST0
+	constexpr uint8_t rst0 = 0xd0;
+	constexpr size_t num_rst_markers = 8;
+	for (auto s = begin_segment + 1; s != end_segment; ++s) {
+		auto marker_offset = scan_start + (l.segment_offsets[s] - l.segment_offsets[begin_segment]) - 1;
+		ASSERT(ret[marker_offset - 1] == jpeg_marker_prefix)
+		ret[marker_offset] = uint8_t(rst0 + (s - begin_segment - 1) % num_rst_markers);
+	}
+
+	constexpr uint8_t eoi = 0xd9;
+	ret.push_back(jpeg_marker_prefix);
+	ret.push_back(eoi);
+
+	return ret;
+}
+
+// Decode band stream, skip first skip_rows and write following rows to the destination.
+template <size_t num_channels>
+void decode_jpeg_band(std::vector<uint8_t> stream, uint32_t skip_rows, image_span<uint8_t, num_channels> dst)
+{
+	fsif::memory_file fi(std::move(stream));
+	fsif::file::guard file_guard(fi);
+
+	// band statistics are not reported, they are accounted in the statistics of the whole image
+	instrumentation::internal::recorder rec(instrumentation::operation::read_jpeg);
+
+	jpeg_reader reader(fi, rec);
+	reader.read_header();
+
+	auto& cinfo = reader.cinfo;
+
+	reader.call([&cinfo]() {
+		jpeg_start_decompress(&cinfo);
+	});
+
+	if (size_t(cinfo.output_components) != num_channels || cinfo.output_width != dst.dims().x() ||
+		cinfo.output_height < skip_rows + dst.dims().y())
+	{
+		throw std::invalid_argument("rasterimage::read_jpeg(): unexpected JPEG band properties");
+	}
+
+	std::vector<JSAMPLE> skip_buffer(size_t(cinfo.output_width) * num_channels);
+
+	reader.call([&]() {
+		for (uint32_t y = 0; y != skip_rows; ++y) {
+			JSAMPROW row = skip_buffer.data();
+			jpeg_read_scanlines(&cinfo, &row, 1);
+		}
+
+		for (auto row : dst) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			JSAMPROW p = reinterpret_cast<JSAMPLE*>(row.data());
+			jpeg_read_scanlines(&cinfo, &p, 1);
+		}
+	});
+
+	// the rest of the band stream is not needed, jpeg_destroy_decompress() aborts the decompression
+}
+} // namespace
+
+image_variant rasterimage::read_jpeg(const fsif::file& fi, unsigned num_threads)
+{
+	utki::assert(!fi.is_open(), SL);
+
+	auto data = fi.load();
+
+	auto layout = parse_jpeg_restart_layout(data);
+	if (!layout.has_value()) {
+		return read_jpeg(fsif::memory_file(std::move(data)));
+	}
+	const auto& l = layout.value();
+
+	// MCU rows at which restart intervals start
+	unsigned unit_mcu_rows = l.restart_interval / std::gcd(l.restart_interval, l.mcus_per_row);
+	unsigned num_units = (l.num_mcu_rows + unit_mcu_rows - 1) / unit_mcu_rows;
+
+	internal::band_partition partition(num_units, size_t(unit_mcu_rows) * l.mcu_height * l.width, num_threads);
+	if (partition.size() == 1) {
+		return read_jpeg(fsif::memory_file(std::move(data)));
+	}
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_jpeg);
+	rec.start(instrumentation::phase::header);
+	rec.add_read(data.size());
+
+	auto info = [&data, &l]() {
+		// reading the header only needs the data up to the start of entropy coded data
+		fsif::memory_file mfi(
+			std::vector<uint8_t>(data.begin(), std::next(data.begin(), ptrdiff_t(l.scan_data_offset)))
+		);
+		return probe_jpeg(mfi);
+	}();
+
+	internal::check_decode_limits(info);
+
+	rec.start(instrumentation::phase::allocation);
+
+	image_variant im(info.dims, info.pixel_format, info.channel_depth);
+
+	rec.start(instrumentation::phase::decode);
+
+	std::visit(
+		[&](auto& image) {
+			using pixel_type = typename std::remove_reference_t<decltype(image)>::pixel_type;
+			if constexpr (std::is_same_v<typename pixel_type::value_type, uint8_t>) {
+				auto span = image.span();
+				partition.for_each([&](size_t, size_t begin_unit, size_t end_unit) {
+					// decode one more restart interval above and below the band, if available,
+					// so that chroma upsampling near band boundaries is same as for the whole image
+					size_t context = l.needs_context_rows ? 1 : 0;
+					auto decode_begin_unit = begin_unit - std::min(begin_unit, context);
+					auto decode_end_unit = std::min(end_unit + context, size_t(num_units));
+
+					auto to_mcu_row = [&](size_t unit) {
+						return unsigned(std::min(unit * unit_mcu_rows, size_t(l.num_mcu_rows)));
+					};
+					auto to_pixel_row = [&](size_t unit) {
+						return std::min(to_mcu_row(unit) * l.mcu_height, l.height);
+					};
+
+					auto begin_row = to_pixel_row(begin_unit);
+					auto end_row = to_pixel_row(end_unit);
+
+					decode_jpeg_band(
+						make_jpeg_band_stream(data, l, to_mcu_row(decode_begin_unit), to_mcu_row(decode_end_unit)),
+						begin_row - to_pixel_row(decode_begin_unit),
+						span.subspan({
+							{0, begin_row},
+							{l.width, end_row - begin_row}
+						})
+					);
+				});
+			} else {
+				utki::assert(false, SL);
+			}
+		},
+		im.variant
+	);
+
+	rec.add_rows(im.dims().y());
+
+	rec.finish();
+
+	return im;
+}
+
+void internal::read_jpeg(
+	const fsif::file& fi,
+	const r4::rectangle<uint32_t>& roi,
+	const destination_getter& get_destination
+)
+{
+	utki::assert(!fi.is_open(), SL);
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_jpeg);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(fi);
+
+	jpeg_reader reader(fi, rec);
+	reader.read_header();
+
+	auto info = reader.get_info();
+
+	if (!r4::rectangle<uint32_t>({0, 0}, info.dims).contains(roi)) {
+		throw std::invalid_argument("rasterimage::read_jpeg(): region of interest is out of the image");
+	}
+
+	// the limits apply to the whole image, since libjpeg allocates its buffers for the whole image width
+	internal::check_decode_limits(info);
+
+	rec.start(instrumentation::phase::allocation);
+
+	auto dst = get_destination(info);
+
+	if (roi.d.x() == 0 || roi.d.y() == 0) {
+		rec.finish();
+		return;
+	}
+
+	rec.start(instrumentation::phase::decode);
+
+	auto& cinfo = reader.cinfo;
+
+	reader.call([&cinfo]() {
+		jpeg_start_decompress(&cinfo);
+	});
+
+	JDIMENSION x_offset = roi.p.x();
+
+#ifdef LIBJPEG_TURBO_VERSION
+	// Only decode the iMCU columns which intersect with the region.
+	// The offset is moved left to iMCU boundary and the width is adjusted accordingly.
+	// The region is extended by one pixel to each side, so that chroma upsampling
+	// of the region's edge pixels has the neighbour pixels, same as when decoding the whole image.
+	reader.call([&]() {
+		x_offset = roi.p.x() == 0 ? 0 : roi.p.x() - 1;
+		JDIMENSION width = std::min(roi.p.x() + roi.d.x() + 1, cinfo.output_width) - x_offset;
+		jpeg_crop_scanline(&cinfo, &x_offset, &width);
+	});
+
+	// skipped rows are entropy decoded, but not dequantized, transformed and color converted
+	for (JDIMENSION num_skipped = 0; num_skipped != roi.p.y();) {
+		JDIMENSION n = 0;
+		reader.call([&]() {
+			n = jpeg_skip_scanlines(&cinfo, roi.p.y() - num_skipped);
+		});
+		if (n == 0) {
+			throw std::invalid_argument("rasterimage::read_jpeg(): could not skip scanlines");
+		}
+		num_skipped += n;
+	}
+#else
+	// skip rows above the region by decoding them
+	x_offset = 0;
+	{
+		std::vector<JSAMPLE> row(size_t(cinfo.output_width) * size_t(cinfo.output_components));
+		reader.call([&]() {
+			for (uint32_t y = 0; y != roi.p.y(); ++y) {
+				JSAMPROW p = row.data();
+				jpeg_read_scanlines(&cinfo, &p, 1);
+			}
+		});
+	}
+#endif
+
+	auto pixel_size = size_t(cinfo.output_components);
+	std::vector<JSAMPLE> row(size_t(cinfo.output_width) * pixel_size);
+
+	reader.call([&]() {
+		for (uint32_t y = 0; y != roi.d.y(); ++y) {
+			JSAMPROW p = row.data();
+			jpeg_read_scanlines(&cinfo, &p, 1);
+			std::copy_n(
+				std::next(row.begin(), ptrdiff_t((roi.p.x() - x_offset) * pixel_size)),
+				roi.d.x() * pixel_size,
+				dst[y].data()
+			);
+		}
+	});
+
+	rec.add_rows(roi.d.y());
+
+	// rows below the region are not needed, jpeg_destroy_decompress() aborts the decompression
+
+	rec.finish();
+}
+
+image_variant rasterimage::read_jpeg(const fsif::file& fi, const r4::rectangle<uint32_t>& roi)
+{
+	image_variant im;
+	internal::read_jpeg(fi, roi, internal::make_roi_destination_getter(roi, im));
+	return im;
+}
+
+void rasterimage::read_jpeg(const fsif::file& fi, const r4::rectangle<uint32_t>& roi, any_image_span dst)
+{
+	internal::read_jpeg(fi, roi, internal::make_roi_destination_getter(roi, dst));
+}
+
+image_variant rasterimage::read_jpeg_preview(const fsif::file& fi, unsigned num_scans)
+{
+	utki::assert(!fi.is_open(), SL);
+
+	if (num_scans == 0) {
+		throw std::invalid_argument("rasterimage::read_jpeg_preview(): number of scans must be greater than zero");
+	}
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_jpeg);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(fi);
+
+	jpeg_reader reader(fi, rec);
+	reader.read_header();
+
+	auto& cinfo = reader.cinfo;
+
+	// In buffered-image mode the input is consumed scan by scan into the coefficient buffer
+	// and the output pass can be run at any point, reconstructing the image from the scans consumed so far.
+	bool buffered = false;
+	reader.call([&cinfo, &buffered]() {
+		buffered = jpeg_has_multiple_scans(&cinfo);
+	});
+	cinfo.buffered_image = buffered ? TRUE : FALSE;
+
+	internal::check_decode_limits(reader.get_info());
+
+	// in buffered-image mode this reads the input up to the first scan
+	reader.call([&cinfo]() {
+		jpeg_start_decompress(&cinfo);
+	});
+
+	rec.start(instrumentation::phase::allocation);
+
+	image_variant im({cinfo.output_width, cinfo.output_height}, to_format(cinfo.output_components), depth::uint_8_bit);
+
+	rec.start(instrumentation::phase::decode);
+
+	if (buffered) {
+		reader.call([&]() {
+			// scans up to input_scan_number - 1 are complete when the start of the next scan is reached
+			for (;;) {
+				auto ret = jpeg_consume_input(&cinfo);
+				if (ret == JPEG_REACHED_EOI) {
+					break;
+				}
+				if (ret == JPEG_REACHED_SOS && unsigned(cinfo.input_scan_number) > num_scans) {
+					break;
+				}
+				if (ret == JPEG_SUSPENDED) {
+					throw std::invalid_argument("rasterimage::read_jpeg_preview(): could not read JPEG data");
+				}
+			}
+
+			auto scan_number = jpeg_input_complete(&cinfo) ? cinfo.input_scan_number : int(num_scans);
+			jpeg_start_output(&cinfo, scan_number);
+		});
+	}
+
+	reader.call([&]() {
+		std::visit(
+			[&cinfo](auto& image) {
+#ifdef DEBUG
+				using pixel_type = typename std::remove_reference_t<decltype(image)>::pixel_type;
+				ASSERT((std::is_same_v<typename pixel_type::value_type, uint8_t>))
+#endif
+				for (auto i = image.span().begin(); cinfo.output_scanline < cinfo.output_height; ++i) {
+					// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+					JSAMPROW row = reinterpret_cast<uint8_t*>(i->data());
+					jpeg_read_scanlines(&cinfo, &row, 1);
+				}
+			},
+			im.variant
+		);
+	});
+
+	rec.add_rows(im.dims().y());
+
+	rec.start(instrumentation::phase::post_process);
+
+	reader.call([&]() {
+		if (buffered) {
+			jpeg_finish_output(&cinfo);
+		}
+
+		// in case the rest of the scans was not read, jpeg_destroy_decompress() aborts the decompression
+		if (!buffered || jpeg_input_complete(&cinfo)) {
+			jpeg_finish_decompress(&cinfo);
+		}
+	});
+
+	rec.finish();
+
+	return im;
+}
+
+namespace {
+// Incremental JPEG decoder.
+// Uses suspending data source: when libjpeg runs out of input data it suspends,
+// then decoding is resumed from the same point when more data is pushed.
+// libjpeg reports errors via error_exit callback which longjmps back to process().
+// In case progressive refinement is requested, multi-scan images are decoded in buffered-image mode:
+// the input is consumed into the coefficient buffer and after each push() which completes new scans
+// the image is reconstructed from the scans received so far.
+class jpeg_push_codec : public internal::push_codec
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+	jpeg_error_mgr jerr;
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+	jpeg_source_mgr src;
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+	jpeg_decompress_struct cinfo;
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-member-init)
+	std::jmp_buf jump_buffer;
+
+	std::array<char, JMSG_LENGTH_MAX> error_message = {0};
+
+	// buffered input data which has not been consumed by libjpeg yet
+	std::vector<JOCTET> buffer;
+
+	// number of bytes requested to be skipped beyond the buffered data
+	size_t num_bytes_to_skip = 0;
+
+	uint8_t* pixels = nullptr;
+	size_t row_size_bytes = 0;
+
+	// whether buffered-image mode is used
+	bool buffered = false;
+
+	// number of scans the current content of the image is reconstructed from
+	unsigned num_output_scans = 0;
+
+	enum class state {
+		header,
+		start,
+		scans, // buffered-image mode only
+		scanlines,
+		finish_output, // buffered-image mode only
+		finish,
+		done
+	};
+
+	state cur_state = state::header;
+
+	static jpeg_push_codec& get_codec(j_common_ptr cinfo)
+	{
+		ASSERT(cinfo)
+		auto c = static_cast<jpeg_push_codec*>(cinfo->client_data);
+		ASSERT(c)
+		return *c;
+	}
+
+	[[noreturn]] static void error_exit_callback(j_common_ptr cinfo)
+	{
+		auto& c = get_codec(cinfo);
+		(*cinfo->err->format_message)(cinfo, c.error_message.data());
+		std::longjmp(c.jump_buffer, 1);
+	}
+
+	static void init_source_callback(j_decompress_ptr /* cinfo */) {}
+
+	// there is no more data available at the moment, suspend decoding
+	static boolean fill_input_buffer_callback(j_decompress_ptr /* cinfo */)
+	{
+		return FALSE;
+	}
+
+	static void skip_input_data_callback(j_decompress_ptr cinfo, long num_bytes)
+	{
+		if (num_bytes <= 0) {
+			return;
+		}
+
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		auto& c = get_codec(reinterpret_cast<j_common_ptr>(cinfo));
+
+		auto n = std::min(size_t(num_bytes), c.src.bytes_in_buffer);
+
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		c.src.next_input_byte += n;
+		c.src.bytes_in_buffer -= n;
+
+		// the rest is skipped when the data arrives
+		c.num_bytes_to_skip += size_t(num_bytes) - n;
+	}
+
+	static void term_source_callback(j_decompress_ptr /* cinfo */) {}
+
+	void on_header()
+	{
+		// calculate output_width, output_height and output_components according to decompression parameters
+		jpeg_calc_output_dimensions(&this->cinfo);
+
+		auto& im = this->allocate_image({
+			{this->cinfo.output_width, this->cinfo.output_height},
+			to_format(this->cinfo.output_components),
+			depth::uint_8_bit
+		});
+
+		std::visit(
+			[this](auto& image) {
+				using pixel_type = typename std::remove_reference_t<decltype(image)>::pixel_type;
+				ASSERT((std::is_same_v<typename pixel_type::value_type, uint8_t>))
+				this->row_size_bytes = sizeof(pixel_type) * image.dims().x();
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+				this->pixels = reinterpret_cast<uint8_t*>(image.pixels().data());
+			},
+			im.variant
+		);
+
+		this->buffered = this->owner.callbacks.refinement && jpeg_has_multiple_scans(&this->cinfo);
+		this->cinfo.buffered_image = this->buffered ? TRUE : FALSE;
+	}
+
+	// Reconstruct the image from the completely received scans.
+	// Called from process(), so same restrictions apply.
+	void output_refinement(int scan_number)
+	{
+		jpeg_start_output(&this->cinfo, scan_number);
+		while (this->cinfo.output_scanline < this->cinfo.output_height) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			JSAMPROW row = this->pixels + size_t(this->cinfo.output_scanline) * this->row_size_bytes;
+			[[maybe_unused]] auto n = jpeg_read_scanlines(&this->cinfo, &row, 1);
+			// the scans being output are completely received, so reading does not suspend
+			ASSERT(n == 1)
+		}
+		jpeg_finish_output(&this->cinfo);
+		this->num_output_scans = unsigned(scan_number);
+	}
+
+	// Advance decoding as far as the buffered data allows.
+	// Returns false in case of libjpeg error.
+	bool process()
+	{
+		// NOTE: no non-trivially destructible objects are allowed in this function,
+		//       because libjpeg error makes longjmp back to here
+		if (setjmp(this->jump_buffer)) {
+			return false;
+		}
+
+		for (;;) {
+			switch (this->cur_state) {
+				case state::header:
+					if (jpeg_read_header(&this->cinfo, TRUE) == JPEG_SUSPENDED) {
+						return true;
+					}
+					this->on_header();
+					this->cur_state = state::start;
+					break;
+				case state::start:
+					// for multi-scan images the whole image data is consumed by jpeg_start_decompress()
+					if (!jpeg_start_decompress(&this->cinfo)) {
+						return true;
+					}
+					ASSERT(this->cinfo.output_components * this->cinfo.output_width == this->row_size_bytes)
+					this->cur_state = this->buffered ? state::scans : state::scanlines;
+					break;
+				case state::scans:
+					for (;;) {
+						auto ret = jpeg_consume_input(&this->cinfo);
+						if (ret == JPEG_SUSPENDED || ret == JPEG_REACHED_EOI) {
+							break;
+						}
+					}
+					if (jpeg_input_complete(&this->cinfo)) {
+						// final output pass
+						jpeg_start_output(&this->cinfo, this->cinfo.input_scan_number);
+						this->cur_state = state::scanlines;
+						break;
+					}
+					// scans before the one being received are complete
+					if (this->cinfo.input_scan_number - 1 > int(this->num_output_scans)) {
+						this->output_refinement(this->cinfo.input_scan_number - 1);
+					}
+					return true;
+				case state::scanlines:
+					while (this->cinfo.output_scanline < this->cinfo.output_height) {
+						// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+						JSAMPROW row = this->pixels + size_t(this->cinfo.output_scanline) * this->row_size_bytes;
+						if (jpeg_read_scanlines(&this->cinfo, &row, 1) == 0) {
+							return true;
+						}
+					}
+					this->cur_state = this->buffered ? state::finish_output : state::finish;
+					break;
+				case state::finish_output:
+					if (!jpeg_finish_output(&this->cinfo)) {
+						return true;
+					}
+					this->cur_state = state::finish;
+					break;
+				case state::finish:
+					if (!jpeg_finish_decompress(&this->cinfo)) {
+						return true;
+					}
+					this->cur_state = state::done;
+					[[fallthrough]];
+				case state::done:
+					return true;
+			}
+		}
+	}
+
+public:
+	jpeg_push_codec(push_decoder& owner) :
+		push_codec(owner)
+	{
+		// set error manager before calling to jpeg_create_*()
+		this->cinfo.err = jpeg_std_error(&this->jerr);
+		this->jerr.error_exit = &error_exit_callback;
+
+		jpeg_create_decompress(&this->cinfo);
+
+		this->cinfo.client_data = this;
+
+		this->src.init_source = &init_source_callback;
+		this->src.fill_input_buffer = &fill_input_buffer_callback;
+		this->src.skip_input_data = &skip_input_data_callback;
+		this->src.resync_to_restart = &jpeg_resync_to_restart; // use default func
+		this->src.term_source = &term_source_callback;
+		this->src.bytes_in_buffer = 0;
+		this->src.next_input_byte = nullptr;
+
+		this->cinfo.src = &this->src;
+	}
+
+	jpeg_push_codec(const jpeg_push_codec&) = delete;
+	jpeg_push_codec& operator=(const jpeg_push_codec&) = delete;
+
+	jpeg_push_codec(jpeg_push_codec&&) = delete;
+	jpeg_push_codec& operator=(jpeg_push_codec&&) = delete;
+
+	~jpeg_push_codec() override
+	{
+		jpeg_destroy_decompress(&this->cinfo);
+	}
+
+	bool push(utki::span<const uint8_t> data) override
+	{
+		if (this->cur_state == state::done) {
+			return true;
+		}
+
+		// skip the data which libjpeg has requested to skip
+		{
+			auto n = std::min(this->num_bytes_to_skip, data.size());
+			data = data.subspan(n);
+			this->num_bytes_to_skip -= n;
+		}
+
+		if (data.empty()) {
+			return false;
+		}
+
+		// drop the data consumed by libjpeg and append the new data
+		{
+			auto num_consumed = this->buffer.size() - this->src.bytes_in_buffer;
+			this->buffer.erase(this->buffer.begin(), std::next(this->buffer.begin(), ptrdiff_t(num_consumed)));
+			this->buffer.insert(this->buffer.end(), data.begin(), data.end());
+
+			this->src.next_input_byte = this->buffer.data();
+			this->src.bytes_in_buffer = this->buffer.size();
+		}
+
+		if (!this->process()) {
+			throw std::invalid_argument("rasterimage::push_decoder: JPEG decoding error: "s + this->error_message.data());
+		}
+
+		return this->cur_state == state::done;
+	}
+
+	uint32_t num_final_rows() const noexcept override
+	{
+		switch (this->cur_state) {
+			case state::header:
+			case state::start:
+			case state::scans:
+				return 0;
+			case state::scanlines:
+			case state::finish_output:
+			case state::finish:
+				return this->cinfo.output_scanline;
+			case state::done:
+				return this->cinfo.output_height;
+		}
+		return 0;
+	}
+
+	unsigned num_refined_scans() const noexcept override
+	{
+		return this->num_output_scans;
+	}
+};
+} // namespace
+
+std::unique_ptr<internal::push_codec> internal::make_jpeg_push_codec(push_decoder& owner)
+{
+	return std::make_unique<jpeg_push_codec>(owner);
+}
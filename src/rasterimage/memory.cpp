@@ -0,0 +1,277 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "memory.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#include <utki/debug.hpp>
+
+using namespace rasterimage;
+
+namespace {
+constexpr size_t num_buckets = size_t(depth::enum_size) * max_num_channels + 1;
+
+// Live byte counters are sharded to avoid contention between threads allocating images concurrently.
+// Each thread updates its own shard, the values are summed up on query. Since an image can be freed
+// by other thread than the one which allocated it, shard values can be negative.
+constexpr size_t num_shards = 16;
+
+// Changes of shard's live bytes are added to the approximate global counter in batches of at least this size,
+// so the approximate counter differs from the exact sum of shards by less than num_shards * flush_threshold.
+constexpr int64_t flush_threshold = 64 * 1024;
+
+constexpr size_t cache_line_size = 64;
+
+struct alignas(cache_line_size) shard {
+	std::atomic<int64_t> total_live{0};
+	std::array<std::atomic<int64_t>, num_buckets> bucket_live{};
+
+	// change of total_live which is not yet added to approximate_total_live
+	std::atomic<int64_t> unflushed{0};
+};
+
+std::array<shard, num_shards> shards;
+
+std::atomic<int64_t> approximate_total_live{0};
+
+std::atomic<size_t> total_peak{0};
+std::array<std::atomic<size_t>, num_buckets> bucket_peaks{};
+
+std::atomic<size_t> soft_limit{0};
+
+std::mutex tags_mutex;
+std::unordered_map<uint64_t, memory_usage> tags;
+
+thread_local uint64_t current_tag = 0;
+
+shard& get_thread_shard() noexcept
+{
+	static std::atomic<size_t> next_shard_index{0};
+	thread_local size_t shard_index = next_shard_index.fetch_add(1, std::memory_order_relaxed) % num_shards;
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+	return shards[shard_index];
+}
+
+size_t sum_total_live() noexcept
+{
+	int64_t ret = 0;
+	for (const auto& s : shards) {
+		ret += s.total_live.load(std::memory_order_relaxed);
+	}
+	// relaxed loads of different shards are not a snapshot, so the sum can be transiently negative
+	return size_t(std::max(ret, int64_t(0)));
+}
+
+size_t sum_bucket_live(size_t bucket) noexcept
+{
+	int64_t ret = 0;
+	for (const auto& s : shards) {
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+		ret += s.bucket_live[bucket].load(std::memory_order_relaxed);
+	}
+	return size_t(std::max(ret, int64_t(0)));
+}
+
+void update_peak(std::atomic<size_t>& peak, size_t value) noexcept
+{
+	auto p = peak.load(std::memory_order_relaxed);
+	while (p < value && !peak.compare_exchange_weak(p, value, std::memory_order_relaxed)) {
+	}
+}
+
+// returns true if the shard's changes were added to the approximate global counter
+bool flush(shard& s, int64_t delta) noexcept
+{
+	auto unflushed = s.unflushed.fetch_add(delta, std::memory_order_relaxed) + delta;
+	if (std::abs(unflushed) < flush_threshold) {
+		return false;
+	}
+	approximate_total_live.fetch_add(s.unflushed.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+	return true;
+}
+} // namespace
+
+void internal::memory_ticket::acquire()
+{
+	if (this->num_bytes == 0) {
+		return;
+	}
+
+	ASSERT(this->bucket < num_buckets)
+
+	// concurrent allocations and not yet flushed shard changes can make the live bytes
+	// exceed the limit slightly, so the limit is soft
+	auto limit = soft_limit.load(std::memory_order_relaxed);
+	if (limit != 0) {
+		auto approximate_live = size_t(std::max(approximate_total_live.load(std::memory_order_relaxed), int64_t(0)));
+		if (approximate_live + this->num_bytes > limit) {
+			// the allocation is about to fail, so it is worth checking the exact value
+			auto live = sum_total_live();
+			if (live + this->num_bytes > limit) {
+				throw memory_limit_exceeded(this->num_bytes, live, limit);
+			}
+		}
+	}
+
+	auto& s = get_thread_shard();
+	s.total_live.fetch_add(int64_t(this->num_bytes), std::memory_order_relaxed);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+	s.bucket_live[this->bucket].fetch_add(int64_t(this->num_bytes), std::memory_order_relaxed);
+
+	// peaks are only sampled when the shard is flushed, i.e. at least once per flush_threshold bytes
+	// allocated through the shard, and on query
+	if (flush(s, int64_t(this->num_bytes))) {
+		update_peak(total_peak, sum_total_live());
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+		update_peak(bucket_peaks[this->bucket], sum_bucket_live(this->bucket));
+	}
+
+	this->tag = current_tag;
+	if (this->tag != 0) {
+		std::lock_guard<std::mutex> lock(tags_mutex);
+		auto& u = tags[this->tag];
+		u.live_bytes += this->num_bytes;
+		u.peak_bytes = std::max(u.peak_bytes, u.live_bytes);
+	}
+}
+
+void internal::memory_ticket::release() noexcept
+{
+	if (this->num_bytes == 0) {
+		return;
+	}
+
+	auto& s = get_thread_shard();
+	s.total_live.fetch_sub(int64_t(this->num_bytes), std::memory_order_relaxed);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+	s.bucket_live[this->bucket].fetch_sub(int64_t(this->num_bytes), std::memory_order_relaxed);
+
+	flush(s, -int64_t(this->num_bytes));
+
+	if (this->tag != 0) {
+		std::lock_guard<std::mutex> lock(tags_mutex);
+		auto i = tags.find(this->tag);
+		// the tag could be released while the image was still alive
+		if (i != tags.end()) {
+			ASSERT(i->second.live_bytes >= this->num_bytes)
+			i->second.live_bytes -= this->num_bytes;
+		}
+	}
+
+	this->num_bytes = 0;
+}
+
+memory_usage rasterimage::get_memory_usage() noexcept
+{
+	auto live = sum_total_live();
+	update_peak(total_peak, live);
+	return {live, total_peak.load(std::memory_order_relaxed)};
+}
+
+memory_usage rasterimage::get_memory_usage(depth channel_depth, format pixel_format) noexcept
+{
+	ASSERT(channel_depth < depth::enum_size)
+	ASSERT(pixel_format < format::enum_size)
+
+	auto bucket = size_t(channel_depth) * max_num_channels + to_num_channels(pixel_format) - 1;
+
+	auto live = sum_bucket_live(bucket);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+	auto& peak = bucket_peaks[bucket];
+	update_peak(peak, live);
+	return {live, peak.load(std::memory_order_relaxed)};
+}
+
+memory_usage rasterimage::get_memory_usage(uint64_t tag)
+{
+	std::lock_guard<std::mutex> lock(tags_mutex);
+	auto i = tags.find(tag);
+	if (i == tags.end()) {
+		return {};
+	}
+	return i->second;
+}
+
+void rasterimage::release_memory_tag(uint64_t tag)
+{
+	std::lock_guard<std::mutex> lock(tags_mutex);
+	tags.erase(tag);
+}
+
+void rasterimage::reset_memory_peaks() noexcept
+{
+	total_peak.store(sum_total_live(), std::memory_order_relaxed);
+	for (size_t i = 0; i != num_buckets; ++i) {
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+		bucket_peaks[i].store(sum_bucket_live(i), std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(tags_mutex);
+	for (auto& t : tags) {
+		t.second.peak_bytes = t.second.live_bytes;
+	}
+}
+
+void rasterimage::set_memory_soft_limit(size_t limit_bytes) noexcept
+{
+	soft_limit.store(limit_bytes, std::memory_order_relaxed);
+}
+
+size_t rasterimage::get_memory_soft_limit() noexcept
+{
+	return soft_limit.load(std::memory_order_relaxed);
+}
+
+memory_limit_exceeded::memory_limit_exceeded(size_t requested_bytes, size_t live_bytes, size_t limit_bytes) :
+	message([&]() {
+		std::stringstream ss;
+		ss << "rasterimage: image allocation of " << requested_bytes << " bytes would exceed memory soft limit of "
+		   << limit_bytes << " bytes, " << live_bytes << " bytes are currently held by images";
+		return ss.str();
+	}()),
+	requested_bytes(requested_bytes),
+	live_bytes(live_bytes),
+	limit_bytes(limit_bytes)
+{}
+
+memory_tag_scope::memory_tag_scope(uint64_t tag) noexcept :
+	previous_tag(current_tag)
+{
+	current_tag = tag;
+}
+
+memory_tag_scope::~memory_tag_scope()
+{
+	current_tag = this->previous_tag;
+}
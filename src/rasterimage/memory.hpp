@@ -0,0 +1,258 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <cstdint>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "format.hpp"
+
+namespace rasterimage {
+
+/**
+ * @brief Memory usage of image pixel buffers.
+ */
+struct memory_usage {
+	/**
+	 * @brief Number of bytes currently held by pixel buffers.
+	 */
+	size_t live_bytes = 0;
+
+	/**
+	 * @brief Maximal value of live_bytes since the start of the process or since last reset_memory_peaks() call.
+	 * Process wide and per pixel type peaks are sampled once per 64 kilobytes allocated by a group of threads
+	 * and on query, so short spikes of small allocations can be missed.
+	 */
+	size_t peak_bytes = 0;
+};
+
+/**
+ * @brief Get memory usage of all image pixel buffers.
+ */
+memory_usage get_memory_usage() noexcept;
+
+/**
+ * @brief Get memory usage of image pixel buffers of given depth and format.
+ * Images of channel types or number of channels which do not correspond to any depth or format value
+ * are only accounted in the total memory usage.
+ * Pixel buffers are accounted by number of channels, so formats with the same number of channels,
+ * e.g. rgba and bgra, share the memory usage.
+ */
+memory_usage get_memory_usage(depth channel_depth, format pixel_format) noexcept;
+
+/**
+ * @brief Get memory usage of image pixel buffers allocated under the given tag.
+ * @param tag - tag to get memory usage for. See memory_tag_scope.
+ * @return Memory usage of the tag, or zero usage if there were no allocations under the tag
+ *         or the tag was released.
+ */
+memory_usage get_memory_usage(uint64_t tag);
+
+/**
+ * @brief Forget memory usage of the tag.
+ * Tag statistics are kept until this function is called, so that peak usage can be queried
+ * after all images of the tag are freed. Long running applications which use unique tags, e.g. request ids,
+ * should release the tags to avoid growth of the tags table.
+ * Images which are still alive are not accounted under the tag anymore after it is released.
+ */
+void release_memory_tag(uint64_t tag);
+
+/**
+ * @brief Reset peak values to current live values.
+ */
+void reset_memory_peaks() noexcept;
+
+/**
+ * @brief Set soft limit on total memory held by image pixel buffers.
+ * Image allocation which would make the total live bytes exceed the limit fails with
+ * memory_limit_exceeded exception. The limit is checked against a total which is updated
+ * in batches of 64 kilobytes per group of threads, so the live bytes can exceed the limit by up to a megabyte.
+ * @param limit_bytes - the limit in bytes. Zero means no limit, which is the default.
+ */
+void set_memory_soft_limit(size_t limit_bytes) noexcept;
+
+/**
+ * @brief Get soft limit on total memory held by image pixel buffers.
+ * @return Current soft limit in bytes. Zero means no limit.
+ */
+size_t get_memory_soft_limit() noexcept;
+
+/**
+ * @brief Image allocation would exceed memory soft limit.
+ */
+class memory_limit_exceeded : public std::bad_alloc
+{
+	std::string message;
+
+public:
+	const size_t requested_bytes;
+	const size_t live_bytes;
+	const size_t limit_bytes;
+
+	memory_limit_exceeded(size_t requested_bytes, size_t live_bytes, size_t limit_bytes);
+
+	const char* what() const noexcept override
+	{
+		return this->message.c_str();
+	}
+};
+
+/**
+ * @brief Tag image allocations of the calling thread.
+ * While the object exists, images allocated by the calling thread are accounted under the given tag
+ * in addition to the total and per depth/format accounting.
+ * Objects must be destroyed in reverse order of creation, previous tag is restored on destruction.
+ */
+class memory_tag_scope
+{
+	uint64_t previous_tag;
+
+public:
+	/**
+	 * @param tag - tag to account allocations under, e.g. request id. Zero means no tag.
+	 */
+	memory_tag_scope(uint64_t tag) noexcept;
+
+	memory_tag_scope(const memory_tag_scope&) = delete;
+	memory_tag_scope& operator=(const memory_tag_scope&) = delete;
+
+	memory_tag_scope(memory_tag_scope&&) = delete;
+	memory_tag_scope& operator=(memory_tag_scope&&) = delete;
+
+	~memory_tag_scope();
+};
+
+namespace internal {
+
+/**
+ * @brief Index of memory accounting bucket.
+ * Buckets correspond to depth and number of channels combinations, plus one bucket for all other pixel types.
+ */
+template <typename channel_type, size_t num_channels>
+constexpr size_t memory_bucket_index() noexcept
+{
+	constexpr size_t num_typed_buckets = size_t(depth::enum_size) * max_num_channels;
+
+	constexpr size_t depth_index = [] {
+		if constexpr (std::is_same_v<channel_type, uint8_t>) {
+			return size_t(depth::uint_8_bit);
+		} else if constexpr (std::is_same_v<channel_type, uint16_t>) {
+			return size_t(depth::uint_16_bit);
+		} else if constexpr (std::is_same_v<channel_type, float>) {
+			return size_t(depth::float_32_bit);
+		} else if constexpr (std::is_same_v<channel_type, float16>) {
+			return size_t(depth::float_16_bit);
+		} else {
+			return size_t(depth::enum_size);
+		}
+	}();
+
+	if constexpr (depth_index == size_t(depth::enum_size) || num_channels < 1 ||
+				  num_channels > max_num_channels)
+	{
+		return num_typed_buckets;
+	} else {
+		return depth_index * max_num_channels + num_channels - 1;
+	}
+}
+
+/**
+ * @brief Accounting record of one pixel buffer.
+ * Registers the buffer size in the memory accounting on construction and unregisters on destruction.
+ * Copying registers a buffer of the same size, moving transfers the registration.
+ */
+class memory_ticket
+{
+	size_t num_bytes;
+	size_t bucket;
+	uint64_t tag;
+
+	void acquire();
+	void release() noexcept;
+
+public:
+	/**
+	 * @throw memory_limit_exceeded - if the allocation would exceed the soft limit.
+	 */
+	memory_ticket(size_t num_bytes, size_t bucket) :
+		num_bytes(num_bytes),
+		bucket(bucket),
+		tag(0)
+	{
+		this->acquire();
+	}
+
+	memory_ticket(const memory_ticket& t) :
+		memory_ticket(t.num_bytes, t.bucket)
+	{}
+
+	memory_ticket& operator=(const memory_ticket& t)
+	{
+		if (this == &t) {
+			return *this;
+		}
+		// acquire new one before releasing the old one, so that in case of
+		// exceeding the limit this object stays unchanged
+		memory_ticket copy(t);
+		std::swap(*this, copy);
+		return *this;
+	}
+
+	memory_ticket(memory_ticket&& t) noexcept :
+		num_bytes(t.num_bytes),
+		bucket(t.bucket),
+		tag(t.tag)
+	{
+		t.num_bytes = 0;
+	}
+
+	memory_ticket& operator=(memory_ticket&& t) noexcept
+	{
+		if (this == &t) {
+			return *this;
+		}
+		this->release();
+		this->num_bytes = t.num_bytes;
+		this->bucket = t.bucket;
+		this->tag = t.tag;
+		t.num_bytes = 0;
+		return *this;
+	}
+
+	~memory_ticket()
+	{
+		this->release();
+	}
+};
+
+} // namespace internal
+
+} // namespace rasterimage
@@ -32,6 +32,9 @@ SOFTWARE.
 #include <utki/debug.hpp>
 #include <utki/types.hpp>
 
+#include "float16.hpp"
+#include "format.hpp"
+
 // TODO: doxygen
 namespace rasterimage {
 
@@ -64,7 +67,7 @@ constexpr value_type multiply(
 		return value_type(calc_type(a) * calc_type(b) / calc_type(val_max));
 	} else {
 		static_assert(
-			std::is_floating_point_v<value_type>,
+			is_floating_point_v<value_type>,
 			"unexpected value type, expected either integral or floating point"
 		);
 		ASSERT(val_zero <= a && a <= val_one)
@@ -74,6 +77,18 @@ constexpr value_type multiply(
 	}
 }
 
+/**
+ * @brief Multiply two half precision color values.
+ * The multiplication is done in single precision.
+ */
+inline float16 multiply(
+	float16 a, //
+	float16 b
+)
+{
+	return multiply(float(a), float(b));
+}
+
 /**
  * @brief Divide color value by another color value.
  * In case color value is of integral type it is treated as normalized value in range [0:1].
@@ -104,18 +119,28 @@ constexpr value_type divide(
 		return value_type(min(calc_type(calc_type(a) * calc_type(val_max) / calc_type(b)), calc_type(val_max)));
 	} else {
 		static_assert(
-			std::is_floating_point_v<value_type>,
+			is_floating_point_v<value_type>,
 			"unexpected value type, expected either integral or floating point"
 		);
 		ASSERT(val_zero <= a && a <= val_one)
 		ASSERT(val_zero < b && b <= val_one)
 
-		auto res = min(a / b, val_one); // clamp top
-
-		return a;
+		return min(a / b, val_one); // clamp top
 	}
 }
 
+/**
+ * @brief Divide half precision color value by another color value.
+ * The division is done in single precision.
+ */
+inline float16 divide(
+	float16 a, //
+	float16 b
+)
+{
+	return divide(float(a), float(b));
+}
+
 /**
  * @brief Construct value from float.
  * This is mainly to construct color value literals from floating point value.
@@ -127,7 +152,7 @@ constexpr value_type divide(
 template <typename value_type>
 constexpr value_type value(float f)
 {
-	if constexpr (std::is_floating_point_v<value_type>) {
+	if constexpr (is_floating_point_v<value_type>) {
 		return value_type(f);
 	} else {
 		static_assert(std::is_integral_v<value_type>, "unexpected non-integral value_type");
@@ -192,13 +217,18 @@ constexpr value_type luminance(const r4::vector<value_type, num_channels>& px)
 template <typename to_value_type = float, typename from_value_type, size_t num_channels>
 constexpr r4::vector<to_value_type, num_channels> to_float(const r4::vector<from_value_type, num_channels>& px)
 {
-	static_assert(std::is_floating_point_v<to_value_type>, "unexpected non-floating point destination type");
+	static_assert(is_floating_point_v<to_value_type>, "unexpected non-floating point destination type");
 	static_assert(std::is_integral_v<from_value_type>, "unexpceted non-integral source type");
 	static_assert(std::is_unsigned_v<from_value_type>, "unexpected signed source type");
 
-	constexpr auto val_max = std::numeric_limits<from_value_type>::max();
+	if constexpr (std::is_same_v<to_value_type, float16>) {
+		// 16 bit integral values are not representable in half precision, so convert via single precision
+		return to_float<float>(px).template to<float16>();
+	} else {
+		constexpr auto val_max = std::numeric_limits<from_value_type>::max();
 
-	return px.template to<to_value_type>() / to_value_type(val_max);
+		return px.template to<to_value_type>() / to_value_type(val_max);
+	}
 }
 
 /**
@@ -209,13 +239,18 @@ constexpr r4::vector<to_value_type, num_channels> to_float(const r4::vector<from
 template <typename to_value_type, typename from_value_type, size_t num_channels>
 constexpr r4::vector<to_value_type, num_channels> to_integral(const r4::vector<from_value_type, num_channels>& px)
 {
-	static_assert(std::is_floating_point_v<from_value_type>, "unexpected non-floating point source type");
+	static_assert(is_floating_point_v<from_value_type>, "unexpected non-floating point source type");
 	static_assert(std::is_integral_v<to_value_type>, "unexpceted non-integral destination type");
 	static_assert(std::is_unsigned_v<to_value_type>, "unexpected signed destination type");
 
-	constexpr auto val_max = std::numeric_limits<to_value_type>::max();
+	if constexpr (std::is_same_v<from_value_type, float16>) {
+		// 16 bit integral values are not representable in half precision, so convert via single precision
+		return to_integral<to_value_type>(px.template to<float>());
+	} else {
+		constexpr auto val_max = std::numeric_limits<to_value_type>::max();
 
-	return (px * val_max).template to<to_value_type>();
+		return (px * val_max).template to<to_value_type>();
+	}
 }
 
 template <typename to_value_type, typename from_value_type, size_t num_channels>
@@ -225,8 +260,8 @@ constexpr r4::vector<to_value_type, num_channels> to(const r4::vector<from_value
 		return px;
 	}
 
-	if constexpr (std::is_floating_point_v<from_value_type>) {
-		if constexpr (std::is_floating_point_v<to_value_type>) {
+	if constexpr (is_floating_point_v<from_value_type>) {
+		if constexpr (is_floating_point_v<to_value_type>) {
 			return px.template to<to_value_type>();
 		} else {
 			static_assert(std::is_integral_v<to_value_type>, "unexpected non-integral to_value_type");
@@ -237,7 +272,7 @@ constexpr r4::vector<to_value_type, num_channels> to(const r4::vector<from_value
 		static_assert(std::is_integral_v<from_value_type>, "unexpected non-integral from_value_type");
 		static_assert(std::is_unsigned_v<from_value_type>, "unexpected signed from_value_type");
 
-		if constexpr (std::is_floating_point_v<to_value_type>) {
+		if constexpr (is_floating_point_v<to_value_type>) {
 			return to_float<to_value_type>(px);
 		} else {
 			static_assert(std::is_integral_v<to_value_type>, "unexpected non-integral to_value_type");
@@ -319,4 +354,54 @@ inline value_type get_alpha(const r4::vector<value_type, num_channels>& px)
 	}
 }
 
+/**
+ * @brief Reorder pixel channels from the given format's order to the canonical order.
+ * E.g. BGRA pixel is converted to RGBA pixel.
+ * @param f - pixel format of the pixel. Must have num_channels channels.
+ * @param px - pixel to convert.
+ * @return Pixel with channels in the canonical order.
+ */
+template <typename value_type, size_t num_channels>
+constexpr r4::vector<value_type, num_channels> to_canonical_order(format f, const r4::vector<value_type, num_channels>& px)
+{
+	ASSERT(to_num_channels(f) == num_channels)
+	switch (f) {
+		case format::bgr:
+		case format::bgra:
+			if constexpr (num_channels == 3) {
+				return {px[2], px[1], px[0]};
+			} else if constexpr (num_channels == 4) {
+				return {px[2], px[1], px[0], px[3]};
+			}
+			break;
+		case format::argb:
+			if constexpr (num_channels == 4) {
+				return {px[1], px[2], px[3], px[0]};
+			}
+			break;
+		default:
+			break;
+	}
+	return px;
+}
+
+/**
+ * @brief Reorder pixel channels from the canonical order to the given format's order.
+ * E.g. RGBA pixel is converted to BGRA pixel.
+ * @param f - pixel format to convert to. Must have num_channels channels.
+ * @param px - pixel with channels in the canonical order.
+ * @return Pixel with channels in the given format's order.
+ */
+template <typename value_type, size_t num_channels>
+constexpr r4::vector<value_type, num_channels> from_canonical_order(format f, const r4::vector<value_type, num_channels>& px)
+{
+	if (f == format::argb) {
+		if constexpr (num_channels == 4) {
+			return {px[3], px[0], px[1], px[2]};
+		}
+	}
+	// other formats differ from canonical ones by swapping of two channels
+	return to_canonical_order(f, px);
+}
+
 } // namespace rasterimage
@@ -0,0 +1,377 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+#include "image_span.hpp"
+
+namespace rasterimage {
+
+namespace internal {
+
+/**
+ * @brief Get tile size for tiled transposition kernels.
+ * Transposing reads rows and writes columns, so with naive loops every written pixel
+ * lands on a different cache line. The kernels process the image in square tiles,
+ * small enough for both source and destination tiles to stay in L1 data cache (assumed 32kB),
+ * while still long enough per tile row to use whole cache lines.
+ * The tile size is a power of two, so it is a multiple of 4 which is required by 4x4 SIMD blocks.
+ * @param pixel_size - size of a pixel in bytes.
+ * @return Tile size in pixels.
+ */
+constexpr size_t transpose_tile_size(size_t pixel_size)
+{
+	// source and destination tiles together should take half of the L1 data cache
+	constexpr size_t tile_bytes = size_t(8) * 1024;
+
+	size_t ret = 4;
+	while ((ret * 2) * (ret * 2) * pixel_size <= tile_bytes) {
+		ret *= 2;
+	}
+	return ret;
+}
+
+/**
+ * @brief Copy pixels of a source tile to transposed positions in destination.
+ * Source pixel (x, y) goes to dst[x * dst_row_step + y * dst_col_step].
+ * @tparam reverse_columns - if true then dst_col_step is -1, otherwise it is 1.
+ */
+template <bool reverse_columns, typename pixel_type>
+void transpose_tile(
+	const pixel_type* src, //
+	ptrdiff_t src_stride,
+	pixel_type* dst,
+	ptrdiff_t dst_row_step,
+	size_t width,
+	size_t height
+)
+{
+	constexpr ptrdiff_t dst_col_step = reverse_columns ? -1 : 1;
+
+	size_t simd_width = 0;
+	size_t simd_height = 0;
+
+#if defined(__SSE2__)
+	if constexpr (sizeof(pixel_type) == sizeof(uint32_t)) {
+		simd_width = width - width % 4;
+		simd_height = height - height % 4;
+
+		// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic, cppcoreguidelines-pro-type-reinterpret-cast)
+		for (size_t y = 0; y != simd_height; y += 4) {
+			const auto* s = src + ptrdiff_t(y) * src_stride;
+			for (size_t x = 0; x != simd_width; x += 4) {
+				__m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + x));
+				__m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + src_stride + x));
+				__m128i r2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 2 * src_stride + x));
+				__m128i r3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + 3 * src_stride + x));
+
+				// 4x4 transpose of 32 bit elements
+				__m128i t0 = _mm_unpacklo_epi32(r0, r1);
+				__m128i t1 = _mm_unpacklo_epi32(r2, r3);
+				__m128i t2 = _mm_unpackhi_epi32(r0, r1);
+				__m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+				std::array<__m128i, 4> cols = {
+					_mm_unpacklo_epi64(t0, t1),
+					_mm_unpackhi_epi64(t0, t1),
+					_mm_unpacklo_epi64(t2, t3),
+					_mm_unpackhi_epi64(t2, t3)
+				};
+
+				for (size_t i = 0; i != cols.size(); ++i) {
+					auto* d = dst + ptrdiff_t(x + i) * dst_row_step + ptrdiff_t(y) * dst_col_step;
+					if constexpr (reverse_columns) {
+						// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+						auto c = _mm_shuffle_epi32(cols[i], _MM_SHUFFLE(0, 1, 2, 3));
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(d - 3), c);
+					} else {
+						// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(d), cols[i]);
+					}
+				}
+			}
+		}
+		// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic, cppcoreguidelines-pro-type-reinterpret-cast)
+	}
+#endif
+
+	// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	auto copy_scalar = [&](size_t x_begin, size_t x_end, size_t y_begin, size_t y_end) {
+		for (size_t x = x_begin; x != x_end; ++x) {
+			auto* d = dst + ptrdiff_t(x) * dst_row_step + ptrdiff_t(y_begin) * dst_col_step;
+			const auto* s = src + ptrdiff_t(y_begin) * src_stride + ptrdiff_t(x);
+			for (size_t y = y_begin; y != y_end; ++y, d += dst_col_step, s += src_stride) {
+				*d = *s;
+			}
+		}
+	};
+	// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+	// columns not covered by SIMD blocks
+	copy_scalar(simd_width, width, 0, height);
+
+	// rows not covered by SIMD blocks
+	copy_scalar(0, simd_width, simd_height, height);
+}
+
+/**
+ * @brief Tiled transposing copy.
+ * Source pixel (x, y) goes to dst[x * dst_row_step + y * dst_col_step].
+ */
+template <bool reverse_columns, typename channel_type, size_t number_of_channels, bool is_src_const>
+void transpose_tiled(
+	const image_span<channel_type, number_of_channels, is_src_const>& src,
+	r4::vector<channel_type, number_of_channels>* dst,
+	ptrdiff_t dst_row_step
+)
+{
+	using pixel_type = r4::vector<channel_type, number_of_channels>;
+
+	constexpr size_t tile_size = transpose_tile_size(sizeof(pixel_type));
+
+	const pixel_type* src_data = src.data();
+	auto src_stride = ptrdiff_t(src.stride_pixels());
+
+	constexpr ptrdiff_t dst_col_step = reverse_columns ? -1 : 1;
+
+	// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	for (size_t ty = 0; ty < src.dims().y(); ty += tile_size) {
+		auto tile_height = std::min(tile_size, src.dims().y() - ty);
+		for (size_t tx = 0; tx < src.dims().x(); tx += tile_size) {
+			auto tile_width = std::min(tile_size, src.dims().x() - tx);
+			transpose_tile<reverse_columns>(
+				src_data + ptrdiff_t(ty) * src_stride + ptrdiff_t(tx), //
+				src_stride,
+				dst + ptrdiff_t(tx) * dst_row_step + ptrdiff_t(ty) * dst_col_step,
+				dst_row_step,
+				tile_width,
+				tile_height
+			);
+		}
+	}
+	// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+}
+
+template <typename dims_type>
+void check_transposed_dims(const dims_type& src_dims, const dims_type& dst_dims)
+{
+	if (src_dims.x() != dst_dims.y() || src_dims.y() != dst_dims.x()) {
+		throw std::invalid_argument("destination image span dimensions are not transposed source dimensions");
+	}
+}
+
+template <typename dims_type>
+void check_square(const dims_type& dims)
+{
+	if (dims.x() != dims.y()) {
+		throw std::invalid_argument("in-place operation requires a square image span");
+	}
+}
+
+} // namespace internal
+
+/**
+ * @brief Transpose image.
+ * Source pixel (x, y) goes to destination pixel (y, x).
+ * @param src - image span to transpose.
+ * @param dst - destination image span. Its dimensions must be transposed dimensions of the source.
+ *              Must not overlap with the source.
+ * @throw std::invalid_argument - in case destination dimensions do not match.
+ */
+template <typename channel_type, size_t number_of_channels, bool is_src_const>
+void transpose(
+	const image_span<channel_type, number_of_channels, is_src_const>& src, //
+	image_span<channel_type, number_of_channels> dst
+)
+{
+	internal::check_transposed_dims(src.dims(), dst.dims());
+
+	internal::transpose_tiled<false>(src, dst.data(), ptrdiff_t(dst.stride_pixels()));
+}
+
+/**
+ * @brief Rotate image by 90 degrees clockwise.
+ * @param src - image span to rotate.
+ * @param dst - destination image span. Its dimensions must be transposed dimensions of the source.
+ *              Must not overlap with the source.
+ * @throw std::invalid_argument - in case destination dimensions do not match.
+ */
+template <typename channel_type, size_t number_of_channels, bool is_src_const>
+void rotate_90(
+	const image_span<channel_type, number_of_channels, is_src_const>& src, //
+	image_span<channel_type, number_of_channels> dst
+)
+{
+	internal::check_transposed_dims(src.dims(), dst.dims());
+
+	if (dst.dims().x() == 0) {
+		return;
+	}
+
+	// source pixel (x, y) goes to destination pixel (h - 1 - y, x)
+	internal::transpose_tiled<true>(src, &dst[0][dst.dims().x() - 1], ptrdiff_t(dst.stride_pixels()));
+}
+
+/**
+ * @brief Rotate image by 270 degrees clockwise.
+ * I.e. rotate by 90 degrees counter-clockwise.
+ * @param src - image span to rotate.
+ * @param dst - destination image span. Its dimensions must be transposed dimensions of the source.
+ *              Must not overlap with the source.
+ * @throw std::invalid_argument - in case destination dimensions do not match.
+ */
+template <typename channel_type, size_t number_of_channels, bool is_src_const>
+void rotate_270(
+	const image_span<channel_type, number_of_channels, is_src_const>& src, //
+	image_span<channel_type, number_of_channels> dst
+)
+{
+	internal::check_transposed_dims(src.dims(), dst.dims());
+
+	if (dst.dims().y() == 0) {
+		return;
+	}
+
+	// source pixel (x, y) goes to destination pixel (y, w - 1 - x)
+	internal::transpose_tiled<false>(src, dst[dst.dims().y() - 1].data(), -ptrdiff_t(dst.stride_pixels()));
+}
+
+/**
+ * @brief Rotate image by 180 degrees.
+ * @param src - image span to rotate.
+ * @param dst - destination image span. Must be of same dimensions as the source.
+ *              Must not overlap with the source.
+ * @throw std::invalid_argument - in case destination dimensions do not match.
+ */
+template <typename channel_type, size_t number_of_channels, bool is_src_const>
+void rotate_180(
+	const image_span<channel_type, number_of_channels, is_src_const>& src, //
+	image_span<channel_type, number_of_channels> dst
+)
+{
+	if (src.dims() != dst.dims()) {
+		throw std::invalid_argument("rotate_180(): destination image span dimensions do not match source dimensions");
+	}
+
+	// rows are read and written sequentially, so no tiling is needed
+	auto d = dst.rbegin();
+	for (auto s = src.cbegin(); s != src.cend(); ++s, ++d) {
+		std::reverse_copy(s->begin(), s->end(), (*d).begin());
+	}
+}
+
+/**
+ * @brief Transpose square image in-place.
+ * @param span - image span to transpose.
+ * @throw std::invalid_argument - in case the image span is not square.
+ */
+template <typename channel_type, size_t number_of_channels>
+void transpose(image_span<channel_type, number_of_channels> span)
+{
+	internal::check_square(span.dims());
+
+	using pixel_type = r4::vector<channel_type, number_of_channels>;
+
+	constexpr size_t tile_size = internal::transpose_tile_size(sizeof(pixel_type));
+
+	const size_t n = span.dims().x();
+
+	// swap tiles above the diagonal with their mirror tiles below the diagonal,
+	// diagonal tiles are transposed in place
+	for (size_t ty = 0; ty < n; ty += tile_size) {
+		auto y_end = std::min(ty + tile_size, n);
+		for (size_t tx = ty; tx < n; tx += tile_size) {
+			auto x_end = std::min(tx + tile_size, n);
+			for (size_t y = ty; y != y_end; ++y) {
+				auto row = span[uint32_t(y)];
+				for (size_t x = std::max(tx, y + 1); x < x_end; ++x) {
+					using std::swap;
+					swap(row[x], span[uint32_t(x)][y]);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief Rotate square image by 90 degrees clockwise in-place.
+ * @param span - image span to rotate.
+ * @throw std::invalid_argument - in case the image span is not square.
+ */
+template <typename channel_type, size_t number_of_channels>
+void rotate_90(image_span<channel_type, number_of_channels> span)
+{
+	transpose(span);
+	span.flip_horizontal();
+}
+
+/**
+ * @brief Rotate square image by 270 degrees clockwise in-place.
+ * @param span - image span to rotate.
+ * @throw std::invalid_argument - in case the image span is not square.
+ */
+template <typename channel_type, size_t number_of_channels>
+void rotate_270(image_span<channel_type, number_of_channels> span)
+{
+	transpose(span);
+	span.flip_vertical();
+}
+
+/**
+ * @brief Rotate image by 180 degrees in-place.
+ * The image span does not have to be square.
+ * @param span - image span to rotate.
+ */
+template <typename channel_type, size_t number_of_channels>
+void rotate_180(image_span<channel_type, number_of_channels> span) noexcept
+{
+	if (span.dims().y() == 0) {
+		return;
+	}
+
+	// NOTE: see image_span::flip_vertical() for why std::prev() is not used
+	auto upper = span.begin();
+	auto lower = --span.end();
+	for (; upper < lower; ++upper, --lower) {
+		std::swap_ranges(upper->begin(), upper->end(), std::make_reverse_iterator(lower->end()));
+	}
+
+	if (upper == lower) {
+		// middle row of odd number of rows
+		std::reverse(upper->begin(), upper->end());
+	}
+}
+
+} // namespace rasterimage
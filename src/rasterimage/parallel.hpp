@@ -0,0 +1,145 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <algorithm>
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace rasterimage::internal {
+
+/**
+ * @brief Partition of image rows into horizontal bands.
+ * Each band is processed by its own thread.
+ */
+class band_partition
+{
+	size_t num_rows;
+	size_t bands;
+
+public:
+	/**
+	 * @brief Minimal number of pixels per band.
+	 * Spawning a thread costs tens of microseconds, so it does not make sense
+	 * to give a thread less work than that.
+	 */
+	constexpr static size_t min_pixels_per_band = size_t(64) * 1024;
+
+	/**
+	 * @brief Constructor.
+	 * @param num_rows - number of rows to partition.
+	 * @param row_width - number of pixels in a row.
+	 * @param num_threads - maximal number of threads to use.
+	 *                      0 means use number of threads supported by hardware.
+	 */
+	band_partition(
+		size_t num_rows, //
+		size_t row_width,
+		unsigned num_threads
+	) :
+		num_rows(num_rows)
+	{
+		if (num_threads == 0) {
+			num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		size_t max_bands_by_work = std::max(num_rows * row_width / min_pixels_per_band, size_t(1));
+
+		this->bands = std::min({size_t(num_threads), max_bands_by_work, std::max(num_rows, size_t(1))});
+	}
+
+	size_t size() const noexcept
+	{
+		return this->bands;
+	}
+
+	size_t begin_row(size_t band_index) const noexcept
+	{
+		return this->num_rows * band_index / this->bands;
+	}
+
+	size_t end_row(size_t band_index) const noexcept
+	{
+		return this->num_rows * (band_index + 1) / this->bands;
+	}
+
+	/**
+	 * @brief Run function for each band.
+	 * The last band is processed on the calling thread, the rest of the bands are processed on
+	 * separate threads. The function returns after all bands are processed.
+	 * If processing of any band throws, then the first exception is re-thrown after all threads are joined.
+	 * @param func - function to call for each band. Signature: void(size_t band_index, size_t begin_row, size_t
+	 * end_row).
+	 */
+	template <typename function_type>
+	void for_each(function_type&& func) const
+	{
+		if (this->bands == 1) {
+			func(size_t(0), this->begin_row(0), this->end_row(0));
+			return;
+		}
+
+		std::vector<std::exception_ptr> errors(this->bands);
+
+		auto run_band = [&](size_t band_index) {
+			try {
+				func(band_index, this->begin_row(band_index), this->end_row(band_index));
+			} catch (...) {
+				errors[band_index] = std::current_exception();
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve(this->bands - 1);
+
+		for (size_t i = 0; i != this->bands - 1; ++i) {
+			try {
+				threads.emplace_back(run_band, i);
+			} catch (std::system_error&) {
+				// could not start a thread, process the band on this thread then
+				run_band(i);
+			}
+		}
+
+		run_band(this->bands - 1);
+
+		for (auto& t : threads) {
+			t.join();
+		}
+
+		for (const auto& e : errors) {
+			if (e) {
+				std::rethrow_exception(e);
+			}
+		}
+	}
+};
+
+} // namespace rasterimage::internal
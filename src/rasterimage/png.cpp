@@ -0,0 +1,1444 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "image_variant.hpp"
+
+#include <optional>
+
+#include <png.h>
+#include <utki/config.hpp>
+#include <utki/util.hpp>
+#include <zlib.h>
+
+#include "instrumentation.hpp"
+#include "operations.hpp"
+#include "parallel.hpp"
+#include "push_decoder.hpp"
+
+using namespace std::string_literals;
+
+using namespace rasterimage;
+
+namespace {
+// PNG I/O callbacks context
+struct png_io {
+	const fsif::file& fi;
+	instrumentation::internal::recorder& rec;
+};
+
+void png_write_callback(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+	auto io = static_cast<png_io*>(png_get_io_ptr(png_ptr));
+	ASSERT(io)
+
+	ASSERT(io->fi.is_open())
+
+	// TODO: check return value
+	io->fi.write(utki::make_span(data, length));
+
+	io->rec.add_written(length);
+}
+
+void png_flush_callback(png_structp /* png_ptr */)
+{
+	// do nothing
+}
+
+// PNG stores channels only in canonical order, so non-canonical formats map to the color type of their canonical format
+uint8_t to_png_color_type(format pixel_format)
+{
+	switch (to_canonical(pixel_format)) {
+		case format::grey:
+			return PNG_COLOR_TYPE_GRAY;
+		case format::greya:
+			return PNG_COLOR_TYPE_GRAY_ALPHA;
+		case format::rgb:
+			return PNG_COLOR_TYPE_RGB;
+		case format::rgba:
+			return PNG_COLOR_TYPE_RGB_ALPHA;
+		default:
+			break;
+	}
+	utki::assert(false, SL);
+	return PNG_COLOR_TYPE_GRAY;
+}
+} // namespace
+
+void image_variant::write_png(const fsif::file& fi) const
+{
+	if (this->get_depth() != rasterimage::depth::uint_8_bit) {
+		// TODO: add support for writing 16 bit images
+		throw std::logic_error("writing of only 8 bit images is currently supported");
+	}
+
+	if (to_canonical(this->get_format()) != rasterimage::format::rgba) {
+		// TODO: support writing of non-RGBA images
+		throw std::logic_error("writing of non RGBA iamges is currently not supported");
+	}
+
+	instrumentation::internal::recorder rec(instrumentation::operation::write_png);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(
+		fi, //
+		fsif::mode::create
+	);
+
+	png_structp png_ptr = nullptr;
+	png_infop info_ptr = nullptr;
+
+	// Initialize write structure
+	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	if (png_ptr == nullptr) {
+		throw std::runtime_error("Could not allocate PNG write struct");
+	}
+	utki::scope_exit png_scope_exit([&png_ptr, &info_ptr]() {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+	});
+
+	// Initialize info structure
+	info_ptr = png_create_info_struct(png_ptr);
+	if (info_ptr == nullptr) {
+		throw std::runtime_error("Could not allocate PNG info struct");
+	}
+	utki::scope_exit info_scope_exit([&png_ptr, &info_ptr]() {
+		png_free_data(png_ptr, info_ptr, PNG_FREE_ALL, -1);
+	});
+
+	auto dims = this->dims();
+
+	png_io io{fi, rec};
+
+	png_set_write_fn(
+		png_ptr,
+		&io,
+		&png_write_callback,
+		&png_flush_callback
+	);
+
+	// write header (8 bit color depth)
+	png_set_IHDR(
+		png_ptr,
+		info_ptr,
+		dims.x(),
+		dims.y(),
+		// get bits per channel
+		std::visit(
+			[](const auto& im) -> int {
+				using value_type = typename std::remove_reference_t<decltype(im)>::pixel_type::value_type;
+				if constexpr (!std::is_same_v<value_type, uint8_t> && !std::is_same_v<value_type, uint16_t>) {
+					throw std::invalid_argument("write_png(): PNG supports only 8 bit or 16 bit per channel images");
+				} else {
+					return int(sizeof(value_type) * utki::byte_bits);
+				}
+			},
+			this->variant
+		),
+		// get PNG color format
+		to_png_color_type(this->get_format()),
+		PNG_INTERLACE_NONE,
+		PNG_COMPRESSION_TYPE_BASE,
+		PNG_FILTER_TYPE_BASE
+	);
+
+	png_write_info(png_ptr, info_ptr);
+
+	// let libpng reorder channels of non-canonical formats while writing the rows
+	switch (this->get_format()) {
+		case rasterimage::format::bgr:
+		case rasterimage::format::bgra:
+			png_set_bgr(png_ptr);
+			break;
+		case rasterimage::format::argb:
+			png_set_swap_alpha(png_ptr);
+			break;
+		default:
+			break;
+	}
+
+	rec.start(instrumentation::phase::encode);
+
+	// write image data
+	auto p = std::visit(
+		[](const auto& im) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			return reinterpret_cast<png_const_bytep>(im.pixels().data());
+		},
+		this->variant
+	);
+	auto stride = std::visit(
+		[](const auto& im) {
+			return sizeof(typename std::remove_reference_t<decltype(im)>::pixel_type) * im.dims().x();
+		},
+		this->variant
+	);
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	for (uint32_t y = 0; y != dims.y(); ++y, p += stride) {
+		png_write_row(png_ptr, p);
+	}
+	rec.add_rows(dims.y());
+
+	rec.start(instrumentation::phase::post_process);
+
+	png_write_end(png_ptr, nullptr);
+
+	rec.finish();
+}
+
+namespace {
+// Parallel PNG encoding.
+// Image rows are split into horizontal bands, each band is filtered and compressed to raw deflate data
+// by its own thread. All bands except the last one are terminated with sync flush, so that the compressed
+// data ends on a byte boundary and the bands can be concatenated into a single deflate stream.
+// To keep the compression ratio close to single-threaded one, each band's compressor is primed
+// with the last 32 KiB of the previous band's uncompressed data as a dictionary.
+
+constexpr int deflate_window_bits = 15;
+constexpr size_t deflate_window_size = size_t(1) << deflate_window_bits;
+
+// PNG row filter types
+enum class png_filter : uint8_t {
+	none,
+	sub,
+	up,
+	average,
+	paeth,
+
+	enum_size
+};
+
+uint8_t paeth_predictor(uint8_t a, uint8_t b, uint8_t c)
+{
+	int p = int(a) + int(b) - int(c);
+	int pa = std::abs(p - int(a));
+	int pb = std::abs(p - int(b));
+	int pc = std::abs(p - int(c));
+
+	if (pa <= pb && pa <= pc) {
+		return a;
+	} else if (pb <= pc) {
+		return b;
+	}
+	return c;
+}
+
+// Writes PNG image rows in network byte order and canonical channel order, filtered.
+// Each filtered row is prepended with the filter type byte.
+template <typename image_span_type>
+class png_row_filter
+{
+	using pixel_type = typename image_span_type::pixel_type;
+	using channel_type = typename pixel_type::value_type;
+
+	static constexpr size_t bytes_per_pixel = sizeof(pixel_type);
+
+	const image_span_type& im;
+
+	format pixel_format;
+
+	size_t row_size_bytes;
+
+	// rows converted to network byte order and canonical channel order, for 16 bit images and non-canonical formats
+	std::vector<uint8_t> cur_row_buffer;
+	std::vector<uint8_t> prev_row_buffer;
+
+	// filtered row candidates, one per filter type
+	std::array<std::vector<uint8_t>, size_t(png_filter::enum_size)> candidates;
+
+	utki::span<const uint8_t> get_row(uint32_t y, std::vector<uint8_t>& buffer)
+	{
+		auto row = utki::make_span(
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			reinterpret_cast<const uint8_t*>(this->im[y].data()),
+			this->row_size_bytes
+		);
+
+		static_assert(sizeof(channel_type) <= 2, "only 8 and 16 bit channels are supported by PNG");
+
+		if (to_canonical(this->pixel_format) != this->pixel_format) {
+			// reorder channels while serializing the row, so that no swizzled copy of the whole image is needed
+			buffer.resize(row.size());
+			auto dst = buffer.data();
+			for (const auto& px : this->im[y]) {
+				for (auto c : to_canonical_order(this->pixel_format, px)) {
+					if constexpr (sizeof(channel_type) == 1) {
+						*dst = c;
+						// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+						++dst;
+					} else {
+						dst = utki::serialize16be(c, dst);
+					}
+				}
+			}
+			return buffer;
+		}
+
+		if constexpr (sizeof(channel_type) == 1 || CFG_ENDIANNESS == CFG_ENDIANNESS_BIG) {
+			return row;
+		} else {
+			buffer.resize(row.size());
+			for (size_t i = 0; i < row.size(); i += 2) {
+				buffer[i] = row[i + 1];
+				buffer[i + 1] = row[i];
+			}
+			return buffer;
+		}
+	}
+
+public:
+	png_row_filter(const image_span_type& im, format pixel_format) :
+		im(im),
+		pixel_format(pixel_format),
+		row_size_bytes(size_t(im.dims().x()) * bytes_per_pixel)
+	{
+		for (auto& c : this->candidates) {
+			c.resize(this->row_size_bytes + 1);
+		}
+	}
+
+	size_t filtered_row_size() const noexcept
+	{
+		return this->row_size_bytes + 1;
+	}
+
+	// Filter the row, choosing the filter type which gives minimal sum of absolute values of the filtered bytes,
+	// which is the heuristic recommended by PNG specification.
+	utki::span<const uint8_t> filter(uint32_t y)
+	{
+		auto cur = this->get_row(y, this->cur_row_buffer);
+
+		std::vector<uint8_t> zero_row;
+		utki::span<const uint8_t> prev;
+		if (y == 0) {
+			zero_row.resize(this->row_size_bytes, 0);
+			prev = zero_row;
+		} else {
+			prev = this->get_row(y - 1, this->prev_row_buffer);
+		}
+
+		std::array<size_t, size_t(png_filter::enum_size)> sums = {0};
+
+		// applies filter to the row, predictor's signature is uint8_t(a, b, c),
+		// where a is left byte, b is upper byte and c is upper-left byte
+		auto apply = [&](png_filter f, const auto& predictor) {
+			auto& out = this->candidates[size_t(f)];
+			out[0] = uint8_t(f);
+			size_t sum = 0;
+			for (size_t i = 0; i != cur.size(); ++i) {
+				uint8_t a = i < bytes_per_pixel ? 0 : cur[i - bytes_per_pixel];
+				uint8_t b = prev[i];
+				uint8_t c = i < bytes_per_pixel ? 0 : prev[i - bytes_per_pixel];
+
+				auto v = uint8_t(cur[i] - predictor(a, b, c));
+				out[i + 1] = v;
+				sum += size_t(std::abs(int(int8_t(v))));
+			}
+			sums[size_t(f)] = sum;
+		};
+
+		apply(png_filter::none, [](uint8_t, uint8_t, uint8_t) {
+			return uint8_t(0);
+		});
+		apply(png_filter::sub, [](uint8_t a, uint8_t, uint8_t) {
+			return a;
+		});
+		apply(png_filter::up, [](uint8_t, uint8_t b, uint8_t) {
+			return b;
+		});
+		apply(png_filter::average, [](uint8_t a, uint8_t b, uint8_t) {
+			return uint8_t((unsigned(a) + unsigned(b)) / 2);
+		});
+		apply(png_filter::paeth, &paeth_predictor);
+
+		auto best = std::distance(sums.begin(), std::min_element(sums.begin(), sums.end()));
+		return this->candidates[size_t(best)];
+	}
+};
+
+// compressed band of image rows
+struct png_band {
+	std::vector<uint8_t> data;
+
+	// Adler-32 checksum and size of the uncompressed band data
+	uLong adler = adler32(0, nullptr, 0);
+	size_t uncompressed_size = 0;
+};
+
+template <typename image_span_type>
+void deflate_png_band(
+	const image_span_type& im,
+	format pixel_format,
+	uint32_t begin_row,
+	uint32_t end_row,
+	png_band& band
+)
+{
+	png_row_filter<image_span_type> filter(im, pixel_format);
+
+	z_stream zs{};
+	if (deflateInit2(
+			&zs,
+			Z_DEFAULT_COMPRESSION,
+			Z_DEFLATED,
+			// negative window bits means raw deflate, without zlib header and checksum
+			-deflate_window_bits,
+			8, // NOLINT(cppcoreguidelines-avoid-magic-numbers), default memory level
+			// the strategy is tuned for data produced by filters, same as libpng uses for filtered rows
+			Z_FILTERED
+		) != Z_OK)
+	{
+		throw std::runtime_error("rasterimage::write_png(): deflateInit2() failed");
+	}
+	utki::scope_exit zs_scope_exit([&zs]() {
+		deflateEnd(&zs);
+	});
+
+	if (begin_row != 0) {
+		// prime the compressor with the tail of the previous band's data,
+		// the decompressor will have that data in its window at this point
+		auto num_dict_rows = uint32_t(std::min(
+			size_t(begin_row),
+			(deflate_window_size + filter.filtered_row_size() - 1) / filter.filtered_row_size()
+		));
+
+		std::vector<uint8_t> dict;
+		for (uint32_t y = begin_row - num_dict_rows; y != begin_row; ++y) {
+			auto row = filter.filter(y);
+			dict.insert(dict.end(), row.begin(), row.end());
+		}
+
+		auto dict_span = utki::make_span(dict);
+		if (dict_span.size() > deflate_window_size) {
+			dict_span = dict_span.subspan(dict_span.size() - deflate_window_size);
+		}
+
+		if (deflateSetDictionary(&zs, dict_span.data(), uInt(dict_span.size())) != Z_OK) {
+			throw std::runtime_error("rasterimage::write_png(): deflateSetDictionary() failed");
+		}
+	}
+
+	band.data.resize(size_t(deflateBound(&zs, uLong(end_row - begin_row) * uLong(filter.filtered_row_size()))));
+
+	auto deflate_data = [&zs, &band](utki::span<const uint8_t> data, int flush) {
+		// zlib does not modify the input data, but takes it via non-const pointer
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+		zs.next_in = const_cast<Bytef*>(data.data());
+		zs.avail_in = uInt(data.size());
+
+		for (;;) {
+			if (zs.total_out == band.data.size()) {
+				band.data.resize(band.data.size() * 2);
+			}
+			zs.next_out = std::next(band.data.data(), ptrdiff_t(zs.total_out));
+			zs.avail_out = uInt(std::min(
+				band.data.size() - size_t(zs.total_out),
+				size_t(std::numeric_limits<uInt>::max())
+			));
+
+			auto res = deflate(&zs, flush);
+			if (res == Z_STREAM_END) {
+				ASSERT(flush == Z_FINISH)
+				return;
+			}
+			if (res != Z_OK && res != Z_BUF_ERROR) {
+				throw std::runtime_error("rasterimage::write_png(): deflate() failed");
+			}
+			// deflate() is done when it has consumed all input and did not fill all the output space
+			if (zs.avail_in == 0 && zs.avail_out != 0 && flush != Z_FINISH) {
+				return;
+			}
+		}
+	};
+
+	for (uint32_t y = begin_row; y != end_row; ++y) {
+		auto row = filter.filter(y);
+		band.adler = adler32(band.adler, row.data(), uInt(row.size()));
+		band.uncompressed_size += row.size();
+		deflate_data(row, Z_NO_FLUSH);
+	}
+
+	// sync flush makes the band end on byte boundary without ending the deflate stream
+	deflate_data({}, end_row == im.dims().y() ? Z_FINISH : Z_SYNC_FLUSH);
+
+	band.data.resize(size_t(zs.total_out));
+}
+
+void write_png_chunk(
+	const fsif::file& fi,
+	const std::array<char, 4>& type,
+	utki::span<const uint8_t> data,
+	instrumentation::internal::recorder& rec
+)
+{
+	if (data.size() > size_t(std::numeric_limits<int32_t>::max())) {
+		throw std::invalid_argument("rasterimage::write_png(): PNG chunk is too big");
+	}
+
+	std::array<uint8_t, sizeof(uint32_t)> buf{};
+
+	utki::serialize32be(uint32_t(data.size()), buf.data());
+	fi.write(buf);
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	auto type_bytes = utki::make_span(reinterpret_cast<const uint8_t*>(type.data()), type.size());
+	fi.write(type_bytes);
+	fi.write(data);
+
+	// CRC is calculated over chunk type and data
+	auto crc = crc32(0, type_bytes.data(), uInt(type_bytes.size()));
+	for (auto d = data; !d.empty();) {
+		auto n = std::min(d.size(), size_t(std::numeric_limits<uInt>::max()));
+		crc = crc32(crc, d.data(), uInt(n));
+		d = d.subspan(n);
+	}
+	utki::serialize32be(uint32_t(crc), buf.data());
+	fi.write(buf);
+
+	rec.add_written(data.size() + sizeof(uint32_t) * 3);
+}
+} // namespace
+
+void image_variant::write_png(const fsif::file& fi, unsigned num_threads) const
+{
+	if (this->get_depth() != depth::uint_8_bit && this->get_depth() != depth::uint_16_bit) {
+		throw std::invalid_argument("write_png(): PNG supports only 8 bit or 16 bit per channel images");
+	}
+
+	instrumentation::internal::recorder rec(instrumentation::operation::write_png);
+	rec.start(instrumentation::phase::header);
+
+	auto dims = this->dims();
+
+	internal::band_partition partition(dims.y(), dims.x(), num_threads);
+
+	std::vector<png_band> bands(partition.size());
+
+	fsif::file::guard file_guard(
+		fi, //
+		fsif::mode::create
+	);
+
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+	constexpr std::array<uint8_t, 8> png_signature = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	fi.write(png_signature);
+	rec.add_written(png_signature.size());
+
+	{
+		// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+		std::array<uint8_t, 13> ihdr{};
+		auto p = ihdr.data();
+		p = utki::serialize32be(dims.x(), p);
+		p = utki::serialize32be(dims.y(), p);
+		*p = uint8_t(to_channel_size(this->get_depth()) * utki::byte_bits); // bit depth
+		++p;
+		*p = to_png_color_type(this->get_format());
+		// compression method, filter method and interlace method are all 0
+		write_png_chunk(fi, {'I', 'H', 'D', 'R'}, ihdr, rec);
+	}
+
+	rec.start(instrumentation::phase::encode);
+
+	std::visit(
+		[&](const auto& im) {
+			using pixel_type = typename std::remove_reference_t<decltype(im)>::pixel_type;
+			using value_type = typename pixel_type::value_type;
+			if constexpr (std::is_same_v<value_type, uint8_t> || std::is_same_v<value_type, uint16_t>) {
+				auto span = im.span();
+				auto pixel_format = this->get_format();
+				partition.for_each([&](size_t band_index, size_t begin_row, size_t end_row) {
+					deflate_png_band(
+						span,
+						pixel_format,
+						uint32_t(begin_row),
+						uint32_t(end_row),
+						bands[band_index]
+					);
+				});
+			}
+		},
+		this->variant
+	);
+
+	rec.add_rows(dims.y());
+
+	// zlib stream header: deflate method with 32K window, default compression level, no preset dictionary
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+	constexpr std::array<uint8_t, 2> zlib_header = {0x78, 0x9c};
+
+	uLong adler = adler32(0, nullptr, 0);
+
+	std::vector<uint8_t> first_idat(zlib_header.begin(), zlib_header.end());
+	for (size_t i = 0; i != bands.size(); ++i) {
+		const auto& b = bands[i];
+		adler = adler32_combine64(adler, b.adler, z_off64_t(b.uncompressed_size));
+
+		if (i == 0) {
+			// zlib header goes to the first IDAT chunk together with the first band
+			first_idat.insert(first_idat.end(), b.data.begin(), b.data.end());
+			bands[i].data = std::move(first_idat);
+		}
+	}
+
+	// zlib stream trailer: Adler-32 checksum of uncompressed data goes to the last IDAT chunk
+	{
+		auto& last = bands.back().data;
+		std::array<uint8_t, sizeof(uint32_t)> trailer{};
+		utki::serialize32be(uint32_t(adler), trailer.data());
+		last.insert(last.end(), trailer.begin(), trailer.end());
+	}
+
+	rec.start(instrumentation::phase::post_process);
+
+	constexpr size_t max_idat_size = size_t(1) << 30;
+	for (auto& b : bands) {
+		for (auto d = utki::make_span(b.data); !d.empty();) {
+			auto n = std::min(d.size(), max_idat_size);
+			write_png_chunk(fi, {'I', 'D', 'A', 'T'}, d.subspan(0, n), rec);
+			d = d.subspan(n);
+		}
+		// free memory as early as possible
+		b.data = decltype(b.data)();
+	}
+
+	write_png_chunk(fi, {'I', 'E', 'N', 'D'}, {}, rec);
+
+	rec.finish();
+}
+
+namespace {
+void png_read_callback(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+	auto io = static_cast<png_io*>(png_get_io_ptr(png_ptr));
+	ASSERT(io)
+
+	auto num_bytes_read = io->fi.read(utki::make_span(data, length));
+
+	io->rec.add_read(num_bytes_read);
+
+	if (num_bytes_read != length) {
+		png_error(png_ptr, "unexpected end of file");
+	}
+}
+
+// Set up libpng limits. Must be called before the image info is read.
+// libpng is made to accept any image size allowed by PNG specification, the decode limits are checked
+// after the header is read, so that exceeding them is reported with size_limit_error.
+void set_up_read_limits(png_structp png_ptr)
+{
+	constexpr png_uint_32 max_png_dimension = 0x7fffffff;
+	png_set_user_limits(png_ptr, max_png_dimension, max_png_dimension);
+
+	// limit memory used by decompressed ancillary chunks, like iCCP or zTXt
+	png_set_chunk_malloc_max(
+		png_ptr,
+		png_alloc_size_t(std::min(get_decode_limits().max_inflate_bytes, uint64_t(png_get_chunk_malloc_max(png_ptr))))
+	);
+}
+
+// Get number of bytes decompressed from IDAT chunks, i.e. size of filtered image rows.
+// Must be called after the image info is read and before the pixel transformations are set up,
+// since the transformations change the image info.
+uint64_t get_image_data_inflate_size(png_structp png_ptr, png_infop info_ptr)
+{
+	png_uint_32 width = 0;
+	png_uint_32 height = 0;
+	int bit_depth = 0;
+	int color_type = 0;
+	int interlace_type = 0;
+	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, &interlace_type, nullptr, nullptr);
+
+	uint64_t bits_per_pixel = uint64_t(bit_depth) * png_get_channels(png_ptr, info_ptr);
+
+	// each filtered row starts with filter type byte
+	auto filtered_rows_size = [bits_per_pixel](uint64_t num_cols, uint64_t num_rows) -> uint64_t {
+		if (num_cols == 0) {
+			return 0;
+		}
+		return num_rows * (1 + (num_cols * bits_per_pixel + utki::byte_bits - 1) / utki::byte_bits);
+	};
+
+	if (interlace_type == PNG_INTERLACE_NONE) {
+		return filtered_rows_size(width, height);
+	}
+
+	uint64_t ret = 0;
+	constexpr int num_adam7_passes = 7;
+	for (int pass = 0; pass != num_adam7_passes; ++pass) {
+		ret += filtered_rows_size(PNG_PASS_COLS(width, pass), PNG_PASS_ROWS(height, pass));
+	}
+	return ret;
+}
+
+// Check decode limits before allocating the decoded image.
+void check_png_decode_limits(const image_info& decoded_info, uint64_t inflate_size)
+{
+	internal::check_decode_limits(decoded_info);
+	internal::check_inflate_limit(inflate_size);
+}
+
+// Pixel type of decoded image requested by the caller.
+// Only 8 and 16 bit depths can be produced by libpng.
+struct pixel_type_request {
+	format pixel_format;
+	depth channel_depth;
+};
+
+// Set up pixel transformations applied when reading PNG image.
+// Must be called after the image info is read.
+// In case pixel type is requested, libpng is set up to convert pixels to it while decoding,
+// otherwise the image is decoded to its native pixel type.
+// Returns properties of the image after the transformations.
+image_info set_up_read_transformations(
+	png_structp png_ptr,
+	png_infop info_ptr,
+	const std::optional<pixel_type_request>& request = std::nullopt
+)
+{
+	// get information from info_ptr
+	png_uint_32 width = 0;
+	png_uint_32 height = 0;
+	int bit_depth = 0;
+	int color_format = 0;
+	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_format, nullptr, nullptr, nullptr);
+
+	bool keep_alpha = !request.has_value() || //
+		to_num_channels(request->pixel_format) == 2 || //
+		to_num_channels(request->pixel_format) == 4;
+
+	if (keep_alpha) {
+		// we want to convert tRNS transparency (e.g. single color treated as transparent) to proper alpha channel
+		png_set_tRNS_to_alpha(png_ptr);
+	}
+
+	// convert paletted PNG to rgb image
+	if (color_format == PNG_COLOR_TYPE_PALETTE) {
+		png_set_palette_to_rgb(png_ptr);
+	}
+
+	// convert grayscale PNG to 8bit greyscale PNG
+	if (color_format == PNG_COLOR_TYPE_GRAY && bit_depth < utki::byte_bits) {
+		png_set_expand_gray_1_2_4_to_8(png_ptr);
+	}
+
+#if CFG_ENDIANNESS == CFG_ENDIANNESS_LITTLE
+	// PNG stores 16 bit images in network order (big endian),
+	// so we ask libpng to convert it to little endian
+	png_set_swap(png_ptr);
+#endif
+
+	// set gamma information
+	double gamma = 0.0f;
+
+	constexpr auto screen_gamma = 2.2;
+
+	// if there's gamma info in the file, set it to screen_gamma
+	if (png_get_gAMA(png_ptr, info_ptr, &gamma)) {
+		png_set_gamma(png_ptr, screen_gamma, gamma);
+	} else {
+		constexpr auto default_gamma = 0.45455; // good guess for GIF images on PCs
+		png_set_gamma(png_ptr, screen_gamma, default_gamma);
+	}
+
+	if (request.has_value()) {
+		// palette is expanded to RGB and tRNS to alpha, so only the color type bits matter
+		bool has_color = (color_format & PNG_COLOR_MASK_COLOR) != 0;
+		bool has_alpha = (color_format & PNG_COLOR_MASK_ALPHA) != 0 ||
+			(keep_alpha && png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS) != 0);
+
+		bool want_color = to_num_channels(request->pixel_format) >= 3;
+
+		if (want_color && !has_color) {
+			png_set_gray_to_rgb(png_ptr);
+		} else if (!want_color && has_color) {
+			// use default coefficients, which are same as used by rasterimage::luminance(),
+			// note that libpng applies them in linear light
+			png_set_rgb_to_gray_fixed(png_ptr, PNG_ERROR_ACTION_NONE, -1, -1);
+		}
+
+		bool alpha_first = request->pixel_format == format::argb;
+
+		if (keep_alpha && !has_alpha) {
+			constexpr auto opaque = 0xffff;
+			png_set_add_alpha(png_ptr, opaque, alpha_first ? PNG_FILLER_BEFORE : PNG_FILLER_AFTER);
+		} else if (!keep_alpha && has_alpha) {
+			png_set_strip_alpha(png_ptr);
+		} else if (alpha_first) {
+			png_set_swap_alpha(png_ptr);
+		}
+
+		if (request->pixel_format == format::bgr || request->pixel_format == format::bgra) {
+			png_set_bgr(png_ptr);
+		}
+
+		if (request->channel_depth == depth::uint_8_bit) {
+			png_set_strip_16(png_ptr);
+		} else {
+			ASSERT(request->channel_depth == depth::uint_16_bit)
+			png_set_expand_16(png_ptr);
+		}
+	}
+
+	// let libpng de-interlace Adam7 images when reading the whole image
+	png_set_interlace_handling(png_ptr);
+
+	// update info after all transformations
+	png_read_update_info(png_ptr, info_ptr);
+
+	// get all dimensions and color info again
+	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_format, nullptr, nullptr, nullptr);
+
+	depth image_depth = [&bit_depth]() {
+		if (bit_depth == sizeof(uint16_t) * utki::byte_bits) {
+			return depth::uint_16_bit;
+		} else {
+			ASSERT(bit_depth == utki::byte_bits)
+			return depth::uint_8_bit;
+		}
+	}();
+
+	// set image type
+	format image_format = [color_format, &request]() {
+		if (request.has_value()) {
+			// channel order transformations do not change the color type
+			return request->pixel_format;
+		}
+		switch (color_format) {
+			case PNG_COLOR_TYPE_GRAY:
+				return format::grey;
+			case PNG_COLOR_TYPE_GRAY_ALPHA:
+				return format::greya;
+			case PNG_COLOR_TYPE_RGB:
+				return format::rgb;
+			case PNG_COLOR_TYPE_RGB_ALPHA:
+				return format::rgba;
+			default:
+				throw std::invalid_argument("rasterimage::read_png(): unknown color_format");
+		}
+	}();
+
+	return {
+		{width, height},
+		image_format,
+		image_depth
+	};
+}
+
+// PNG reading state.
+// Constructor creates libpng structures, read_header() reads the file header and sets up pixel transformations.
+// The file must be opened before calling read_header().
+// libpng reports errors via longjmp, so all the libpng calls which read the file are done via call().
+class png_reader
+{
+	// libpng error message, set by error callback
+	std::string error_message;
+
+	[[noreturn]] static void error_callback(png_structp png_ptr, png_const_charp message)
+	{
+		auto r = static_cast<png_reader*>(png_get_error_ptr(png_ptr));
+		ASSERT(r)
+
+		try {
+			r->error_message = message;
+		} catch (...) {
+			// ignore, the error will be reported without message
+		}
+
+		png_longjmp(png_ptr, 1);
+	}
+
+	// returns false in case of libpng error
+	template <typename func_type>
+	bool call_guarded(const func_type& func)
+	{
+		// NOTE: the function must not create non-trivially destructible objects,
+		//       because libpng error makes longjmp back to here
+		if (setjmp(png_jmpbuf(this->png_ptr))) {
+			return false;
+		}
+
+		func();
+
+		return true;
+	}
+
+public:
+	png_io io;
+
+	// create internal PNG-structure to work with PNG file
+	// (no warning callback, libpng prints warnings to stderr)
+	png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, this, &error_callback, nullptr);
+	png_infop info_ptr = png_create_info_struct(png_ptr);
+
+	image_info info;
+
+	// number of bytes to be decompressed from image data chunks
+	uint64_t inflate_size = 0;
+
+	png_reader(const fsif::file& fi, instrumentation::internal::recorder& rec) :
+		io{fi, rec}
+	{}
+
+	png_reader(const png_reader&) = delete;
+	png_reader& operator=(const png_reader&) = delete;
+
+	png_reader(png_reader&&) = delete;
+	png_reader& operator=(png_reader&&) = delete;
+
+	~png_reader()
+	{
+		png_destroy_read_struct(&this->png_ptr, &this->info_ptr, nullptr);
+	}
+
+	void read_header(const std::optional<pixel_type_request>& request = std::nullopt);
+
+	// Call the function which calls libpng, libpng errors are thrown as std::invalid_argument.
+	// Calls must not be nested.
+	template <typename func_type>
+	void call(const func_type& func)
+	{
+		if (!this->call_guarded(func)) {
+			throw std::invalid_argument("rasterimage::read_png(): "s + this->error_message);
+		}
+	}
+};
+
+void png_reader::read_header(const std::optional<pixel_type_request>& request)
+{
+	auto png_ptr = this->png_ptr;
+	auto info_ptr = this->info_ptr;
+
+	static const unsigned png_sig_size = 8; // the size of PNG signature
+
+	{
+		std::array<png_byte, png_sig_size> sig = {0};
+		auto span = utki::make_span(sig);
+
+		auto num_bytes_read = this->io.fi.read(span);
+		this->io.rec.add_read(num_bytes_read);
+		if (num_bytes_read != span.size_bytes()) {
+			throw std::invalid_argument("rasterimage::read_png(): could not read file signature");
+		}
+
+		// check that it is a PNG file
+		if (png_sig_cmp(span.data(), 0, span.size_bytes()) != 0) {
+			throw std::invalid_argument("rasterimage::read_png(): not a PNG file");
+		}
+	}
+
+	if (!this->png_ptr || !this->info_ptr) {
+		throw std::bad_alloc();
+	}
+
+	png_set_sig_bytes(png_ptr, png_sig_size); // we've already read png_sig_size bytes
+
+	set_up_read_limits(png_ptr);
+
+	png_set_read_fn(
+		png_ptr,
+		&this->io,
+		png_read_callback
+	);
+
+	this->call([&]() {
+		// read in all information about file
+		png_read_info(png_ptr, info_ptr);
+
+		this->inflate_size = get_image_data_inflate_size(png_ptr, info_ptr);
+
+		this->info = set_up_read_transformations(png_ptr, info_ptr, request);
+	});
+}
+} // namespace
+
+image_info rasterimage::probe_png(const fsif::file& fi)
+{
+	ASSERT(!fi.is_open())
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_png);
+
+	fsif::file::guard file_guard(fi);
+
+	png_reader reader(fi, rec);
+	reader.read_header();
+
+	return reader.info;
+}
+
+namespace {
+// Convert row of 16 bit channel values to floating point in place.
+// The 16 bit values are at the beginning of the row memory, since floating point values may be bigger,
+// the row is converted from its end, so that no value is overwritten before it is converted.
+template <typename float_type>
+void convert_row_to_float_in_place(utki::span<float_type> row)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	auto src = reinterpret_cast<const uint16_t*>(row.data());
+	for (size_t i = row.size(); i != 0;) {
+		--i;
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		auto v = src[i];
+		row[i] = float(v) / float(std::numeric_limits<uint16_t>::max());
+	}
+}
+
+// Decode PNG image to the destination returned by the getter.
+// The getter is called once the image header is read, the destination must be of the decoded pixel type.
+void decode_png(
+	const fsif::file& fi,
+	const std::optional<pixel_type_request>& request,
+	const internal::destination_getter& get_destination
+)
+{
+	ASSERT(!fi.is_open())
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_png);
+	rec.start(instrumentation::phase::header);
+
+	// open file
+	fsif::file::guard file_guard(fi);
+
+	// libpng cannot produce floating point values, so decode 16 bit values and convert them after
+	bool to_float = request.has_value() &&
+		(request->channel_depth == depth::float_32_bit || request->channel_depth == depth::float_16_bit);
+
+	png_reader reader(fi, rec);
+	if (to_float) {
+		reader.read_header(pixel_type_request{request->pixel_format, depth::uint_16_bit});
+	} else {
+		reader.read_header(request);
+	}
+
+	auto png_ptr = reader.png_ptr;
+	auto info_ptr = reader.info_ptr;
+
+	image_info dst_info = {
+		reader.info.dims,
+		reader.info.pixel_format,
+		to_float ? request->channel_depth : reader.info.channel_depth
+	};
+
+	check_png_decode_limits(dst_info, reader.inflate_size);
+
+	rec.start(instrumentation::phase::allocation);
+
+	auto dst = get_destination(dst_info);
+
+	rec.start(instrumentation::phase::decode);
+
+	// get PNG bytes per row
+	png_size_t num_bytes_per_row = png_get_rowbytes(png_ptr, info_ptr);
+
+	// check that our expectations are correct
+	if (num_bytes_per_row !=
+		png_size_t(dst.dims().x()) * png_size_t(dst.num_channels()) *
+			png_size_t(to_channel_size(reader.info.channel_depth)))
+	{
+		throw std::runtime_error("rasterimage::read_png(): number of bytes per row does not match expected value");
+	}
+
+	ASSERT(!dst.empty())
+
+	// make an array of row pointers, destination rows are big enough to hold floating point values,
+	// 16 bit values are decoded to the beginning of the rows
+	std::vector<png_bytep> rows(dst.dims().y());
+	for (uint32_t y = 0; y != dst.dims().y(); ++y) {
+		rows[y] = dst[y].data();
+	}
+
+	// read in image data
+	reader.call([&]() {
+		png_read_image(png_ptr, rows.data());
+	});
+	rec.add_rows(rows.size());
+
+	if (to_float) {
+		rec.start(instrumentation::phase::post_process);
+		auto row_size = size_t(dst.dims().x()) * dst.num_channels();
+		for (auto row : rows) {
+			// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+			if (dst.get_depth() == depth::float_32_bit) {
+				convert_row_to_float_in_place(utki::make_span(reinterpret_cast<float*>(row), row_size));
+			} else {
+				ASSERT(dst.get_depth() == depth::float_16_bit)
+				convert_row_to_float_in_place(utki::make_span(reinterpret_cast<float16*>(row), row_size));
+			}
+			// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+		}
+	}
+
+	rec.finish();
+}
+
+image_variant decode_png(const fsif::file& fi, const std::optional<pixel_type_request>& request)
+{
+	image_variant im;
+	decode_png(fi, request, [&im](const image_info& info) {
+		im = image_variant(info.dims, info.pixel_format, info.channel_depth);
+		return im.span();
+	});
+	return im;
+}
+} // namespace
+
+image_variant rasterimage::read_png(const fsif::file& fi)
+{
+	return decode_png(fi, std::nullopt);
+}
+
+image_variant rasterimage::read_png(const fsif::file& fi, format pixel_format, depth channel_depth)
+{
+	return decode_png(fi, pixel_type_request{pixel_format, channel_depth});
+}
+
+void rasterimage::read_png(const fsif::file& fi, any_image_span dst)
+{
+	decode_png(fi, pixel_type_request{dst.get_format(), dst.get_depth()}, internal::make_destination_getter(dst));
+}
+
+void internal::read_png(const fsif::file& fi, const destination_getter& get_destination)
+{
+	decode_png(fi, std::nullopt, get_destination);
+}
+
+void internal::read_png(
+	const fsif::file& fi,
+	const r4::rectangle<uint32_t>& roi,
+	const destination_getter& get_destination
+)
+{
+	ASSERT(!fi.is_open())
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_png);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(fi);
+
+	png_reader reader(fi, rec);
+	reader.read_header();
+
+	if (!r4::rectangle<uint32_t>({0, 0}, reader.info.dims).contains(roi)) {
+		throw std::invalid_argument("rasterimage::read_png(): region of interest is out of the image");
+	}
+
+	// the limits apply to the whole image, since its rows are decompressed and held in memory
+	// even if only the region of interest is allocated
+	check_png_decode_limits(reader.info, reader.inflate_size);
+
+	auto png_ptr = reader.png_ptr;
+	auto info_ptr = reader.info_ptr;
+
+	rec.start(instrumentation::phase::allocation);
+
+	auto dst = get_destination(reader.info);
+
+	rec.start(instrumentation::phase::decode);
+
+	size_t pixel_size = to_num_channels(reader.info.pixel_format) * to_channel_size(reader.info.channel_depth);
+
+	png_size_t num_bytes_per_row = png_get_rowbytes(png_ptr, info_ptr);
+	if (num_bytes_per_row != png_size_t(reader.info.dims.x()) * pixel_size) {
+		throw std::invalid_argument("rasterimage::read_png(): number of bytes per row does not match expected value");
+	}
+
+	if (roi.d.x() == 0 || roi.d.y() == 0) {
+		rec.finish();
+		return;
+	}
+
+	auto copy_roi_row = [&](uint32_t roi_row, const png_byte* image_row) {
+		std::copy_n(
+			std::next(image_row, ptrdiff_t(roi.p.x() * pixel_size)),
+			roi.d.x() * pixel_size,
+			dst[roi_row].data()
+		);
+	};
+
+	// rows below the region of interest are never decoded
+	uint32_t end_row = roi.p.y() + roi.d.y();
+
+	if (png_get_interlace_type(png_ptr, info_ptr) == PNG_INTERLACE_NONE) {
+		std::vector<png_byte> row(num_bytes_per_row);
+		reader.call([&]() {
+			for (uint32_t y = 0; y != end_row; ++y) {
+				png_read_row(png_ptr, row.data(), nullptr);
+				if (y >= roi.p.y()) {
+					copy_roi_row(y - roi.p.y(), row.data());
+				}
+			}
+		});
+	} else {
+		// Interlacing passes are stored one after another, so all passes have to be decoded.
+		// Rows of the region are accumulated in full width, other rows are decoded to scratch buffer.
+		std::vector<png_byte> roi_rows(num_bytes_per_row * roi.d.y());
+		std::vector<png_byte> scratch_row(num_bytes_per_row);
+
+		reader.call([&]() {
+			constexpr unsigned num_adam7_passes = 7;
+			for (unsigned pass = 0; pass != num_adam7_passes; ++pass) {
+				auto num_rows = pass == num_adam7_passes - 1 ? end_row : reader.info.dims.y();
+				for (uint32_t y = 0; y != num_rows; ++y) {
+					png_bytep row = scratch_row.data();
+					if (y >= roi.p.y() && y < end_row) {
+						row = std::next(roi_rows.data(), ptrdiff_t(num_bytes_per_row * (y - roi.p.y())));
+					}
+					png_read_row(png_ptr, row, nullptr);
+				}
+			}
+		});
+
+		for (uint32_t y = 0; y != roi.d.y(); ++y) {
+			copy_roi_row(y, std::next(roi_rows.data(), ptrdiff_t(num_bytes_per_row * y)));
+		}
+	}
+
+	rec.add_rows(end_row);
+
+	rec.finish();
+}
+
+image_variant rasterimage::read_png(const fsif::file& fi, const r4::rectangle<uint32_t>& roi)
+{
+	image_variant im;
+	internal::read_png(fi, roi, internal::make_roi_destination_getter(roi, im));
+	return im;
+}
+
+void rasterimage::read_png(const fsif::file& fi, const r4::rectangle<uint32_t>& roi, any_image_span dst)
+{
+	internal::read_png(fi, roi, internal::make_roi_destination_getter(roi, dst));
+}
+
+namespace {
+// Progressive PNG decoder.
+// libpng reports errors via longjmp, so all the libpng calls are done from process() which sets the jump point.
+// Exceptions thrown from libpng callbacks are stored and reported as libpng errors to get back to process().
+class png_push_codec : public internal::push_codec
+{
+	png_structp png_ptr = nullptr;
+	png_infop info_ptr = nullptr;
+
+	// libpng error message, set by error callback
+	std::string error_message;
+
+	// exception thrown from one of libpng callbacks
+	std::exception_ptr callback_exception;
+
+	uint8_t* pixels = nullptr;
+	size_t row_size_bytes = 0;
+	uint32_t height = 0;
+	bool interlaced = false;
+
+	uint32_t final_rows = 0;
+	bool finished = false;
+
+	[[noreturn]] static void error_callback(png_structp png_ptr, png_const_charp message)
+	{
+		auto c = static_cast<png_push_codec*>(png_get_error_ptr(png_ptr));
+		ASSERT(c)
+
+		try {
+			c->error_message = message;
+		} catch (...) {
+			// ignore, the error will be reported without message
+		}
+
+		png_longjmp(png_ptr, 1);
+	}
+
+	static png_push_codec& get_codec(png_structp png_ptr)
+	{
+		auto c = static_cast<png_push_codec*>(png_get_progressive_ptr(png_ptr));
+		ASSERT(c)
+		return *c;
+	}
+
+	// Calls the function and in case it throws, stores the exception and raises libpng error.
+	// The error must be raised outside of the catch block, because longjmp must not leave the catch block.
+	template <typename func_type>
+	static void call_guarded(png_structp png_ptr, func_type func)
+	{
+		auto& c = get_codec(png_ptr);
+		try {
+			func(c);
+			return;
+		} catch (...) {
+			c.callback_exception = std::current_exception();
+		}
+		png_error(png_ptr, "exception thrown from callback");
+	}
+
+	static void info_callback(png_structp png_ptr, png_infop /* info_ptr */)
+	{
+		call_guarded(png_ptr, [](png_push_codec& c) {
+			c.on_info();
+		});
+	}
+
+	static void row_callback(png_structp png_ptr, png_bytep new_row, png_uint_32 row_num, int pass)
+	{
+		auto& c = get_codec(png_ptr);
+
+		if (row_num >= c.height) {
+			return;
+		}
+
+		// new_row is null for rows which are not affected by current interlacing pass
+		if (new_row) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			png_progressive_combine_row(png_ptr, c.pixels + size_t(row_num) * c.row_size_bytes, new_row);
+		}
+
+		if (!c.interlaced) {
+			c.final_rows = row_num + 1;
+			return;
+		}
+
+		// Adam7 last pass fills odd rows and by that time all even rows are complete.
+		// The odd row is followed by an even one, so rows up to the next even row are final.
+		// The even rows are reported with null new_row, and the next odd row is not yet received.
+		constexpr int last_adam7_pass = 6;
+		if (pass == last_adam7_pass) {
+			c.final_rows = std::min(new_row ? row_num + 2 : row_num + 1, c.height);
+		}
+	}
+
+	static void end_callback(png_structp png_ptr, png_infop /* info_ptr */)
+	{
+		auto& c = get_codec(png_ptr);
+		c.final_rows = c.height;
+		c.finished = true;
+	}
+
+	void on_info()
+	{
+		auto inflate_size = get_image_data_inflate_size(this->png_ptr, this->info_ptr);
+
+		auto info = set_up_read_transformations(this->png_ptr, this->info_ptr);
+
+		// decode limits for the image dimensions are checked on allocation
+		internal::check_inflate_limit(inflate_size);
+
+		this->interlaced = png_get_interlace_type(this->png_ptr, this->info_ptr) != PNG_INTERLACE_NONE;
+
+		auto& im = this->allocate_image(info);
+
+		std::visit(
+			[this](auto& image) {
+				using pixel_type = typename std::remove_reference_t<decltype(image)>::pixel_type;
+				this->row_size_bytes = sizeof(pixel_type) * image.dims().x();
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+				this->pixels = reinterpret_cast<uint8_t*>(image.pixels().data());
+				this->height = image.dims().y();
+			},
+			im.variant
+		);
+
+		// check that our expectations are correct
+		if (png_get_rowbytes(this->png_ptr, this->info_ptr) != this->row_size_bytes) {
+			throw std::invalid_argument("rasterimage::push_decoder: number of bytes per row does not match expected value");
+		}
+	}
+
+	// returns false in case of libpng error
+	bool process(utki::span<const uint8_t> data)
+	{
+		// NOTE: no non-trivially destructible objects are allowed in this function,
+		//       because libpng error makes longjmp back to here
+		if (setjmp(png_jmpbuf(this->png_ptr))) {
+			return false;
+		}
+
+		png_process_data(
+			this->png_ptr,
+			this->info_ptr,
+			// libpng does not modify the data, but takes it via non-const pointer
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+			const_cast<png_bytep>(data.data()),
+			data.size()
+		);
+
+		return true;
+	}
+
+public:
+	png_push_codec(push_decoder& owner) :
+		push_codec(owner)
+	{
+		this->png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, this, &error_callback, nullptr);
+		if (!this->png_ptr) {
+			throw std::bad_alloc();
+		}
+
+		this->info_ptr = png_create_info_struct(this->png_ptr);
+		if (!this->info_ptr) {
+			png_destroy_read_struct(&this->png_ptr, nullptr, nullptr);
+			throw std::bad_alloc();
+		}
+
+		set_up_read_limits(this->png_ptr);
+
+		png_set_progressive_read_fn(this->png_ptr, this, &info_callback, &row_callback, &end_callback);
+	}
+
+	png_push_codec(const png_push_codec&) = delete;
+	png_push_codec& operator=(const png_push_codec&) = delete;
+
+	png_push_codec(png_push_codec&&) = delete;
+	png_push_codec& operator=(png_push_codec&&) = delete;
+
+	~png_push_codec() override
+	{
+		png_destroy_read_struct(&this->png_ptr, &this->info_ptr, nullptr);
+	}
+
+	bool push(utki::span<const uint8_t> data) override
+	{
+		if (this->finished || data.empty()) {
+			return this->finished;
+		}
+
+		if (!this->process(data)) {
+			if (this->callback_exception) {
+				std::rethrow_exception(this->callback_exception);
+			}
+			throw std::invalid_argument("rasterimage::push_decoder: PNG decoding error: "s + this->error_message);
+		}
+
+		return this->finished;
+	}
+
+	uint32_t num_final_rows() const noexcept override
+	{
+		return this->final_rows;
+	}
+};
+} // namespace
+
+std::unique_ptr<internal::push_codec> internal::make_png_push_codec(push_decoder& owner)
+{
+	return std::make_unique<png_push_codec>(owner);
+}
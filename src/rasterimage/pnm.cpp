@@ -0,0 +1,692 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "pnm.hpp"
+
+#include <algorithm>
+#include <array>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <string>
+
+#include <utki/config.hpp>
+#include <utki/debug.hpp>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#endif
+
+#include "instrumentation.hpp"
+#include "operations.hpp"
+
+using namespace std::string_literals;
+
+using namespace rasterimage;
+
+namespace {
+// header lines and numbers are limited in length, so that garbage input is rejected quickly
+constexpr size_t max_header_line_length = 1024;
+constexpr size_t max_header_number_length = 10;
+
+/**
+ * @brief Swap bytes of 16 bit values.
+ * Source and destination can be the same memory.
+ */
+void swap_bytes_16(const uint8_t* src, uint8_t* dst, size_t num_values) noexcept
+{
+	size_t i = 0;
+#if defined(__SSE2__)
+	constexpr size_t simd_size = 8;
+	// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+	for (; i + simd_size <= num_values; i += simd_size) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(std::next(src, ptrdiff_t(i * 2))));
+		// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(std::next(dst, ptrdiff_t(i * 2))), v);
+	}
+	// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+#endif
+	for (; i != num_values; ++i) {
+		auto lo = src[i * 2];
+		auto hi = src[i * 2 + 1];
+		dst[i * 2] = hi;
+		dst[i * 2 + 1] = lo;
+	}
+}
+
+// convert 16 bit values between big endian, as PNM files store them, and native byte order
+void big_endian_to_native(const uint8_t* src, uint8_t* dst, size_t num_values) noexcept
+{
+#if CFG_ENDIANNESS == CFG_ENDIANNESS_LITTLE
+	swap_bytes_16(src, dst, num_values);
+#else
+	if (src != dst) {
+		std::copy_n(src, num_values * 2, dst);
+	}
+#endif
+}
+
+template <typename channel_type, size_t num_channels>
+void reorder_channels(uint8_t* data, uint32_t width, format pixel_format, bool from_canonical) noexcept
+{
+	using pixel_type = r4::vector<channel_type, num_channels>;
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	auto pixels = utki::make_span(reinterpret_cast<pixel_type*>(data), width);
+	for (auto& px : pixels) {
+		if (from_canonical) {
+			px = from_canonical_order(pixel_format, px);
+		} else {
+			px = to_canonical_order(pixel_format, px);
+		}
+	}
+}
+
+/**
+ * @brief Reorder channels of row pixels in place.
+ * Reorders from the canonical order to the pixel format's order or vice versa.
+ */
+void reorder_channels(uint8_t* data, uint32_t width, format pixel_format, depth channel_depth, bool from_canonical)
+{
+	if (to_canonical(pixel_format) == pixel_format) {
+		return;
+	}
+
+	// only 3 and 4 channel formats have non-canonical variants
+	bool is_16_bit = channel_depth == depth::uint_16_bit;
+	if (to_num_channels(pixel_format) == 3) {
+		if (is_16_bit) {
+			reorder_channels<uint16_t, 3>(data, width, pixel_format, from_canonical);
+		} else {
+			reorder_channels<uint8_t, 3>(data, width, pixel_format, from_canonical);
+		}
+	} else {
+		ASSERT(to_num_channels(pixel_format) == 4)
+		if (is_16_bit) {
+			reorder_channels<uint16_t, 4>(data, width, pixel_format, from_canonical);
+		} else {
+			reorder_channels<uint8_t, 4>(data, width, pixel_format, from_canonical);
+		}
+	}
+}
+
+// scale samples from [0:maxval] range to the full range of channel type
+template <typename channel_type>
+void scale_to_full_range(uint8_t* data, size_t num_values, uint32_t maxval) noexcept
+{
+	constexpr uint32_t full_range = std::numeric_limits<channel_type>::max();
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	auto values = utki::make_span(reinterpret_cast<channel_type*>(data), num_values);
+	for (auto& v : values) {
+		// values above maxval are invalid, clamp them
+		v = channel_type((std::min(uint32_t(v), maxval) * full_range + maxval / 2) / maxval);
+	}
+}
+
+bool is_space(int c) noexcept
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+uint32_t parse_header_number(const std::string& str)
+{
+	if (str.empty() || str.size() > max_header_number_length) {
+		throw std::invalid_argument("rasterimage: invalid PNM header number: "s + str);
+	}
+
+	uint64_t ret = 0;
+	for (auto c : str) {
+		if (c < '0' || '9' < c) {
+			throw std::invalid_argument("rasterimage: invalid PNM header number: "s + str);
+		}
+		// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+		ret = ret * 10 + uint64_t(c - '0');
+	}
+
+	if (ret > std::numeric_limits<uint32_t>::max()) {
+		throw std::invalid_argument("rasterimage: invalid PNM header number: "s + str);
+	}
+
+	return uint32_t(ret);
+}
+
+std::string_view get_tuple_type(format pixel_format)
+{
+	switch (to_canonical(pixel_format)) {
+		case format::grey:
+			return "GRAYSCALE";
+		case format::greya:
+			return "GRAYSCALE_ALPHA";
+		case format::rgb:
+			return "RGB";
+		default:
+			ASSERT(to_canonical(pixel_format) == format::rgba)
+			return "RGB_ALPHA";
+	}
+}
+
+struct header_values {
+	uint32_t width;
+	uint32_t height;
+	uint32_t num_channels;
+	uint32_t maxval;
+};
+
+// read PGM or PPM header value, get_byte() returns -1 at the end of data
+template <typename get_byte_type>
+std::string read_header_token(get_byte_type& get_byte)
+{
+	int c = get_byte();
+
+	// skip whitespaces and comments
+	for (;;) {
+		if (c == '#') {
+			while (c != '\n' && c != '\r' && c != -1) {
+				c = get_byte();
+			}
+		} else if (is_space(c)) {
+			c = get_byte();
+		} else {
+			break;
+		}
+	}
+
+	std::string ret;
+	for (; c != -1 && !is_space(c) && c != '#'; c = get_byte()) {
+		if (ret.size() == max_header_number_length) {
+			throw std::invalid_argument("rasterimage: invalid PNM header");
+		}
+		ret.push_back(char(c));
+	}
+
+	// the value is terminated by single whitespace, after the last header value the pixel data follows it
+	if (!is_space(c)) {
+		throw std::invalid_argument("rasterimage: invalid PNM header");
+	}
+
+	return ret;
+}
+
+template <typename get_byte_type>
+std::string read_header_line(get_byte_type& get_byte)
+{
+	std::string ret;
+	for (int c = get_byte(); c != '\n'; c = get_byte()) {
+		if (c == -1 || ret.size() == max_header_line_length) {
+			throw std::invalid_argument("rasterimage: invalid PAM header");
+		}
+		ret.push_back(char(c));
+	}
+	return ret;
+}
+
+// read PAM header after the "P7" magic
+template <typename get_byte_type>
+header_values read_pam_header(get_byte_type& get_byte)
+{
+	header_values ret{};
+
+	if (!read_header_line(get_byte).empty()) {
+		throw std::invalid_argument("rasterimage: invalid PAM header");
+	}
+
+	for (;;) {
+		auto line = read_header_line(get_byte);
+
+		auto key_begin = std::find_if_not(line.begin(), line.end(), is_space);
+		if (key_begin == line.end() || *key_begin == '#') {
+			continue;
+		}
+		auto key_end = std::find_if(key_begin, line.end(), is_space);
+		auto value_begin = std::find_if_not(key_end, line.end(), is_space);
+		auto value_end = std::find_if(value_begin, line.end(), is_space);
+
+		std::string key(key_begin, key_end);
+		std::string value(value_begin, value_end);
+
+		if (key == "ENDHDR") {
+			break;
+		} else if (key == "WIDTH") {
+			ret.width = parse_header_number(value);
+		} else if (key == "HEIGHT") {
+			ret.height = parse_header_number(value);
+		} else if (key == "DEPTH") {
+			ret.num_channels = parse_header_number(value);
+		} else if (key == "MAXVAL") {
+			ret.maxval = parse_header_number(value);
+		} else if (key == "TUPLTYPE") {
+			// number of channels is given by depth, tuple type is informational
+			continue;
+		} else {
+			throw std::invalid_argument("rasterimage: unknown PAM header field: "s + key);
+		}
+	}
+
+	if (ret.num_channels < 1 || ret.num_channels > max_num_channels) {
+		throw std::invalid_argument("rasterimage: unsupported PAM depth");
+	}
+
+	return ret;
+}
+
+bool is_pnm_pixel_type(const image_info& info) noexcept
+{
+	return info.pixel_format < format::enum_size &&
+		(info.channel_depth == depth::uint_8_bit || info.channel_depth == depth::uint_16_bit);
+}
+} // namespace
+
+pnm_reader::pnm_reader(std::function<size_t(utki::span<uint8_t>)> read_func, const fsif::file* fi) :
+	read_func(std::move(read_func)),
+	fi(fi)
+{
+	if (this->fi) {
+		this->fi->open(fsif::mode::read);
+	}
+}
+
+pnm_reader::pnm_reader(std::function<size_t(utki::span<uint8_t>)> read_func) :
+	pnm_reader(std::move(read_func), nullptr)
+{
+	this->read_header();
+}
+
+pnm_reader::pnm_reader(const fsif::file& fi) :
+	pnm_reader(
+		[&fi](utki::span<uint8_t> buf) {
+			return fi.read(buf);
+		},
+		&fi
+	)
+{
+	// the object is constructed by the delegated constructor,
+	// so in case of exception the destructor closes the file
+	this->read_header();
+}
+
+pnm_reader::pnm_reader(std::istream& s) :
+	pnm_reader(
+		[&s](utki::span<uint8_t> buf) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			s.read(reinterpret_cast<char*>(buf.data()), std::streamsize(buf.size()));
+			return size_t(s.gcount());
+		},
+		nullptr
+	)
+{
+	this->read_header();
+}
+
+pnm_reader::~pnm_reader()
+{
+	if (this->fi) {
+		this->fi->close();
+	}
+}
+
+int pnm_reader::read_byte()
+{
+	uint8_t ret = 0;
+	if (this->read_func(utki::make_span(&ret, 1)) == 0) {
+		return -1;
+	}
+	return ret;
+}
+
+void pnm_reader::read_bytes(utki::span<uint8_t> buf)
+{
+	// reading from pipe can return less bytes than requested
+	while (!buf.empty()) {
+		auto num_read = this->read_func(buf);
+		if (num_read == 0) {
+			throw std::invalid_argument("rasterimage::pnm_reader: unexpected end of data");
+		}
+		buf = buf.subspan(num_read);
+	}
+}
+
+void pnm_reader::read_header()
+{
+	// header is read byte by byte, so that not a single byte of pixel data is consumed
+	auto get_byte = [this]() {
+		return this->read_byte();
+	};
+
+	if (get_byte() != 'P') {
+		throw std::invalid_argument("rasterimage: not a PNM file");
+	}
+
+	header_values h{};
+
+	auto kind = get_byte();
+	switch (kind) {
+		case '5':
+		case '6':
+			h.width = parse_header_number(read_header_token(get_byte));
+			h.height = parse_header_number(read_header_token(get_byte));
+			h.maxval = parse_header_number(read_header_token(get_byte));
+			h.num_channels = kind == '5' ? 1 : 3;
+			break;
+		case '7':
+			h = read_pam_header(get_byte);
+			break;
+		default:
+			throw std::invalid_argument("rasterimage: not a binary PGM, PPM or PAM file");
+	}
+
+	if (h.maxval == 0 || h.maxval > std::numeric_limits<uint16_t>::max()) {
+		throw std::invalid_argument("rasterimage: invalid PNM maximal sample value");
+	}
+
+	this->maxval = h.maxval;
+	this->info = {
+		{h.width, h.height},
+		to_format(h.num_channels),
+		h.maxval <= std::numeric_limits<uint8_t>::max() ? depth::uint_8_bit : depth::uint_16_bit
+	};
+}
+
+void pnm_reader::read_rows(any_image_span dst)
+{
+	if (dst.dims().x() != this->info.dims.x() || dst.dims().y() > this->num_remaining_rows()) {
+		throw std::invalid_argument("rasterimage::pnm_reader::read_rows(): destination span does not fit the image");
+	}
+	if (to_canonical(dst.get_format()) != this->info.pixel_format || dst.get_depth() != this->info.channel_depth) {
+		throw std::invalid_argument(
+			"rasterimage::pnm_reader::read_rows(): destination span pixel type does not match the image"
+		);
+	}
+
+	bool is_16_bit = this->info.channel_depth == depth::uint_16_bit;
+	size_t num_values = size_t(dst.dims().x()) * dst.num_channels();
+
+	for (uint32_t y = 0; y != dst.dims().y(); ++y) {
+		auto row = dst[y];
+		this->read_bytes(row);
+
+		if (is_16_bit) {
+			big_endian_to_native(row.data(), row.data(), num_values);
+			if (this->maxval != std::numeric_limits<uint16_t>::max()) {
+				scale_to_full_range<uint16_t>(row.data(), num_values, this->maxval);
+			}
+		} else if (this->maxval != std::numeric_limits<uint8_t>::max()) {
+			scale_to_full_range<uint8_t>(row.data(), num_values, this->maxval);
+		}
+
+		reorder_channels(row.data(), dst.dims().x(), dst.get_format(), dst.get_depth(), true);
+
+		++this->num_rows_read;
+	}
+}
+
+pnm_writer::pnm_writer(
+	std::function<void(utki::span<const uint8_t>)> write_func,
+	const fsif::file* fi,
+	const image_info& info
+) :
+	write_func(std::move(write_func)),
+	fi(fi),
+	info(info)
+{
+	if (!is_pnm_pixel_type(info)) {
+		throw std::invalid_argument("rasterimage::pnm_writer: PNM supports only 8 bit or 16 bit per channel images");
+	}
+
+	if (this->fi) {
+		this->fi->open(fsif::mode::create);
+	}
+}
+
+pnm_writer::pnm_writer(
+	std::function<void(utki::span<const uint8_t>)> write_func,
+	const image_info& info,
+	pnm_type type
+) :
+	pnm_writer(std::move(write_func), nullptr, info)
+{
+	this->write_header(type);
+}
+
+pnm_writer::pnm_writer(const fsif::file& fi, const image_info& info, pnm_type type) :
+	pnm_writer(
+		[&fi](utki::span<const uint8_t> buf) {
+			if (fi.write(buf) != buf.size()) {
+				throw std::runtime_error("rasterimage::pnm_writer: could not write to file");
+			}
+		},
+		&fi,
+		info
+	)
+{
+	// the object is constructed by the delegated constructor,
+	// so in case of exception the destructor closes the file
+	this->write_header(type);
+}
+
+pnm_writer::pnm_writer(std::ostream& s, const image_info& info, pnm_type type) :
+	pnm_writer(
+		[&s](utki::span<const uint8_t> buf) {
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			s.write(reinterpret_cast<const char*>(buf.data()), std::streamsize(buf.size()));
+			if (!s) {
+				throw std::runtime_error("rasterimage::pnm_writer: could not write to stream");
+			}
+		},
+		nullptr,
+		info
+	)
+{
+	this->write_header(type);
+}
+
+pnm_writer::~pnm_writer()
+{
+	if (this->fi) {
+		this->fi->close();
+	}
+}
+
+void pnm_writer::write_header(pnm_type type)
+{
+	auto canonical_format = to_canonical(this->info.pixel_format);
+	auto maxval = this->info.channel_depth == depth::uint_8_bit ? std::numeric_limits<uint8_t>::max()
+																: std::numeric_limits<uint16_t>::max();
+
+	auto dims = std::to_string(this->info.dims.x()) + " "s + std::to_string(this->info.dims.y());
+
+	std::string header;
+	if (type == pnm_type::automatic && canonical_format == format::grey) {
+		header = "P5\n"s + dims + "\n"s + std::to_string(maxval) + "\n"s;
+	} else if (type == pnm_type::automatic && canonical_format == format::rgb) {
+		header = "P6\n"s + dims + "\n"s + std::to_string(maxval) + "\n"s;
+	} else {
+		header = "P7\nWIDTH "s + std::to_string(this->info.dims.x()) + "\nHEIGHT "s +
+			std::to_string(this->info.dims.y()) + "\nDEPTH "s + std::to_string(to_num_channels(canonical_format)) +
+			"\nMAXVAL "s + std::to_string(maxval) + "\nTUPLTYPE "s + std::string(get_tuple_type(canonical_format)) +
+			"\nENDHDR\n"s;
+	}
+
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+	this->write_func(utki::make_span(reinterpret_cast<const uint8_t*>(header.data()), header.size()));
+}
+
+void pnm_writer::write_rows(const_any_image_span rows)
+{
+	if (rows.dims().x() != this->info.dims.x() || rows.dims().y() > this->num_remaining_rows()) {
+		throw std::invalid_argument("rasterimage::pnm_writer::write_rows(): rows do not fit the image");
+	}
+	if (rows.get_format() != this->info.pixel_format || rows.get_depth() != this->info.channel_depth) {
+		throw std::invalid_argument("rasterimage::pnm_writer::write_rows(): rows pixel type does not match the image");
+	}
+
+	bool is_16_bit = this->info.channel_depth == depth::uint_16_bit;
+	bool is_canonical = to_canonical(this->info.pixel_format) == this->info.pixel_format;
+	size_t num_values = size_t(rows.dims().x()) * rows.num_channels();
+
+	for (uint32_t y = 0; y != rows.dims().y(); ++y) {
+		auto row = rows[y];
+
+		if (is_canonical && (!is_16_bit || CFG_ENDIANNESS == CFG_ENDIANNESS_BIG)) {
+			// pixels are written as is
+			this->write_func(row);
+		} else {
+			auto src = row.data();
+			this->buffer.resize(row.size());
+			if (!is_canonical) {
+				std::copy(row.begin(), row.end(), this->buffer.begin());
+				reorder_channels(this->buffer.data(), rows.dims().x(), rows.get_format(), rows.get_depth(), false);
+				src = this->buffer.data();
+			}
+			if (is_16_bit) {
+				// conversion from native byte order to big endian is same as the reverse one
+				big_endian_to_native(src, this->buffer.data(), num_values);
+			}
+			this->write_func(this->buffer);
+		}
+
+		++this->num_rows_written;
+	}
+}
+
+image_info rasterimage::probe_pnm(const fsif::file& fi)
+{
+	return pnm_reader(fi).get_info();
+}
+
+image_variant rasterimage::read_pnm(const fsif::file& fi)
+{
+	ASSERT(!fi.is_open())
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_pnm);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(fi);
+
+	pnm_reader reader([&](utki::span<uint8_t> buf) {
+		auto num_read = fi.read(buf);
+		rec.add_read(num_read);
+		return num_read;
+	});
+
+	internal::check_decode_limits(reader.get_info());
+
+	rec.start(instrumentation::phase::allocation);
+
+	image_variant im(reader.get_info().dims, reader.get_info().pixel_format, reader.get_info().channel_depth);
+
+	rec.start(instrumentation::phase::decode);
+
+	reader.read_rows(im.span());
+
+	rec.add_rows(im.dims().y());
+	rec.finish();
+
+	return im;
+}
+
+image_variant rasterimage::read_pnm(std::istream& s)
+{
+	pnm_reader reader(s);
+
+	internal::check_decode_limits(reader.get_info());
+
+	image_variant im(reader.get_info().dims, reader.get_info().pixel_format, reader.get_info().channel_depth);
+	reader.read_rows(im.span());
+
+	return im;
+}
+
+void rasterimage::read_pnm(const fsif::file& fi, any_image_span dst)
+{
+	ASSERT(!fi.is_open())
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_pnm);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(fi);
+
+	pnm_reader reader([&](utki::span<uint8_t> buf) {
+		auto num_read = fi.read(buf);
+		rec.add_read(num_read);
+		return num_read;
+	});
+
+	internal::check_decode_limits(reader.get_info());
+
+	if (dst.dims() != reader.get_info().dims) {
+		throw std::invalid_argument("destination image span dimensions do not match image dimensions");
+	}
+
+	rec.start(instrumentation::phase::decode);
+
+	reader.read_rows(dst);
+
+	rec.add_rows(dst.dims().y());
+	rec.finish();
+}
+
+void rasterimage::write_pnm(const fsif::file& fi, const_any_image_span span, pnm_type type)
+{
+	ASSERT(!fi.is_open())
+
+	instrumentation::internal::recorder rec(instrumentation::operation::write_pnm);
+	rec.start(instrumentation::phase::header);
+
+	image_info info{span.dims(), span.get_format(), span.get_depth()};
+
+	fsif::file::guard file_guard(
+		fi, //
+		fsif::mode::create
+	);
+
+	pnm_writer writer(
+		[&](utki::span<const uint8_t> buf) {
+			auto num_written = fi.write(buf);
+			rec.add_written(num_written);
+			if (num_written != buf.size()) {
+				throw std::runtime_error("rasterimage::write_pnm(): could not write to file");
+			}
+		},
+		info,
+		type
+	);
+
+	rec.start(instrumentation::phase::encode);
+
+	writer.write_rows(span);
+
+	rec.add_rows(span.dims().y());
+	rec.finish();
+}
+
+void rasterimage::write_pnm(std::ostream& s, const_any_image_span span, pnm_type type)
+{
+	pnm_writer writer(s, {span.dims(), span.get_format(), span.get_depth()}, type);
+	writer.write_rows(span);
+}
@@ -0,0 +1,289 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <functional>
+#include <iosfwd>
+#include <vector>
+
+#include <fsif/file.hpp>
+#include <utki/span.hpp>
+
+#include "any_image_span.hpp"
+#include "image_variant.hpp"
+
+namespace rasterimage {
+
+/**
+ * @brief Kind of PNM file to write.
+ */
+enum class pnm_type {
+	/**
+	 * @brief PGM for greyscale images, PPM for RGB images and PAM for images with alpha channel.
+	 * This is the most widely supported choice.
+	 */
+	automatic,
+
+	/**
+	 * @brief PAM for all images.
+	 */
+	pam,
+
+	enum_size
+};
+
+/**
+ * @brief Row by row reader of binary PGM, PPM and PAM images.
+ * The reader reads exactly the bytes of one image from the source, so several images
+ * concatenated in one stream, e.g. in a pipe, can be read by consecutive readers.
+ * Pixel rows are read directly to the destination, the image is never buffered as a whole.
+ * Images with maximal sample value up to 255 are read as 8 bit images, others as 16 bit images.
+ * Samples are scaled to the full range of the channel type in case the maximal sample value
+ * is not 255 or 65535.
+ * The reader does not allocate the image, so it does not check decode limits, read_pnm() checks them.
+ */
+class pnm_reader
+{
+	std::function<size_t(utki::span<uint8_t>)> read_func;
+	const fsif::file* fi = nullptr;
+
+	image_info info{};
+	uint32_t maxval = 0;
+	uint32_t num_rows_read = 0;
+
+	pnm_reader(std::function<size_t(utki::span<uint8_t>)> read_func, const fsif::file* fi);
+
+	int read_byte();
+	void read_bytes(utki::span<uint8_t> buf);
+	void read_header();
+
+public:
+	/**
+	 * @brief Create reader of the data provided by a function.
+	 * Reads the image header.
+	 * @param read_func - function which reads up to the given buffer size bytes to the buffer
+	 *                    and returns number of bytes read. Returning 0 means end of data.
+	 * @throw std::invalid_argument - in case the data is not a valid binary PGM, PPM or PAM file.
+	 */
+	pnm_reader(std::function<size_t(utki::span<uint8_t>)> read_func);
+
+	/**
+	 * @brief Create file reader.
+	 * Opens the file and reads the image header. The file stays opened until the reader is destroyed.
+	 * @param fi - file to read the image from. File must not be opened.
+	 * @throw std::invalid_argument - in case the file is not a valid binary PGM, PPM or PAM file.
+	 */
+	pnm_reader(const fsif::file& fi);
+
+	/**
+	 * @brief Create stream reader.
+	 * Reads the image header. Note, that in order to read from std::cin on Windows,
+	 * the standard input has to be switched to binary mode.
+	 * @param s - stream to read the image from.
+	 * @throw std::invalid_argument - in case the stream does not contain a valid binary PGM, PPM or PAM file.
+	 */
+	pnm_reader(std::istream& s);
+
+	pnm_reader(const pnm_reader&) = delete;
+	pnm_reader& operator=(const pnm_reader&) = delete;
+
+	pnm_reader(pnm_reader&&) = delete;
+	pnm_reader& operator=(pnm_reader&&) = delete;
+
+	~pnm_reader();
+
+	/**
+	 * @brief Get image properties.
+	 * Pixel format is one of grey, greya, rgb or rgba, channel depth is 8 or 16 bit.
+	 * @return Properties of the image.
+	 */
+	const image_info& get_info() const noexcept
+	{
+		return this->info;
+	}
+
+	/**
+	 * @brief Get number of not yet read rows.
+	 * @return Number of remaining rows.
+	 */
+	uint32_t num_remaining_rows() const noexcept
+	{
+		return this->info.dims.y() - this->num_rows_read;
+	}
+
+	/**
+	 * @brief Read next rows of the image.
+	 * @param dst - span to read the rows to. Must have the image width and not more rows than remaining ones.
+	 *              Must have same channel depth as the image and pixel format with same channels as the image,
+	 *              e.g. image with rgb pixels can be read to rgb and bgr spans.
+	 * @throw std::invalid_argument - in case the destination span does not fit the image
+	 *                                or in case of unexpected end of data.
+	 */
+	void read_rows(any_image_span dst);
+};
+
+/**
+ * @brief Row by row writer of binary PGM, PPM and PAM images.
+ * Only a single row is buffered, in case the pixels need reordering or byte swapping.
+ * 16 bit samples are written in big endian byte order, as the format requires.
+ */
+class pnm_writer
+{
+	std::function<void(utki::span<const uint8_t>)> write_func;
+	const fsif::file* fi = nullptr;
+
+	image_info info;
+	uint32_t num_rows_written = 0;
+
+	std::vector<uint8_t> buffer;
+
+	pnm_writer(std::function<void(utki::span<const uint8_t>)> write_func, const fsif::file* fi, const image_info& info);
+
+	void write_header(pnm_type type);
+
+public:
+	/**
+	 * @brief Create writer to a function.
+	 * Writes the image header.
+	 * @param write_func - function which writes all the given bytes.
+	 * @param info - properties of the image to write. Channel depth must be 8 or 16 bit.
+	 * @param type - kind of PNM file to write.
+	 * @throw std::invalid_argument - in case the image has pixel type which PNM does not support.
+	 */
+	pnm_writer(
+		std::function<void(utki::span<const uint8_t>)> write_func,
+		const image_info& info,
+		pnm_type type = pnm_type::automatic
+	);
+
+	/**
+	 * @brief Create file writer.
+	 * Opens the file and writes the image header. The file stays opened until the writer is destroyed.
+	 * @param fi - file interface for writing the file. Must not be opened. Exisitng file will be overwritten.
+	 * @param info - properties of the image to write. Channel depth must be 8 or 16 bit.
+	 * @param type - kind of PNM file to write.
+	 * @throw std::invalid_argument - in case the image has pixel type which PNM does not support.
+	 */
+	pnm_writer(const fsif::file& fi, const image_info& info, pnm_type type = pnm_type::automatic);
+
+	/**
+	 * @brief Create stream writer.
+	 * Writes the image header. Note, that in order to write to std::cout on Windows,
+	 * the standard output has to be switched to binary mode.
+	 * @param s - stream to write the image to.
+	 * @param info - properties of the image to write. Channel depth must be 8 or 16 bit.
+	 * @param type - kind of PNM file to write.
+	 * @throw std::invalid_argument - in case the image has pixel type which PNM does not support.
+	 */
+	pnm_writer(std::ostream& s, const image_info& info, pnm_type type = pnm_type::automatic);
+
+	pnm_writer(const pnm_writer&) = delete;
+	pnm_writer& operator=(const pnm_writer&) = delete;
+
+	pnm_writer(pnm_writer&&) = delete;
+	pnm_writer& operator=(pnm_writer&&) = delete;
+
+	~pnm_writer();
+
+	/**
+	 * @brief Get number of not yet written rows.
+	 * @return Number of remaining rows.
+	 */
+	uint32_t num_remaining_rows() const noexcept
+	{
+		return this->info.dims.y() - this->num_rows_written;
+	}
+
+	/**
+	 * @brief Write next rows of the image.
+	 * @param rows - rows to write. Must have the image width, pixel type and not more rows than remaining ones.
+	 * @throw std::invalid_argument - in case the rows do not fit the image.
+	 */
+	void write_rows(const_any_image_span rows);
+};
+
+/**
+ * @brief Read binary PGM, PPM or PAM image header.
+ * @param fi - file to read the image header from. File must not be opened.
+ * @return Properties of the image which read_pnm() would return for the file.
+ * @throw std::invalid_argument - in case the file is not a valid binary PGM, PPM or PAM file.
+ */
+image_info probe_pnm(const fsif::file& fi);
+
+/**
+ * @brief Read binary PGM, PPM or PAM image.
+ * See pnm_reader for details.
+ * @param fi - file to read the image from. File must not be opened.
+ * @return Image read from the file.
+ * @throw std::invalid_argument - in case the file is not a valid binary PGM, PPM or PAM file.
+ * @throw size_limit_error - in case the image exceeds decode limits, see set_decode_limits().
+ */
+image_variant read_pnm(const fsif::file& fi);
+
+/**
+ * @brief Read binary PGM, PPM or PAM image from stream.
+ * See pnm_reader for details.
+ * @param s - stream to read the image from, e.g. std::cin.
+ * @return Image read from the stream.
+ * @throw std::invalid_argument - in case the stream does not contain a valid binary PGM, PPM or PAM file.
+ * @throw size_limit_error - in case the image exceeds decode limits, see set_decode_limits().
+ */
+image_variant read_pnm(std::istream& s);
+
+/**
+ * @brief Read binary PGM, PPM or PAM image to an existing image span.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param dst - span to write the image to. Must have same dimensions and channel depth as the image
+ *              and pixel format with same channels as the image, see pnm_reader::read_rows().
+ * @throw std::invalid_argument - in case the file is not a valid binary PGM, PPM or PAM file,
+ *                                or the destination span does not fit the image.
+ * @throw size_limit_error - in case the image exceeds decode limits, see set_decode_limits().
+ */
+void read_pnm(const fsif::file& fi, any_image_span dst);
+
+/**
+ * @brief Write image to binary PGM, PPM or PAM file.
+ * See pnm_writer for details.
+ * @param fi - file interface for writing the file. Must not be opened. Exisitng file will be overwritten.
+ * @param span - image to write. Channel depth must be 8 or 16 bit.
+ * @param type - kind of PNM file to write.
+ * @throw std::invalid_argument - in case the image has pixel type which PNM does not support.
+ */
+void write_pnm(const fsif::file& fi, const_any_image_span span, pnm_type type = pnm_type::automatic);
+
+/**
+ * @brief Write image to stream as binary PGM, PPM or PAM file.
+ * See pnm_writer for details.
+ * @param s - stream to write the image to, e.g. std::cout.
+ * @param span - image to write. Channel depth must be 8 or 16 bit.
+ * @param type - kind of PNM file to write.
+ * @throw std::invalid_argument - in case the image has pixel type which PNM does not support.
+ */
+void write_pnm(std::ostream& s, const_any_image_span span, pnm_type type = pnm_type::automatic);
+
+} // namespace rasterimage
@@ -0,0 +1,189 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "push_decoder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace rasterimage;
+
+image_variant& internal::push_codec::allocate_image(const image_info& info)
+{
+	ASSERT(!this->owner.decoded_info.has_value())
+
+	internal::check_decode_limits(info);
+
+	this->owner.decoded_image = image_variant(info.dims, info.pixel_format, info.channel_depth);
+	this->owner.decoded_info = info;
+
+	return this->owner.decoded_image;
+}
+
+push_decoder::~push_decoder() = default;
+
+namespace {
+constexpr size_t png_sig_size = 8;
+constexpr size_t jpeg_sig_size = 3;
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+constexpr std::array<uint8_t, png_sig_size> png_sig = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+// JPEG file starts with SOI marker followed by another marker
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+constexpr std::array<uint8_t, jpeg_sig_size> jpeg_sig = {0xff, 0xd8, 0xff};
+
+// Returns true if the data is a prefix of the signature or the signature is a prefix of the data.
+template <size_t size>
+bool matches_signature(utki::span<const uint8_t> data, const std::array<uint8_t, size>& sig)
+{
+	auto n = std::min(data.size(), sig.size());
+	return std::equal(data.begin(), std::next(data.begin(), ptrdiff_t(n)), sig.begin());
+}
+} // namespace
+
+push_decoder::status push_decoder::push_internal(utki::span<const uint8_t> data)
+{
+	if (!this->codec) {
+		// detect image file format by file signature
+		auto n = std::min(data.size(), png_sig_size - this->signature.size());
+		this->signature.insert(this->signature.end(), data.begin(), std::next(data.begin(), ptrdiff_t(n)));
+		data = data.subspan(n);
+
+		auto sig = utki::make_span(this->signature);
+
+		if (sig.size() >= png_sig_size && matches_signature(sig, png_sig)) {
+			this->codec = internal::make_png_push_codec(*this);
+		} else if (sig.size() >= jpeg_sig_size && matches_signature(sig, jpeg_sig)) {
+			this->codec = internal::make_jpeg_push_codec(*this);
+		} else if (matches_signature(sig, png_sig) || matches_signature(sig, jpeg_sig)) {
+			// not enough data to detect the format yet
+			ASSERT(data.empty())
+			return status::need_more_data;
+		} else {
+			throw std::invalid_argument("rasterimage::push_decoder::push(): unknown image file format");
+		}
+
+		ASSERT(this->codec != nullptr)
+
+		auto signature = std::move(this->signature);
+		if (this->codec->push(signature)) {
+			return status::done;
+		}
+	}
+
+	ASSERT(this->codec != nullptr)
+
+	if (this->codec->push(data)) {
+		return status::done;
+	}
+	return status::need_more_data;
+}
+
+push_decoder::status push_decoder::push(utki::span<const uint8_t> data)
+{
+	switch (this->cur_status) {
+		case status::done:
+			return status::done;
+		case status::failed:
+			throw std::logic_error("rasterimage::push_decoder::push(): decoding has failed previously");
+		case status::need_more_data:
+			break;
+	}
+
+	try {
+		auto s = this->push_internal(data);
+
+		if (this->decoded_info.has_value() && !this->header_reported) {
+			this->header_reported = true;
+			if (this->callbacks.header) {
+				this->callbacks.header(this->decoded_info.value());
+			}
+		}
+
+		if (this->codec) {
+			auto num_scans = this->codec->num_refined_scans();
+			if (num_scans > this->num_reported_scans) {
+				this->num_reported_scans = num_scans;
+				if (this->callbacks.refinement) {
+					this->callbacks.refinement(num_scans);
+				}
+			}
+		}
+
+		uint32_t num_final_rows = [&]() -> uint32_t {
+			if (s == status::done) {
+				return this->decoded_image.dims().y();
+			}
+			if (!this->codec) {
+				return 0;
+			}
+			return this->codec->num_final_rows();
+		}();
+		if (num_final_rows > this->num_reported_rows) {
+			auto begin = this->num_reported_rows;
+			this->num_reported_rows = num_final_rows;
+			if (this->callbacks.rows) {
+				this->callbacks.rows(begin, num_final_rows);
+			}
+		}
+
+		this->cur_status = s;
+	} catch (...) {
+		this->cur_status = status::failed;
+
+		// the callback is allowed to destroy this object, so call it through the local copy
+		auto on_error = this->callbacks.error;
+		if (!on_error) {
+			throw;
+		}
+		on_error(std::current_exception());
+		return status::failed;
+	}
+
+	if (this->cur_status == status::done) {
+		// release codec resources
+		this->codec.reset();
+
+		// the callback is allowed to destroy this object, so call it through the local copy
+		auto on_done = this->callbacks.done;
+		if (on_done) {
+			on_done();
+		}
+		return status::done;
+	}
+
+	return status::need_more_data;
+}
+
+image_variant push_decoder::take_image()
+{
+	if (this->cur_status != status::done) {
+		throw std::logic_error("rasterimage::push_decoder::take_image(): decoding is not complete");
+	}
+	return std::move(this->decoded_image);
+}
@@ -0,0 +1,296 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <utki/span.hpp>
+
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+#	include <coroutine>
+#endif
+
+#include "image_variant.hpp"
+
+namespace rasterimage {
+
+class push_decoder;
+
+namespace internal {
+// Image codec backend of the push_decoder.
+class push_codec
+{
+protected:
+	push_decoder& owner;
+
+	// allocate image to decode pixels into, to be called once the image header is decoded
+	image_variant& allocate_image(const image_info& info);
+
+public:
+	push_codec(push_decoder& owner) :
+		owner(owner)
+	{}
+
+	push_codec(const push_codec&) = delete;
+	push_codec& operator=(const push_codec&) = delete;
+
+	push_codec(push_codec&&) = delete;
+	push_codec& operator=(push_codec&&) = delete;
+
+	virtual ~push_codec() = default;
+
+	// Consume the data completely, buffering it internally if needed.
+	// Returns true if the image is completely decoded.
+	// Throws std::invalid_argument in case of malformed data.
+	virtual bool push(utki::span<const uint8_t> data) = 0;
+
+	// number of rows, counting from the top of the image, which are completely decoded
+	virtual uint32_t num_final_rows() const noexcept = 0;
+
+	// number of scans the current content of the image is reconstructed from,
+	// 0 if the codec does not do progressive refinement
+	virtual unsigned num_refined_scans() const noexcept
+	{
+		return 0;
+	}
+};
+
+std::unique_ptr<push_codec> make_png_push_codec(push_decoder& owner);
+std::unique_ptr<push_codec> make_jpeg_push_codec(push_decoder& owner);
+} // namespace internal
+
+/**
+ * @brief Incremental image decoder.
+ * Push-style decoder which is fed with image file bytes as they arrive, e.g. from network,
+ * and never blocks on I/O, so it is suitable for use from event loops.
+ * Image file format is detected by the file signature from the first pushed bytes.
+ * Supported formats are PNG and JPEG.
+ */
+class push_decoder
+{
+	friend class internal::push_codec;
+
+public:
+	enum class status {
+		/**
+		 * @brief All pushed bytes are consumed, more data is needed to complete the image.
+		 */
+		need_more_data,
+
+		/**
+		 * @brief Image is completely decoded.
+		 */
+		done,
+
+		/**
+		 * @brief Decoding has failed.
+		 */
+		failed
+	};
+
+	/**
+	 * @brief Decoding event callbacks.
+	 * All callbacks are optional and are called from within push().
+	 */
+	struct callbacks_type {
+		/**
+		 * @brief Image header is decoded.
+		 * Called once, before any rows are reported. At this point the image() is allocated.
+		 */
+		std::function<void(const image_info& info)> header;
+
+		/**
+		 * @brief Image rows are completely decoded.
+		 * Rows in range [begin_row, end_row) of the image() are final.
+		 * Rows are reported in order and each row is reported once.
+		 * For interlaced PNG images rows become final only during the last interlacing pass.
+		 */
+		std::function<void(uint32_t begin_row, uint32_t end_row)> rows;
+
+		/**
+		 * @brief Progressive image is refined.
+		 * The whole image() is reconstructed from the progressive JPEG image data received so far,
+		 * so it can be shown as a preview while the rest of the data arrives.
+		 * The num_scans is the number of completely received scans.
+		 * Refinements are only done in case this callback is set before the image header is decoded,
+		 * otherwise progressive JPEG images are reconstructed once all the data has arrived.
+		 * Called at most once per push() call, in case new scans have been completely received,
+		 * which limits the reconstruction work when the data arrives fast.
+		 * The final image is reported with rows and done callbacks, as for any other image.
+		 */
+		std::function<void(unsigned num_scans)> refinement;
+
+		/**
+		 * @brief Image is completely decoded.
+		 * Called as the last thing push() does, so the callback is allowed to destroy the decoder object.
+		 */
+		std::function<void()> done;
+
+		/**
+		 * @brief Decoding error.
+		 * In case this callback is set, push() calls it instead of throwing the decoding error.
+		 * Called as the last thing push() does, so the callback is allowed to destroy the decoder object.
+		 */
+		std::function<void(std::exception_ptr error)> error;
+	};
+
+	callbacks_type callbacks;
+
+private:
+	// bytes accumulated for image file format detection
+	std::vector<uint8_t> signature;
+
+	std::unique_ptr<internal::push_codec> codec;
+
+	std::optional<image_info> decoded_info;
+	bool header_reported = false;
+
+	image_variant decoded_image;
+
+	uint32_t num_reported_rows = 0;
+
+	unsigned num_reported_scans = 0;
+
+	status cur_status = status::need_more_data;
+
+	status push_internal(utki::span<const uint8_t> data);
+
+public:
+	push_decoder() = default;
+
+	push_decoder(const push_decoder&) = delete;
+	push_decoder& operator=(const push_decoder&) = delete;
+
+	push_decoder(push_decoder&&) = delete;
+	push_decoder& operator=(push_decoder&&) = delete;
+
+	~push_decoder();
+
+	/**
+	 * @brief Push image file data to the decoder.
+	 * The data is consumed completely, it does not need to be kept by the caller after the call.
+	 * Pushing data after the image is completely decoded does nothing.
+	 * @param data - next portion of the image file.
+	 * @return Decoding status.
+	 * @throw std::invalid_argument - in case of unknown file format or malformed image data and no error callback set.
+	 * @throw std::logic_error - in case decoding has previously failed.
+	 */
+	status push(utki::span<const uint8_t> data);
+
+	/**
+	 * @brief Get current decoding status.
+	 */
+	status get_status() const noexcept
+	{
+		return this->cur_status;
+	}
+
+	/**
+	 * @brief Get image properties.
+	 * @return Image properties if the header is already decoded, otherwise empty optional.
+	 */
+	const std::optional<image_info>& info() const noexcept
+	{
+		return this->decoded_info;
+	}
+
+	/**
+	 * @brief Get decoded image.
+	 * The image is allocated once the header is decoded and is being filled as the data arrives,
+	 * see callbacks_type::rows.
+	 */
+	const image_variant& image() const noexcept
+	{
+		return this->decoded_image;
+	}
+
+	/**
+	 * @brief Take decoded image out of the decoder.
+	 * @return Decoded image.
+	 * @throw std::logic_error - if decoding is not complete.
+	 */
+	image_variant take_image();
+};
+
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+
+/**
+ * @brief Awaitable for completion of push decoding.
+ * Suspends the awaiting coroutine until the decoder completes or fails.
+ * The coroutine is resumed from within the push_decoder::push() call which completes the image.
+ * The awaitable takes over done and error callbacks of the decoder.
+ * Usage:
+ * @code{.cpp}
+ * rasterimage::push_decoder decoder;
+ * // pass the decoder to the code which pushes the data as it is received
+ * rasterimage::image_variant im = co_await rasterimage::decoded(decoder);
+ * @endcode
+ */
+class decoded
+{
+	push_decoder& decoder;
+	std::exception_ptr error;
+
+public:
+	decoded(push_decoder& decoder) :
+		decoder(decoder)
+	{}
+
+	bool await_ready() const noexcept
+	{
+		return this->decoder.get_status() != push_decoder::status::need_more_data;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle)
+	{
+		this->decoder.callbacks.done = [handle]() {
+			handle.resume();
+		};
+		this->decoder.callbacks.error = [this, handle](std::exception_ptr e) {
+			this->error = std::move(e);
+			handle.resume();
+		};
+	}
+
+	image_variant await_resume()
+	{
+		if (this->error) {
+			std::rethrow_exception(this->error);
+		}
+		// in case the decoder had already failed before awaiting, take_image() throws
+		return this->decoder.take_image();
+	}
+};
+
+#endif
+
+} // namespace rasterimage
@@ -0,0 +1,601 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "qoi.hpp"
+
+#include <array>
+#include <cstring>
+
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+
+#include "instrumentation.hpp"
+
+using namespace rasterimage;
+
+namespace {
+// QOI file layout, see https://qoiformat.org/qoi-specification.pdf
+//   0: magic "qoif"
+//   4: width, uint32, big endian
+//   8: height, uint32, big endian
+//  12: number of channels, uint8, 3 or 4
+//  13: colorspace, uint8, 0 is sRGB with linear alpha, 1 is all channels linear
+// The header is followed by the stream of encoded pixels, terminated by the end marker.
+
+constexpr std::array<uint8_t, 4> qoi_magic = {'q', 'o', 'i', 'f'};
+constexpr size_t qoi_header_size = 14;
+constexpr uint8_t qoi_colorspace_srgb = 0;
+constexpr uint8_t qoi_colorspace_linear = 1;
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+constexpr std::array<uint8_t, 8> qoi_end_marker = {0, 0, 0, 0, 0, 0, 0, 1};
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+constexpr uint8_t qoi_op_index = 0x00;
+constexpr uint8_t qoi_op_diff = 0x40;
+constexpr uint8_t qoi_op_luma = 0x80;
+constexpr uint8_t qoi_op_run = 0xc0;
+constexpr uint8_t qoi_op_rgb = 0xfe;
+constexpr uint8_t qoi_op_rgba = 0xff;
+constexpr uint8_t qoi_op_mask = 0xc0;
+constexpr uint8_t qoi_op_arg_mask = 0x3f;
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+
+// maximal size of single operation, which is QOI_OP_RGBA
+constexpr size_t qoi_max_op_size = 5;
+
+// run length is stored with bias of -1 in 6 bits, values 63 and 64 are occupied by QOI_OP_RGB and QOI_OP_RGBA
+constexpr uint32_t qoi_max_run = 62;
+
+constexpr size_t qoi_index_size = 64;
+
+// files are read and written in chunks of this size
+constexpr size_t qoi_stream_buffer_size = 0x10000;
+
+using pixel_type = r4::vector4<uint8_t>;
+
+size_t qoi_hash(const pixel_type& px) noexcept
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+	return (size_t(px.r()) * 3 + size_t(px.g()) * 5 + size_t(px.b()) * 7 + size_t(px.a()) * 11) % qoi_index_size;
+}
+
+// returns 0 in case QOI does not support the pixel type
+size_t get_qoi_num_channels(format pixel_format, depth channel_depth) noexcept
+{
+	if (channel_depth != depth::uint_8_bit) {
+		return 0;
+	}
+	switch (pixel_format) {
+		case format::rgb:
+			return 3;
+		case format::rgba:
+			return 4;
+		default:
+			return 0;
+	}
+}
+
+struct qoi_header {
+	dimensioned::dimensions_type dims;
+	uint8_t num_channels;
+	uint8_t colorspace;
+
+	format get_format() const noexcept
+	{
+		return this->num_channels == 4 ? format::rgba : format::rgb;
+	}
+
+	image_info get_info() const noexcept
+	{
+		return {this->dims, this->get_format(), depth::uint_8_bit};
+	}
+
+	std::array<uint8_t, qoi_header_size> serialize() const noexcept
+	{
+		std::array<uint8_t, qoi_header_size> ret{};
+		auto p = std::copy(qoi_magic.begin(), qoi_magic.end(), ret.data());
+		p = utki::serialize32be(this->dims.x(), p);
+		p = utki::serialize32be(this->dims.y(), p);
+		*p = this->num_channels;
+		++p;
+		*p = this->colorspace;
+		return ret;
+	}
+
+	// throws std::invalid_argument in case the header is invalid
+	static qoi_header deserialize(utki::span<const uint8_t> buf)
+	{
+		if (buf.size() < qoi_header_size || !std::equal(qoi_magic.begin(), qoi_magic.end(), buf.begin())) {
+			throw std::invalid_argument("rasterimage: not a QOI file");
+		}
+
+		auto p = std::next(buf.data(), qoi_magic.size());
+
+		qoi_header h{};
+		auto width = utki::deserialize32be(p);
+		auto height = utki::deserialize32be(std::next(p, sizeof(uint32_t)));
+		h.dims = {width, height};
+		std::advance(p, sizeof(uint32_t) * 2);
+		h.num_channels = *p;
+		h.colorspace = *std::next(p);
+
+		if ((h.num_channels != 3 && h.num_channels != 4) ||
+			(h.colorspace != qoi_colorspace_srgb && h.colorspace != qoi_colorspace_linear))
+		{
+			throw std::invalid_argument("rasterimage: invalid QOI file header");
+		}
+
+		return h;
+	}
+};
+
+// encoded data which is already in memory
+class memory_source
+{
+public:
+	const uint8_t* p;
+	const uint8_t* end;
+
+	memory_source(utki::span<const uint8_t> data) :
+		p(data.data()),
+		end(std::next(data.data(), ptrdiff_t(data.size())))
+	{}
+
+	void refill() noexcept {}
+};
+
+// encoded data which is read from file in chunks
+class file_source
+{
+	const fsif::file& fi;
+	instrumentation::internal::recorder& rec;
+	std::vector<uint8_t> buffer;
+
+public:
+	const uint8_t* p;
+	const uint8_t* end;
+
+	file_source(const fsif::file& fi, instrumentation::internal::recorder& rec) :
+		fi(fi),
+		rec(rec),
+		buffer(qoi_stream_buffer_size),
+		p(this->buffer.data()),
+		end(this->buffer.data())
+	{}
+
+	void refill()
+	{
+		// move not consumed bytes to the beginning of the buffer and read more after them
+		auto remaining = size_t(this->end - this->p);
+		std::memmove(this->buffer.data(), this->p, remaining);
+
+		auto num_read = this->fi.read(utki::make_span(this->buffer).subspan(remaining));
+		this->rec.add_read(num_read);
+
+		this->p = this->buffer.data();
+		this->end = std::next(this->p, ptrdiff_t(remaining + num_read));
+	}
+};
+
+// make sure that at least given number of bytes is available in the source
+template <typename source_type>
+void ensure_available(source_type& src, size_t num_bytes)
+{
+	if (size_t(src.end - src.p) >= num_bytes) {
+		return;
+	}
+	src.refill();
+	if (size_t(src.end - src.p) < num_bytes) {
+		throw std::invalid_argument("rasterimage::read_qoi(): unexpected end of data");
+	}
+}
+
+template <typename source_type>
+qoi_header read_header(source_type& src)
+{
+	ensure_available(src, qoi_header_size);
+	auto h = qoi_header::deserialize(utki::make_span(src.p, qoi_header_size));
+	std::advance(src.p, qoi_header_size);
+	internal::check_decode_limits(h.get_info());
+	return h;
+}
+
+class qoi_decoder
+{
+	std::array<pixel_type, qoi_index_size> index{};
+	pixel_type px{0, 0, 0, 0xff};
+
+	// number of remaining pixels of the current run
+	uint32_t run = 0;
+
+	void decode_op(const uint8_t*& p) noexcept
+	{
+		// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+		uint8_t b1 = *p;
+		++p;
+
+		if (b1 == qoi_op_rgb) {
+			this->px = {p[0], p[1], p[2], this->px.a()};
+			std::advance(p, 3);
+		} else if (b1 == qoi_op_rgba) {
+			this->px = {p[0], p[1], p[2], p[3]};
+			std::advance(p, 4);
+		} else if ((b1 & qoi_op_mask) == qoi_op_index) {
+			this->px = this->index[b1];
+		} else if ((b1 & qoi_op_mask) == qoi_op_diff) {
+			this->px.r() = uint8_t(this->px.r() + ((b1 >> 4) & 0x03) - 2);
+			this->px.g() = uint8_t(this->px.g() + ((b1 >> 2) & 0x03) - 2);
+			this->px.b() = uint8_t(this->px.b() + (b1 & 0x03) - 2);
+		} else if ((b1 & qoi_op_mask) == qoi_op_luma) {
+			uint8_t b2 = *p;
+			++p;
+			int vg = (b1 & qoi_op_arg_mask) - 32;
+			this->px.r() = uint8_t(this->px.r() + vg - 8 + ((b2 >> 4) & 0x0f));
+			this->px.g() = uint8_t(this->px.g() + vg);
+			this->px.b() = uint8_t(this->px.b() + vg - 8 + (b2 & 0x0f));
+		} else {
+			// current pixel is the first one of the run
+			this->run = b1 & qoi_op_arg_mask;
+		}
+		// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+
+		this->index[qoi_hash(this->px)] = this->px;
+	}
+
+public:
+	template <size_t num_channels, typename source_type>
+	void decode_row(source_type& src, uint8_t* dst, uint32_t width)
+	{
+		for (auto dst_end = std::next(dst, ptrdiff_t(size_t(width) * num_channels)); dst != dst_end;
+			 std::advance(dst, num_channels))
+		{
+			if (this->run != 0) {
+				--this->run;
+			} else {
+				// valid stream is terminated by the end marker, which is longer than any operation,
+				// so decoding of valid stream never requests bytes past the end of the stream
+				ensure_available(src, qoi_max_op_size);
+				this->decode_op(src.p);
+			}
+			std::copy_n(this->px.begin(), num_channels, dst);
+		}
+	}
+};
+
+class qoi_encoder
+{
+	std::array<pixel_type, qoi_index_size> index{};
+	pixel_type prev{0, 0, 0, 0xff};
+
+	// number of pixels equal to the previous one, not yet written
+	uint32_t run = 0;
+
+	uint8_t* write_run(uint8_t* out) noexcept
+	{
+		ASSERT(this->run != 0)
+		*out = uint8_t(qoi_op_run | (this->run - 1));
+		this->run = 0;
+		return std::next(out);
+	}
+
+	uint8_t* write_pixel(const pixel_type& px, uint8_t* out) noexcept
+	{
+		// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+		auto hash = qoi_hash(px);
+		if (this->index[hash] == px) {
+			*out = uint8_t(qoi_op_index | hash);
+			return std::next(out);
+		}
+		this->index[hash] = px;
+
+		if (px.a() != this->prev.a()) {
+			out[0] = qoi_op_rgba;
+			std::copy(px.begin(), px.end(), std::next(out));
+			return std::next(out, 5);
+		}
+
+		// differences wrap around, same as channel values do when decoding
+		auto vr = int8_t(px.r() - this->prev.r());
+		auto vg = int8_t(px.g() - this->prev.g());
+		auto vb = int8_t(px.b() - this->prev.b());
+
+		if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+			*out = uint8_t(qoi_op_diff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+			return std::next(out);
+		}
+
+		int vg_r = vr - vg;
+		int vg_b = vb - vg;
+
+		if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8) {
+			out[0] = uint8_t(qoi_op_luma | (vg + 32));
+			out[1] = uint8_t((vg_r + 8) << 4 | (vg_b + 8));
+			return std::next(out, 2);
+		}
+
+		out[0] = qoi_op_rgb;
+		out[1] = px.r();
+		out[2] = px.g();
+		out[3] = px.b();
+		return std::next(out, 4);
+		// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+	}
+
+public:
+	// maximal number of bytes encode_row() writes
+	static size_t max_row_size(uint32_t width) noexcept
+	{
+		// run which started on previous row can be written in addition to the row pixels
+		return size_t(width) * qoi_max_op_size + 1;
+	}
+
+	template <size_t num_channels>
+	uint8_t* encode_row(const uint8_t* src, uint32_t width, uint8_t* out) noexcept
+	{
+		for (auto src_end = std::next(src, ptrdiff_t(size_t(width) * num_channels)); src != src_end;
+			 std::advance(src, num_channels))
+		{
+			pixel_type px{src[0], src[1], src[2], 0xff};
+			if constexpr (num_channels == 4) {
+				px.a() = src[3];
+			}
+
+			if (px == this->prev) {
+				++this->run;
+				if (this->run == qoi_max_run) {
+					out = this->write_run(out);
+				}
+				continue;
+			}
+
+			if (this->run != 0) {
+				out = this->write_run(out);
+			}
+
+			out = this->write_pixel(px, out);
+			this->prev = px;
+		}
+		return out;
+	}
+
+	// maximal number of bytes finish() writes
+	static constexpr size_t max_finish_size = 1 + qoi_end_marker.size();
+
+	uint8_t* finish(uint8_t* out) noexcept
+	{
+		if (this->run != 0) {
+			out = this->write_run(out);
+		}
+		return std::copy(qoi_end_marker.begin(), qoi_end_marker.end(), out);
+	}
+};
+
+void check_destination(const qoi_header& h, const_any_image_span dst)
+{
+	if (get_qoi_num_channels(dst.get_format(), dst.get_depth()) == 0) {
+		throw std::invalid_argument("rasterimage::read_qoi(): destination image span must be 8 bit RGB or RGBA");
+	}
+	if (dst.dims() != h.dims) {
+		throw std::invalid_argument("destination image span dimensions do not match image dimensions");
+	}
+}
+
+template <typename source_type>
+void decode(source_type& src, any_image_span dst, instrumentation::internal::recorder& rec)
+{
+	rec.start(instrumentation::phase::decode);
+
+	qoi_decoder decoder;
+	bool is_rgba = dst.get_format() == format::rgba;
+	for (uint32_t y = 0; y != dst.dims().y(); ++y) {
+		auto row = dst[y].data();
+		if (is_rgba) {
+			decoder.decode_row<4>(src, row, dst.dims().x());
+		} else {
+			decoder.decode_row<3>(src, row, dst.dims().x());
+		}
+	}
+
+	rec.add_rows(dst.dims().y());
+	rec.finish();
+}
+
+template <typename source_type>
+image_variant decode(source_type& src, const qoi_header& h, instrumentation::internal::recorder& rec)
+{
+	rec.start(instrumentation::phase::allocation);
+
+	image_variant im(h.dims, h.get_format(), depth::uint_8_bit);
+
+	decode(src, im.span(), rec);
+
+	return im;
+}
+
+// flush is called with encoded data chunks
+template <typename flush_type>
+void encode(const_any_image_span span, flush_type flush, instrumentation::internal::recorder& rec)
+{
+	rec.start(instrumentation::phase::header);
+
+	auto num_channels = get_qoi_num_channels(span.get_format(), span.get_depth());
+	if (num_channels == 0) {
+		throw std::invalid_argument("write_qoi(): QOI supports only 8 bit RGB and RGBA images");
+	}
+
+	qoi_header h{span.dims(), uint8_t(num_channels), qoi_colorspace_srgb};
+
+	std::vector<uint8_t> buffer(
+		qoi_stream_buffer_size + std::max(qoi_encoder::max_row_size(span.dims().x()), qoi_encoder::max_finish_size)
+	);
+
+	auto header = h.serialize();
+	auto out = std::copy(header.begin(), header.end(), buffer.data());
+
+	rec.start(instrumentation::phase::encode);
+
+	auto flush_buffer = [&]() {
+		flush(utki::make_span(buffer.data(), size_t(out - buffer.data())));
+		out = buffer.data();
+	};
+
+	qoi_encoder encoder;
+	for (uint32_t y = 0; y != span.dims().y(); ++y) {
+		auto row = span[y].data();
+		if (num_channels == 4) {
+			out = encoder.encode_row<4>(row, span.dims().x(), out);
+		} else {
+			out = encoder.encode_row<3>(row, span.dims().x(), out);
+		}
+
+		if (size_t(out - buffer.data()) >= qoi_stream_buffer_size) {
+			flush_buffer();
+		}
+	}
+	rec.add_rows(span.dims().y());
+
+	out = encoder.finish(out);
+	flush_buffer();
+
+	rec.finish();
+}
+} // namespace
+
+image_info rasterimage::probe_qoi(const fsif::file& fi)
+{
+	instrumentation::internal::recorder rec(instrumentation::operation::read_qoi);
+
+	fsif::file::guard file_guard(fi);
+
+	std::array<uint8_t, qoi_header_size> buf{};
+	auto num_read = fi.read(buf);
+	rec.add_read(num_read);
+
+	return qoi_header::deserialize(utki::make_span(buf.data(), num_read)).get_info();
+}
+
+image_info rasterimage::probe_qoi(utki::span<const uint8_t> data)
+{
+	return qoi_header::deserialize(data).get_info();
+}
+
+image_variant rasterimage::read_qoi(const fsif::file& fi)
+{
+	ASSERT(!fi.is_open())
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_qoi);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(fi);
+
+	file_source src(fi, rec);
+	auto h = read_header(src);
+
+	return decode(src, h, rec);
+}
+
+void rasterimage::read_qoi(const fsif::file& fi, any_image_span dst)
+{
+	ASSERT(!fi.is_open())
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_qoi);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(fi);
+
+	file_source src(fi, rec);
+	auto h = read_header(src);
+	check_destination(h, dst);
+
+	decode(src, dst, rec);
+}
+
+image_variant rasterimage::read_qoi(utki::span<const uint8_t> data)
+{
+	instrumentation::internal::recorder rec(instrumentation::operation::read_qoi);
+	rec.start(instrumentation::phase::header);
+	rec.add_read(data.size());
+
+	memory_source src(data);
+	auto h = read_header(src);
+
+	return decode(src, h, rec);
+}
+
+void rasterimage::read_qoi(utki::span<const uint8_t> data, any_image_span dst)
+{
+	instrumentation::internal::recorder rec(instrumentation::operation::read_qoi);
+	rec.start(instrumentation::phase::header);
+	rec.add_read(data.size());
+
+	memory_source src(data);
+	auto h = read_header(src);
+	check_destination(h, dst);
+
+	decode(src, dst, rec);
+}
+
+void rasterimage::write_qoi(const fsif::file& fi, const_any_image_span span)
+{
+	instrumentation::internal::recorder rec(instrumentation::operation::write_qoi);
+
+	fsif::file::guard file_guard(
+		fi, //
+		fsif::mode::create
+	);
+
+	encode(
+		span,
+		[&](utki::span<const uint8_t> chunk) {
+			auto num_written = fi.write(chunk);
+			rec.add_written(num_written);
+			if (num_written != chunk.size()) {
+				throw std::runtime_error("rasterimage::write_qoi(): could not write to file");
+			}
+		},
+		rec
+	);
+}
+
+std::vector<uint8_t> rasterimage::write_qoi(const_any_image_span span)
+{
+	instrumentation::internal::recorder rec(instrumentation::operation::write_qoi);
+
+	std::vector<uint8_t> ret;
+
+	encode(
+		span,
+		[&](utki::span<const uint8_t> chunk) {
+			ret.insert(ret.end(), chunk.begin(), chunk.end());
+			rec.add_written(chunk.size());
+		},
+		rec
+	);
+
+	return ret;
+}
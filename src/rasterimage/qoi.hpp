@@ -0,0 +1,121 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <vector>
+
+#include <fsif/file.hpp>
+#include <utki/span.hpp>
+
+#include "any_image_span.hpp"
+#include "image_variant.hpp"
+
+namespace rasterimage {
+
+/**
+ * @brief Read QOI image header.
+ * Only reads the file header, pixel data is not decoded.
+ * @param fi - file to read the image header from. File must not be opened.
+ * @return Properties of the image which read_qoi() would return for the file.
+ * @throw std::invalid_argument - in case the file is not a valid QOI file.
+ */
+image_info probe_qoi(const fsif::file& fi);
+
+/**
+ * @brief Read QOI image header from memory.
+ * @param data - QOI file contents.
+ * @return Properties of the image which read_qoi() would return for the data.
+ * @throw std::invalid_argument - in case the data is not a valid QOI file.
+ */
+image_info probe_qoi(utki::span<const uint8_t> data);
+
+/**
+ * @brief Read QOI image.
+ * The file is decoded while it is read, in chunks, so the whole file is never loaded to memory.
+ * The image is decoded to 8 bit RGB or RGBA pixels, depending on the number of channels stored in the file.
+ * Colorspace stored in the file is ignored.
+ * @param fi - file to read the image from. File must not be opened.
+ * @return Image read from the file.
+ * @throw std::invalid_argument - in case the file is not a valid QOI file.
+ * @throw size_limit_error - in case the image exceeds decode limits, see set_decode_limits().
+ */
+image_variant read_qoi(const fsif::file& fi);
+
+/**
+ * @brief Read QOI image to an existing image span.
+ * Unlike read(const fsif::file&, any_image_span), no conversion to other pixel types is done.
+ * QOI decoder produces both RGB and RGBA pixels directly, regardless of the number of channels
+ * stored in the file. Alpha of RGB images is 0xff.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param dst - span to write the image to. Must be 8 bit RGB or RGBA
+ *              and have same dimensions as the image, see probe_qoi().
+ * @throw std::invalid_argument - in case the file is not a valid QOI file,
+ *                                or the destination span does not fit the image.
+ */
+void read_qoi(const fsif::file& fi, any_image_span dst);
+
+/**
+ * @brief Decode QOI image from memory.
+ * Same as read_qoi(const fsif::file&), but the file contents are already in memory.
+ * @param data - QOI file contents.
+ * @return Decoded image.
+ * @throw std::invalid_argument - in case the data is not a valid QOI file.
+ */
+image_variant read_qoi(utki::span<const uint8_t> data);
+
+/**
+ * @brief Decode QOI image from memory to an existing image span.
+ * Same as read_qoi(const fsif::file&, any_image_span), but the file contents are already in memory.
+ * @param data - QOI file contents.
+ * @param dst - span to write the image to. Must be 8 bit RGB or RGBA
+ *              and have same dimensions as the image, see probe_qoi().
+ * @throw std::invalid_argument - in case the data is not a valid QOI file,
+ *                                or the destination span does not fit the image.
+ */
+void read_qoi(utki::span<const uint8_t> data, any_image_span dst);
+
+/**
+ * @brief Write image to QOI file.
+ * The image is encoded while it is written, in chunks, so the whole encoded file is never held in memory.
+ * Colorspace is written as sRGB with linear alpha.
+ * @param fi - file interface for writing the file. Must not be opened. Exisitng file will be overwritten.
+ * @param span - image to write. Must be 8 bit RGB or RGBA.
+ * @throw std::invalid_argument - in case the image has pixel type which QOI does not support.
+ */
+void write_qoi(const fsif::file& fi, const_any_image_span span);
+
+/**
+ * @brief Encode image to QOI file contents in memory.
+ * Same as write_qoi(const fsif::file&, const_any_image_span), but the encoded file is returned.
+ * @param span - image to encode. Must be 8 bit RGB or RGBA.
+ * @return QOI file contents.
+ * @throw std::invalid_argument - in case the image has pixel type which QOI does not support.
+ */
+std::vector<uint8_t> write_qoi(const_any_image_span span);
+
+} // namespace rasterimage
@@ -0,0 +1,611 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "raw.hpp"
+
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <system_error>
+#include <vector>
+
+#include <utki/debug.hpp>
+#include <utki/util.hpp>
+#include <zlib.h>
+
+#if CFG_OS == CFG_OS_WINDOWS
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#include "decode_limits.hpp"
+#include "instrumentation.hpp"
+#include "parallel.hpp"
+
+using namespace rasterimage;
+
+namespace {
+// Raw image file layout, all header values are little endian:
+//   0: signature, 8 bytes
+//   8: version, uint16
+//  10: header size, uint16
+//  12: pixel format, uint8
+//  13: channel depth, uint8
+//  14: compression, uint8
+//  15: byte order of channel values, uint8
+//  16: width, uint32
+//  20: height, uint32
+//  24: row stride in bytes, uint64
+//  32: number of rows per band, uint32, zero for uncompressed data
+//  36: number of bands, uint32
+//  40: offset of pixel data, uint64
+//  48: size of pixel data, uint64
+//  56: reserved, 8 bytes
+// Uncompressed pixel data is rows of stride bytes. Compressed pixel data starts with a table of
+// (offset, size) pairs of uint64 values, one for each band, followed by the compressed bands.
+// Each band decompresses to tightly packed rows, i.e. stride is equal to row size.
+
+constexpr std::array<uint8_t, 8> raw_signature = {0x89, 'R', 'I', 'M', 'G', '\r', '\n', 0x1a};
+constexpr uint16_t raw_version = 1;
+constexpr size_t raw_header_size = 64;
+
+// alignment of uncompressed rows, enough for SIMD loads and to avoid sharing cache lines between rows
+constexpr size_t raw_row_alignment = 64;
+
+// approximate size of uncompressed band, big enough for deflate to be efficient
+constexpr size_t raw_band_size = size_t(1) << 20;
+
+// band table entry is offset and size of the band
+constexpr size_t band_table_entry_size = sizeof(uint64_t) * 2;
+
+constexpr uint8_t raw_little_endian = 1;
+constexpr uint8_t raw_big_endian = 2;
+
+constexpr uint8_t native_byte_order =
+#if CFG_ENDIANNESS == CFG_ENDIANNESS_BIG
+	raw_big_endian;
+#else
+	raw_little_endian;
+#endif
+
+template <typename value_type>
+uint8_t* serialize_le(value_type v, uint8_t* buf) noexcept
+{
+	for (size_t i = 0; i != sizeof(value_type); ++i) {
+		*buf = uint8_t(v >> (i * utki::byte_bits));
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		++buf;
+	}
+	return buf;
+}
+
+template <typename value_type>
+value_type deserialize_le(const uint8_t* buf) noexcept
+{
+	value_type ret = 0;
+	for (size_t i = 0; i != sizeof(value_type); ++i) {
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+		ret |= value_type(buf[i]) << (i * utki::byte_bits);
+	}
+	return ret;
+}
+
+struct raw_header {
+	dimensioned::dimensions_type dims;
+	format pixel_format;
+	depth channel_depth;
+	raw_compression compression;
+	uint8_t byte_order;
+	uint64_t stride;
+	uint32_t band_rows;
+	uint32_t num_bands;
+	uint64_t data_offset;
+	uint64_t data_size;
+
+	size_t pixel_size() const noexcept
+	{
+		return to_num_channels(this->pixel_format) * to_channel_size(this->channel_depth);
+	}
+
+	size_t row_size() const noexcept
+	{
+		return size_t(this->dims.x()) * this->pixel_size();
+	}
+
+	std::array<uint8_t, raw_header_size> serialize() const noexcept
+	{
+		std::array<uint8_t, raw_header_size> ret{};
+		auto p = std::copy(raw_signature.begin(), raw_signature.end(), ret.data());
+		p = serialize_le(raw_version, p);
+		p = serialize_le(uint16_t(raw_header_size), p);
+		p = serialize_le(uint8_t(this->pixel_format), p);
+		p = serialize_le(uint8_t(this->channel_depth), p);
+		p = serialize_le(uint8_t(this->compression), p);
+		p = serialize_le(this->byte_order, p);
+		p = serialize_le(this->dims.x(), p);
+		p = serialize_le(this->dims.y(), p);
+		p = serialize_le(this->stride, p);
+		p = serialize_le(this->band_rows, p);
+		p = serialize_le(this->num_bands, p);
+		p = serialize_le(this->data_offset, p);
+		p = serialize_le(this->data_size, p);
+		ASSERT(p <= std::next(ret.data(), ret.size()))
+		return ret;
+	}
+
+	// throws std::invalid_argument in case the header is invalid
+	static raw_header deserialize(utki::span<const uint8_t> buf)
+	{
+		if (buf.size() < raw_header_size ||
+			!std::equal(raw_signature.begin(), raw_signature.end(), buf.begin()))
+		{
+			throw std::invalid_argument("rasterimage: not a raw image file");
+		}
+
+		auto p = std::next(buf.data(), raw_signature.size());
+		auto read = [&p](auto v) {
+			auto ret = deserialize_le<decltype(v)>(p);
+			std::advance(p, sizeof(v));
+			return ret;
+		};
+
+		if (read(uint16_t()) != raw_version) {
+			throw std::invalid_argument("rasterimage: unsupported raw image file version");
+		}
+		if (read(uint16_t()) != raw_header_size) {
+			throw std::invalid_argument("rasterimage: unexpected raw image file header size");
+		}
+
+		raw_header h{};
+		h.pixel_format = format(read(uint8_t()));
+		h.channel_depth = depth(read(uint8_t()));
+		h.compression = raw_compression(read(uint8_t()));
+		h.byte_order = read(uint8_t());
+		auto width = read(uint32_t());
+		auto height = read(uint32_t());
+		h.dims = {width, height};
+		h.stride = read(uint64_t());
+		h.band_rows = read(uint32_t());
+		h.num_bands = read(uint32_t());
+		h.data_offset = read(uint64_t());
+		h.data_size = read(uint64_t());
+
+		if (h.pixel_format >= format::enum_size || h.channel_depth >= depth::enum_size ||
+			h.compression >= raw_compression::enum_size)
+		{
+			throw std::invalid_argument("rasterimage: invalid raw image file header");
+		}
+
+		if (h.byte_order != native_byte_order) {
+			throw std::invalid_argument("rasterimage: raw image file byte order differs from native one");
+		}
+
+		if (h.data_offset < raw_header_size || h.stride < h.row_size() ||
+			h.stride % to_channel_size(h.channel_depth) != 0)
+		{
+			throw std::invalid_argument("rasterimage: invalid raw image file header");
+		}
+
+		if (h.compression == raw_compression::none) {
+			if (h.dims.y() != 0 &&
+				h.data_size < internal::checked_add(internal::checked_mul(h.stride, h.dims.y() - 1), h.row_size()))
+			{
+				throw std::invalid_argument("rasterimage: raw image file pixel data is too small");
+			}
+		} else if (h.band_rows == 0 || uint64_t(h.num_bands) != (uint64_t(h.dims.y()) + h.band_rows - 1) / h.band_rows) {
+			throw std::invalid_argument("rasterimage: invalid raw image file header");
+		}
+
+		return h;
+	}
+};
+
+void write_bytes(const fsif::file& fi, utki::span<const uint8_t> bytes, instrumentation::internal::recorder& rec)
+{
+	auto num_written = fi.write(bytes);
+	rec.add_written(num_written);
+	if (num_written != bytes.size()) {
+		throw std::runtime_error("rasterimage::write_raw(): could not write to file");
+	}
+}
+
+void read_bytes(const fsif::file& fi, utki::span<uint8_t> bytes, instrumentation::internal::recorder& rec)
+{
+	auto num_read = fi.read(bytes);
+	rec.add_read(num_read);
+	if (num_read != bytes.size()) {
+		throw std::invalid_argument("rasterimage::read_raw(): unexpected end of file");
+	}
+}
+
+// Skips bytes by reading them to the buffer chunk by chunk, so that the amount of memory needed
+// does not depend on the file contents.
+class byte_skipper
+{
+	constexpr static size_t max_chunk_size = 0x10000;
+
+	std::vector<uint8_t> chunk;
+
+public:
+	byte_skipper(uint64_t max_num_bytes) :
+		chunk(size_t(std::min(max_num_bytes, uint64_t(max_chunk_size))))
+	{}
+
+	void skip(const fsif::file& fi, uint64_t num_bytes, instrumentation::internal::recorder& rec)
+	{
+		while (num_bytes != 0) {
+			auto n = size_t(std::min(num_bytes, uint64_t(this->chunk.size())));
+			read_bytes(fi, utki::make_span(this->chunk.data(), n), rec);
+			num_bytes -= n;
+		}
+	}
+};
+
+// Maximal size of zlib compressed data of the given uncompressed size, same as compressBound(),
+// but does not overflow for sizes which do not fit into uLong.
+uint64_t deflate_bound(uint64_t size)
+{
+	// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers)
+	return internal::checked_add(size, (size >> 12) + (size >> 14) + (size >> 25) + 13);
+}
+
+raw_header read_header(const fsif::file& fi, instrumentation::internal::recorder& rec)
+{
+	std::array<uint8_t, raw_header_size> buf{};
+	auto num_read = fi.read(buf);
+	rec.add_read(num_read);
+	return raw_header::deserialize(utki::make_span(buf.data(), num_read));
+}
+} // namespace
+
+void rasterimage::write_raw(
+	const fsif::file& fi,
+	const_any_image_span span,
+	raw_compression compression,
+	unsigned num_threads
+)
+{
+	instrumentation::internal::recorder rec(instrumentation::operation::write_raw);
+	rec.start(instrumentation::phase::header);
+
+	raw_header h{};
+	h.dims = span.dims();
+	h.pixel_format = span.get_format();
+	h.channel_depth = span.get_depth();
+	h.compression = compression;
+	h.byte_order = native_byte_order;
+	h.data_offset = raw_header_size;
+
+	auto row_size = h.row_size();
+
+	if (compression == raw_compression::none) {
+		// stride is also a multiple of pixel size, so that mapped pixels can be accessed via typed image_span
+		auto alignment = std::lcm(raw_row_alignment, h.pixel_size());
+		h.stride = (row_size + alignment - 1) / alignment * alignment;
+		h.data_size = h.stride * h.dims.y();
+	} else if (compression == raw_compression::deflate) {
+		h.stride = row_size;
+		h.band_rows = uint32_t(std::max(raw_band_size / std::max(row_size, size_t(1)), size_t(1)));
+		h.num_bands = uint32_t((uint64_t(h.dims.y()) + h.band_rows - 1) / h.band_rows);
+	} else {
+		throw std::invalid_argument("rasterimage::write_raw(): invalid compression");
+	}
+
+	fsif::file::guard file_guard(
+		fi, //
+		fsif::mode::create
+	);
+
+	if (compression == raw_compression::none) {
+		write_bytes(fi, h.serialize(), rec);
+
+		rec.start(instrumentation::phase::encode);
+
+		std::vector<uint8_t> padding(h.stride - row_size, 0);
+		for (uint32_t y = 0; y != h.dims.y(); ++y) {
+			write_bytes(fi, span[y], rec);
+			write_bytes(fi, padding, rec);
+		}
+		rec.add_rows(h.dims.y());
+		rec.finish();
+		return;
+	}
+
+	rec.start(instrumentation::phase::encode);
+
+	std::vector<std::vector<uint8_t>> bands(h.num_bands);
+
+	// bands are assigned to threads in groups of consecutive bands
+	internal::band_partition partition(h.num_bands, size_t(h.band_rows) * h.dims.x(), num_threads);
+	partition.for_each([&](size_t, size_t begin_band, size_t end_band) {
+		std::vector<uint8_t> rows;
+		for (size_t b = begin_band; b != end_band; ++b) {
+			auto begin_row = uint32_t(b * h.band_rows);
+			auto end_row = std::min(begin_row + h.band_rows, h.dims.y());
+
+			rows.resize(row_size * (end_row - begin_row));
+			for (auto y = begin_row; y != end_row; ++y) {
+				auto row = span[y];
+				std::copy(row.begin(), row.end(), std::next(rows.begin(), ptrdiff_t(row_size * (y - begin_row))));
+			}
+
+			auto& band = bands[b];
+			uLongf compressed_size = compressBound(uLong(rows.size()));
+			band.resize(compressed_size);
+			if (compress2(band.data(), &compressed_size, rows.data(), uLong(rows.size()), Z_BEST_SPEED) != Z_OK) {
+				throw std::runtime_error("rasterimage::write_raw(): compression failed");
+			}
+			band.resize(compressed_size);
+		}
+	});
+
+	// band table, offsets of bands are from the start of the file
+	std::vector<uint8_t> band_table(band_table_entry_size * h.num_bands);
+	uint64_t offset = h.data_offset + band_table.size();
+	auto p = band_table.data();
+	for (const auto& band : bands) {
+		p = serialize_le(offset, p);
+		p = serialize_le(uint64_t(band.size()), p);
+		offset += band.size();
+	}
+
+	h.data_size = offset - h.data_offset;
+
+	write_bytes(fi, h.serialize(), rec);
+	write_bytes(fi, band_table, rec);
+	for (const auto& band : bands) {
+		write_bytes(fi, band, rec);
+	}
+
+	rec.add_rows(h.dims.y());
+	rec.finish();
+}
+
+image_info rasterimage::probe_raw(const fsif::file& fi)
+{
+	instrumentation::internal::recorder rec(instrumentation::operation::read_raw);
+
+	fsif::file::guard file_guard(fi);
+
+	auto h = read_header(fi, rec);
+
+	return {h.dims, h.pixel_format, h.channel_depth};
+}
+
+image_variant rasterimage::read_raw(const fsif::file& fi, unsigned num_threads)
+{
+	ASSERT(!fi.is_open())
+
+	instrumentation::internal::recorder rec(instrumentation::operation::read_raw);
+	rec.start(instrumentation::phase::header);
+
+	fsif::file::guard file_guard(fi);
+
+	auto h = read_header(fi, rec);
+
+	internal::check_decode_limits(h.dims, h.pixel_size());
+
+	if (h.compression == raw_compression::deflate) {
+		// all bands are decompressed directly to the image
+		internal::check_inflate_limit(uint64_t(h.row_size()) * h.dims.y());
+
+		// the compressed data is read into memory as a whole, so check its size before allocating
+		auto band_size = internal::checked_mul(h.row_size(), h.band_rows);
+		auto max_data_size = internal::checked_mul(h.num_bands, band_table_entry_size + deflate_bound(band_size));
+		if (h.data_size > max_data_size) {
+			throw std::invalid_argument("rasterimage::read_raw(): raw image file compressed data is too big");
+		}
+	}
+
+	// skip to the pixel data, in case the header is followed by something
+	byte_skipper(h.data_offset - raw_header_size).skip(fi, h.data_offset - raw_header_size, rec);
+
+	rec.start(instrumentation::phase::allocation);
+
+	image_variant im(h.dims, h.pixel_format, h.channel_depth);
+	auto dst = im.span();
+
+	auto row_size = h.row_size();
+
+	rec.start(instrumentation::phase::decode);
+
+	if (h.compression == raw_compression::none) {
+		auto padding_size = h.stride - row_size;
+		byte_skipper padding(padding_size);
+		for (uint32_t y = 0; y != h.dims.y(); ++y) {
+			read_bytes(fi, dst[y], rec);
+			if (y != h.dims.y() - 1) {
+				padding.skip(fi, padding_size, rec);
+			}
+		}
+		rec.add_rows(h.dims.y());
+		rec.finish();
+		return im;
+	}
+
+	ASSERT(h.compression == raw_compression::deflate)
+
+	// image_variant rows are tightly packed, same as rows of decompressed band
+	ASSERT(dst.empty() || dst.stride_bytes() == row_size)
+
+	std::vector<uint8_t> data(internal::to_size(h.data_size));
+	read_bytes(fi, data, rec);
+
+	if (data.size() < band_table_entry_size * h.num_bands) {
+		throw std::invalid_argument("rasterimage::read_raw(): raw image file band table is truncated");
+	}
+
+	internal::band_partition partition(h.num_bands, size_t(h.band_rows) * h.dims.x(), num_threads);
+	partition.for_each([&](size_t, size_t begin_band, size_t end_band) {
+		for (size_t b = begin_band; b != end_band; ++b) {
+			auto entry = std::next(data.data(), ptrdiff_t(band_table_entry_size * b));
+			auto offset = deserialize_le<uint64_t>(entry);
+			auto size = deserialize_le<uint64_t>(std::next(entry, sizeof(uint64_t)));
+
+			if (offset < h.data_offset || offset - h.data_offset > data.size() ||
+				size > data.size() - (offset - h.data_offset))
+			{
+				throw std::invalid_argument("rasterimage::read_raw(): raw image file band is out of the file");
+			}
+
+			// band_rows comes from the file and may be close to 2^32, so the last row of the band
+			// is computed in 64 bits to not wrap around
+			auto begin_row = uint64_t(b) * h.band_rows;
+			auto end_row = std::min(begin_row + h.band_rows, uint64_t(h.dims.y()));
+
+			uLongf uncompressed_size = uLongf(row_size * size_t(end_row - begin_row));
+			auto expected_size = uncompressed_size;
+			if (uncompress(
+					dst[uint32_t(begin_row)].data(),
+					&uncompressed_size,
+					std::next(data.data(), ptrdiff_t(offset - h.data_offset)),
+					uLong(size)
+				) != Z_OK ||
+				uncompressed_size != expected_size)
+			{
+				throw std::invalid_argument("rasterimage::read_raw(): raw image file band is corrupted");
+			}
+		}
+	});
+
+	rec.add_rows(h.dims.y());
+	rec.finish();
+
+	return im;
+}
+
+mapped_raw_image::mapped_raw_image(const std::string& path)
+{
+#if CFG_OS == CFG_OS_WINDOWS
+	HANDLE file = CreateFileA(
+		path.c_str(),
+		GENERIC_READ,
+		FILE_SHARE_READ,
+		nullptr,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		nullptr
+	);
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::system_error(int(GetLastError()), std::system_category(), std::string("could not open file: ") + path);
+	}
+	utki::scope_exit file_scope_exit([file]() {
+		CloseHandle(file);
+	});
+
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		throw std::system_error(int(GetLastError()), std::system_category(), "could not get file size");
+	}
+	this->size = size_t(file_size.QuadPart);
+
+	if (this->size != 0) {
+		this->mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!this->mapping_handle) {
+			throw std::system_error(int(GetLastError()), std::system_category(), "could not map file");
+		}
+		this->data = static_cast<const uint8_t*>(MapViewOfFile(this->mapping_handle, FILE_MAP_READ, 0, 0, 0));
+		if (!this->data) {
+			auto error = int(GetLastError());
+			CloseHandle(this->mapping_handle);
+			throw std::system_error(error, std::system_category(), "could not map file");
+		}
+	}
+#else
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::system_error(errno, std::generic_category(), "could not open file: " + path);
+	}
+	utki::scope_exit fd_scope_exit([fd]() {
+		close(fd);
+	});
+
+	struct stat st {};
+	if (fstat(fd, &st) != 0) {
+		throw std::system_error(errno, std::generic_category(), "could not get file size");
+	}
+	this->size = size_t(st.st_size);
+
+	if (this->size != 0) {
+		void* p = mmap(nullptr, this->size, PROT_READ, MAP_SHARED, fd, 0);
+		if (p == MAP_FAILED) {
+			throw std::system_error(errno, std::generic_category(), "could not map file");
+		}
+		this->data = static_cast<const uint8_t*>(p);
+	}
+#endif
+
+	// file is mapped, unmap it in case of invalid file
+	utki::scope_exit unmap_scope_exit([this]() {
+		this->unmap();
+	});
+
+	auto h = raw_header::deserialize(utki::make_span(this->data, this->size));
+
+	if (h.compression != raw_compression::none) {
+		throw std::invalid_argument("mapped_raw_image: compressed raw image file cannot be mapped, use read_raw()");
+	}
+
+	if (h.data_offset > this->size || h.data_size > this->size - h.data_offset) {
+		throw std::invalid_argument("mapped_raw_image: raw image file is truncated");
+	}
+
+	this->pixels = const_any_image_span(
+		h.dims,
+		internal::to_size(h.stride),
+		h.pixel_format,
+		h.channel_depth,
+		h.dims.is_any_zero() ? nullptr : std::next(this->data, ptrdiff_t(h.data_offset))
+	);
+
+	unmap_scope_exit.release();
+}
+
+mapped_raw_image::~mapped_raw_image()
+{
+	this->unmap();
+}
+
+void mapped_raw_image::unmap() noexcept
+{
+	if (!this->data) {
+		return;
+	}
+#if CFG_OS == CFG_OS_WINDOWS
+	UnmapViewOfFile(this->data);
+	CloseHandle(this->mapping_handle);
+#else
+	// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast)
+	munmap(const_cast<uint8_t*>(this->data), this->size);
+#endif
+	this->data = nullptr;
+}
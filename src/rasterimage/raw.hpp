@@ -0,0 +1,144 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <string>
+
+#include <fsif/file.hpp>
+#include <utki/config.hpp>
+
+#include "any_image_span.hpp"
+#include "image_variant.hpp"
+
+namespace rasterimage {
+
+/**
+ * @brief Compression of raw image file pixel data.
+ */
+enum class raw_compression {
+	/**
+	 * @brief Rows are stored as is, aligned, so that the file can be memory mapped.
+	 */
+	none,
+
+	/**
+	 * @brief Bands of rows are compressed with deflate independently of each other.
+	 * Bands are compressed and decompressed in parallel.
+	 */
+	deflate,
+
+	enum_size
+};
+
+/**
+ * @brief Write image to raw image file.
+ * Raw image file is a native container for temporary storage of images, e.g. intermediate results
+ * of processing pipeline stages. It consists of a header holding dimensions, pixel format, channel depth
+ * and row stride, followed by pixel rows. Channel values are stored in native byte order.
+ * Uncompressed rows start at 64 byte aligned offsets, so the file can be memory mapped, see mapped_raw_image.
+ * read() and probe() detect raw image files by ".rimg" suffix or by the file signature.
+ * @param fi - file interface for writing the file. Must not be opened. Exisitng file will be overwritten.
+ * @param span - image to write.
+ * @param compression - compression of pixel data.
+ * @param num_threads - maximal number of threads to use for compression.
+ *                      0 means use number of threads supported by hardware.
+ */
+void write_raw(
+	const fsif::file& fi,
+	const_any_image_span span,
+	raw_compression compression = raw_compression::none,
+	unsigned num_threads = 1
+);
+
+/**
+ * @brief Read raw image file header.
+ * @param fi - file to read the image header from. File must not be opened.
+ * @return Properties of the image.
+ * @throw std::invalid_argument - in case the file is not a valid raw image file.
+ */
+image_info probe_raw(const fsif::file& fi);
+
+/**
+ * @brief Read raw image file.
+ * @param fi - file to read the image from. File must not be opened.
+ * @param num_threads - maximal number of threads to use for decompression.
+ *                      0 means use number of threads supported by hardware.
+ * @return Image read from the file.
+ * @throw std::invalid_argument - in case the file is not a valid raw image file,
+ *                                or it was written on a platform with other byte order.
+ * @throw size_limit_error - in case the image exceeds decode limits, see set_decode_limits().
+ */
+image_variant read_raw(const fsif::file& fi, unsigned num_threads = 1);
+
+/**
+ * @brief Memory mapped uncompressed raw image file.
+ * Pixels are accessed directly in the mapped file, without copying.
+ * The pixels are valid while the object exists.
+ */
+class mapped_raw_image
+{
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+
+#if CFG_OS == CFG_OS_WINDOWS
+	void* mapping_handle = nullptr;
+#endif
+
+	const_any_image_span pixels;
+
+	void unmap() noexcept;
+
+public:
+	/**
+	 * @brief Map raw image file.
+	 * @param path - path to the file in the native file system.
+	 * @throw std::system_error - in case the file could not be mapped.
+	 * @throw std::invalid_argument - in case the file is not a valid raw image file, it is compressed,
+	 *                                or it was written on a platform with other byte order.
+	 */
+	mapped_raw_image(const std::string& path);
+
+	mapped_raw_image(const mapped_raw_image&) = delete;
+	mapped_raw_image& operator=(const mapped_raw_image&) = delete;
+
+	mapped_raw_image(mapped_raw_image&&) = delete;
+	mapped_raw_image& operator=(mapped_raw_image&&) = delete;
+
+	~mapped_raw_image();
+
+	/**
+	 * @brief Get the mapped pixels.
+	 * @return Span of the pixels in the mapped file.
+	 */
+	const_any_image_span span() const noexcept
+	{
+		return this->pixels;
+	}
+};
+
+} // namespace rasterimage
@@ -0,0 +1,88 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "shared_image.hpp"
+
+#include <atomic>
+
+using namespace rasterimage;
+
+shared_image::shared_image() :
+	shared_image(image_variant())
+{}
+
+shared_image::shared_image(image_variant&& im) :
+	im(std::make_shared<image_variant>(std::move(im))),
+	region({0, 0}, this->im->dims())
+{}
+
+bool shared_image::is_shared() const noexcept
+{
+	if (this->im.use_count() != 1) {
+		return true;
+	}
+
+	// The use count is read with relaxed memory order. In case other owner of the buffer has just been destroyed
+	// on another thread, its reads of the pixels must happen before the pixels are modified by this thread.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return false;
+}
+
+const_any_image_span shared_image::span() const noexcept
+{
+	return const_any_image_span(std::as_const(*this->im).span()).subspan(this->region);
+}
+
+any_image_span shared_image::span()
+{
+	if (this->is_shared()) {
+		auto copy = std::make_shared<image_variant>(this->to_image_variant());
+		this->im = std::move(copy);
+		this->region.p = {0, 0};
+	}
+
+	return this->im->span().subspan(this->region);
+}
+
+shared_image shared_image::subimage(const r4::rectangle<uint32_t>& rect) const
+{
+	if (!r4::rectangle<uint32_t>({0, 0}, this->dims()).contains(rect)) {
+		throw std::invalid_argument("shared_image::subimage(): region is out of the image");
+	}
+
+	shared_image ret = *this;
+	ret.region.p += rect.p;
+	ret.region.d = rect.d;
+	return ret;
+}
+
+image_variant shared_image::to_image_variant() const
+{
+	image_variant ret(this->dims(), this->get_format(), this->get_depth());
+	convert(this->span(), ret.span());
+	return ret;
+}
@@ -0,0 +1,139 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <memory>
+
+#include <r4/rectangle.hpp>
+
+#include "any_image_span.hpp"
+#include "image_variant.hpp"
+
+namespace rasterimage {
+
+/**
+ * @brief Reference counted image with copy on write.
+ * Copying shared_image does not copy pixels, the copies share the pixel buffer.
+ * Shared pixels are never modified, so the copies can be read from different threads concurrently.
+ * Mutable access to pixels via non-const span() makes a private copy of the pixels
+ * in case the buffer is shared with other shared_image objects.
+ * Same as for other types, a single shared_image object must not be modified from several threads concurrently.
+ *
+ * A shared_image can be a view of a region of another shared_image's pixels, see subimage().
+ * The view keeps the whole pixel buffer alive.
+ */
+class shared_image
+{
+	std::shared_ptr<image_variant> im;
+
+	// region of the image viewed by this object
+	r4::rectangle<uint32_t> region;
+
+	bool is_shared() const noexcept;
+
+public:
+	/**
+	 * @brief Construct empty image.
+	 */
+	shared_image();
+
+	/**
+	 * @brief Construct shared image taking ownership of the image.
+	 * @param im - image to move into the shared image.
+	 */
+	shared_image(image_variant&& im);
+
+	const dimensioned::dimensions_type& dims() const noexcept
+	{
+		return this->region.d;
+	}
+
+	bool empty() const noexcept
+	{
+		return this->region.d.is_any_zero();
+	}
+
+	format get_format() const noexcept
+	{
+		return this->im->get_format();
+	}
+
+	depth get_depth() const noexcept
+	{
+		return this->im->get_depth();
+	}
+
+	size_t num_channels() const noexcept
+	{
+		return this->im->num_channels();
+	}
+
+	/**
+	 * @brief Get number of shared_image objects sharing the pixel buffer.
+	 * Includes views of regions of the buffer.
+	 * In multithreaded environment the value is approximate.
+	 */
+	long use_count() const noexcept
+	{
+		return this->im.use_count();
+	}
+
+	/**
+	 * @brief Get read-only span of the pixels.
+	 * Never copies the pixels.
+	 * @return Span of the pixels.
+	 */
+	const_any_image_span span() const noexcept;
+
+	/**
+	 * @brief Get mutable span of the pixels.
+	 * In case the pixel buffer is shared with other shared_image objects, the pixels viewed by this object
+	 * are copied to a new buffer first, so that modification is not seen by the other objects.
+	 * The returned span is valid until this object is modified, copied or destroyed, since the copy
+	 * shares the buffer and the next call to span() will then make a private copy.
+	 * @return Span of the pixels.
+	 */
+	any_image_span span();
+
+	/**
+	 * @brief Get view of region of the image.
+	 * Does not copy pixels, the view shares the pixel buffer with this image.
+	 * @param rect - region of this image to view.
+	 * @return View of the region.
+	 * @throw std::invalid_argument - in case the region is out of the image.
+	 */
+	shared_image subimage(const r4::rectangle<uint32_t>& rect) const;
+
+	/**
+	 * @brief Copy pixels to image_variant.
+	 * @return Image holding copy of the pixels.
+	 */
+	image_variant to_image_variant() const;
+};
+
+} // namespace rasterimage
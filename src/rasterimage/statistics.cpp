@@ -0,0 +1,101 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#include "statistics.hpp"
+
+#include "image_variant.hpp"
+#include "operations.hpp"
+
+using namespace rasterimage;
+
+statistics<float, 4> rasterimage::get_statistics(const image_variant& im, unsigned num_threads)
+{
+	return std::visit(
+		[&](const auto& image) {
+			using image_type = std::remove_reference_t<decltype(image)>;
+			using value_type = typename image_type::pixel_type::value_type;
+
+			auto s = get_statistics(image.span(), num_threads);
+
+			auto min = to_canonical_order(im.get_format(), to<float>(s.min));
+			auto max = to_canonical_order(im.get_format(), to<float>(s.max));
+			auto mean = to_canonical_order(im.get_format(), s.mean);
+
+			constexpr auto value_max = std::is_integral_v<value_type> ? double(std::numeric_limits<value_type>::max()) : 1.0;
+
+			statistics<float, 4> ret{0, 0, 0};
+			for (size_t c = 0; c != image_type::num_channels; ++c) {
+				ret.min[c] = min[c];
+				ret.max[c] = max[c];
+				ret.mean[c] = mean[c] / value_max;
+			}
+			return ret;
+		},
+		im.variant
+	);
+}
+
+std::vector<std::vector<size_t>> rasterimage::make_histogram(
+	const image_variant& im, //
+	size_t num_bins,
+	unsigned num_threads
+)
+{
+	return std::visit(
+		[&](const auto& image) {
+			using image_type = std::remove_reference_t<decltype(image)>;
+
+			auto h = make_histogram(image.span(), num_bins, num_threads);
+
+			// indices of source channels in the canonical order
+			r4::vector<size_t, image_type::num_channels> indices;
+			for (size_t c = 0; c != image_type::num_channels; ++c) {
+				indices[c] = c;
+			}
+			indices = to_canonical_order(im.get_format(), indices);
+
+			std::vector<std::vector<size_t>> ret;
+			ret.reserve(image_type::num_channels);
+			for (auto i : indices) {
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+				ret.push_back(std::move(h[i]));
+			}
+			return ret;
+		},
+		im.variant
+	);
+}
+
+r4::rectangle<uint32_t> rasterimage::non_transparent_bounding_box(const image_variant& im)
+{
+	return std::visit(
+		[&](const auto& image) {
+			return non_transparent_bounding_box(image.span(), im.get_format());
+		},
+		im.variant
+	);
+}
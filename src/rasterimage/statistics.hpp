@@ -0,0 +1,440 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <r4/rectangle.hpp>
+#include <r4/vector.hpp>
+
+#include "format.hpp"
+#include "image_span.hpp"
+#include "parallel.hpp"
+
+namespace rasterimage {
+
+class image_variant;
+
+/**
+ * @brief Per-channel statistics of an image.
+ */
+template <typename value_type, size_t num_channels>
+struct statistics {
+	r4::vector<value_type, num_channels> min;
+	r4::vector<value_type, num_channels> max;
+	r4::vector<double, num_channels> mean;
+};
+
+/**
+ * @brief Per-channel histogram.
+ * Array of histograms, one for each channel. Each histogram is a vector of pixel counts per bin.
+ */
+template <size_t num_channels>
+using histogram = std::array<std::vector<size_t>, num_channels>;
+
+namespace internal {
+
+template <typename value_type>
+using channel_sum_type = std::conditional_t<std::is_integral_v<value_type>, uint64_t, double>;
+
+template <typename value_type, size_t num_channels>
+struct statistics_accumulator {
+	std::array<value_type, num_channels> min;
+	std::array<value_type, num_channels> max;
+	std::array<channel_sum_type<value_type>, num_channels> sum;
+
+	statistics_accumulator()
+	{
+		this->min.fill(std::numeric_limits<value_type>::max());
+		this->max.fill(std::numeric_limits<value_type>::lowest());
+		this->sum.fill(0);
+	}
+
+	// The loop goes over flat array of channel values and has no branches,
+	// so that compiler can vectorize it.
+	void accumulate_row(
+		const value_type* values, //
+		size_t num_pixels
+	) noexcept
+	{
+		auto mn = this->min;
+		auto mx = this->max;
+		auto sm = this->sum;
+
+		// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic, cppcoreguidelines-pro-bounds-constant-array-index)
+		for (size_t i = 0; i != num_pixels; ++i, values += num_channels) {
+			for (size_t c = 0; c != num_channels; ++c) {
+				auto v = values[c];
+				mn[c] = v < mn[c] ? v : mn[c];
+				mx[c] = v > mx[c] ? v : mx[c];
+				sm[c] += v;
+			}
+		}
+		// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic, cppcoreguidelines-pro-bounds-constant-array-index)
+
+		this->min = mn;
+		this->max = mx;
+		this->sum = sm;
+	}
+
+	void merge(const statistics_accumulator& a) noexcept
+	{
+		for (size_t c = 0; c != num_channels; ++c) {
+			using std::max;
+			using std::min;
+			// NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+			this->min[c] = min(this->min[c], a.min[c]);
+			this->max[c] = max(this->max[c], a.max[c]);
+			this->sum[c] += a.sum[c];
+			// NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+		}
+	}
+};
+
+/**
+ * @brief Make lookup table from channel value to histogram bin.
+ * For integral channel types of up to 16 bits it is cheaper to look up the bin than to calculate it.
+ */
+template <typename value_type>
+std::vector<uint32_t> make_bin_lookup_table(size_t num_bins)
+{
+	static_assert(std::is_integral_v<value_type> && sizeof(value_type) <= sizeof(uint16_t));
+
+	constexpr auto num_values = uint64_t(std::numeric_limits<value_type>::max()) + 1;
+
+	std::vector<uint32_t> ret(num_values);
+	for (uint64_t v = 0; v != num_values; ++v) {
+		ret[v] = uint32_t(v * num_bins / num_values);
+	}
+	return ret;
+}
+
+template <typename value_type>
+size_t to_bin(value_type v, size_t num_bins) noexcept
+{
+	if constexpr (std::is_integral_v<value_type>) {
+		constexpr auto num_values = uint64_t(std::numeric_limits<value_type>::max()) + 1;
+		return size_t(uint64_t(v) * num_bins / num_values);
+	} else {
+		// also handles NaN
+		if (!(v > value_type(0))) {
+			return 0;
+		}
+		return std::min(size_t(v * value_type(num_bins)), num_bins - 1);
+	}
+}
+
+template <typename value_type, size_t num_channels>
+constexpr size_t alpha_channel_index(format pixel_format) noexcept
+{
+	static_assert(num_channels != 3, "no alpha channel");
+	if (pixel_format == format::argb) {
+		return 0;
+	}
+	// for greyscale image treat the grey value as alpha, same as get_alpha() does
+	return num_channels - 1;
+}
+
+/**
+ * @brief Check if there is a non-transparent pixel in a row segment.
+ * The pixels are checked in chunks without branching inside of the chunk,
+ * so that the chunk check can be vectorized. Returns early after first chunk
+ * having a non-transparent pixel.
+ */
+template <size_t num_channels, typename value_type>
+bool has_non_transparent(
+	const r4::vector<value_type, num_channels>* px, //
+	size_t num_pixels,
+	size_t alpha_index
+) noexcept
+{
+	constexpr size_t chunk_size = 64;
+
+	// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+	for (size_t i = 0; i < num_pixels; i += chunk_size) {
+		auto end = std::min(i + chunk_size, num_pixels);
+		unsigned any = 0;
+		for (size_t j = i; j != end; ++j) {
+			any |= unsigned(px[j][alpha_index] != value_type(0));
+		}
+		if (any != 0) {
+			return true;
+		}
+	}
+	// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+	return false;
+}
+
+} // namespace internal
+
+/**
+ * @brief Calculate per-channel minimum, maximum and mean values.
+ * @param span - image span to calculate statistics for.
+ * @param num_threads - maximal number of threads to use. 0 means number of threads supported by hardware.
+ *                      Small images are always processed on the calling thread.
+ * @return Statistics. For empty image span all values are zero.
+ */
+template <typename channel_type, size_t number_of_channels, bool is_const_span>
+statistics<channel_type, number_of_channels> get_statistics(
+	const image_span<channel_type, number_of_channels, is_const_span>& span,
+	unsigned num_threads = 1
+)
+{
+	statistics<channel_type, number_of_channels> ret{channel_type(0), channel_type(0), 0};
+
+	if (span.dims().is_any_zero()) {
+		return ret;
+	}
+
+	using accumulator_type = internal::statistics_accumulator<channel_type, number_of_channels>;
+
+	internal::band_partition bands(span.dims().y(), span.dims().x(), num_threads);
+
+	std::vector<accumulator_type> partials(bands.size());
+
+	bands.for_each([&](size_t band_index, size_t begin_row, size_t end_row) {
+		auto& acc = partials[band_index];
+		for (auto y = begin_row; y != end_row; ++y) {
+			auto row = span[uint32_t(y)];
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+			acc.accumulate_row(reinterpret_cast<const channel_type*>(row.data()), row.size());
+		}
+	});
+
+	auto& total = partials.front();
+	for (auto i = std::next(partials.begin()); i != partials.end(); ++i) {
+		total.merge(*i);
+	}
+
+	auto num_pixels = double(span.dims().x()) * double(span.dims().y());
+
+	for (size_t c = 0; c != number_of_channels; ++c) {
+		// NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+		ret.min[c] = total.min[c];
+		ret.max[c] = total.max[c];
+		ret.mean[c] = double(total.sum[c]) / num_pixels;
+		// NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+	}
+
+	return ret;
+}
+
+/**
+ * @brief Calculate per-channel histograms.
+ * Channel values range is divided into num_bins equal bins. For floating point channel values
+ * the range is [0:1], values out of the range go to the first or the last bin.
+ * @param span - image span to calculate histograms for.
+ * @param num_bins - number of bins in each histogram.
+ * @param num_threads - maximal number of threads to use. 0 means number of threads supported by hardware.
+ *                      Small images are always processed on the calling thread.
+ * @return Histograms of each channel.
+ * @throw std::invalid_argument - if num_bins is zero.
+ */
+template <typename channel_type, size_t number_of_channels, bool is_const_span>
+histogram<number_of_channels> make_histogram(
+	const image_span<channel_type, number_of_channels, is_const_span>& span,
+	size_t num_bins = 256,
+	unsigned num_threads = 1
+)
+{
+	if (num_bins == 0) {
+		throw std::invalid_argument("make_histogram(): num_bins must not be zero");
+	}
+
+	internal::band_partition bands(span.dims().y(), span.dims().x(), num_threads);
+
+	std::vector<histogram<number_of_channels>> partials(bands.size());
+	for (auto& p : partials) {
+		for (auto& h : p) {
+			h.resize(num_bins, 0);
+		}
+	}
+
+	constexpr bool use_lookup_table = std::is_integral_v<channel_type> && sizeof(channel_type) <= sizeof(uint16_t);
+
+	std::vector<uint32_t> lookup_table;
+	if constexpr (use_lookup_table) {
+		lookup_table = internal::make_bin_lookup_table<channel_type>(num_bins);
+	}
+
+	bands.for_each([&](size_t band_index, size_t begin_row, size_t end_row) {
+		auto& hist = partials[band_index];
+		for (auto y = begin_row; y != end_row; ++y) {
+			for (const auto& px : span[uint32_t(y)]) {
+				for (size_t c = 0; c != number_of_channels; ++c) {
+					if constexpr (use_lookup_table) {
+						// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+						++hist[c][lookup_table[px[c]]];
+					} else {
+						// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+						++hist[c][internal::to_bin(px[c], num_bins)];
+					}
+				}
+			}
+		}
+	});
+
+	auto& ret = partials.front();
+	for (auto i = std::next(partials.begin()); i != partials.end(); ++i) {
+		for (size_t c = 0; c != number_of_channels; ++c) {
+			// NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+			std::transform(ret[c].begin(), ret[c].end(), (*i)[c].begin(), ret[c].begin(), std::plus<>());
+			// NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+		}
+	}
+
+	return std::move(ret);
+}
+
+/**
+ * @brief Find bounding box of non-transparent pixels.
+ * Non-transparent pixels are the ones with non-zero alpha as returned by get_alpha().
+ * Rows are scanned from the top and from the bottom until the first non-transparent
+ * pixel is met, then only the parts of the remaining rows which are out of the
+ * current box are scanned for left and right bounds.
+ * @param span - image span to find the bounding box in.
+ * @param pixel_format - pixel format of the span, defines which channel is alpha.
+ *                       Must have number_of_channels channels.
+ * @return Bounding box of non-transparent pixels.
+ *         If all pixels are transparent, then zero rectangle is returned.
+ */
+template <typename channel_type, size_t number_of_channels, bool is_const_span>
+r4::rectangle<uint32_t> non_transparent_bounding_box(
+	const image_span<channel_type, number_of_channels, is_const_span>& span, //
+	format pixel_format = to_format(number_of_channels)
+) noexcept
+{
+	ASSERT(to_num_channels(pixel_format) == number_of_channels)
+
+	const auto& dims = span.dims();
+
+	if constexpr (number_of_channels == 3) {
+		// no alpha channel, all pixels are opaque
+		if (dims.is_any_zero()) {
+			return {0, 0};
+		}
+		return {0, dims};
+	} else {
+		const size_t width = dims.x();
+		const size_t alpha_index = internal::alpha_channel_index<channel_type, number_of_channels>(pixel_format);
+
+		auto row_has_non_transparent = [&](uint32_t y) {
+			return internal::has_non_transparent(span[y].data(), width, alpha_index);
+		};
+
+		uint32_t top = 0;
+		for (; top != dims.y(); ++top) {
+			if (row_has_non_transparent(top)) {
+				break;
+			}
+		}
+
+		if (top == dims.y()) {
+			return {0, 0};
+		}
+
+		uint32_t bottom = dims.y() - 1;
+		for (; bottom != top; --bottom) {
+			if (row_has_non_transparent(bottom)) {
+				break;
+			}
+		}
+
+		size_t left = width;
+		size_t right = 0;
+
+		for (uint32_t y = top; y <= bottom; ++y) {
+			auto row = span[y];
+
+			for (size_t x = 0; x != left; ++x) {
+				if (row[x][alpha_index] != channel_type(0)) {
+					left = x;
+					break;
+				}
+			}
+
+			for (size_t x = width; x > right; --x) {
+				if (row[x - 1][alpha_index] != channel_type(0)) {
+					right = x;
+					break;
+				}
+			}
+
+			if (left == 0 && right == width) {
+				break;
+			}
+		}
+
+		ASSERT(left < right)
+
+		return {
+			{uint32_t(left), top},
+			{uint32_t(right - left), bottom - top + 1}
+		};
+	}
+}
+
+/**
+ * @brief Calculate per-channel minimum, maximum and mean values.
+ * Values of integral channel types are normalized to [0:1] range.
+ * @param im - image to calculate statistics for.
+ * @param num_threads - maximal number of threads to use. 0 means number of threads supported by hardware.
+ * @return Statistics. Channels are in the canonical order of the image format,
+ *         i.e. grey, grey-alpha, RGB or RGBA. Values of channels which the image does not have are zero.
+ */
+statistics<float, 4> get_statistics(const image_variant& im, unsigned num_threads = 1);
+
+/**
+ * @brief Calculate per-channel histograms.
+ * @param im - image to calculate histograms for.
+ * @param num_bins - number of bins in each histogram.
+ * @param num_threads - maximal number of threads to use. 0 means number of threads supported by hardware.
+ * @return Histograms of each channel in the canonical order of the image format,
+ *         i.e. grey, grey-alpha, RGB or RGBA. Number of histograms is the number of image channels.
+ * @throw std::invalid_argument - if num_bins is zero.
+ */
+std::vector<std::vector<size_t>> make_histogram(
+	const image_variant& im, //
+	size_t num_bins = 256,
+	unsigned num_threads = 1
+);
+
+/**
+ * @brief Find bounding box of non-transparent pixels.
+ * @param im - image to find the bounding box in.
+ * @return Bounding box of non-transparent pixels.
+ *         If all pixels are transparent, then zero rectangle is returned.
+ */
+r4::rectangle<uint32_t> non_transparent_bounding_box(const image_variant& im);
+
+} // namespace rasterimage
@@ -0,0 +1,267 @@
+/*
+MIT License
+
+Copyright (c) 2023-2026 Ivan Gagis <igagis@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+/* ================ LICENSE END ================ */
+
+
+#pragma once
+
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include <r4/vector.hpp>
+
+#include "float16.hpp"
+#include "image_span.hpp"
+#include "operations.hpp"
+#include "parallel.hpp"
+
+namespace rasterimage {
+
+/**
+ * @brief Per-pixel operations for use with transform().
+ * Each operation is a function object which takes a pixel and returns a transformed pixel,
+ * possibly of different channel type or number of channels.
+ */
+namespace op {
+
+struct swap_red_blue {
+	template <typename value_type, size_t num_channels>
+	constexpr r4::vector<value_type, num_channels> operator()(r4::vector<value_type, num_channels> px) const
+	{
+		static_assert(num_channels >= 3, "swap_red_blue requires at least 3 channels");
+		using std::swap;
+		swap(px.r(), px.b());
+		return px;
+	}
+};
+
+struct unpremultiply_alpha {
+	template <typename value_type>
+	constexpr r4::vector4<value_type> operator()(const r4::vector4<value_type>& px) const
+	{
+		return rasterimage::unpremultiply_alpha(px);
+	}
+};
+
+struct premultiply_alpha {
+	template <typename value_type>
+	constexpr r4::vector4<value_type> operator()(const r4::vector4<value_type>& px) const
+	{
+		return {
+			multiply(px.r(), px.a()), //
+			multiply(px.g(), px.a()),
+			multiply(px.b(), px.a()),
+			px.a()
+		};
+	}
+};
+
+/**
+ * @brief Convert pixel to another channel type.
+ * @tparam to_value_type - channel type to convert to.
+ */
+template <typename to_value_type>
+struct to {
+	template <typename value_type, size_t num_channels>
+	constexpr r4::vector<to_value_type, num_channels> operator()(const r4::vector<value_type, num_channels>& px
+	) const
+	{
+		return rasterimage::to<to_value_type>(px);
+	}
+};
+
+/**
+ * @brief Rearrange channels.
+ * Result pixel has as many channels as there are indices. Each result channel is a
+ * source channel of corresponding index. E.g. swizzle<2, 1, 0, 3> converts RGBA to BGRA,
+ * swizzle<0, 1, 2> drops alpha channel.
+ * @tparam indices - source channel indices.
+ */
+template <size_t... indices>
+struct swizzle {
+	template <typename value_type, size_t num_channels>
+	constexpr r4::vector<value_type, sizeof...(indices)> operator()(const r4::vector<value_type, num_channels>& px
+	) const
+	{
+		static_assert(((indices < num_channels) && ...), "swizzle index out of range");
+		return {px[indices]...};
+	}
+};
+
+/**
+ * @brief Convert pixel to single channel luminance.
+ */
+struct luminance {
+	template <typename value_type, size_t num_channels>
+	constexpr r4::vector<value_type, 1> operator()(const r4::vector<value_type, num_channels>& px) const
+	{
+		return {rasterimage::luminance(px)};
+	}
+};
+
+} // namespace op
+
+/**
+ * @brief Composition of per-pixel operations.
+ * Calling the composition applies the operations to a pixel one after another, in order of their listing.
+ */
+template <typename... op_types>
+class pipeline
+{
+	std::tuple<op_types...> ops;
+
+	template <size_t index, typename pixel_type>
+	constexpr auto apply(const pixel_type& px) const
+	{
+		if constexpr (index == sizeof...(op_types)) {
+			return std::remove_cv_t<pixel_type>(px);
+		} else {
+			return this->apply<index + 1>(std::get<index>(this->ops)(px));
+		}
+	}
+
+public:
+	constexpr pipeline(op_types... ops) :
+		ops(std::move(ops)...)
+	{}
+
+	template <typename pixel_type>
+	constexpr auto operator()(const pixel_type& px) const
+	{
+		return this->apply<0>(px);
+	}
+};
+
+/**
+ * @brief Compose per-pixel operations.
+ * @param ops - operations to compose, applied in order of listing.
+ * @return Function object applying the operations.
+ */
+template <typename... op_types>
+constexpr pipeline<std::decay_t<op_types>...> compose(op_types&&... ops)
+{
+	return {std::forward<op_types>(ops)...};
+}
+
+namespace internal {
+// whether the operations are a single conversion between single and half precision channels,
+// which is done by bulk converters using F16C instructions when available
+template <typename src_channel_type, typename dst_channel_type, typename... op_types>
+constexpr bool is_half_precision_conversion_v = sizeof...(op_types) == 1 &&
+	((std::is_same_v<src_channel_type, float> && std::is_same_v<dst_channel_type, float16>) ||
+	 (std::is_same_v<src_channel_type, float16> && std::is_same_v<dst_channel_type, float>)) &&
+	(std::is_same_v<std::decay_t<op_types>, op::to<dst_channel_type>> && ...);
+} // namespace internal
+
+/**
+ * @brief Apply per-pixel operations to an image.
+ * All the operations are applied to each pixel in a single pass over the image, without
+ * intermediate images. The composition is resolved at compile time, so the row loop has no indirect
+ * calls and can be auto-vectorized by the compiler.
+ * Source and destination spans can be the same span, in this case the image is transformed in-place.
+ * Overlapping spans which are not the same are not allowed.
+ * @param num_threads - maximal number of threads to use. 0 means use number of threads supported by hardware.
+ * @param src - source image span.
+ * @param dst - destination image span. Must have same dimensions as source.
+ *              Pixel type must match the result of applying the operations to a source pixel.
+ * @param ops - operations to apply, in order of listing. Operations are function objects taking a pixel
+ *              and returning a pixel, e.g. the ones from rasterimage::op namespace, or lambdas.
+ *              Operations may be called concurrently from several threads.
+ */
+template <
+	typename src_channel_type,
+	size_t src_num_channels,
+	bool is_src_const,
+	typename dst_channel_type,
+	size_t dst_num_channels,
+	typename... op_types>
+void transform(
+	unsigned num_threads,
+	image_span<src_channel_type, src_num_channels, is_src_const> src,
+	image_span<dst_channel_type, dst_num_channels> dst,
+	op_types&&... ops
+)
+{
+	auto p = compose(std::forward<op_types>(ops)...);
+
+	using src_pixel_type = r4::vector<src_channel_type, src_num_channels>;
+	using dst_pixel_type = r4::vector<dst_channel_type, dst_num_channels>;
+
+	static_assert(
+		std::is_same_v<decltype(p(std::declval<src_pixel_type>())), dst_pixel_type>,
+		"result of the operations does not match destination pixel type"
+	);
+
+	if (src.dims() != dst.dims()) {
+		throw std::invalid_argument("transform(): source and destination dimensions do not match");
+	}
+
+	internal::band_partition bands(src.dims().y(), src.dims().x(), num_threads);
+
+	bands.for_each([&](size_t, size_t begin_row, size_t end_row) {
+		auto width = size_t(src.dims().x());
+		for (auto y = begin_row; y != end_row; ++y) {
+			const src_pixel_type* s = src[uint32_t(y)].data();
+			dst_pixel_type* d = dst[uint32_t(y)].data();
+			if constexpr (internal::is_half_precision_conversion_v<src_channel_type, dst_channel_type, op_types...>) {
+				// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+				convert(
+					utki::make_span(reinterpret_cast<const src_channel_type*>(s), width * src_num_channels),
+					utki::make_span(reinterpret_cast<dst_channel_type*>(d), width * dst_num_channels)
+				);
+				// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+				continue;
+			}
+			for (size_t x = 0; x != width; ++x) {
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+				d[x] = p(s[x]);
+			}
+		}
+	});
+}
+
+/**
+ * @brief Apply per-pixel operations to an image.
+ * Same as transform(num_threads, src, dst, ops...) with num_threads = 1.
+ */
+template <
+	typename src_channel_type,
+	size_t src_num_channels,
+	bool is_src_const,
+	typename dst_channel_type,
+	size_t dst_num_channels,
+	typename... op_types>
+void transform(
+	image_span<src_channel_type, src_num_channels, is_src_const> src,
+	image_span<dst_channel_type, dst_num_channels> dst,
+	op_types&&... ops
+)
+{
+	transform(1, src, dst, std::forward<op_types>(ops)...);
+}
+
+} // namespace rasterimage
@@ -0,0 +1,514 @@
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <rasterimage/compare.hpp>
+#include <rasterimage/image_variant.hpp>
+#include <rasterimage/orientation.hpp>
+#include <rasterimage/statistics.hpp>
+#include <rasterimage/transform.hpp>
+
+namespace {
+struct config {
+	std::string out_file;
+	std::string baseline_file;
+	std::string filter;
+	double regression_threshold_percent = 10;
+	double min_seconds_per_measurement = 0.2;
+	uint32_t max_size = std::numeric_limits<uint32_t>::max();
+	unsigned num_threads = 1;
+};
+
+struct result {
+	std::string name;
+	std::string type;
+	uint32_t width;
+	uint32_t height;
+	double seconds;
+	double mpix_per_s;
+	double gb_per_s;
+
+	std::string key() const
+	{
+		std::stringstream ss;
+		ss << this->name << " " << this->type << " " << this->width << "x" << this->height;
+		return ss.str();
+	}
+};
+
+// image sizes from L1 cache resident up to 8K
+const std::vector<rasterimage::dimensioned::dimensions_type> sizes = {
+	{  64,   64},
+	{ 256,  256},
+	{1024, 1024},
+	{3840, 2160},
+	{7680, 4320}
+};
+
+template <typename channel_type>
+std::string channel_type_name()
+{
+	if constexpr (std::is_same_v<channel_type, uint8_t>) {
+		return "uint8_t";
+	} else if constexpr (std::is_same_v<channel_type, uint16_t>) {
+		return "uint16_t";
+	} else if constexpr (std::is_same_v<channel_type, float>) {
+		return "float";
+	} else if constexpr (std::is_same_v<channel_type, rasterimage::float16>) {
+		return "float16";
+	} else {
+		return "unknown";
+	}
+}
+
+/**
+ * @brief Measure time of one run of the function.
+ * The function is run repeatedly until minimal total time is spent,
+ * the best time of single run is returned.
+ */
+template <typename function_type>
+double measure(const config& cfg, function_type&& func)
+{
+	using clock_type = std::chrono::steady_clock;
+
+	// warm up caches and page in the memory
+	func();
+
+	constexpr unsigned min_iterations = 3;
+
+	double best = std::numeric_limits<double>::max();
+	double total = 0;
+
+	for (unsigned i = 0; i < min_iterations || total < cfg.min_seconds_per_measurement; ++i) {
+		auto start = clock_type::now();
+		func();
+		double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+		best = std::min(best, seconds);
+		total += seconds;
+	}
+
+	return best;
+}
+
+class runner
+{
+	const config& cfg;
+
+public:
+	std::vector<result> results;
+
+	runner(const config& cfg) :
+		cfg(cfg)
+	{}
+
+	/**
+	 * @param bytes_touched - number of bytes read and written by one run of the function.
+	 */
+	template <typename function_type>
+	void run(
+		const std::string& name,
+		const std::string& type,
+		rasterimage::dimensioned::dimensions_type dims,
+		size_t bytes_touched,
+		function_type&& func
+	)
+	{
+		if (!this->cfg.filter.empty() && (name + " " + type).find(this->cfg.filter) == std::string::npos) {
+			return;
+		}
+
+		double seconds = measure(this->cfg, std::forward<function_type>(func));
+
+		double num_pixels = double(dims.x()) * double(dims.y());
+
+		constexpr double mega = 1e6;
+		constexpr double giga = 1e9;
+
+		result r{
+			name,
+			type,
+			dims.x(),
+			dims.y(),
+			seconds,
+			num_pixels / seconds / mega,
+			double(bytes_touched) / seconds / giga
+		};
+
+		std::cout << std::left << std::setw(36) << r.key() << std::right << std::fixed << std::setprecision(1)
+				  << std::setw(12) << r.mpix_per_s << " MPix/s" << std::setprecision(2) << std::setw(10) << r.gb_per_s
+				  << " GB/s" << std::endl;
+
+		this->results.push_back(std::move(r));
+	}
+};
+
+template <typename image_type>
+void fill_pattern(image_type& img)
+{
+	using value_type = typename image_type::pixel_type::value_type;
+
+	for (uint32_t y = 0; y != img.dims().y(); ++y) {
+		auto row = img[y];
+		for (uint32_t x = 0; x != img.dims().x(); ++x) {
+			for (size_t c = 0; c != image_type::num_channels; ++c) {
+				constexpr unsigned period = 251;
+				row[x][c] = rasterimage::value<value_type>(float((x + y + c) % period) / float(period));
+			}
+		}
+	}
+}
+
+template <typename from_image_type, typename to_channel_type>
+void run_conversion(runner& r, const std::string& type, const from_image_type& src)
+{
+	using from_channel_type = typename from_image_type::pixel_type::value_type;
+	if constexpr (!std::is_same_v<from_channel_type, to_channel_type>) {
+		using to_image_type = rasterimage::image<to_channel_type, from_image_type::num_channels>;
+		to_image_type dst(src.dims());
+
+		r.run(
+			"to_" + channel_type_name<to_channel_type>(),
+			type,
+			src.dims(),
+			src.pixels().size_bytes() + dst.pixels().size_bytes(),
+			[&]() {
+				for (uint32_t y = 0; y != src.dims().y(); ++y) {
+					auto s = src[y];
+					auto d = dst[y];
+					for (size_t x = 0; x != s.size(); ++x) {
+						d[x] = rasterimage::to<to_channel_type>(s[x]);
+					}
+				}
+			}
+		);
+	}
+}
+
+template <typename image_type>
+void run_type(runner& r, const config& cfg)
+{
+	using pixel_type = typename image_type::pixel_type;
+	using channel_type = typename pixel_type::value_type;
+	constexpr auto num_channels = image_type::num_channels;
+
+	const std::string type = channel_type_name<channel_type>() + "_" + std::to_string(num_channels);
+
+	for (const auto& dims : sizes) {
+		if (dims.x() > cfg.max_size || dims.y() > cfg.max_size) {
+			continue;
+		}
+
+		image_type a(dims);
+		fill_pattern(a);
+		image_type b = a;
+
+		const auto bytes = a.pixels().size_bytes();
+
+		r.run("clear", type, dims, bytes, [&]() {
+			b.span().clear(pixel_type(0));
+		});
+
+		r.run("blit", type, dims, bytes * 2, [&]() {
+			b.span().blit(a.span(), {0, 0});
+		});
+
+		r.run("flip_vertical", type, dims, bytes * 2, [&]() {
+			b.span().flip_vertical();
+		});
+
+		r.run("flip_horizontal", type, dims, bytes * 2, [&]() {
+			b.span().flip_horizontal();
+		});
+
+		if constexpr (num_channels >= 3) {
+			r.run("swap_red_blue", type, dims, bytes * 2, [&]() {
+				b.span().swap_red_blue();
+			});
+		}
+
+		if constexpr (num_channels == 4) {
+			r.run("unpremultiply_alpha", type, dims, bytes * 2, [&]() {
+				b = a;
+				b.span().unpremultiply_alpha();
+			});
+
+			// same pipeline as separate passes and as a single fused pass
+			rasterimage::image<float, num_channels> f(dims);
+
+			r.run("bgra_to_float_passes", type, dims, bytes * 5 + f.pixels().size_bytes(), [&]() {
+				b = a;
+				b.span().swap_red_blue();
+				b.span().unpremultiply_alpha();
+				for (uint32_t y = 0; y != dims.y(); ++y) {
+					auto s = b[y];
+					auto d = f[y];
+					for (size_t x = 0; x != s.size(); ++x) {
+						d[x] = rasterimage::to<float>(s[x]);
+					}
+				}
+			});
+
+			r.run("bgra_to_float_fused", type, dims, bytes + f.pixels().size_bytes(), [&]() {
+				rasterimage::transform(
+					cfg.num_threads,
+					a.span(),
+					f.span(),
+					rasterimage::op::swap_red_blue(),
+					rasterimage::op::unpremultiply_alpha(),
+					rasterimage::op::to<float>()
+				);
+			});
+		}
+
+		run_conversion<image_type, uint8_t>(r, type, a);
+		run_conversion<image_type, uint16_t>(r, type, a);
+		run_conversion<image_type, float>(r, type, a);
+		run_conversion<image_type, rasterimage::float16>(r, type, a);
+
+		if constexpr (std::is_same_v<channel_type, float>) {
+			// bulk conversion of whole rows, uses F16C instructions when available
+			rasterimage::image<rasterimage::float16, num_channels> h(dims);
+			r.run("to_float16_transform", type, dims, bytes + h.pixels().size_bytes(), [&]() {
+				rasterimage::transform(a.span(), h.span(), rasterimage::op::to<rasterimage::float16>());
+			});
+		}
+
+		image_type t(rasterimage::dimensioned::dimensions_type{dims.y(), dims.x()});
+
+		r.run("transpose", type, dims, bytes * 2, [&]() {
+			rasterimage::transpose(a.span(), t.span());
+		});
+
+		r.run("rotate_90", type, dims, bytes * 2, [&]() {
+			rasterimage::rotate_90(a.span(), t.span());
+		});
+
+		r.run("get_statistics", type, dims, bytes, [&]() {
+			rasterimage::get_statistics(a.span(), cfg.num_threads);
+		});
+
+		r.run("make_histogram", type, dims, bytes, [&]() {
+			rasterimage::make_histogram(a.span(), 256, cfg.num_threads);
+		});
+
+		b = a;
+		r.run("compare_identical", type, dims, bytes * 2, [&]() {
+			rasterimage::compare(a.span(), b.span(), {false, cfg.num_threads});
+		});
+
+		b.span().clear(pixel_type(0));
+		r.run("compare_different", type, dims, bytes * 2, [&]() {
+			rasterimage::compare(a.span(), b.span(), {false, cfg.num_threads});
+		});
+	}
+}
+
+template <size_t... index>
+void run_all_types(runner& r, const config& cfg, std::index_sequence<index...>)
+{
+	// formats with the same number of channels have the same image type, so only run canonical formats
+	constexpr auto num_formats = size_t(rasterimage::format::enum_size);
+	(
+		[&]() {
+			constexpr auto f = rasterimage::format(index % num_formats);
+			if constexpr (rasterimage::to_canonical(f) == f) {
+				run_type<std::variant_alternative_t<index, rasterimage::image_variant::variant_type>>(r, cfg);
+			}
+		}(),
+		...
+	);
+}
+
+void write_json(const std::vector<result>& results, std::ostream& o)
+{
+	o << "{\n\t\"results\": [\n";
+	for (auto i = results.begin(); i != results.end(); ++i) {
+		// one result per line, this is what read_baseline() relies on
+		o << "\t\t{\"name\": \"" << i->name << "\", \"type\": \"" << i->type << "\", \"width\": " << i->width
+		  << ", \"height\": " << i->height << ", \"seconds\": " << std::scientific << std::setprecision(6)
+		  << i->seconds << ", \"mpix_per_s\": " << std::fixed << std::setprecision(3) << i->mpix_per_s
+		  << ", \"gb_per_s\": " << i->gb_per_s << "}";
+		if (std::next(i) != results.end()) {
+			o << ",";
+		}
+		o << "\n";
+	}
+	o << "\t]\n}\n";
+}
+
+std::string get_json_field(const std::string& line, const std::string& field)
+{
+	auto key = "\"" + field + "\":";
+	auto pos = line.find(key);
+	if (pos == std::string::npos) {
+		throw std::invalid_argument("field not found: " + field);
+	}
+	pos = line.find_first_not_of(" \"", pos + key.size());
+	auto end = line.find_first_of(",\"}", pos);
+	return line.substr(pos, end - pos);
+}
+
+std::map<std::string, result> read_baseline(const std::string& file_name)
+{
+	std::ifstream f(file_name);
+	if (!f) {
+		throw std::runtime_error("could not open baseline file: " + file_name);
+	}
+
+	std::map<std::string, result> ret;
+
+	std::string line;
+	while (std::getline(f, line)) {
+		if (line.find("\"name\":") == std::string::npos) {
+			continue;
+		}
+
+		result r{
+			get_json_field(line, "name"),
+			get_json_field(line, "type"),
+			uint32_t(std::stoul(get_json_field(line, "width"))),
+			uint32_t(std::stoul(get_json_field(line, "height"))),
+			std::stod(get_json_field(line, "seconds")),
+			std::stod(get_json_field(line, "mpix_per_s")),
+			std::stod(get_json_field(line, "gb_per_s"))
+		};
+
+		ret.insert(std::make_pair(r.key(), std::move(r)));
+	}
+
+	return ret;
+}
+
+/**
+ * @return Number of regressions.
+ */
+size_t compare_with_baseline(const std::vector<result>& results, const config& cfg)
+{
+	auto baseline = read_baseline(cfg.baseline_file);
+
+	std::cout << "\ncomparison with baseline " << cfg.baseline_file << ":" << std::endl;
+
+	size_t num_regressions = 0;
+
+	for (const auto& r : results) {
+		auto i = baseline.find(r.key());
+		if (i == baseline.end()) {
+			continue;
+		}
+
+		constexpr double percent = 100;
+
+		double change = (r.mpix_per_s / i->second.mpix_per_s - 1) * percent;
+
+		bool is_regression = change < -cfg.regression_threshold_percent;
+		if (is_regression) {
+			++num_regressions;
+		}
+
+		std::cout << std::left << std::setw(36) << r.key() << std::right << std::fixed << std::setprecision(1)
+				  << std::setw(8) << std::showpos << change << std::noshowpos << "%"
+				  << (is_regression ? "  REGRESSION" : "") << std::endl;
+	}
+
+	std::cout << num_regressions << " regression(s) over " << cfg.regression_threshold_percent << "% threshold"
+			  << std::endl;
+
+	return num_regressions;
+}
+
+void print_help()
+{
+	std::cout << "rasterimage kernels benchmark" << "\n\n";
+	std::cout << "options:" << "\n";
+	std::cout << "  --out <file>           write results to JSON file" << "\n";
+	std::cout << "  --baseline <file>      compare results with previously saved JSON file," << "\n";
+	std::cout << "                         exit code is 1 if there are regressions" << "\n";
+	std::cout << "  --threshold <percent>  regression threshold, default is 10" << "\n";
+	std::cout << "  --filter <substring>   run only benchmarks whose 'name type' contains the substring" << "\n";
+	std::cout << "  --max-size <pixels>    skip image sizes with width or height bigger than that" << "\n";
+	std::cout << "  --min-time <seconds>   minimal time spent on each measurement, default is 0.2" << "\n";
+	std::cout << "  --threads <number>     number of threads for multithreaded kernels, default is 1" << "\n";
+	std::cout << std::flush;
+}
+
+config parse_args(int argc, const char** argv)
+{
+	config cfg;
+
+	auto args = utki::make_span(argv, size_t(argc)).subspan(1);
+
+	for (auto i = args.begin(); i != args.end(); ++i) {
+		std::string arg = *i;
+
+		if (arg == "--help") {
+			print_help();
+			std::exit(0);
+		}
+
+		if (std::next(i) == args.end()) {
+			throw std::invalid_argument("missing value for argument: " + arg);
+		}
+
+		std::string value = *(++i);
+
+		if (arg == "--out") {
+			cfg.out_file = value;
+		} else if (arg == "--baseline") {
+			cfg.baseline_file = value;
+		} else if (arg == "--threshold") {
+			cfg.regression_threshold_percent = std::stod(value);
+		} else if (arg == "--filter") {
+			cfg.filter = value;
+		} else if (arg == "--max-size") {
+			cfg.max_size = uint32_t(std::stoul(value));
+		} else if (arg == "--min-time") {
+			cfg.min_seconds_per_measurement = std::stod(value);
+		} else if (arg == "--threads") {
+			cfg.num_threads = unsigned(std::stoul(value));
+		} else {
+			throw std::invalid_argument("unknown argument: " + arg);
+		}
+	}
+
+	return cfg;
+}
+} // namespace
+
+int main(int argc, const char** argv)
+{
+	try {
+		auto cfg = parse_args(argc, argv);
+
+		runner r(cfg);
+
+		run_all_types(
+			r,
+			cfg,
+			std::make_index_sequence<std::variant_size_v<rasterimage::image_variant::variant_type>>()
+		);
+
+		if (!cfg.out_file.empty()) {
+			std::ofstream f(cfg.out_file);
+			write_json(r.results, f);
+			if (!f) {
+				throw std::runtime_error("could not write results to file: " + cfg.out_file);
+			}
+		}
+
+		if (!cfg.baseline_file.empty()) {
+			if (compare_with_baseline(r.results, cfg) != 0) {
+				return 1;
+			}
+		}
+	} catch (std::exception& e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,416 @@
+#include "corpus.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+
+#include <fsif/native_file.hpp>
+#include <png.h>
+#include <rasterimage/qoi.hpp>
+#include <utki/util.hpp>
+#include <utki/enum_iterable.hpp>
+
+// JPEG lib does not have 'extern "C"{}' :-(
+extern "C" {
+#include <jpeglib.h>
+}
+
+using namespace corpus;
+
+std::string corpus::to_string(content c)
+{
+	switch (c) {
+		case content::photo:
+			return "photo";
+		case content::flat_art:
+			return "flat_art";
+		case content::noise:
+			return "noise";
+		case content::gradient:
+			return "gradient";
+		case content::enum_size:
+			break;
+	}
+	return "unknown";
+}
+
+namespace {
+std::string format_name(rasterimage::format f)
+{
+	switch (f) {
+		case rasterimage::format::grey:
+			return "grey";
+		case rasterimage::format::greya:
+			return "greya";
+		case rasterimage::format::rgb:
+			return "rgb";
+		case rasterimage::format::rgba:
+			return "rgba";
+		case rasterimage::format::bgr:
+			return "bgr";
+		case rasterimage::format::bgra:
+			return "bgra";
+		case rasterimage::format::argb:
+			return "argb";
+		case rasterimage::format::enum_size:
+			break;
+	}
+	return "unknown";
+}
+
+// deterministic pseudo random number generator, same sequence on all platforms
+class xorshift
+{
+	uint32_t state;
+
+public:
+	xorshift(uint32_t seed) :
+		state(seed)
+	{}
+
+	uint32_t next() noexcept
+	{
+		// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+		this->state ^= this->state << 13;
+		this->state ^= this->state >> 17;
+		this->state ^= this->state << 5;
+		// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+		return this->state;
+	}
+
+	float next_float() noexcept
+	{
+		return float(this->next() >> 8) / float(1 << 24);
+	}
+};
+
+/**
+ * @brief Generate RGBA image with channel values in [0:1] range.
+ */
+std::vector<std::array<float, 4>> generate_pixels(content c, rasterimage::dimensioned::dimensions_type dims)
+{
+	std::vector<std::array<float, 4>> ret(size_t(dims.x()) * size_t(dims.y()));
+
+	xorshift rng(0x12345678);
+
+	float w = float(dims.x());
+	float h = float(dims.y());
+
+	// flat art is a set of solid color rectangles
+	struct rect {
+		float x0, y0, x1, y1;
+		std::array<float, 4> color;
+	};
+
+	std::vector<rect> rects;
+	if (c == content::flat_art) {
+		constexpr unsigned num_rects = 40;
+		for (unsigned i = 0; i != num_rects; ++i) {
+			float x0 = rng.next_float() * w;
+			float y0 = rng.next_float() * h;
+			rects.push_back(rect{
+				x0,
+				y0,
+				x0 + rng.next_float() * w / 3,
+				y0 + rng.next_float() * h / 8,
+				{rng.next_float(), rng.next_float(), rng.next_float(), 0.5f + rng.next_float() / 2}
+			});
+		}
+	}
+
+	auto i = ret.begin();
+	for (uint32_t y = 0; y != dims.y(); ++y) {
+		for (uint32_t x = 0; x != dims.x(); ++x, ++i) {
+			auto& px = *i;
+			float fx = float(x) / w;
+			float fy = float(y) / h;
+
+			switch (c) {
+				case content::photo:
+					{
+						// smooth large scale structure with some fine detail and sensor noise
+						constexpr float pi2 = 6.2831853f;
+						float base = 0.5f + 0.25f * std::sin(pi2 * fx * 3) * std::cos(pi2 * fy * 2);
+						float detail = 0.1f * std::sin(pi2 * (fx * 40 + fy * 25));
+						for (size_t ch = 0; ch != 3; ++ch) {
+							float noise = (rng.next_float() - 0.5f) * 0.06f;
+							px[ch] = base + detail * float(ch + 1) / 3 + noise;
+						}
+						px[3] = 0.75f + 0.25f * fx;
+					}
+					break;
+				case content::flat_art:
+					px = {0.95f, 0.95f, 0.95f, 0};
+					for (const auto& r : rects) {
+						if (r.x0 <= float(x) && float(x) < r.x1 && r.y0 <= float(y) && float(y) < r.y1) {
+							px = r.color;
+						}
+					}
+					break;
+				case content::noise:
+					for (auto& ch : px) {
+						ch = rng.next_float();
+					}
+					break;
+				case content::gradient:
+					px = {fx, fy, (fx + fy) / 2, 1 - fx};
+					break;
+				case content::enum_size:
+					break;
+			}
+
+			for (auto& ch : px) {
+				ch = std::min(std::max(ch, 0.0f), 1.0f);
+			}
+		}
+	}
+
+	return ret;
+}
+
+using file_ptr = std::unique_ptr<std::FILE, decltype(&std::fclose)>;
+
+file_ptr open_for_writing(const std::string& path)
+{
+	file_ptr f(std::fopen(path.c_str(), "wb"), &std::fclose);
+	if (!f) {
+		throw std::runtime_error("could not open file for writing: " + path);
+	}
+	return f;
+}
+
+void write_png(const std::string& path, const entry& e, const std::vector<std::array<float, 4>>& pixels)
+{
+	auto num_channels = rasterimage::to_num_channels(e.image_format);
+	bool is_16_bit = e.image_depth == rasterimage::depth::uint_16_bit;
+	size_t bytes_per_channel = is_16_bit ? 2 : 1;
+
+	// pack pixels into PNG row format, 16 bit values are big endian
+	std::vector<uint8_t> data(pixels.size() * num_channels * bytes_per_channel);
+	auto d = data.begin();
+	for (const auto& px : pixels) {
+		// grey is luminance of rgb
+		float grey = 0.2126f * px[0] + 0.7152f * px[1] + 0.0722f * px[2];
+
+		std::array<float, 4> values{};
+		switch (e.image_format) {
+			case rasterimage::format::grey:
+				values = {grey};
+				break;
+			case rasterimage::format::greya:
+				values = {grey, px[3]};
+				break;
+			default:
+				values = px;
+				break;
+		}
+
+		for (size_t c = 0; c != num_channels; ++c) {
+			if (is_16_bit) {
+				auto v = uint16_t(std::lround(values[c] * 0xffff));
+				*d++ = uint8_t(v >> 8);
+				*d++ = uint8_t(v & 0xff);
+			} else {
+				*d++ = uint8_t(std::lround(values[c] * 0xff));
+			}
+		}
+	}
+
+	auto f = open_for_writing(path);
+
+	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	png_infop info_ptr = png_create_info_struct(png_ptr);
+	if (!png_ptr || !info_ptr) {
+		throw std::runtime_error("could not create PNG write structs");
+	}
+	utki::scope_exit png_scope_exit([&]() {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+	});
+
+	png_init_io(png_ptr, f.get());
+
+	int color_type = [&]() {
+		switch (e.image_format) {
+			case rasterimage::format::grey:
+				return PNG_COLOR_TYPE_GRAY;
+			case rasterimage::format::greya:
+				return PNG_COLOR_TYPE_GRAY_ALPHA;
+			case rasterimage::format::rgb:
+				return PNG_COLOR_TYPE_RGB;
+			default:
+				return PNG_COLOR_TYPE_RGB_ALPHA;
+		}
+	}();
+
+	png_set_IHDR(
+		png_ptr,
+		info_ptr,
+		e.dims.x(),
+		e.dims.y(),
+		is_16_bit ? 16 : 8,
+		color_type,
+		e.interlaced ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE,
+		PNG_COMPRESSION_TYPE_BASE,
+		PNG_FILTER_TYPE_BASE
+	);
+
+	png_write_info(png_ptr, info_ptr);
+
+	size_t stride = size_t(e.dims.x()) * num_channels * bytes_per_channel;
+	std::vector<png_bytep> rows(e.dims.y());
+	for (size_t y = 0; y != rows.size(); ++y) {
+		rows[y] = &data[y * stride];
+	}
+
+	// png_write_image() handles interlacing passes itself
+	png_write_image(png_ptr, rows.data());
+	png_write_end(png_ptr, nullptr);
+}
+
+void write_jpeg(const std::string& path, const entry& e, const std::vector<std::array<float, 4>>& pixels)
+{
+	bool is_grey = e.image_format == rasterimage::format::grey;
+	size_t num_channels = is_grey ? 1 : 3;
+
+	std::vector<uint8_t> data(pixels.size() * num_channels);
+	auto d = data.begin();
+	for (const auto& px : pixels) {
+		if (is_grey) {
+			*d++ = uint8_t(std::lround((0.2126f * px[0] + 0.7152f * px[1] + 0.0722f * px[2]) * 0xff));
+		} else {
+			for (size_t c = 0; c != 3; ++c) {
+				*d++ = uint8_t(std::lround(px[c] * 0xff));
+			}
+		}
+	}
+
+	auto f = open_for_writing(path);
+
+	jpeg_compress_struct cinfo{};
+	jpeg_error_mgr jerr{};
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	utki::scope_exit cinfo_scope_exit([&cinfo]() {
+		jpeg_destroy_compress(&cinfo);
+	});
+
+	jpeg_stdio_dest(&cinfo, f.get());
+
+	cinfo.image_width = e.dims.x();
+	cinfo.image_height = e.dims.y();
+	cinfo.input_components = int(num_channels);
+	cinfo.in_color_space = is_grey ? JCS_GRAYSCALE : JCS_RGB;
+
+	jpeg_set_defaults(&cinfo);
+
+	constexpr int quality = 90;
+	jpeg_set_quality(&cinfo, quality, TRUE);
+
+	if (e.interlaced) {
+		jpeg_simple_progression(&cinfo);
+	}
+
+	if (e.restart_markers) {
+		cinfo.restart_in_rows = 1;
+	}
+
+	jpeg_start_compress(&cinfo, TRUE);
+
+	size_t stride = size_t(e.dims.x()) * num_channels;
+	while (cinfo.next_scanline < cinfo.image_height) {
+		JSAMPROW row = &data[cinfo.next_scanline * stride];
+		jpeg_write_scanlines(&cinfo, &row, 1);
+	}
+
+	jpeg_finish_compress(&cinfo);
+}
+
+// QOI does not need external library, so the corpus file is written by rasterimage's own encoder
+void write_qoi(const std::string& path, const entry& e, const std::vector<std::array<float, 4>>& pixels)
+{
+	bool is_rgba = e.image_format == rasterimage::format::rgba;
+	size_t num_channels = is_rgba ? 4 : 3;
+
+	rasterimage::image_variant im(e.dims, e.image_format, rasterimage::depth::uint_8_bit);
+	auto span = im.span();
+
+	auto p = pixels.begin();
+	for (uint32_t y = 0; y != e.dims.y(); ++y) {
+		auto d = span[y].begin();
+		for (uint32_t x = 0; x != e.dims.x(); ++x, ++p) {
+			for (size_t c = 0; c != num_channels; ++c) {
+				*d++ = uint8_t(std::lround((*p)[c] * 0xff));
+			}
+		}
+	}
+
+	rasterimage::write_qoi(fsif::native_file(path), span);
+}
+} // namespace
+
+std::vector<entry> corpus::make_list(rasterimage::dimensioned::dimensions_type dims)
+{
+	std::vector<entry> ret;
+
+	for (auto c : utki::enum_iterable_v<content>) {
+		for (auto f : utki::enum_iterable_v<rasterimage::format>) {
+			for (auto d : {rasterimage::depth::uint_8_bit, rasterimage::depth::uint_16_bit}) {
+				for (bool interlaced : {false, true}) {
+					std::string name = to_string(c) + "_" + format_name(f) + "_" +
+						(d == rasterimage::depth::uint_8_bit ? "8" : "16") + (interlaced ? "_interlaced" : "") + ".png";
+					ret.push_back({name, codec::png, c, f, d, interlaced, dims});
+				}
+			}
+		}
+
+		for (auto f : {rasterimage::format::grey, rasterimage::format::rgb}) {
+			for (bool progressive : {false, true}) {
+				std::string name = to_string(c) + "_" + format_name(f) + (progressive ? "_progressive" : "") + ".jpg";
+				ret.push_back({name, codec::jpeg, c, f, rasterimage::depth::uint_8_bit, progressive, dims});
+			}
+
+			std::string name = to_string(c) + "_" + format_name(f) + "_restart.jpg";
+			ret.push_back({name, codec::jpeg, c, f, rasterimage::depth::uint_8_bit, false, dims, true});
+		}
+
+		for (auto f : {rasterimage::format::rgb, rasterimage::format::rgba}) {
+			std::string name = to_string(c) + "_" + format_name(f) + ".qoi";
+			ret.push_back({name, codec::qoi, c, f, rasterimage::depth::uint_8_bit, false, dims});
+		}
+	}
+
+	return ret;
+}
+
+void corpus::generate(const std::string& dir, const std::vector<entry>& entries)
+{
+	content current_content = content::enum_size;
+	std::vector<std::array<float, 4>> pixels;
+
+	for (const auto& e : entries) {
+		auto path = (std::filesystem::path(dir) / e.file_name).string();
+		if (std::filesystem::exists(path)) {
+			continue;
+		}
+
+		if (e.image_content != current_content) {
+			pixels = generate_pixels(e.image_content, e.dims);
+			current_content = e.image_content;
+		}
+
+		switch (e.file_codec) {
+			case codec::png:
+				write_png(path, e, pixels);
+				break;
+			case codec::jpeg:
+				write_jpeg(path, e, pixels);
+				break;
+			case codec::qoi:
+				write_qoi(path, e, pixels);
+				break;
+		}
+	}
+}
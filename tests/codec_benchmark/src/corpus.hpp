@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <rasterimage/image_variant.hpp>
+
+namespace corpus {
+
+enum class content {
+	photo,
+	flat_art,
+	noise,
+	gradient,
+
+	enum_size
+};
+
+enum class codec {
+	png,
+	jpeg,
+	qoi
+};
+
+struct entry {
+	std::string file_name;
+	codec file_codec;
+	content image_content;
+	rasterimage::format image_format;
+	rasterimage::depth image_depth;
+	bool interlaced; // Adam7 for PNG, progressive for JPEG
+	rasterimage::dimensioned::dimensions_type dims;
+	bool restart_markers = false; // restart marker after every MCU row, for JPEG
+};
+
+/**
+ * @brief Get list of corpus entries.
+ * @param dims - dimensions of corpus images.
+ */
+std::vector<entry> make_list(rasterimage::dimensioned::dimensions_type dims);
+
+/**
+ * @brief Generate corpus image files.
+ * Images are generated deterministically, so the same corpus is produced on every run.
+ * Existing files are not regenerated.
+ * @param dir - directory to write files to. Must exist.
+ * @param entries - entries to generate.
+ */
+void generate(const std::string& dir, const std::vector<entry>& entries);
+
+std::string to_string(content c);
+
+} // namespace corpus
@@ -0,0 +1,469 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fsif/native_file.hpp>
+#include <fsif/memory_file.hpp>
+#include <rasterimage/image_variant.hpp>
+#include <rasterimage/qoi.hpp>
+#include <sys/resource.h>
+
+#include "corpus.hpp"
+
+namespace {
+struct config {
+	std::string corpus_dir = "codec_corpus";
+	std::string out_file;
+	std::string baseline_file;
+	std::string filter;
+	double regression_threshold_percent = 10;
+	double min_seconds_per_measurement = 0.2;
+	rasterimage::dimensioned::dimensions_type dims = {1920, 1080};
+};
+
+struct result {
+	std::string name;
+	std::string file;
+	double seconds;
+	double mpix_per_s;
+	double compressed_mb_per_s;
+	double compression_ratio;
+	size_t peak_rss_kb;
+
+	std::string key() const
+	{
+		return this->name + " " + this->file;
+	}
+};
+
+/**
+ * @brief Reset peak resident set size counter of the process.
+ * Only supported on Linux, on other systems the peak value is not reset
+ * and reported numbers are the peak over the whole process run.
+ */
+void reset_peak_rss()
+{
+	// writing "5" to clear_refs resets the VmHWM value
+	std::ofstream f("/proc/self/clear_refs");
+	f << "5";
+}
+
+/**
+ * @return Peak resident set size in kilobytes.
+ */
+size_t get_peak_rss_kb()
+{
+	std::ifstream f("/proc/self/status");
+	std::string line;
+	while (std::getline(f, line)) {
+		const std::string key = "VmHWM:";
+		if (line.compare(0, key.size(), key) == 0) {
+			return std::stoul(line.substr(key.size()));
+		}
+	}
+
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return size_t(usage.ru_maxrss);
+}
+
+/**
+ * @brief Measure time of one run of the function.
+ * The function is run repeatedly until minimal total time is spent,
+ * the best time of single run is returned.
+ */
+template <typename function_type>
+double measure(const config& cfg, function_type&& func)
+{
+	using clock_type = std::chrono::steady_clock;
+
+	// warm up caches and page in the file
+	func();
+
+	constexpr unsigned min_iterations = 3;
+
+	double best = std::numeric_limits<double>::max();
+	double total = 0;
+
+	for (unsigned i = 0; i < min_iterations || total < cfg.min_seconds_per_measurement; ++i) {
+		auto start = clock_type::now();
+		func();
+		double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+		best = std::min(best, seconds);
+		total += seconds;
+	}
+
+	return best;
+}
+
+class runner
+{
+	const config& cfg;
+
+public:
+	std::vector<result> results;
+
+	runner(const config& cfg) :
+		cfg(cfg)
+	{}
+
+	/**
+	 * @param raw_size - size of decoded image in bytes.
+	 * @param compressed_size - size of encoded image file in bytes.
+	 */
+	template <typename function_type>
+	void run(
+		const std::string& name,
+		const corpus::entry& e,
+		size_t raw_size,
+		size_t compressed_size,
+		function_type&& func
+	)
+	{
+		if (!this->cfg.filter.empty() && (name + " " + e.file_name).find(this->cfg.filter) == std::string::npos) {
+			return;
+		}
+
+		reset_peak_rss();
+
+		double seconds = measure(this->cfg, std::forward<function_type>(func));
+
+		double num_pixels = double(e.dims.x()) * double(e.dims.y());
+
+		constexpr double mega = 1e6;
+
+		result r{
+			name,
+			e.file_name,
+			seconds,
+			num_pixels / seconds / mega,
+			double(compressed_size) / seconds / mega,
+			double(raw_size) / double(compressed_size),
+			get_peak_rss_kb()
+		};
+
+		std::cout << std::left << std::setw(48) << r.key() << std::right << std::fixed << std::setprecision(1)
+				  << std::setw(10) << r.mpix_per_s << " MPix/s" << std::setw(10) << r.compressed_mb_per_s << " MB/s"
+				  << std::setprecision(2) << std::setw(8) << r.compression_ratio << " ratio" << std::setw(10)
+				  << r.peak_rss_kb << " KiB peak RSS" << std::endl;
+
+		this->results.push_back(std::move(r));
+	}
+};
+
+std::vector<uint8_t> load_file(const std::string& path)
+{
+	std::ifstream f(path, std::ios::binary);
+	return {std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>()};
+}
+
+void run_entry(runner& r, const config& cfg, const corpus::entry& e)
+{
+	auto path = (std::filesystem::path(cfg.corpus_dir) / e.file_name).string();
+
+	auto data = load_file(path);
+	if (data.empty()) {
+		throw std::runtime_error("could not load corpus file: " + path);
+	}
+
+	auto read = [&e](const fsif::file& fi) {
+		switch (e.file_codec) {
+			case corpus::codec::png:
+				return rasterimage::read_png(fi);
+			case corpus::codec::qoi:
+				return rasterimage::read_qoi(fi);
+			case corpus::codec::jpeg:
+				break;
+		}
+		return rasterimage::read_jpeg(fi);
+	};
+
+	auto decoded = read(fsif::native_file(path));
+
+	// raw size of decoded image in bytes
+	size_t raw_size = std::visit(
+		[](const auto& img) {
+			return img.pixels().size_bytes();
+		},
+		decoded.variant
+	);
+
+	r.run("decode_file", e, raw_size, data.size(), [&]() {
+		read(fsif::native_file(path));
+	});
+
+	r.run("decode_memory", e, raw_size, data.size(), [&]() {
+		read(fsif::memory_file(data));
+	});
+
+	// e.g. for uploading to GPU, conversion is done by the codec while decoding
+	r.run("decode_file_rgba8", e, raw_size, data.size(), [&]() {
+		rasterimage::read(fsif::native_file(path), rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+	});
+
+	if (e.file_codec == corpus::codec::jpeg) {
+		// parallel decoding only makes difference for images with restart markers
+		r.run("decode_file_mt", e, raw_size, data.size(), [&]() {
+			rasterimage::read_jpeg(fsif::native_file(path), 0);
+		});
+
+		if (e.interlaced) {
+			// first scan of progressive image, DC coefficients only
+			r.run("decode_preview", e, raw_size, data.size(), [&]() {
+				rasterimage::read_jpeg_preview(fsif::native_file(path), 1);
+			});
+		}
+	}
+
+	if (e.file_codec == corpus::codec::qoi) {
+		// decoding from memory without file interface
+		r.run("decode_span", e, raw_size, data.size(), [&]() {
+			rasterimage::read_qoi(utki::make_span(data));
+		});
+	}
+
+	// QOI only supports 8 bit RGB and RGBA images, compare with PNG encoding of same images
+	if ((decoded.get_format() == rasterimage::format::rgb || decoded.get_format() == rasterimage::format::rgba) &&
+		decoded.get_depth() == rasterimage::depth::uint_8_bit)
+	{
+		size_t encoded_size = rasterimage::write_qoi(decoded.span()).size();
+
+		r.run("encode_qoi", e, raw_size, encoded_size, [&]() {
+			fsif::memory_file fi;
+			rasterimage::write_qoi(fi, decoded.span());
+		});
+
+		r.run("encode_qoi_memory", e, raw_size, encoded_size, [&]() {
+			rasterimage::write_qoi(decoded.span());
+		});
+	}
+
+	// image_variant::write_png() only supports 8 bit RGBA images for now
+	if (decoded.get_format() == rasterimage::format::rgba && decoded.get_depth() == rasterimage::depth::uint_8_bit) {
+		fsif::memory_file encoded;
+		decoded.write_png(encoded);
+
+		size_t encoded_size = encoded.reset_data().size();
+
+		r.run("encode_png", e, raw_size, encoded_size, [&]() {
+			fsif::memory_file fi;
+			decoded.write_png(fi);
+		});
+	}
+
+	// multithreaded encoder supports all integer formats
+	if (decoded.get_depth() != rasterimage::depth::float_32_bit) {
+		fsif::memory_file encoded;
+		decoded.write_png(encoded, 0);
+
+		size_t encoded_size = encoded.reset_data().size();
+
+		r.run("encode_png_mt", e, raw_size, encoded_size, [&]() {
+			fsif::memory_file fi;
+			decoded.write_png(fi, 0);
+		});
+	}
+}
+
+void write_json(const std::vector<result>& results, std::ostream& o)
+{
+	o << "{\n\t\"results\": [\n";
+	for (auto i = results.begin(); i != results.end(); ++i) {
+		// one result per line, this is what read_baseline() relies on
+		o << "\t\t{\"name\": \"" << i->name << "\", \"file\": \"" << i->file << "\", \"seconds\": "
+		  << std::scientific << std::setprecision(6) << i->seconds << ", \"mpix_per_s\": " << std::fixed
+		  << std::setprecision(3) << i->mpix_per_s << ", \"compressed_mb_per_s\": " << i->compressed_mb_per_s
+		  << ", \"compression_ratio\": " << i->compression_ratio << ", \"peak_rss_kb\": " << i->peak_rss_kb << "}";
+		if (std::next(i) != results.end()) {
+			o << ",";
+		}
+		o << "\n";
+	}
+	o << "\t]\n}\n";
+}
+
+std::string get_json_field(const std::string& line, const std::string& field)
+{
+	auto key = "\"" + field + "\":";
+	auto pos = line.find(key);
+	if (pos == std::string::npos) {
+		throw std::invalid_argument("field not found: " + field);
+	}
+	pos = line.find_first_not_of(" \"", pos + key.size());
+	auto end = line.find_first_of(",\"}", pos);
+	return line.substr(pos, end - pos);
+}
+
+std::map<std::string, result> read_baseline(const std::string& file_name)
+{
+	std::ifstream f(file_name);
+	if (!f) {
+		throw std::runtime_error("could not open baseline file: " + file_name);
+	}
+
+	std::map<std::string, result> ret;
+
+	std::string line;
+	while (std::getline(f, line)) {
+		if (line.find("\"name\":") == std::string::npos) {
+			continue;
+		}
+
+		result r{
+			get_json_field(line, "name"),
+			get_json_field(line, "file"),
+			std::stod(get_json_field(line, "seconds")),
+			std::stod(get_json_field(line, "mpix_per_s")),
+			std::stod(get_json_field(line, "compressed_mb_per_s")),
+			std::stod(get_json_field(line, "compression_ratio")),
+			std::stoul(get_json_field(line, "peak_rss_kb"))
+		};
+
+		ret.insert(std::make_pair(r.key(), std::move(r)));
+	}
+
+	return ret;
+}
+
+/**
+ * @return Number of regressions.
+ */
+size_t compare_with_baseline(const std::vector<result>& results, const config& cfg)
+{
+	auto baseline = read_baseline(cfg.baseline_file);
+
+	std::cout << "\ncomparison with baseline " << cfg.baseline_file << ":" << std::endl;
+
+	size_t num_regressions = 0;
+
+	for (const auto& r : results) {
+		auto i = baseline.find(r.key());
+		if (i == baseline.end()) {
+			continue;
+		}
+
+		constexpr double percent = 100;
+
+		double change = (r.mpix_per_s / i->second.mpix_per_s - 1) * percent;
+
+		bool is_regression = change < -cfg.regression_threshold_percent;
+		if (is_regression) {
+			++num_regressions;
+		}
+
+		std::cout << std::left << std::setw(48) << r.key() << std::right << std::fixed << std::setprecision(1)
+				  << std::setw(8) << std::showpos << change << std::noshowpos << "%"
+				  << (is_regression ? "  REGRESSION" : "") << std::endl;
+	}
+
+	std::cout << num_regressions << " regression(s) over " << cfg.regression_threshold_percent << "% threshold"
+			  << std::endl;
+
+	return num_regressions;
+}
+
+void print_help()
+{
+	std::cout << "rasterimage codecs benchmark" << "\n\n";
+	std::cout << "options:" << "\n";
+	std::cout << "  --corpus <dir>         directory of generated image corpus, default is 'codec_corpus'," << "\n";
+	std::cout << "                         missing corpus files are generated" << "\n";
+	std::cout << "  --size <w>x<h>         dimensions of corpus images, default is 1920x1080" << "\n";
+	std::cout << "  --out <file>           write results to JSON file" << "\n";
+	std::cout << "  --baseline <file>      compare results with previously saved JSON file," << "\n";
+	std::cout << "                         exit code is 1 if there are regressions" << "\n";
+	std::cout << "  --threshold <percent>  regression threshold, default is 10" << "\n";
+	std::cout << "  --filter <substring>   run only benchmarks whose 'name file' contains the substring" << "\n";
+	std::cout << "  --min-time <seconds>   minimal time spent on each measurement, default is 0.2" << "\n";
+	std::cout << std::flush;
+}
+
+config parse_args(int argc, const char** argv)
+{
+	config cfg;
+
+	auto args = utki::make_span(argv, size_t(argc)).subspan(1);
+
+	for (auto i = args.begin(); i != args.end(); ++i) {
+		std::string arg = *i;
+
+		if (arg == "--help") {
+			print_help();
+			std::exit(0);
+		}
+
+		if (std::next(i) == args.end()) {
+			throw std::invalid_argument("missing value for argument: " + arg);
+		}
+
+		std::string value = *(++i);
+
+		if (arg == "--corpus") {
+			cfg.corpus_dir = value;
+		} else if (arg == "--size") {
+			auto x_pos = value.find('x');
+			if (x_pos == std::string::npos) {
+				throw std::invalid_argument("malformed --size value: " + value);
+			}
+			cfg.dims = {uint32_t(std::stoul(value.substr(0, x_pos))), uint32_t(std::stoul(value.substr(x_pos + 1)))};
+		} else if (arg == "--out") {
+			cfg.out_file = value;
+		} else if (arg == "--baseline") {
+			cfg.baseline_file = value;
+		} else if (arg == "--threshold") {
+			cfg.regression_threshold_percent = std::stod(value);
+		} else if (arg == "--filter") {
+			cfg.filter = value;
+		} else if (arg == "--min-time") {
+			cfg.min_seconds_per_measurement = std::stod(value);
+		} else {
+			throw std::invalid_argument("unknown argument: " + arg);
+		}
+	}
+
+	return cfg;
+}
+} // namespace
+
+int main(int argc, const char** argv)
+{
+	try {
+		auto cfg = parse_args(argc, argv);
+
+		auto entries = corpus::make_list(cfg.dims);
+
+		std::filesystem::create_directories(cfg.corpus_dir);
+		corpus::generate(cfg.corpus_dir, entries);
+
+		runner r(cfg);
+
+		for (const auto& e : entries) {
+			run_entry(r, cfg, e);
+		}
+
+		if (!cfg.out_file.empty()) {
+			std::ofstream f(cfg.out_file);
+			write_json(r.results, f);
+			if (!f) {
+				throw std::runtime_error("could not write results to file: " + cfg.out_file);
+			}
+		}
+
+		if (!cfg.baseline_file.empty()) {
+			if (compare_with_baseline(r.results, cfg) != 0) {
+				return 1;
+			}
+		}
+	} catch (std::exception& e) {
+		std::cerr << "error: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,417 @@
+#include <cstring>
+
+#include <fsif/memory_file.hpp>
+#include <rasterimage/any_image_span.hpp>
+#include <rasterimage/compare.hpp>
+#include <rasterimage/image_variant.hpp>
+#include <rasterimage/operations.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+#include <utki/enum_iterable.hpp>
+
+namespace {
+// buffer of external image with padded rows, float aligned
+struct external_image {
+	// multiple of all pixel sizes, so that typed image span can be obtained
+	static constexpr size_t padding = 48;
+
+	rasterimage::dimensioned::dimensions_type dims;
+	rasterimage::format pixel_format;
+	rasterimage::depth channel_depth;
+	size_t stride;
+	std::vector<float> buffer;
+
+	external_image(
+		rasterimage::dimensioned::dimensions_type dims,
+		rasterimage::format pixel_format,
+		rasterimage::depth channel_depth
+	) :
+		dims(dims),
+		pixel_format(pixel_format),
+		channel_depth(channel_depth),
+		stride(
+			size_t(dims.x()) * rasterimage::to_num_channels(pixel_format) *
+				rasterimage::to_channel_size(channel_depth) +
+			padding
+		),
+		buffer(stride * dims.y() / sizeof(float) + 1, 0)
+	{}
+
+	uint8_t* data()
+	{
+		// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+		return reinterpret_cast<uint8_t*>(this->buffer.data());
+	}
+
+	rasterimage::any_image_span span()
+	{
+		return {this->dims, this->stride, this->pixel_format, this->channel_depth, this->data()};
+	}
+
+	// bytes of the padding after the row
+	utki::span<uint8_t> padding_bytes(uint32_t row)
+	{
+		auto r = this->span()[row];
+		return utki::make_span(r.end(), padding);
+	}
+};
+
+rasterimage::image_variant make_grey_rgba_image()
+{
+	rasterimage::image_variant im({16, 16}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+	auto& rgba = im.get<rasterimage::format::rgba>();
+	for (uint32_t y = 0; y != rgba.dims().y(); ++y) {
+		for (uint32_t x = 0; x != rgba.dims().x(); ++x) {
+			auto v = uint8_t(y * rgba.dims().x() + x);
+			rgba[y][x] = {v, v, v, 0xff};
+		}
+	}
+	return im;
+}
+} // namespace
+
+namespace {
+const tst::set set("any_image_span", [](tst::suite& suite) {
+	suite.add("external_buffer", []() {
+		external_image ext({5, 3}, rasterimage::format::bgra, rasterimage::depth::uint_16_bit);
+
+		auto span = ext.span();
+		tst::check_eq(span.dims(), ext.dims, SL);
+		tst::check_eq(span.num_channels(), size_t(4), SL);
+		tst::check_eq(span.pixel_size(), size_t(8), SL);
+		tst::check_eq(span.stride_bytes(), ext.stride, SL);
+		tst::check_eq(span[2].size(), size_t(5 * 8), SL);
+		tst::check(span[1].data() == std::next(ext.data(), ptrdiff_t(ext.stride)), SL);
+
+		auto sub = span.subspan({{1, 2}, {3, 1}});
+		tst::check_eq(sub.dims(), r4::vector2<uint32_t>{3, 1}, SL);
+		tst::check(sub[0].data() == std::next(span[2].data(), 8), SL);
+
+		rasterimage::const_any_image_span const_span = span;
+		tst::check(const_span.data() == span.data(), SL);
+		tst::check(const_span.get_format() == rasterimage::format::bgra, SL);
+	});
+
+	suite.add("invalid_arguments", []() {
+		external_image ext({5, 3}, rasterimage::format::rgb, rasterimage::depth::uint_16_bit);
+
+		auto make = [&](size_t stride, uint8_t* data) {
+			return rasterimage::any_image_span(ext.dims, stride, ext.pixel_format, ext.channel_depth, data);
+		};
+
+		// stride less than row size
+		tst::check(
+			[&]() {
+				try {
+					make(5 * 6 - 2, ext.data());
+				} catch (std::invalid_argument&) {
+					return true;
+				}
+				return false;
+			}(),
+			SL
+		);
+
+		// misaligned data
+		tst::check(
+			[&]() {
+				try {
+					make(ext.stride, std::next(ext.data()));
+				} catch (std::invalid_argument&) {
+					return true;
+				}
+				return false;
+			}(),
+			SL
+		);
+
+		// misaligned stride
+		tst::check(
+			[&]() {
+				try {
+					make(ext.stride + 1, ext.data());
+				} catch (std::invalid_argument&) {
+					return true;
+				}
+				return false;
+			}(),
+			SL
+		);
+
+		// null data
+		tst::check(
+			[&]() {
+				try {
+					make(ext.stride, nullptr);
+				} catch (std::invalid_argument&) {
+					return true;
+				}
+				return false;
+			}(),
+			SL
+		);
+
+		// empty span does not need data
+		rasterimage::any_image_span empty({0, 0}, 0, rasterimage::format::rgba, rasterimage::depth::float_32_bit, nullptr);
+		tst::check(empty.empty(), SL);
+	});
+
+	suite.add("typed_span", []() {
+		rasterimage::image<uint16_t, 3> im(r4::vector2<uint32_t>{7, 4});
+		im.span().clear({1, 2, 3});
+
+		rasterimage::any_image_span span(im.span(), rasterimage::format::bgr);
+		tst::check(span.get_format() == rasterimage::format::bgr, SL);
+		tst::check(span.get_depth() == rasterimage::depth::uint_16_bit, SL);
+		tst::check_eq(span.stride_bytes(), im.span().stride_bytes(), SL);
+
+		auto typed = span.get<uint16_t, 3>();
+		tst::check(typed.data() == im.span().data(), SL);
+		tst::check_eq(typed.dims(), im.dims(), SL);
+		typed[3][6] = {4, 5, 6};
+		tst::check_eq(im[3][6], r4::vector3<uint16_t>{4, 5, 6}, SL);
+
+		// pixel type mismatch
+		tst::check(
+			[&]() {
+				try {
+					span.get<uint8_t, 3>();
+				} catch (std::invalid_argument&) {
+					return true;
+				}
+				return false;
+			}(),
+			SL
+		);
+
+		// format with other number of channels
+		tst::check(
+			[&]() {
+				try {
+					rasterimage::any_image_span(im.span(), rasterimage::format::rgba);
+				} catch (std::invalid_argument&) {
+					return true;
+				}
+				return false;
+			}(),
+			SL
+		);
+
+		auto num_channels = rasterimage::visit(
+			[](auto s) {
+				return typename decltype(s)::pixel_type().size();
+			},
+			span
+		);
+		tst::check_eq(num_channels, size_t(3), SL);
+	});
+
+	suite.add("image_variant_span", []() {
+		rasterimage::image_variant im({9, 5}, rasterimage::format::argb, rasterimage::depth::float_16_bit);
+
+		auto span = im.span();
+		tst::check_eq(span.dims(), im.dims(), SL);
+		tst::check(span.get_format() == rasterimage::format::argb, SL);
+		tst::check(span.get_depth() == rasterimage::depth::float_16_bit, SL);
+		tst::check(
+			span.data() ==
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+				reinterpret_cast<uint8_t*>(im.get<rasterimage::format::argb, rasterimage::depth::float_16_bit>().pixels().data()),
+			SL
+		);
+	});
+
+	suite.add<std::tuple<rasterimage::format, rasterimage::depth>>(
+		"convert_round_trip",
+		[]() {
+			std::vector<std::tuple<rasterimage::format, rasterimage::depth>> ret;
+			for (auto d : utki::enum_iterable_v<rasterimage::depth>) {
+				for (auto f : utki::enum_iterable_v<rasterimage::format>) {
+					ret.emplace_back(f, d);
+				}
+			}
+			return ret;
+		}(),
+		[](const auto& p) {
+			auto [pixel_format, channel_depth] = p;
+
+			// grey opaque pixels are representable by all pixel types
+			auto src = make_grey_rgba_image();
+
+			external_image ext(src.dims(), pixel_format, channel_depth);
+			rasterimage::convert(src.span(), ext.span());
+
+			rasterimage::image_variant back(src.dims(), rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+			rasterimage::convert(ext.span(), back.span());
+
+			tst::check(rasterimage::compare(back.span(), src.span()).identical(), SL);
+
+			for (uint32_t y = 0; y != ext.dims.y(); ++y) {
+				auto pad = ext.padding_bytes(y);
+				tst::check(std::all_of(pad.begin(), pad.end(), [](auto b) {
+					return b == 0;
+				}), SL) << "y = " << y;
+			}
+		}
+	);
+
+	suite.add("convert_channel_order", []() {
+		rasterimage::image<uint8_t, 4> src(r4::vector2<uint32_t>{300, 300});
+		for (uint32_t y = 0; y != src.dims().y(); ++y) {
+			for (uint32_t x = 0; x != src.dims().x(); ++x) {
+				src[y][x] = {uint8_t(x), uint8_t(y), uint8_t(x + y), uint8_t(x * y)};
+			}
+		}
+
+		for (auto f : {rasterimage::format::bgra, rasterimage::format::argb}) {
+			for (unsigned num_threads : {1, 4}) {
+				rasterimage::image<uint8_t, 4> dst(src.dims());
+				rasterimage::convert(rasterimage::const_any_image_span(src.span()), rasterimage::any_image_span(dst.span(), f), num_threads);
+
+				for (uint32_t y = 0; y != src.dims().y(); ++y) {
+					for (uint32_t x = 0; x != src.dims().x(); ++x) {
+						tst::check_eq(rasterimage::to_canonical_order(f, dst[y][x]), src[y][x], SL);
+					}
+				}
+			}
+		}
+	});
+
+	suite.add("convert_16_bit_to_8_bit", []() {
+		rasterimage::image<uint16_t, 1> src(r4::vector2<uint32_t>{3, 1});
+		src[0][0] = {0};
+		src[0][1] = {0xffff};
+		src[0][2] = {257 * 100 + 128};
+
+		rasterimage::image<uint8_t, 1> dst(src.dims());
+		rasterimage::convert(rasterimage::const_any_image_span(src.span()), rasterimage::any_image_span(dst.span()));
+
+		tst::check_eq(dst[0][0][0], uint8_t(0), SL);
+		tst::check_eq(dst[0][1][0], uint8_t(0xff), SL);
+		// rounded to nearest
+		tst::check_eq(dst[0][2][0], uint8_t(100), SL);
+	});
+
+	suite.add("convert_dims_mismatch", []() {
+		rasterimage::image_variant a({3, 4});
+		rasterimage::image_variant b({4, 3});
+		tst::check(
+			[&]() {
+				try {
+					rasterimage::convert(a.span(), b.span());
+				} catch (std::invalid_argument&) {
+					return true;
+				}
+				return false;
+			}(),
+			SL
+		);
+	});
+
+	suite.add("flip", []() {
+		external_image ext({4, 3}, rasterimage::format::rgb, rasterimage::depth::float_32_bit);
+		std::fill(ext.buffer.begin(), ext.buffer.end(), -1.0f);
+
+		auto span = ext.span();
+		auto typed = span.get<float, 3>();
+		for (uint32_t y = 0; y != span.dims().y(); ++y) {
+			for (uint32_t x = 0; x != span.dims().x(); ++x) {
+				typed[y][x] = {float(x), float(y), 0};
+			}
+		}
+
+		rasterimage::flip_horizontal(span);
+		rasterimage::flip_vertical(span);
+
+		for (uint32_t y = 0; y != span.dims().y(); ++y) {
+			for (uint32_t x = 0; x != span.dims().x(); ++x) {
+				tst::check_eq(typed[y][x], r4::vector3<float>{float(3 - x), float(2 - y), 0}, SL);
+			}
+
+			// padding is untouched
+			auto pad = ext.padding_bytes(y);
+			std::array<float, external_image::padding / sizeof(float)> pad_values{};
+			std::memcpy(pad_values.data(), pad.data(), pad.size());
+			tst::check(std::all_of(pad_values.begin(), pad_values.end(), [](auto v) {
+				return v == -1.0f;
+			}), SL) << "y = " << y;
+		}
+	});
+
+	suite.add("premultiply_alpha", []() {
+		for (auto f : {rasterimage::format::rgba, rasterimage::format::argb}) {
+			rasterimage::image<uint8_t, 4> im(r4::vector2<uint32_t>{2, 2});
+			im.span().clear(rasterimage::from_canonical_order(f, r4::vector4<uint8_t>{0xff, 0x80, 0, 0x80}));
+
+			rasterimage::any_image_span span(im.span(), f);
+
+			rasterimage::premultiply_alpha(span);
+			tst::check_eq(rasterimage::to_canonical_order(f, im[1][1]), r4::vector4<uint8_t>{0x80, 0x40, 0, 0x80}, SL);
+
+			// precision of the premultiplied value is lost
+			rasterimage::unpremultiply_alpha(span);
+			tst::check_eq(rasterimage::to_canonical_order(f, im[1][1]), r4::vector4<uint8_t>{0xff, 0x7f, 0, 0x80}, SL);
+		}
+	});
+
+	suite.add<std::tuple<rasterimage::format, rasterimage::depth>>(
+		"read_png_to_external_buffer",
+		{
+			{rasterimage::format::rgba, rasterimage::depth::uint_8_bit},
+			{rasterimage::format::bgra, rasterimage::depth::uint_8_bit},
+			{rasterimage::format::argb, rasterimage::depth::uint_16_bit},
+			{rasterimage::format::grey, rasterimage::depth::uint_8_bit},
+			{rasterimage::format::rgb, rasterimage::depth::float_32_bit},
+			{rasterimage::format::greya, rasterimage::depth::float_16_bit},
+		},
+		[](const auto& p) {
+			auto [pixel_format, channel_depth] = p;
+
+			rasterimage::image_variant im({37, 41}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+			auto& rgba = im.get<rasterimage::format::rgba>();
+			for (uint32_t y = 0; y != rgba.dims().y(); ++y) {
+				for (uint32_t x = 0; x != rgba.dims().x(); ++x) {
+					rgba[y][x] = r4::vector4<uint8_t>{uint8_t(x), uint8_t(y), uint8_t(x * y), uint8_t(x + y)};
+				}
+			}
+
+			fsif::memory_file fi;
+			im.write_png(fi);
+
+			auto expected = rasterimage::read_png(fi, pixel_format, channel_depth);
+
+			external_image ext(im.dims(), pixel_format, channel_depth);
+			rasterimage::read(fi, ext.span());
+
+			tst::check(rasterimage::compare(ext.span(), expected.span()).identical(), SL);
+
+			// region of interest of natively decoded pixel type
+			r4::rectangle<uint32_t> roi = {{3, 5}, {20, 30}};
+			external_image roi_ext(roi.d, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+			rasterimage::read_png(fi, roi, roi_ext.span());
+
+			tst::check(rasterimage::compare(roi_ext.span(), im.span().subspan(roi)).identical(), SL);
+		}
+	);
+
+	suite.add("read_png_to_external_buffer_dims_mismatch", []() {
+		rasterimage::image_variant im({13, 7}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+
+		fsif::memory_file fi;
+		im.write_png(fi);
+
+		external_image ext({7, 13}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+		tst::check(
+			[&]() {
+				try {
+					rasterimage::read_png(fi, ext.span());
+				} catch (std::invalid_argument&) {
+					return true;
+				}
+				return false;
+			}(),
+			SL
+		);
+	});
+});
+} // namespace
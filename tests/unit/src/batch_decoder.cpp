@@ -0,0 +1,124 @@
+#include <algorithm>
+
+#include <fsif/memory_file.hpp>
+#include <rasterimage/batch_decoder.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+std::vector<uint8_t> make_png(uint32_t width, uint32_t height, uint8_t fill)
+{
+	rasterimage::image_variant im({width, height}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+	im.get<rasterimage::format::rgba, rasterimage::depth::uint_8_bit>().span().clear(
+		r4::vector4<uint8_t>{fill, fill, fill, fill}
+	);
+
+	fsif::memory_file fi;
+	im.write_png(fi);
+	return fi.reset_data();
+}
+
+// 16x8 greyscale JPEG with SOF0 marker changed to SOF3, lossless JPEG is not supported by the decoder
+const std::vector<uint8_t> corrupted_jpeg_data = {
+	0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+	0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+	0x00, 0x03, 0x02, 0x02, 0x03, 0x02, 0x02, 0x03, 0x03, 0x03, 0x03, 0x04,
+	0x03, 0x03, 0x04, 0x05, 0x08, 0x05, 0x05, 0x04, 0x04, 0x05, 0x0a, 0x07,
+	0x07, 0x06, 0x08, 0x0c, 0x0a, 0x0c, 0x0c, 0x0b, 0x0a, 0x0b, 0x0b, 0x0d,
+	0x0e, 0x12, 0x10, 0x0d, 0x0e, 0x11, 0x0e, 0x0b, 0x0b, 0x10, 0x16, 0x10,
+	0x11, 0x13, 0x14, 0x15, 0x15, 0x15, 0x0c, 0x0f, 0x17, 0x18, 0x16, 0x14,
+	0x18, 0x12, 0x14, 0x15, 0x14, 0xff, 0xc3, 0x00, 0x0b, 0x08, 0x00, 0x08,
+	0x00, 0x10, 0x01, 0x01, 0x11, 0x00, 0xff, 0xc4, 0x00, 0x15, 0x00, 0x01,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x08, 0x09, 0xff, 0xc4, 0x00, 0x17, 0x10, 0x00, 0x03,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x08, 0x44, 0x81, 0xff, 0xda, 0x00, 0x08, 0x01, 0x01,
+	0x00, 0x00, 0x3f, 0x00, 0x1f, 0xad, 0xb2, 0xe1, 0x55, 0x56, 0xd9, 0x70,
+	0xff, 0xd9,
+};
+} // namespace
+
+namespace {
+const tst::set set("batch_decoder", [](tst::suite& suite) {
+	suite.add<size_t>("decode_buffers", {0, 1024, 50 * 40 * 4}, [](const auto& budget) {
+		rasterimage::batch_decoder decoder(3, budget);
+
+		constexpr size_t num_items = 20;
+
+		std::vector<std::vector<uint8_t>> buffers;
+		for (size_t i = 0; i != num_items; ++i) {
+			buffers.push_back(make_png(uint32_t(10 + i), 40, uint8_t(i)));
+		}
+
+		// broken items
+		const std::vector<size_t> broken_items = {7, 11, 13};
+		buffers[7] = {1, 2, 3, 4, 5};
+		// truncated PNG
+		buffers[11].resize(buffers[11].size() / 2);
+		buffers[13] = corrupted_jpeg_data;
+
+		std::vector<bool> delivered(num_items, false);
+		size_t num_errors = 0;
+
+		decoder.decode(std::move(buffers), [&](rasterimage::batch_decoder::result&& r) {
+			tst::check(r.index < num_items, SL);
+			tst::check(!delivered[r.index], SL);
+			delivered[r.index] = true;
+
+			if (!r.ok()) {
+				++num_errors;
+				tst::check(std::find(broken_items.begin(), broken_items.end(), r.index) != broken_items.end(), SL)
+					<< "r.index = " << r.index;
+				return;
+			}
+
+			tst::check_eq(r.image.dims(), rasterimage::dimensioned::dimensions_type{uint32_t(10 + r.index), 40}, SL);
+			const auto& im = r.image.get<rasterimage::format::rgba, rasterimage::depth::uint_8_bit>();
+			tst::check_eq(im[0][0], r4::vector4<uint8_t>(uint8_t(r.index)), SL);
+		});
+
+		tst::check(std::all_of(delivered.begin(), delivered.end(), [](auto d) {
+			return d;
+		}), SL);
+		tst::check_eq(num_errors, broken_items.size(), SL);
+	});
+
+	suite.add("decode_files_to_vector", []() {
+		rasterimage::batch_decoder decoder(2);
+
+		fsif::memory_file a(make_png(3, 4, 1));
+		fsif::memory_file b(make_png(5, 6, 2));
+
+		std::vector<const fsif::file*> files = {&a, &b};
+
+		auto results = decoder.decode(files);
+
+		tst::check_eq(results.size(), size_t(2), SL);
+		for (const auto& r : results) {
+			tst::check(r.ok(), SL);
+			tst::check_eq(r.image.dims().x(), r.index == 0 ? 3u : 5u, SL);
+		}
+	});
+
+	suite.add("callback_exception_is_rethrown", []() {
+		rasterimage::batch_decoder decoder(2);
+
+		std::vector<std::vector<uint8_t>> buffers = {make_png(2, 2, 0), make_png(2, 2, 0), make_png(2, 2, 0)};
+
+		size_t num_calls = 0;
+
+		bool thrown = false;
+		try {
+			decoder.decode(std::move(buffers), [&](auto&&) {
+				++num_calls;
+				throw std::runtime_error("callback error");
+			});
+		} catch (std::runtime_error&) {
+			thrown = true;
+		}
+
+		tst::check(thrown, SL);
+		tst::check_eq(num_calls, size_t(3), SL);
+	});
+});
+} // namespace
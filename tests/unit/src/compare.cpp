@@ -0,0 +1,142 @@
+#include <rasterimage/compare.hpp>
+#include <rasterimage/image_variant.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+const tst::set set("compare", [](tst::suite& suite) {
+	suite.add<unsigned>("identical", {1, 0}, [](const auto& num_threads) {
+		rasterimage::image<uint8_t, 4> a(rasterimage::dimensioned::dimensions_type{300, 400});
+		a.span().clear({1, 2, 3, 4});
+		auto b = a;
+
+		auto res = rasterimage::compare(a.span(), b.span(), {true, num_threads});
+
+		tst::check(res.identical(), SL);
+		tst::check_eq(res.num_different_pixels, size_t(0), SL);
+		tst::check_eq(res.max_abs_error, 0.0, SL);
+		tst::check_eq(res.diff_bounding_box, r4::rectangle<uint32_t>(0, 0), SL);
+		tst::check(std::isinf(res.psnr), SL);
+		tst::check_eq(res.ssim, 1.0, SL);
+	});
+
+	suite.add<unsigned>("different", {1, 0}, [](const auto& num_threads) {
+		rasterimage::image<uint8_t, 3> a(rasterimage::dimensioned::dimensions_type{300, 400});
+		a.span().clear({100, 100, 100});
+		auto b = a;
+
+		b[10][20] = {100, 110, 100};
+		b[390][5] = {97, 100, 100};
+		b[200][250] = {100, 100, 101};
+
+		auto res = rasterimage::compare(a.span(), b.span(), {false, num_threads});
+
+		tst::check(!res.identical(), SL);
+		tst::check_eq(res.num_different_pixels, size_t(3), SL);
+		tst::check_eq(res.max_abs_error, 10.0, SL);
+		tst::check_eq(res.diff_bounding_box, r4::rectangle<uint32_t>({5, 10}, {246, 381}), SL);
+		tst::check(std::isnan(res.ssim), SL);
+
+		double mse = (10.0 * 10 + 3 * 3 + 1 * 1) / (300.0 * 400 * 3);
+		tst::check_le(std::abs(res.psnr - 10 * std::log10(255.0 * 255.0 / mse)), 1e-9, SL);
+	});
+
+	suite.add("wide_channels", []() {
+		// row is longer than the chunk of pixels whose integral squared differences are summed up at once
+		rasterimage::image<uint16_t, 4> a(rasterimage::dimensioned::dimensions_type{70000, 2});
+		a.span().clear({0, 0, 0, 0});
+		auto b = a;
+		b.span().clear({0xffff, 0xffff, 0xffff, 0xffff});
+
+		auto res = rasterimage::compare(a.span(), b.span(), {false, 1});
+
+		tst::check_eq(res.num_different_pixels, size_t(70000 * 2), SL);
+		tst::check_eq(res.max_abs_error, 65535.0, SL);
+		tst::check_le(std::abs(res.psnr), 1e-9, SL);
+
+		// squared 32 bit differences do not fit into 64 bit integers
+		rasterimage::image<uint32_t, 1> c(rasterimage::dimensioned::dimensions_type{3, 3});
+		c.span().clear(0);
+		auto d = c;
+		d[1][2] = 0xffffffff;
+
+		res = rasterimage::compare(c.span(), d.span(), {false, 1});
+
+		tst::check_eq(res.num_different_pixels, size_t(1), SL);
+		tst::check_eq(res.max_abs_error, 4294967295.0, SL);
+		tst::check_eq(res.diff_bounding_box, r4::rectangle<uint32_t>({2, 1}, {1, 1}), SL);
+		tst::check_le(std::abs(res.psnr - 10 * std::log10(9.0)), 1e-9, SL);
+	});
+
+	suite.add("ssim", []() {
+		rasterimage::image<float, 1> a(rasterimage::dimensioned::dimensions_type{32, 32});
+		auto b = a;
+		for (uint32_t y = 0; y != a.dims().y(); ++y) {
+			for (uint32_t x = 0; x != a.dims().x(); ++x) {
+				a[y][x] = float((x + y) % 2);
+				b[y][x] = float((x + y + 1) % 2);
+			}
+		}
+
+		auto res = rasterimage::compare(a.span(), a.span(), {true});
+		tst::check_eq(res.ssim, 1.0, SL);
+
+		// inverted checkerboard has negative correlation
+		res = rasterimage::compare(a.span(), b.span(), {true});
+		tst::check_lt(res.ssim, 0.0, SL);
+		tst::check_eq(res.num_different_pixels, a.pixels().size(), SL);
+		tst::check_eq(res.max_abs_error, 1.0, SL);
+	});
+
+	suite.add("image_variant", []() {
+		rasterimage::image_variant a({10, 20}, rasterimage::format::grey, rasterimage::depth::uint_16_bit);
+		auto& img_a = a.get<rasterimage::format::grey, rasterimage::depth::uint_16_bit>();
+		img_a.span().clear(1000);
+
+		auto b = a;
+		auto& img_b = b.get<rasterimage::format::grey, rasterimage::depth::uint_16_bit>();
+		img_b[3][4] = 1100;
+
+		auto res = rasterimage::compare(a, b);
+		tst::check_eq(res.num_different_pixels, size_t(1), SL);
+		tst::check_eq(res.max_abs_error, 100.0, SL);
+
+		rasterimage::image_variant c({10, 20}, rasterimage::format::grey, rasterimage::depth::uint_8_bit);
+
+		bool thrown = false;
+		try {
+			rasterimage::compare(a, c);
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+	});
+
+	suite.add("any_image_span", []() {
+		rasterimage::image_variant a({10, 20}, rasterimage::format::bgra, rasterimage::depth::uint_8_bit);
+		auto& img_a = a.get<rasterimage::format::bgra, rasterimage::depth::uint_8_bit>();
+		img_a.span().clear({1, 2, 3, 4});
+
+		auto b = a;
+		auto& img_b = b.get<rasterimage::format::bgra, rasterimage::depth::uint_8_bit>();
+		img_b[3][4] = {1, 2, 3, 10};
+
+		auto res = rasterimage::compare(a.span(), b.span());
+		tst::check_eq(res.num_different_pixels, size_t(1), SL);
+		tst::check_eq(res.max_abs_error, 6.0, SL);
+
+		r4::rectangle<uint32_t> rect = {{5, 0}, {5, 20}};
+		tst::check(rasterimage::compare(a.span().subspan(rect), b.span().subspan(rect)).identical(), SL);
+
+		rasterimage::image_variant c({10, 20}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+
+		bool thrown = false;
+		try {
+			rasterimage::compare(a.span(), c.span());
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+	});
+});
+} // namespace
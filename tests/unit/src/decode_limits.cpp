@@ -0,0 +1,328 @@
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#include <fsif/memory_file.hpp>
+#include <rasterimage/batch_decoder.hpp>
+#include <rasterimage/decode_limits.hpp>
+#include <rasterimage/pnm.hpp>
+#include <rasterimage/push_decoder.hpp>
+#include <rasterimage/qoi.hpp>
+#include <rasterimage/raw.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+constexpr uint32_t image_width = 20;
+constexpr uint32_t image_height = 10;
+
+rasterimage::image_variant make_image()
+{
+	rasterimage::image_variant im(
+		r4::vector2<uint32_t>{image_width, image_height},
+		rasterimage::format::rgba,
+		rasterimage::depth::uint_8_bit
+	);
+	auto& rgba = im.get<rasterimage::format::rgba>();
+	for (uint32_t y = 0; y != image_height; ++y) {
+		for (uint32_t x = 0; x != image_width; ++x) {
+			rgba[y][x] = {uint8_t(x), uint8_t(y), uint8_t(x * y), 0xff};
+		}
+	}
+	return im;
+}
+
+std::vector<uint8_t> make_png()
+{
+	fsif::memory_file fi;
+	make_image().write_png(fi);
+	return fi.reset_data();
+}
+
+template <typename exception_type, typename function_type>
+bool throws(function_type func)
+{
+	try {
+		func();
+	} catch (exception_type&) {
+		return true;
+	}
+	return false;
+}
+
+rasterimage::decode_limits make_limits(uint32_t max_width)
+{
+	rasterimage::decode_limits ret;
+	ret.max_width = max_width;
+	return ret;
+}
+} // namespace
+
+namespace {
+const tst::set set("decode_limits", [](tst::suite& suite) {
+	suite.add("scoped_limits", []() {
+		tst::check_eq(rasterimage::get_decode_limits().max_width, uint32_t(1'000'000), SL);
+
+		{
+			rasterimage::scoped_decode_limits limits(make_limits(5));
+			tst::check_eq(rasterimage::get_decode_limits().max_width, uint32_t(5), SL);
+
+			// limits are per thread
+			uint32_t other_thread_max_width = 0;
+			std::thread([&other_thread_max_width]() {
+				other_thread_max_width = rasterimage::get_decode_limits().max_width;
+			}).join();
+			tst::check_eq(other_thread_max_width, uint32_t(1'000'000), SL);
+
+			{
+				rasterimage::scoped_decode_limits unlimited(rasterimage::decode_limits::unlimited());
+				tst::check_eq(rasterimage::get_decode_limits().max_width, uint32_t(0xffffffff), SL);
+			}
+			tst::check_eq(rasterimage::get_decode_limits().max_width, uint32_t(5), SL);
+		}
+
+		tst::check_eq(rasterimage::get_decode_limits().max_width, uint32_t(1'000'000), SL);
+	});
+
+	suite.add("png_limits", []() {
+		fsif::memory_file fi(make_png());
+
+		auto read_with = [&fi](const rasterimage::decode_limits& l) {
+			rasterimage::scoped_decode_limits limits(l);
+			return throws<rasterimage::size_limit_error>([&fi]() {
+				rasterimage::read_png(fi);
+			});
+		};
+
+		rasterimage::decode_limits l;
+
+		l.max_width = image_width - 1;
+		tst::check(read_with(l), SL);
+		l.max_width = image_width;
+		tst::check(!read_with(l), SL);
+
+		l.max_height = image_height - 1;
+		tst::check(read_with(l), SL);
+		l.max_height = image_height;
+		tst::check(!read_with(l), SL);
+
+		l.max_pixels = image_width * image_height - 1;
+		tst::check(read_with(l), SL);
+		l.max_pixels = image_width * image_height;
+		tst::check(!read_with(l), SL);
+
+		l.max_bytes = image_width * image_height * 4 - 1;
+		tst::check(read_with(l), SL);
+		l.max_bytes = image_width * image_height * 4;
+		tst::check(!read_with(l), SL);
+
+		// each filtered row starts with filter type byte
+		l.max_inflate_bytes = image_height * (1 + image_width * 4) - 1;
+		tst::check(read_with(l), SL);
+		l.max_inflate_bytes = image_height * (1 + image_width * 4);
+		tst::check(!read_with(l), SL);
+
+		// header can still be read
+		rasterimage::scoped_decode_limits limits(make_limits(1));
+		tst::check_eq(rasterimage::probe_png(fi).dims, r4::vector2<uint32_t>{image_width, image_height}, SL);
+	});
+
+	suite.add("png_limits_apply_to_decoded_pixel_type", []() {
+		fsif::memory_file fi(make_png());
+
+		rasterimage::decode_limits l;
+		l.max_bytes = image_width * image_height * 4;
+		rasterimage::scoped_decode_limits limits(l);
+
+		tst::check(!throws<rasterimage::size_limit_error>([&fi]() {
+			rasterimage::read_png(fi, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+		}), SL);
+		tst::check(throws<rasterimage::size_limit_error>([&fi]() {
+			rasterimage::read_png(fi, rasterimage::format::rgba, rasterimage::depth::float_32_bit);
+		}), SL);
+	});
+
+	suite.add("png_region_of_interest", []() {
+		fsif::memory_file fi(make_png());
+
+		// the limits apply to the whole image, not to the region
+		rasterimage::scoped_decode_limits limits(make_limits(image_width - 1));
+		tst::check(throws<rasterimage::size_limit_error>([&fi]() {
+			rasterimage::read_png(fi, r4::rectangle<uint32_t>{{0, 0}, {2, 2}});
+		}), SL);
+	});
+
+	suite.add("push_decoder", []() {
+		auto data = make_png();
+
+		rasterimage::scoped_decode_limits limits(make_limits(image_width - 1));
+		rasterimage::push_decoder decoder;
+		tst::check(throws<rasterimage::size_limit_error>([&]() {
+			decoder.push(data);
+		}), SL);
+	});
+
+	suite.add("batch_decoder_uses_caller_limits", []() {
+		fsif::memory_file fi(make_png());
+		std::vector<const fsif::file*> files = {&fi};
+
+		rasterimage::batch_decoder decoder(1);
+
+		{
+			rasterimage::scoped_decode_limits limits(make_limits(image_width - 1));
+			auto results = decoder.decode(files);
+			tst::check_eq(results.size(), size_t(1), SL);
+			tst::check(throws<rasterimage::size_limit_error>([&results]() {
+				std::rethrow_exception(results[0].error);
+			}), SL);
+		}
+
+		auto results = decoder.decode(files);
+		tst::check(results[0].ok(), SL);
+	});
+
+	suite.add("qoi_huge_dimensions", []() {
+		// header declaring 0xffffffff x 0xffffffff RGBA image, no pixel data
+		const std::vector<uint8_t> data = {
+			'q', 'o', 'i', 'f', 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 4, 0 //
+		};
+
+		tst::check(throws<rasterimage::size_limit_error>([&data]() {
+			rasterimage::read_qoi(data);
+		}), SL);
+
+		// buffer size does not fit into 64 bits
+		rasterimage::scoped_decode_limits limits(rasterimage::decode_limits::unlimited());
+		tst::check(throws<rasterimage::size_limit_error>([&data]() {
+			rasterimage::read_qoi(data);
+		}), SL);
+	});
+
+	suite.add("pnm_huge_dimensions", []() {
+		const std::string data = "P6\n2000000 2000000\n255\n";
+
+		std::istringstream s(data);
+		tst::check(throws<rasterimage::size_limit_error>([&s]() {
+			rasterimage::read_pnm(s);
+		}), SL);
+
+		// header can still be read
+		fsif::memory_file fi{std::vector<uint8_t>(data.begin(), data.end())};
+		tst::check_eq(rasterimage::probe_pnm(fi).dims, r4::vector2<uint32_t>{2000000, 2000000}, SL);
+
+		tst::check(throws<rasterimage::size_limit_error>([&fi]() {
+			rasterimage::read_pnm(fi);
+		}), SL);
+		tst::check(throws<rasterimage::size_limit_error>([&fi]() {
+			rasterimage::read(fi, rasterimage::format::rgb, rasterimage::depth::uint_8_bit);
+		}), SL);
+	});
+
+	suite.add("raw_limits", []() {
+		fsif::memory_file fi;
+		rasterimage::write_raw(fi, make_image().span(), rasterimage::raw_compression::deflate);
+		auto data = fi.reset_data();
+
+		{
+			fsif::memory_file raw_fi{std::vector<uint8_t>(data)};
+			rasterimage::scoped_decode_limits limits(make_limits(image_width - 1));
+			tst::check(throws<rasterimage::size_limit_error>([&raw_fi]() {
+				rasterimage::read_raw(raw_fi);
+			}), SL);
+		}
+
+		// compressed data size is checked before reading the data to memory
+		constexpr size_t data_size_offset = 48;
+		auto huge_data_size = data;
+		huge_data_size[data_size_offset + 5] = 1; // 2^40
+		tst::check(throws<std::invalid_argument>([&huge_data_size]() {
+			rasterimage::read_raw(fsif::memory_file(std::move(huge_data_size)));
+		}), SL);
+
+		// pixel data offset is skipped without allocating memory for skipped bytes
+		constexpr size_t data_offset_offset = 40;
+		auto huge_data_offset = data;
+		huge_data_offset[data_offset_offset + 5] = 1; // 2^40
+		tst::check(throws<std::invalid_argument>([&huge_data_offset]() {
+			rasterimage::read_raw(fsif::memory_file(std::move(huge_data_offset)));
+		}), SL);
+	});
+
+	suite.add<std::string>("read", {"png", "qoi", "pnm", "raw"}, [](const auto& file_format) {
+		auto im = make_image();
+
+		fsif::memory_file fi{[&]() {
+			fsif::memory_file out;
+			if (file_format == "png") {
+				im.write_png(out);
+			} else if (file_format == "qoi") {
+				rasterimage::write_qoi(out, im.span());
+			} else if (file_format == "pnm") {
+				rasterimage::write_pnm(out, im.span());
+			} else {
+				rasterimage::write_raw(out, im.span(), rasterimage::raw_compression::deflate);
+			}
+			return out.reset_data();
+		}()};
+
+		{
+			rasterimage::scoped_decode_limits limits(make_limits(image_width - 1));
+			tst::check(throws<rasterimage::size_limit_error>([&fi]() {
+				rasterimage::read(fi);
+			}), SL);
+			tst::check(throws<rasterimage::size_limit_error>([&fi]() {
+				rasterimage::read(fi, rasterimage::format::rgb, rasterimage::depth::float_32_bit);
+			}), SL);
+		}
+
+		tst::check_eq(rasterimage::read(fi).dims(), im.dims(), SL);
+	});
+
+	suite.add("read_malformed_files", []() {
+		auto png = make_png();
+
+		auto truncated_png = png;
+		truncated_png.resize(png.size() / 2);
+
+		// PNG signature followed by garbage
+		auto garbage_png = png;
+		std::fill(std::next(garbage_png.begin(), 8), garbage_png.end(), uint8_t(0xaa));
+
+		auto qoi = rasterimage::write_qoi(make_image().span());
+		auto truncated_qoi = qoi;
+		truncated_qoi.resize(qoi.size() / 2);
+
+		// JPEG SOI marker followed by garbage
+		std::vector<uint8_t> garbage_jpeg = {0xff, 0xd8, 0xff, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa};
+
+		const std::string bad_pnm_header = "P6\n20 abc\n255\n";
+
+		for (const auto& data : {
+				 truncated_png,
+				 garbage_png,
+				 truncated_qoi,
+				 garbage_jpeg,
+				 std::vector<uint8_t>(bad_pnm_header.begin(), bad_pnm_header.end()),
+			 })
+		{
+			fsif::memory_file fi{std::vector<uint8_t>(data)};
+			tst::check(throws<std::invalid_argument>([&fi]() {
+				rasterimage::read(fi);
+			}), SL) << "data size = " << data.size();
+		}
+	});
+
+	suite.add("image_size_overflow", []() {
+		r4::vector2<uint32_t> dims = {0xffffffff, 0xffffffff};
+
+		tst::check(throws<rasterimage::size_limit_error>([&dims]() {
+			rasterimage::image<float, 4> im(dims);
+		}), SL);
+
+		rasterimage::image_info info = {dims, rasterimage::format::rgba, rasterimage::depth::float_32_bit};
+		tst::check(throws<rasterimage::size_limit_error>([&info]() {
+			info.buffer_size_bytes();
+		}), SL);
+	});
+});
+} // namespace
@@ -0,0 +1,163 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <rasterimage/float16.hpp>
+#include <rasterimage/image.hpp>
+#include <rasterimage/transform.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+uint32_t to_bits(float f)
+{
+	uint32_t ret = 0;
+	std::memcpy(&ret, &f, sizeof(ret));
+	return ret;
+}
+
+float from_bits(uint32_t u)
+{
+	float ret = 0;
+	std::memcpy(&ret, &u, sizeof(ret));
+	return ret;
+}
+
+bool is_nan_half(uint16_t h)
+{
+	return (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+}
+} // namespace
+
+namespace {
+const tst::set set("float16", [](tst::suite& suite) {
+	suite.add<std::pair<float, uint16_t>>(
+		"from_float",
+		{
+			{0.0f, 0x0000},
+			{-0.0f, 0x8000},
+			{1.0f, 0x3c00},
+			{-2.0f, 0xc000},
+			{0.5f, 0x3800},
+			{65504.0f, 0x7bff},
+			// rounds down to maximal value
+			{65519.0f, 0x7bff},
+			// rounds up to infinity
+			{65520.0f, 0x7c00},
+			{1e10f, 0x7c00},
+			{-1e10f, 0xfc00},
+			{std::numeric_limits<float>::infinity(), 0x7c00},
+			// smallest normal
+			{std::ldexp(1.0f, -14), 0x0400},
+			// smallest subnormal
+			{std::ldexp(1.0f, -24), 0x0001},
+			// halfway between zero and smallest subnormal, ties to even
+			{std::ldexp(1.0f, -25), 0x0000},
+			{std::ldexp(3.0f, -25), 0x0002},
+			// halfway between 1 and next value, ties to even
+			{1.0f + std::ldexp(1.0f, -11), 0x3c00},
+			{1.0f + std::ldexp(3.0f, -11), 0x3c02},
+			// mantissa rounding carries to exponent
+			{2.0f - std::ldexp(1.0f, -12), 0x4000},
+		},
+		[](const auto& p) {
+			tst::check_eq(rasterimage::float16(p.first).to_bits(), p.second, SL);
+			tst::check_eq(rasterimage::internal::software_float_to_half_bits(p.first), p.second, SL);
+		}
+	);
+
+	suite.add("nan", []() {
+		auto nan = std::numeric_limits<float>::quiet_NaN();
+		tst::check(is_nan_half(rasterimage::float16(nan).to_bits()), SL);
+		tst::check(is_nan_half(rasterimage::internal::software_float_to_half_bits(nan)), SL);
+		tst::check(std::isnan(float(std::numeric_limits<rasterimage::float16>::quiet_NaN())), SL);
+	});
+
+	suite.add("all_half_values_round_trip", []() {
+		for (uint32_t h = 0; h != 0x10000; ++h) {
+			auto f = float(rasterimage::float16::from_bits(uint16_t(h)));
+			auto sf = rasterimage::internal::software_half_bits_to_float(uint16_t(h));
+
+			if (is_nan_half(uint16_t(h))) {
+				tst::check(std::isnan(f), SL);
+				tst::check(std::isnan(sf), SL);
+				continue;
+			}
+
+			tst::check_eq(to_bits(sf), to_bits(f), SL) << "h = " << h;
+			tst::check_eq(rasterimage::float16(f).to_bits(), uint16_t(h), SL) << "h = " << h;
+			tst::check_eq(rasterimage::internal::software_float_to_half_bits(f), uint16_t(h), SL) << "h = " << h;
+		}
+	});
+
+	suite.add("software_conversion_matches_hardware", []() {
+		// sweep over float values with step in the low mantissa bits, so that rounding is exercised
+		constexpr uint32_t step = 0x1001;
+		for (uint64_t u = 0; u <= std::numeric_limits<uint32_t>::max(); u += step) {
+			auto f = from_bits(uint32_t(u));
+			if (std::isnan(f)) {
+				continue;
+			}
+			tst::check_eq(
+				rasterimage::internal::software_float_to_half_bits(f),
+				rasterimage::float16(f).to_bits(),
+				SL
+			) << "f = "
+			  << f;
+		}
+	});
+
+	suite.add("numeric_limits", []() {
+		using limits = std::numeric_limits<rasterimage::float16>;
+		tst::check_eq(float(limits::max()), 65504.0f, SL);
+		tst::check_eq(float(limits::lowest()), -65504.0f, SL);
+		tst::check_eq(float(limits::min()), std::ldexp(1.0f, -14), SL);
+		tst::check_eq(float(limits::denorm_min()), std::ldexp(1.0f, -24), SL);
+		tst::check_eq(float(limits::epsilon()), std::ldexp(1.0f, -10), SL);
+		tst::check_eq(float(limits::infinity()), std::numeric_limits<float>::infinity(), SL);
+	});
+
+	suite.add<size_t>("bulk_convert", {0, 1, 7, 8, 9, 100}, [](const auto& size) {
+		std::vector<float> src(size);
+		for (size_t i = 0; i != src.size(); ++i) {
+			src[i] = float(i) * 0.37f - 10.0f;
+		}
+
+		std::vector<rasterimage::float16> half(size);
+		rasterimage::convert(utki::make_span(src), utki::make_span(half));
+
+		std::vector<float> back(size);
+		rasterimage::convert(utki::make_span(half), utki::make_span(back));
+
+		for (size_t i = 0; i != size; ++i) {
+			tst::check_eq(half[i].to_bits(), rasterimage::float16(src[i]).to_bits(), SL) << "i = " << i;
+			tst::check_eq(back[i], float(half[i]), SL) << "i = " << i;
+		}
+	});
+
+	suite.add("transform_to_half_precision", []() {
+		rasterimage::image<float, 3> src(r4::vector2<uint32_t>{13, 5});
+		for (uint32_t y = 0; y != src.dims().y(); ++y) {
+			for (uint32_t x = 0; x != src.dims().x(); ++x) {
+				src[y][x] = {float(x) / 13, float(y) / 5, float(x * y) / 65};
+			}
+		}
+
+		rasterimage::image<rasterimage::float16, 3> half(src.dims());
+		rasterimage::transform(2, src.span(), half.span(), rasterimage::op::to<rasterimage::float16>());
+
+		rasterimage::image<float, 3> back(src.dims());
+		rasterimage::transform(half.span(), back.span(), rasterimage::op::to<float>());
+
+		for (uint32_t y = 0; y != src.dims().y(); ++y) {
+			for (uint32_t x = 0; x != src.dims().x(); ++x) {
+				for (size_t i = 0; i != 3; ++i) {
+					tst::check_eq(half[y][x][i].to_bits(), rasterimage::float16(src[y][x][i]).to_bits(), SL);
+					tst::check_eq(back[y][x][i], float(half[y][x][i]), SL);
+					tst::check(std::abs(back[y][x][i] - src[y][x][i]) <= std::ldexp(1.0f, -11), SL);
+				}
+			}
+		}
+	});
+});
+} // namespace
@@ -17,6 +17,29 @@ const tst::set set("image", [](tst::suite& suite) {
 		tst::check_eq(i[3][10], expected, SL);
 	});
 
+	suite.add("size_of_more_than_4_gigapixels", []() {
+		// the allocation is refused by the soft memory limit before the memory is allocated,
+		// so the requested size can be checked without allocating it
+		rasterimage::set_memory_soft_limit(1);
+
+		rasterimage::dimensioned::dimensions_type dims = {0x10001, 0x10000};
+		size_t requested_bytes = 0;
+		try {
+			rasterimage::image<uint8_t, 4> im(dims);
+		} catch (rasterimage::memory_limit_exceeded& e) {
+			requested_bytes = e.requested_bytes;
+		} catch (rasterimage::size_limit_error&) {
+			// size is not addressable on 32 bit platforms
+			tst::check(sizeof(size_t) < sizeof(uint64_t), SL);
+		}
+
+		rasterimage::set_memory_soft_limit(0);
+
+		if (sizeof(size_t) >= sizeof(uint64_t)) {
+			tst::check_eq(uint64_t(requested_bytes), uint64_t(0x10001) * 0x10000 * 4, SL);
+		}
+	});
+
 	suite.add("make", []() {
 		std::array<uint32_t, 4> data = {1, 2, 3, 4};
 
@@ -0,0 +1,249 @@
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <thread>
+
+#include <fsif/memory_file.hpp>
+#include <fsif/native_file.hpp>
+#include <rasterimage/image_cache.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+// size of pixel buffer of images made by make_image()
+constexpr size_t image_size_bytes = 10 * 10 * 4;
+
+rasterimage::image_variant make_image(uint8_t value = 0)
+{
+	rasterimage::image_variant im({10, 10}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+	auto& rgba = im.get<rasterimage::format::rgba>();
+	rgba.span().clear({value, value, value, 0xff});
+	return im;
+}
+
+const uint8_t* data_of(const rasterimage::shared_image& im)
+{
+	return im.span().data();
+}
+} // namespace
+
+namespace {
+const tst::set set("image_cache", [](tst::suite& suite) {
+	suite.add("hit_and_miss", []() {
+		rasterimage::image_cache cache(image_size_bytes * 100);
+
+		unsigned num_decodes = 0;
+		auto decoder = [&num_decodes]() {
+			++num_decodes;
+			return make_image();
+		};
+
+		auto a = cache.get("a", decoder);
+		auto b = cache.get("a", decoder);
+
+		tst::check_eq(num_decodes, 1u, SL);
+		tst::check(data_of(a) == data_of(b), SL);
+
+		auto m = cache.get_metrics();
+		tst::check_eq(m.hits, uint64_t(1), SL);
+		tst::check_eq(m.misses, uint64_t(1), SL);
+		tst::check_eq(m.coalesced, uint64_t(0), SL);
+		tst::check_eq(m.evictions, uint64_t(0), SL);
+		tst::check_eq(m.num_images, size_t(1), SL);
+		tst::check_eq(m.size_bytes, image_size_bytes, SL);
+
+		// modification of returned image does not modify the cached one
+		b.span().get<uint8_t, 4>()[0][0] = {1, 2, 3, 4};
+		auto c = cache.get("a", decoder);
+		tst::check(data_of(c) == data_of(a), SL);
+		tst::check(data_of(c) != data_of(b), SL);
+
+		cache.clear();
+		tst::check_eq(cache.get_metrics().num_images, size_t(0), SL);
+		cache.get("a", decoder);
+		tst::check_eq(num_decodes, 2u, SL);
+	});
+
+	suite.add("lru_eviction", []() {
+		rasterimage::image_cache cache(image_size_bytes * 2, 1);
+
+		std::vector<std::string> decoded;
+		auto decoder = [&decoded](const std::string& key) {
+			return [&decoded, key]() {
+				decoded.push_back(key);
+				return make_image();
+			};
+		};
+
+		cache.get("a", decoder("a"));
+		cache.get("b", decoder("b"));
+		cache.get("a", decoder("a"));
+		cache.get("c", decoder("c"));
+
+		// "b" is least recently used one
+		tst::check_eq(cache.get_metrics().evictions, uint64_t(1), SL);
+
+		cache.get("a", decoder("a"));
+		cache.get("b", decoder("b"));
+
+		tst::check(decoded == std::vector<std::string>{"a", "b", "c", "b"}, SL);
+
+		auto m = cache.get_metrics();
+		tst::check_eq(m.num_images, size_t(2), SL);
+		tst::check_eq(m.size_bytes, image_size_bytes * 2, SL);
+	});
+
+	suite.add("too_big_image_is_not_cached", []() {
+		rasterimage::image_cache cache(image_size_bytes - 1, 1);
+
+		unsigned num_decodes = 0;
+		auto decoder = [&num_decodes]() {
+			++num_decodes;
+			return make_image();
+		};
+
+		auto im = cache.get("a", decoder);
+		tst::check_eq(im.dims(), r4::vector2<uint32_t>{10, 10}, SL);
+		cache.get("a", decoder);
+
+		tst::check_eq(num_decodes, 2u, SL);
+		tst::check_eq(cache.get_metrics().num_images, size_t(0), SL);
+	});
+
+	suite.add("coalescing", []() {
+		rasterimage::image_cache cache(image_size_bytes * 100);
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		bool release = false;
+		std::atomic<unsigned> num_decodes{0};
+
+		auto decoder = [&]() {
+			++num_decodes;
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&release]() {
+				return release;
+			});
+			return make_image(1);
+		};
+
+		constexpr size_t num_threads = 4;
+		std::array<const uint8_t*, num_threads> data{};
+		std::vector<std::thread> threads;
+		for (size_t i = 0; i != num_threads; ++i) {
+			threads.emplace_back([&, i]() {
+				data[i] = data_of(cache.get("a", decoder));
+			});
+		}
+
+		// wait until all the requests are issued
+		while (cache.get_metrics().hits + cache.get_metrics().misses != num_threads) {
+			std::this_thread::yield();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			release = true;
+		}
+		cv.notify_all();
+
+		for (auto& t : threads) {
+			t.join();
+		}
+
+		tst::check_eq(num_decodes.load(), 1u, SL);
+		for (auto d : data) {
+			tst::check(d == data[0], SL);
+		}
+
+		auto m = cache.get_metrics();
+		tst::check_eq(m.misses, uint64_t(1), SL);
+		tst::check_eq(m.hits, uint64_t(num_threads - 1), SL);
+		tst::check_eq(m.coalesced, uint64_t(num_threads - 1), SL);
+	});
+
+	suite.add("decoder_exception", []() {
+		rasterimage::image_cache cache(image_size_bytes * 100);
+
+		bool thrown = false;
+		try {
+			cache.get("a", []() -> rasterimage::image_variant {
+				throw std::runtime_error("decoding failed");
+			});
+		} catch (std::runtime_error&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+
+		// failed image is not cached
+		auto im = cache.get("a", []() {
+			return make_image();
+		});
+		tst::check(!im.empty(), SL);
+		tst::check_eq(cache.get_metrics().misses, uint64_t(2), SL);
+	});
+
+	suite.add("read_file", []() {
+		rasterimage::image_cache cache(image_size_bytes * 100);
+
+		fsif::memory_file fi;
+		make_image(3).write_png(fi);
+
+		auto a = cache.read(fi);
+		auto b = cache.read(fi);
+		tst::check(data_of(a) == data_of(b), SL);
+		tst::check_eq(cache.get_metrics().misses, uint64_t(1), SL);
+
+		// other contents get other key
+		fsif::memory_file other_fi;
+		make_image(4).write_png(other_fi);
+		auto c = cache.read(other_fi);
+		tst::check(data_of(c) != data_of(a), SL);
+		tst::check_eq(c.span().get<uint8_t, 4>()[0][0], r4::vector4<uint8_t>{4, 4, 4, 0xff}, SL);
+	});
+
+	suite.add("read_file_key_collision", []() {
+		rasterimage::image_cache cache(image_size_bytes * 100);
+
+		fsif::memory_file fi;
+		make_image(3).write_png(fi);
+
+		// cache other image under the same key, as if other contents had the same hash
+		auto key = rasterimage::image_cache::make_content_key(fi.load());
+		auto other = cache.get(key, []() {
+			return make_image(4);
+		});
+
+		auto a = cache.read(fi);
+		tst::check(data_of(a) != data_of(other), SL);
+		tst::check_eq(a.span().get<uint8_t, 4>()[0][0], r4::vector4<uint8_t>{3, 3, 3, 0xff}, SL);
+		tst::check_eq(cache.get_metrics().hits, uint64_t(0), SL);
+		tst::check_eq(cache.get_metrics().misses, uint64_t(2), SL);
+
+		// the colliding contents are not cached, the cached image is kept
+		auto b = cache.read(fi);
+		tst::check(data_of(b) != data_of(a), SL);
+		auto c = cache.get(key, []() {
+			return make_image(5);
+		});
+		tst::check(data_of(c) == data_of(other), SL);
+		tst::check_eq(cache.get_metrics().num_images, size_t(1), SL);
+	});
+
+	suite.add("read_path", []() {
+		auto path = (std::filesystem::temp_directory_path() / "rasterimage_image_cache_test.png").string();
+		make_image(5).write_png(fsif::native_file(path));
+
+		rasterimage::image_cache cache(image_size_bytes * 100);
+
+		auto a = cache.read(path);
+		auto b = cache.read(path);
+		tst::check(data_of(a) == data_of(b), SL);
+		tst::check_eq(a.span().get<uint8_t, 4>()[9][9], r4::vector4<uint8_t>{5, 5, 5, 0xff}, SL);
+		tst::check_eq(cache.get_metrics().misses, uint64_t(1), SL);
+
+		std::filesystem::remove(path);
+	});
+});
+} // namespace
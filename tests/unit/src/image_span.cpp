@@ -365,7 +365,7 @@ const tst::set set("image_span", [](tst::suite& suite) {
 		auto im = img.span();
 		auto subim = im.subspan({1, 2, 2, 3});
 
-		tst::check_eq(im.stride_pixels(), unsigned(100), SL);
+		tst::check_eq(im.stride_pixels(), size_t(100), SL);
 		tst::check_eq(im.stride_bytes(), 100 * sizeof(decltype(img)::pixel_type), SL);
 		tst::check_eq(subim.stride_pixels(), im.stride_pixels(), SL);
 		tst::check_eq(subim.stride_bytes(), im.stride_bytes(), SL);
@@ -454,6 +454,28 @@ const tst::set set("image_span", [](tst::suite& suite) {
 		}
 	});
 
+	suite.add<unsigned>("flip_horizontal", {1, 2, 3, 4, 5, 10, 13}, [](const auto& p) {
+		rasterimage::image<int, 4> img(rasterimage::dimensioned::dimensions_type{p, 2});
+
+		auto im = img.span();
+		for (size_t i = 0; i != im.dims().x(); ++i) {
+			int c = int(i * 10);
+			im[0][i] = {c, c + 1, c + 2, c + 3};
+			im[1][i] = {c, c + 4, c + 5, c + 6};
+		}
+
+		im.flip_horizontal();
+
+		for (size_t i = 0; i != im.dims().x(); ++i) {
+			int c = int(im.dims().x() - i - 1) * 10;
+			decltype(im)::pixel_type expected0 = {c, c + 1, c + 2, c + 3};
+			decltype(im)::pixel_type expected1 = {c, c + 4, c + 5, c + 6};
+
+			tst::check_eq(im[0][i], expected0, SL);
+			tst::check_eq(im[1][i], expected1, SL);
+		}
+	});
+
 	suite.add("get_span_of_an_empty_image", []() {
 		rasterimage::image<int, 4> img;
 
@@ -461,7 +483,7 @@ const tst::set set("image_span", [](tst::suite& suite) {
 
 		tst::check_eq(span.dims(), rasterimage::dimensioned::dimensions_type{0, 0}, SL);
 		tst::check(span.data() == img.pixels().data(), SL);
-		tst::check_eq(span.stride_pixels(), unsigned(0), SL);
+		tst::check_eq(span.stride_pixels(), size_t(0), SL);
 		tst::check_eq(span.stride_bytes(), size_t(0), SL);
 	});
 
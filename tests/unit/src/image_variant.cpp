@@ -1,8 +1,43 @@
+#include <cmath>
+
+#include <fsif/memory_file.hpp>
 #include <rasterimage/image_variant.hpp>
 #include <tst/check.hpp>
 #include <tst/set.hpp>
 #include <utki/enum_iterable.hpp>
 
+namespace {
+// convert pixel to floating point one with given number of channels, same way as decoders do
+template <size_t to_num_channels, typename value_type, size_t num_channels>
+r4::vector<float, to_num_channels> to_float_pixel(const r4::vector<value_type, num_channels>& px)
+{
+	auto rgba = rasterimage::get_rgba(rasterimage::to<float>(px));
+
+	// libpng converts RGB to greyscale in linear light
+	auto grey = [&rgba]() {
+		if constexpr (num_channels < 3) {
+			return rgba.r();
+		} else {
+			constexpr auto gamma = 2.2f;
+			auto linear = rasterimage::luminance(rgba.comp_op([](auto c) {
+				return std::pow(c, gamma);
+			}));
+			return std::pow(linear, 1 / gamma);
+		}
+	}();
+
+	if constexpr (to_num_channels == 1) {
+		return {grey};
+	} else if constexpr (to_num_channels == 2) {
+		return {grey, rgba.a()};
+	} else if constexpr (to_num_channels == 3) {
+		return {rgba.r(), rgba.g(), rgba.b()};
+	} else {
+		return rgba;
+	}
+}
+} // namespace
+
 namespace {
 const tst::set set("image_variant", [](tst::suite& suite) {
 	suite.add<std::tuple<rasterimage::format, rasterimage::depth, size_t>>(
@@ -50,5 +85,302 @@ const tst::set set("image_variant", [](tst::suite& suite) {
 			}
 		}
 	});
+
+	suite.add("probe_and_read_memory_file", []() {
+		rasterimage::image_variant im({13, 7}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+
+		fsif::memory_file fi;
+		im.write_png(fi);
+
+		// memory file has no suffix, so file format is detected by signature
+		auto info = rasterimage::probe(fi);
+		tst::check_eq(info.dims, im.dims(), SL);
+		tst::check(info.pixel_format == rasterimage::format::rgba, SL);
+		tst::check(info.channel_depth == rasterimage::depth::uint_8_bit, SL);
+		tst::check_eq(info.buffer_size_bytes(), size_t(13 * 7 * 4), SL);
+
+		auto read_im = rasterimage::read(fi);
+		tst::check_eq(read_im.dims(), im.dims(), SL);
+	});
+
+	suite.add("buffer_size_bytes_of_more_than_4_gigapixels", []() {
+		rasterimage::image_info info = {{0x10001, 0x10000}, rasterimage::format::rgba, rasterimage::depth::float_16_bit};
+
+		if (sizeof(size_t) < sizeof(uint64_t)) {
+			tst::check(
+				[&info]() {
+					try {
+						info.buffer_size_bytes();
+					} catch (rasterimage::size_limit_error&) {
+						return true;
+					}
+					return false;
+				}(),
+				SL
+			);
+			return;
+		}
+
+		tst::check_eq(uint64_t(info.buffer_size_bytes()), uint64_t(0x10001) * 0x10000 * 4 * 2, SL);
+	});
+
+	suite.add<r4::rectangle<uint32_t>>(
+		"read_png_roi",
+		{
+			{{0, 0}, {10, 10}},
+			{{7, 3}, {20, 30}},
+			{{0, 0}, {37, 41}},
+			{{36, 40}, {1, 1}},
+			{{5, 5}, {0, 0}},
+		},
+		[](const auto& roi) {
+			rasterimage::image_variant im({37, 41}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+			auto& rgba = im.get<rasterimage::format::rgba>();
+			for (uint32_t y = 0; y != rgba.dims().y(); ++y) {
+				for (uint32_t x = 0; x != rgba.dims().x(); ++x) {
+					rgba[y][x] = r4::vector4<uint8_t>{uint8_t(x), uint8_t(y), uint8_t(x * y), 0xff};
+				}
+			}
+
+			fsif::memory_file fi;
+			im.write_png(fi);
+
+			rasterimage::image_variant read_im = rasterimage::read(fi, roi);
+			tst::check_eq(read_im.dims(), roi.d, SL);
+
+			const auto& read_rgba = read_im.get<rasterimage::format::rgba>();
+			for (uint32_t y = 0; y != roi.d.y(); ++y) {
+				for (uint32_t x = 0; x != roi.d.x(); ++x) {
+					tst::check_eq(read_rgba[y][x], rgba[y + roi.p.y()][x + roi.p.x()], SL);
+				}
+			}
+		}
+	);
+
+	suite.add<std::tuple<rasterimage::format, rasterimage::depth, unsigned>>(
+		"write_png_multithreaded",
+		[]() {
+			std::vector<std::tuple<rasterimage::format, rasterimage::depth, unsigned>> ret;
+			for (auto d : {rasterimage::depth::uint_8_bit, rasterimage::depth::uint_16_bit}) {
+				for (auto f : utki::enum_iterable_v<rasterimage::format>) {
+					for (unsigned num_threads : {1, 4}) {
+						ret.emplace_back(f, d, num_threads);
+					}
+				}
+			}
+			return ret;
+		}(),
+		[](const auto& p) {
+			// big enough to be split into several bands
+			rasterimage::image_variant im(
+				{301, 700},
+				std::get<rasterimage::format>(p),
+				std::get<rasterimage::depth>(p)
+			);
+
+			// fill with a mix of smooth and noisy content
+			std::visit(
+				[](auto& image) {
+					auto bytes = utki::make_span(
+						// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+						reinterpret_cast<uint8_t*>(image.pixels().data()),
+						image.pixels().size_bytes()
+					);
+					uint32_t state = 1;
+					for (size_t i = 0; i != bytes.size(); ++i) {
+						state = state * 1103515245 + 12345;
+						bytes[i] = (i / 1000) % 2 == 0 ? uint8_t(i / 7) : uint8_t(state >> 24);
+					}
+				},
+				im.variant
+			);
+
+			fsif::memory_file fi;
+			im.write_png(fi, std::get<unsigned>(p));
+
+			// PNG stores channels in canonical order, read the image back in the written format
+			auto read_im = rasterimage::read(fi, im.get_format(), im.get_depth());
+			tst::check_eq(read_im.dims(), im.dims(), SL);
+			tst::check(read_im.get_format() == im.get_format(), SL);
+			tst::check(read_im.get_depth() == im.get_depth(), SL);
+
+			std::visit(
+				[](const auto& image, const auto& read_image) {
+					if constexpr (std::is_same_v<decltype(image), decltype(read_image)>) {
+						auto a = image.pixels();
+						auto b = read_image.pixels();
+						tst::check(std::equal(a.begin(), a.end(), b.begin(), b.end()), SL);
+					} else {
+						tst::check(false, SL);
+					}
+				},
+				im.variant,
+				read_im.variant
+			);
+
+			// file contents must be same as of the image converted to canonical format
+			auto canonical_read_im = rasterimage::read(fi);
+			tst::check(canonical_read_im.get_format() == rasterimage::to_canonical(im.get_format()), SL);
+			std::visit(
+				[&im](const auto& image, const auto& read_image) {
+					if constexpr (std::is_same_v<decltype(image), decltype(read_image)>) {
+						auto a = image.pixels();
+						auto b = read_image.pixels();
+						tst::check(
+							std::equal(
+								a.begin(),
+								a.end(),
+								b.begin(),
+								b.end(),
+								[&im](const auto& pa, const auto& pb) {
+									return rasterimage::to_canonical_order(im.get_format(), pa) == pb;
+								}
+							),
+							SL
+						);
+					} else {
+						tst::check(false, SL);
+					}
+				},
+				im.variant,
+				canonical_read_im.variant
+			);
+		}
+	);
+
+	suite.add<rasterimage::depth>(
+		"write_png_multithreaded_floating_point_throws",
+		{rasterimage::depth::float_32_bit, rasterimage::depth::float_16_bit},
+		[](const auto& d) {
+			rasterimage::image_variant im({13, 7}, rasterimage::format::rgba, d);
+
+			fsif::memory_file fi;
+			tst::check(
+				[&im, &fi]() {
+					try {
+						im.write_png(fi, 2);
+						return false;
+					} catch (std::invalid_argument&) {
+						return true;
+					}
+				}(),
+				SL
+			);
+		}
+	);
+
+	suite.add<rasterimage::format>(
+		"write_png_four_channel_formats",
+		{rasterimage::format::rgba, rasterimage::format::bgra, rasterimage::format::argb},
+		[](const auto& f) {
+			rasterimage::image<uint8_t, 4> image(r4::vector2<uint32_t>{13, 7});
+			for (uint32_t y = 0; y != image.dims().y(); ++y) {
+				for (uint32_t x = 0; x != image.dims().x(); ++x) {
+					image[y][x] = {uint8_t(x * 19), uint8_t(y * 31), uint8_t(x * y), uint8_t(x + y * 13)};
+				}
+			}
+
+			rasterimage::image_variant im(rasterimage::image<uint8_t, 4>(image), f);
+			tst::check(im.get_format() == f, SL);
+
+			// format with other number of channels than the image has
+			tst::check(
+				[&image]() {
+					try {
+						rasterimage::image_variant v(rasterimage::image<uint8_t, 4>(image), rasterimage::format::bgr);
+						return false;
+					} catch (std::invalid_argument&) {
+						return true;
+					}
+				}(),
+				SL
+			);
+
+			fsif::memory_file fi;
+			im.write_png(fi);
+
+			auto read_im = rasterimage::read(fi);
+			tst::check(read_im.get_format() == rasterimage::format::rgba, SL);
+			tst::check_eq(read_im.dims(), im.dims(), SL);
+
+			const auto& read_image = read_im.get<rasterimage::format::rgba>();
+			for (uint32_t y = 0; y != image.dims().y(); ++y) {
+				for (uint32_t x = 0; x != image.dims().x(); ++x) {
+					tst::check_eq(read_image[y][x], rasterimage::to_canonical_order(f, image[y][x]), SL)
+						<< "x = " << x << ", y = " << y;
+				}
+			}
+		}
+	);
+
+	suite.add<std::tuple<rasterimage::format, rasterimage::depth, rasterimage::format, rasterimage::depth>>(
+		"read_png_converted",
+		[]() {
+			std::vector<std::tuple<rasterimage::format, rasterimage::depth, rasterimage::format, rasterimage::depth>> ret;
+			for (auto d : {rasterimage::depth::uint_8_bit, rasterimage::depth::uint_16_bit}) {
+				for (auto f : utki::enum_iterable_v<rasterimage::format>) {
+					for (auto to_d : utki::enum_iterable_v<rasterimage::depth>) {
+						for (auto to_f : utki::enum_iterable_v<rasterimage::format>) {
+							ret.emplace_back(f, d, to_f, to_d);
+						}
+					}
+				}
+			}
+			return ret;
+		}(),
+		[](const auto& p) {
+			auto [from_format, from_depth, to_format, to_depth] = p;
+
+			rasterimage::image_variant im({17, 9}, from_format, from_depth);
+
+			std::visit(
+				[](auto& image) {
+					auto bytes = utki::make_span(
+						// NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+						reinterpret_cast<uint8_t*>(image.pixels().data()),
+						image.pixels().size_bytes()
+					);
+					for (size_t i = 0; i != bytes.size(); ++i) {
+						bytes[i] = uint8_t(i * 37);
+					}
+				},
+				im.variant
+			);
+
+			fsif::memory_file fi;
+			im.write_png(fi, 1);
+
+			auto read_im = rasterimage::read(fi, to_format, to_depth);
+			tst::check_eq(read_im.dims(), im.dims(), SL);
+			tst::check(read_im.get_format() == to_format, SL);
+			tst::check(read_im.get_depth() == to_depth, SL);
+
+			std::visit(
+				[from_format = from_format, to_format = to_format](const auto& image, const auto& read_image) {
+					constexpr auto num_channels = std::remove_reference_t<decltype(read_image)>::num_channels;
+					constexpr auto from_num_channels = std::remove_reference_t<decltype(image)>::num_channels;
+
+					// allow rounding errors of 8 bit values,
+					// greyscale conversion in linear light has additional error from libpng's 8 bit gamma tables
+					constexpr auto tolerance = (from_num_channels >= 3 && num_channels < 3) ? 2.5f / 255 : 1.5f / 255;
+
+					for (uint32_t y = 0; y != image.dims().y(); ++y) {
+						for (uint32_t x = 0; x != image.dims().x(); ++x) {
+							auto expected =
+								to_float_pixel<num_channels>(rasterimage::to_canonical_order(from_format, image[y][x]));
+							auto actual =
+								to_float_pixel<num_channels>(rasterimage::to_canonical_order(to_format, read_image[y][x]));
+							for (size_t i = 0; i != num_channels; ++i) {
+								tst::check(std::abs(expected[i] - actual[i]) <= tolerance, SL)
+									<< "x = " << x << ", y = " << y << ", expected = " << expected << ", actual = " << actual;
+							}
+						}
+					}
+				},
+				im.variant,
+				read_im.variant
+			);
+		}
+	);
 });
 } // namespace
@@ -0,0 +1,119 @@
+#include <fsif/memory_file.hpp>
+#include <rasterimage/image_variant.hpp>
+#include <rasterimage/instrumentation.hpp>
+#include <rasterimage/pnm.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+rasterimage::image_variant make_test_image()
+{
+	rasterimage::image_variant im(
+		rasterimage::dimensioned::dimensions_type{33, 17},
+		rasterimage::format::rgba,
+		rasterimage::depth::uint_8_bit
+	);
+	im.get<rasterimage::format::rgba, rasterimage::depth::uint_8_bit>().span().clear({10, 20, 30, 40});
+	return im;
+}
+} // namespace
+
+namespace {
+const tst::set set("instrumentation", [](tst::suite& suite) {
+	suite.add("disabled_by_default", []() {
+		auto im = make_test_image();
+
+		fsif::memory_file fi;
+		im.write_png(fi);
+		rasterimage::read_png(fi);
+
+		{
+			rasterimage::instrumentation::collector c;
+			tst::check(c.stats.empty(), SL);
+		}
+	});
+
+	suite.add("png_write_and_read", []() {
+		auto im = make_test_image();
+
+		rasterimage::instrumentation::collector c;
+
+		fsif::memory_file fi;
+		im.write_png(fi);
+		auto png_size = fi.reset_data();
+		fi.reset_data(png_size);
+
+		auto read_im = rasterimage::read_png(fi);
+
+		tst::check_eq(read_im.dims(), im.dims(), SL);
+
+		tst::check_eq(c.stats.size(), size_t(2), SL);
+
+		const auto& w = c.stats[0];
+		tst::check(w.op == rasterimage::instrumentation::operation::write_png, SL);
+		tst::check_eq(w.num_rows, uint64_t(17), SL);
+		tst::check_eq(w.num_bytes_read, uint64_t(0), SL);
+		tst::check_eq(w.num_bytes_written, uint64_t(png_size.size()), SL);
+		tst::check(w.num_io_calls != 0, SL);
+		tst::check(w.total_duration().count() > 0, SL);
+		tst::check_eq(w.duration(rasterimage::instrumentation::phase::decode).count(), 0, SL);
+
+		const auto& r = c.stats[1];
+		tst::check(r.op == rasterimage::instrumentation::operation::read_png, SL);
+		tst::check_eq(r.num_rows, uint64_t(17), SL);
+		tst::check_eq(r.num_bytes_written, uint64_t(0), SL);
+		tst::check(r.num_bytes_read != 0, SL);
+		tst::check(r.num_bytes_read <= png_size.size(), SL);
+		tst::check(r.num_io_calls != 0, SL);
+		tst::check_eq(r.duration(rasterimage::instrumentation::phase::encode).count(), 0, SL);
+	});
+
+	suite.add("pnm_read_to_span", []() {
+		auto im = make_test_image();
+
+		fsif::memory_file fi;
+		rasterimage::write_pnm(fi, im.span());
+		auto pnm_size = fi.reset_data();
+		fi.reset_data(pnm_size);
+
+		rasterimage::instrumentation::collector c;
+
+		rasterimage::image_variant read_im(im.dims(), im.get_format(), im.get_depth());
+		rasterimage::read_pnm(fi, read_im.span());
+
+		tst::check_eq(c.stats.size(), size_t(1), SL);
+
+		const auto& r = c.stats[0];
+		tst::check(r.op == rasterimage::instrumentation::operation::read_pnm, SL);
+		tst::check_eq(r.num_rows, uint64_t(17), SL);
+		tst::check_eq(r.num_bytes_read, uint64_t(pnm_size.size()), SL);
+		tst::check_eq(r.num_bytes_written, uint64_t(0), SL);
+	});
+
+	suite.add("set_sink_returns_previous_sink", []() {
+		size_t num_calls = 0;
+
+		auto prev = rasterimage::instrumentation::set_sink([&](const auto&) {
+			++num_calls;
+		});
+		tst::check(!prev, SL);
+
+		{
+			rasterimage::instrumentation::collector c;
+
+			fsif::memory_file fi;
+			make_test_image().write_png(fi);
+
+			tst::check_eq(c.stats.size(), size_t(1), SL);
+			tst::check_eq(num_calls, size_t(0), SL);
+		}
+
+		fsif::memory_file fi;
+		make_test_image().write_png(fi);
+		tst::check_eq(num_calls, size_t(1), SL);
+
+		auto sink = rasterimage::instrumentation::set_sink(nullptr);
+		tst::check(bool(sink), SL);
+	});
+});
+} // namespace
@@ -0,0 +1,438 @@
+#include <algorithm>
+#include <cmath>
+
+#include <fsif/memory_file.hpp>
+#include <rasterimage/image_variant.hpp>
+#include <utki/enum_iterable.hpp>
+#include <rasterimage/push_decoder.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+// JPEG lib does not have 'extern "C"{}'
+extern "C" {
+#include <jpeglib.h>
+}
+
+namespace {
+struct jpeg_params {
+	r4::vector2<uint32_t> dims;
+	int num_components;
+
+	// sampling factors of the first component, other components have sampling factors of 1
+	int h_samp;
+	int v_samp;
+
+	// restart interval in MCU rows, takes precedence over restart_interval
+	int restart_in_rows;
+
+	// restart interval in MCUs
+	unsigned restart_interval;
+
+	bool progressive;
+};
+
+std::vector<uint8_t> make_jpeg(const jpeg_params& p)
+{
+	jpeg_compress_struct cinfo{};
+	jpeg_error_mgr jerr{};
+	cinfo.err = jpeg_std_error(&jerr);
+	jpeg_create_compress(&cinfo);
+	utki::scope_exit cinfo_scope_exit([&cinfo]() {
+		jpeg_destroy_compress(&cinfo);
+	});
+
+	unsigned char* buffer = nullptr;
+	unsigned long size = 0;
+	jpeg_mem_dest(&cinfo, &buffer, &size);
+
+	cinfo.image_width = p.dims.x();
+	cinfo.image_height = p.dims.y();
+	cinfo.input_components = p.num_components;
+	cinfo.in_color_space = p.num_components == 1 ? JCS_GRAYSCALE : JCS_RGB;
+	jpeg_set_defaults(&cinfo);
+
+	cinfo.comp_info[0].h_samp_factor = p.h_samp;
+	cinfo.comp_info[0].v_samp_factor = p.v_samp;
+	cinfo.restart_in_rows = p.restart_in_rows;
+	cinfo.restart_interval = p.restart_interval;
+
+	if (p.progressive) {
+		jpeg_simple_progression(&cinfo);
+	}
+
+	jpeg_start_compress(&cinfo, TRUE);
+
+	std::vector<JSAMPLE> row(size_t(p.dims.x()) * size_t(p.num_components));
+	uint32_t state = 1;
+	while (cinfo.next_scanline < cinfo.image_height) {
+		for (size_t i = 0; i != row.size(); ++i) {
+			state = state * 1103515245 + 12345;
+			row[i] = JSAMPLE((i + cinfo.next_scanline * 3) / 5 + (state >> 28));
+		}
+		JSAMPROW r = row.data();
+		jpeg_write_scanlines(&cinfo, &r, 1);
+	}
+
+	jpeg_finish_compress(&cinfo);
+
+	std::vector<uint8_t> ret(buffer, std::next(buffer, ptrdiff_t(size)));
+	// NOLINTNEXTLINE(cppcoreguidelines-no-malloc)
+	free(buffer);
+	return ret;
+}
+
+bool equal_pixels(const rasterimage::image_variant& a, const rasterimage::image_variant& b)
+{
+	if (a.variant.index() != b.variant.index() || a.dims() != b.dims()) {
+		return false;
+	}
+	return std::visit(
+		[](const auto& a_image, const auto& b_image) {
+			if constexpr (std::is_same_v<decltype(a_image), decltype(b_image)>) {
+				auto pa = a_image.pixels();
+				auto pb = b_image.pixels();
+				return std::equal(pa.begin(), pa.end(), pb.begin(), pb.end());
+			} else {
+				return false;
+			}
+		},
+		a.variant,
+		b.variant
+	);
+}
+} // namespace
+
+namespace {
+const tst::set set("jpeg", [](tst::suite& suite) {
+	suite.add<jpeg_params>(
+		"read_jpeg_multithreaded",
+		{
+			// greyscale, restart every MCU row
+			{{640, 480}, 1, 1, 1, 1, 0, false},
+			// 4:2:0, restart every MCU row, chroma upsampling needs neighbour MCU rows
+			{{1001, 701}, 3, 2, 2, 1, 0, false},
+			// 4:2:2, restart every 3 MCU rows
+			{{800, 500}, 3, 2, 1, 3, 0, false},
+			// 4:4:4
+			{{700, 450}, 3, 1, 1, 1, 0, false},
+			// restart interval not aligned to MCU rows
+			{{640, 480}, 3, 2, 2, 0, 7, false},
+			// restart interval longer than MCU row
+			{{640, 480}, 3, 2, 2, 0, 100, false},
+			// no restart markers, single-threaded decoding
+			{{640, 480}, 3, 2, 2, 0, 0, false},
+			// progressive, single-threaded decoding
+			{{640, 480}, 3, 2, 2, 1, 0, true},
+		},
+		[](const auto& p) {
+			auto data = make_jpeg(p);
+
+			auto expected = rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)));
+
+			auto im = rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)), 4);
+
+			tst::check_eq(im.dims(), p.dims, SL);
+			tst::check(im.get_format() == expected.get_format(), SL);
+			tst::check(equal_pixels(im, expected), SL);
+		}
+	);
+
+	suite.add("read_jpeg_multithreaded_corrupted_data", []() {
+		// restart every MCU row
+		auto data = make_jpeg({{640, 480}, 3, 2, 2, 1, 0, false});
+
+		// corrupt entropy coded data of one restart segment,
+		// libjpeg only warns about corrupted entropy coded data, so the image is still decoded
+		{
+			auto corrupted = data;
+			const std::array<uint8_t, 2> rst3 = {0xff, 0xd3};
+			auto i = std::search(corrupted.begin(), corrupted.end(), rst3.begin(), rst3.end());
+			tst::check(i != corrupted.end(), SL);
+			std::fill_n(std::next(i, rst3.size()), 16, uint8_t(0x55));
+
+			auto im = rasterimage::read_jpeg(fsif::memory_file(std::move(corrupted)), 4);
+			tst::check_eq(im.dims(), r4::vector2<uint32_t>{640, 480}, SL);
+		}
+
+		// Make Huffman table invalid, reading the header does not check it,
+		// it is checked when decompression is started, i.e. by the threads decoding the restart segments.
+		{
+			auto corrupted = data;
+			const std::array<uint8_t, 2> dht = {0xff, 0xc4};
+			auto i = std::search(corrupted.begin(), corrupted.end(), dht.begin(), dht.end());
+			tst::check(i != corrupted.end(), SL);
+
+			// marker is followed by 2 bytes of segment length, 1 byte of table class and id,
+			// then 16 numbers of codes of each length
+			auto counts_begin = std::next(i, 5);
+			auto counts_end = std::next(counts_begin, 16);
+			auto max_count = std::max_element(counts_begin, counts_end);
+			tst::check(*max_count >= 3, SL);
+
+			// 3 codes of 1 bit length do not fit, total number of codes is kept same
+			*max_count -= 3;
+			*counts_begin += 3;
+
+			bool thrown = false;
+			try {
+				rasterimage::read_jpeg(fsif::memory_file(std::move(corrupted)), 4);
+			} catch (std::invalid_argument&) {
+				thrown = true;
+			}
+			tst::check(thrown, SL);
+		}
+	});
+
+	suite.add<r4::rectangle<uint32_t>>(
+		"read_jpeg_roi",
+		{
+			{{0, 0}, {10, 10}},
+			{{17, 33}, {100, 57}},
+			// aligned to iMCU boundaries
+			{{16, 32}, {64, 64}},
+			{{1, 1}, {318, 238}},
+			{{0, 0}, {320, 240}},
+			{{300, 200}, {20, 40}},
+			{{5, 5}, {0, 0}},
+		},
+		[](const auto& roi) {
+			for (int num_components : {1, 3}) {
+				auto data = make_jpeg({{320, 240}, num_components, 2, 2, 0, 0, false});
+
+				auto full = rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)));
+
+				auto im = rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)), roi);
+
+				tst::check_eq(im.dims(), roi.d, SL);
+				tst::check(im.get_format() == full.get_format(), SL);
+
+				std::visit(
+					[&roi](const auto& image, const auto& full_image) {
+						if constexpr (std::is_same_v<decltype(image), decltype(full_image)>) {
+							auto expected = full_image.span().subspan(roi);
+							for (uint32_t y = 0; y != roi.d.y(); ++y) {
+								tst::check(std::equal(image[y].begin(), image[y].end(), expected[y].begin()), SL)
+									<< "y = " << y;
+							}
+						} else {
+							tst::check(false, SL);
+						}
+					},
+					im.variant,
+					full.variant
+				);
+			}
+		}
+	);
+
+	suite.add("read_jpeg_roi_to_span", []() {
+		auto data = make_jpeg({{320, 240}, 3, 2, 2, 0, 0, false});
+
+		r4::rectangle<uint32_t> roi = {{40, 50}, {30, 20}};
+
+		auto full = rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)));
+
+		// decode to the middle of a bigger image
+		rasterimage::image<uint8_t, 3> im(r4::vector2<uint32_t>{100, 100});
+		im.span().clear({0, 0, 0});
+
+		rasterimage::read_jpeg(
+			fsif::memory_file(std::vector<uint8_t>(data)),
+			roi,
+			im.span().subspan({{10, 20}, roi.d})
+		);
+
+		const auto& full_image = full.get<rasterimage::format::rgb>();
+		for (uint32_t y = 0; y != roi.d.y(); ++y) {
+			for (uint32_t x = 0; x != roi.d.x(); ++x) {
+				tst::check_eq(im[y + 20][x + 10], full_image[y + roi.p.y()][x + roi.p.x()], SL);
+			}
+		}
+		tst::check_eq(im[0][0], r4::vector3<uint8_t>(0), SL);
+
+		// pixel type mismatch
+		rasterimage::image<uint8_t, 4> rgba_im(roi.d);
+		bool thrown = false;
+		try {
+			rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)), roi, rgba_im.span());
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+
+		// region out of the image
+		thrown = false;
+		try {
+			rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)), {{300, 0}, {21, 10}});
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+	});
+
+	suite.add<std::tuple<rasterimage::format, rasterimage::depth>>(
+		"read_jpeg_to_external_buffer",
+		{
+			{rasterimage::format::rgb, rasterimage::depth::uint_8_bit},
+			{rasterimage::format::bgra, rasterimage::depth::uint_8_bit},
+			{rasterimage::format::greya, rasterimage::depth::uint_16_bit},
+			{rasterimage::format::argb, rasterimage::depth::float_32_bit},
+		},
+		[](const auto& p) {
+			auto [pixel_format, channel_depth] = p;
+
+			auto data = make_jpeg({{101, 67}, 3, 2, 2, 0, 0, false});
+
+			auto expected =
+				rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)), pixel_format, channel_depth);
+
+			// decode to the middle of a bigger image
+			rasterimage::image_variant im({120, 80}, pixel_format, channel_depth);
+			r4::rectangle<uint32_t> rect = {{10, 5}, {101, 67}};
+			rasterimage::read(fsif::memory_file(std::vector<uint8_t>(data)), im.span().subspan(rect));
+
+			auto dst = rasterimage::const_any_image_span(im.span()).subspan(rect);
+			auto src = rasterimage::const_any_image_span(expected.span());
+			for (uint32_t y = 0; y != rect.d.y(); ++y) {
+				tst::check(std::equal(dst[y].begin(), dst[y].end(), src[y].begin(), src[y].end()), SL) << "y = " << y;
+			}
+		}
+	);
+
+	suite.add<std::tuple<int, rasterimage::format, rasterimage::depth>>(
+		"read_jpeg_converted",
+		[]() {
+			std::vector<std::tuple<int, rasterimage::format, rasterimage::depth>> ret;
+			for (int num_components : {1, 3}) {
+				for (auto d : utki::enum_iterable_v<rasterimage::depth>) {
+					for (auto f : utki::enum_iterable_v<rasterimage::format>) {
+						ret.emplace_back(num_components, f, d);
+					}
+				}
+			}
+			return ret;
+		}(),
+		[](const auto& p) {
+			auto [num_components, to_format, to_depth] = p;
+
+			auto data = make_jpeg({{67, 45}, num_components, 2, 2, 0, 0, false});
+
+			auto native = rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)));
+
+			auto im = rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)), to_format, to_depth);
+			tst::check_eq(im.dims(), native.dims(), SL);
+			tst::check(im.get_format() == to_format, SL);
+			tst::check(im.get_depth() == to_depth, SL);
+
+			std::visit(
+				[to_format = to_format](const auto& native_image, const auto& image) {
+					constexpr auto num_channels = std::remove_reference_t<decltype(image)>::num_channels;
+					using channel_type = typename std::remove_reference_t<decltype(image)>::pixel_type::value_type;
+					constexpr auto native_num_channels = std::remove_reference_t<decltype(native_image)>::num_channels;
+
+					float luma_error = 0;
+
+					for (uint32_t y = 0; y != image.dims().y(); ++y) {
+						for (uint32_t x = 0; x != image.dims().x(); ++x) {
+							// round native pixel to the channel type of the converted image, e.g. to half precision
+							auto native_px = rasterimage::get_rgba(
+								rasterimage::to<float>(rasterimage::to<channel_type>(native_image[y][x]))
+							);
+							auto px = rasterimage::get_rgba(
+								rasterimage::to<float>(rasterimage::to_canonical_order(to_format, image[y][x]))
+							);
+
+							if constexpr (num_channels < 3 && native_num_channels >= 3) {
+								// greyscale is the luma channel of the JPEG image, while decoded RGB values are
+								// rounded and clamped, so luma calculated from them only matches on average
+								auto luma = 0.299f * native_px.r() + 0.587f * native_px.g() + 0.114f * native_px.b();
+								luma_error += std::abs(px.r() - luma);
+								tst::check_eq(px.a(), 1.0f, SL);
+							} else {
+								tst::check_eq(px, native_px, SL) << "x = " << x << ", y = " << y;
+							}
+						}
+					}
+
+					auto mean_luma_error = luma_error / float(image.dims().x() * image.dims().y());
+					tst::check(mean_luma_error <= 1.0f / 255, SL) << "mean_luma_error = " << mean_luma_error;
+				},
+				native.variant,
+				im.variant
+			);
+		}
+	);
+
+	suite.add<int>("read_jpeg_preview", {1, 3}, [](const auto& num_components) {
+		auto data = make_jpeg({{320, 240}, num_components, 2, 2, 0, 0, true});
+
+		auto full = rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)));
+
+		// DC coefficients only
+		auto coarse = rasterimage::read_jpeg_preview(fsif::memory_file(std::vector<uint8_t>(data)), 1);
+		tst::check_eq(coarse.dims(), full.dims(), SL);
+		tst::check(coarse.get_format() == full.get_format(), SL);
+		tst::check(!equal_pixels(coarse, full), SL);
+
+		// more scans than there is in the file
+		auto complete = rasterimage::read_jpeg_preview(fsif::memory_file(std::vector<uint8_t>(data)), 100);
+		tst::check(equal_pixels(complete, full), SL);
+
+		// non-progressive image is decoded completely
+		auto baseline_data = make_jpeg({{320, 240}, num_components, 2, 2, 0, 0, false});
+		tst::check(
+			equal_pixels(
+				rasterimage::read_jpeg_preview(fsif::memory_file(std::vector<uint8_t>(baseline_data)), 1),
+				rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(baseline_data)))
+			),
+			SL
+		);
+
+		bool thrown = false;
+		try {
+			rasterimage::read_jpeg_preview(fsif::memory_file(std::vector<uint8_t>(data)), 0);
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+	});
+
+	suite.add<size_t>("push_decoder_progressive_refinement", {100, 1000, 1000000}, [](const auto& chunk_size) {
+		auto data = make_jpeg({{320, 240}, 3, 2, 2, 0, 0, true});
+
+		auto full = rasterimage::read_jpeg(fsif::memory_file(std::vector<uint8_t>(data)));
+
+		rasterimage::push_decoder decoder;
+
+		unsigned last_num_scans = 0;
+		unsigned num_refinements = 0;
+		uint32_t num_rows = 0;
+
+		decoder.callbacks.refinement = [&](unsigned num_scans) {
+			tst::check(num_scans > last_num_scans, SL);
+			tst::check_eq(num_rows, uint32_t(0), SL);
+			last_num_scans = num_scans;
+			++num_refinements;
+		};
+		decoder.callbacks.rows = [&](uint32_t begin, uint32_t end) {
+			tst::check_eq(begin, num_rows, SL);
+			num_rows = end;
+		};
+
+		for (size_t pos = 0; pos < data.size(); pos += chunk_size) {
+			decoder.push(utki::make_span(data).subspan(pos, std::min(chunk_size, data.size() - pos)));
+		}
+
+		tst::check(decoder.get_status() == rasterimage::push_decoder::status::done, SL);
+		tst::check_eq(num_rows, full.dims().y(), SL);
+		if (chunk_size < data.size()) {
+			tst::check(num_refinements != 0, SL);
+		} else {
+			// all scans are received at once, so no intermediate refinements
+			tst::check_eq(num_refinements, unsigned(0), SL);
+		}
+
+		tst::check(equal_pixels(decoder.take_image(), full), SL);
+	});
+});
+} // namespace
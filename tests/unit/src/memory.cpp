@@ -0,0 +1,115 @@
+#include <rasterimage/image_variant.hpp>
+#include <rasterimage/memory.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+const tst::set set("memory", [](tst::suite& suite) {
+	suite.add("tagged_live_and_peak_bytes", []() {
+		constexpr uint64_t tag = 0x1234'5678;
+
+		{
+			rasterimage::memory_tag_scope tag_scope(tag);
+
+			rasterimage::image<uint8_t, 4> a(rasterimage::dimensioned::dimensions_type{10, 20});
+			tst::check_eq(rasterimage::get_memory_usage(tag).live_bytes, size_t(10 * 20 * 4), SL);
+
+			{
+				rasterimage::image<uint16_t, 3> b(rasterimage::dimensioned::dimensions_type{5, 7});
+				tst::check_eq(rasterimage::get_memory_usage(tag).live_bytes, size_t(800 + 5 * 7 * 3 * 2), SL);
+
+				// copy is accounted, move is not
+				auto c = b;
+				auto d = std::move(c);
+				tst::check_eq(rasterimage::get_memory_usage(tag).live_bytes, size_t(800 + 210 * 2), SL);
+			}
+
+			auto u = rasterimage::get_memory_usage(tag);
+			tst::check_eq(u.live_bytes, size_t(800), SL);
+			tst::check_eq(u.peak_bytes, size_t(800 + 210 * 2), SL);
+		}
+
+		auto u = rasterimage::get_memory_usage(tag);
+		tst::check_eq(u.live_bytes, size_t(0), SL);
+		tst::check_eq(u.peak_bytes, size_t(800 + 210 * 2), SL);
+
+		rasterimage::release_memory_tag(tag);
+		tst::check_eq(rasterimage::get_memory_usage(tag).peak_bytes, size_t(0), SL);
+	});
+
+	suite.add("untagged_allocations_are_not_accounted_under_tag", []() {
+		constexpr uint64_t tag = 13;
+
+		rasterimage::image<uint8_t, 1> a(rasterimage::dimensioned::dimensions_type{10, 10});
+
+		{
+			rasterimage::memory_tag_scope tag_scope(tag);
+			rasterimage::image<uint8_t, 1> b(rasterimage::dimensioned::dimensions_type{10, 10});
+			{
+				rasterimage::memory_tag_scope no_tag_scope(0);
+				rasterimage::image<uint8_t, 1> c(rasterimage::dimensioned::dimensions_type{10, 10});
+				tst::check_eq(rasterimage::get_memory_usage(tag).live_bytes, size_t(100), SL);
+			}
+		}
+
+		rasterimage::release_memory_tag(tag);
+	});
+
+	suite.add("depth_and_format_breakdown", []() {
+		auto before = rasterimage::get_memory_usage(rasterimage::depth::float_32_bit, rasterimage::format::greya);
+		auto total_before = rasterimage::get_memory_usage();
+
+		rasterimage::image_variant im(
+			{100, 100},
+			rasterimage::format::greya,
+			rasterimage::depth::float_32_bit
+		);
+
+		constexpr size_t expected_size = 100 * 100 * 2 * sizeof(float);
+
+		auto after = rasterimage::get_memory_usage(rasterimage::depth::float_32_bit, rasterimage::format::greya);
+		tst::check_ge(after.live_bytes, before.live_bytes + expected_size, SL);
+		tst::check_ge(after.peak_bytes, after.live_bytes, SL);
+		tst::check_ge(rasterimage::get_memory_usage().live_bytes, total_before.live_bytes + expected_size, SL);
+	});
+
+	suite.add("peak_of_released_image", []() {
+		rasterimage::reset_memory_peaks();
+		auto before = rasterimage::get_memory_usage();
+
+		{
+			rasterimage::image<uint16_t, 4> im(rasterimage::dimensioned::dimensions_type{300, 200});
+		}
+
+		constexpr size_t image_size = 300 * 200 * 4 * sizeof(uint16_t);
+
+		auto after = rasterimage::get_memory_usage();
+		tst::check_ge(after.peak_bytes, before.live_bytes + image_size, SL);
+		tst::check_ge(
+			rasterimage::get_memory_usage(rasterimage::depth::uint_16_bit, rasterimage::format::rgba).peak_bytes,
+			image_size,
+			SL
+		);
+	});
+
+	suite.add("soft_limit", []() {
+		constexpr size_t limit_headroom = 1024 * 1024;
+		rasterimage::set_memory_soft_limit(rasterimage::get_memory_usage().live_bytes + limit_headroom);
+
+		bool thrown = false;
+		try {
+			rasterimage::image<uint8_t, 4> im(rasterimage::dimensioned::dimensions_type{1024, 1024});
+		} catch (rasterimage::memory_limit_exceeded& e) {
+			thrown = true;
+			tst::check_eq(e.requested_bytes, size_t(1024 * 1024 * 4), SL);
+		}
+
+		rasterimage::set_memory_soft_limit(0);
+
+		tst::check(thrown, SL);
+
+		// no limit
+		rasterimage::image<uint8_t, 4> im(rasterimage::dimensioned::dimensions_type{1024, 1024});
+	});
+});
+} // namespace
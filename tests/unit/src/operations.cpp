@@ -28,6 +28,29 @@ const tst::set set("operations", [](tst::suite& suite) {
 		tst::check_eq(pixel, r4::vector4<uint8_t>{0x0f, 0x1f, 0x2f, 0x3f}, SL) << std::hex << " pixel = 0x" << pixel;
 	});
 
+	suite.add("to_float16__from_uint16_t", []() {
+		r4::vector4<uint16_t> px = {0, 0x8000, 0xffff, 0x4000};
+
+		auto pixel = rasterimage::to<rasterimage::float16>(px);
+
+		// 16 bit values are not representable in half precision, the conversion must not overflow
+		tst::check_eq(pixel.to<float>(), r4::vector4<float>{0, 0.5f, 1, 0.25f}, SL);
+	});
+
+	suite.add("to_uint16_t__from_float16", []() {
+		r4::vector4<rasterimage::float16> px = {0.0f, 0.5f, 1.0f, 0.25f};
+
+		auto pixel = rasterimage::to<uint16_t>(px);
+
+		tst::check_eq(pixel, r4::vector4<uint16_t>{0, 0x7fff, 0xffff, 0x3fff}, SL) << std::hex << " pixel = 0x" << pixel;
+	});
+
+	suite.add("multiply__float16", []() {
+		auto res = rasterimage::multiply(rasterimage::float16(0.5f), rasterimage::float16(0.25f));
+
+		tst::check_eq(float(res), 0.125f, SL);
+	});
+
 	suite.add("to_uint8_t__from_float", []() {
 		r4::vector4<float> px = {0.125f, 0.25f, 0.5f, 0.75f};
 
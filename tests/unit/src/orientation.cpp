@@ -0,0 +1,134 @@
+#include <algorithm>
+
+#include <rasterimage/image.hpp>
+#include <rasterimage/orientation.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+template <typename image_type>
+image_type make_test_image(rasterimage::dimensioned::dimensions_type dims)
+{
+	image_type img(dims);
+	for (uint32_t y = 0; y != dims.y(); ++y) {
+		for (uint32_t x = 0; x != dims.x(); ++x) {
+			auto& px = img[y][x];
+			for (size_t i = 0; i != px.size(); ++i) {
+				// every pixel gets a unique value
+				px[i] = typename image_type::pixel_type::value_type((y * dims.x() + x) * px.size() + i);
+			}
+		}
+	}
+	return img;
+}
+
+// clang-format off
+const std::vector<rasterimage::dimensioned::dimensions_type> test_dims = {
+	{1, 1},
+	{1, 7},
+	{7, 1},
+	{4, 4},
+	{5, 3},
+	{37, 70},
+	{100, 33},
+	{129, 130}
+};
+// clang-format on
+
+template <typename image_type>
+void check_rotations(rasterimage::dimensioned::dimensions_type dims)
+{
+	auto src = make_test_image<image_type>(dims);
+
+	rasterimage::dimensioned::dimensions_type transposed_dims = {dims.y(), dims.x()};
+
+	image_type transposed(transposed_dims);
+	rasterimage::transpose(src.span(), transposed.span());
+
+	image_type rotated_90(transposed_dims);
+	rasterimage::rotate_90(src.span(), rotated_90.span());
+
+	image_type rotated_270(transposed_dims);
+	rasterimage::rotate_270(src.span(), rotated_270.span());
+
+	image_type rotated_180(dims);
+	rasterimage::rotate_180(src.span(), rotated_180.span());
+
+	auto w = dims.x();
+	auto h = dims.y();
+
+	for (uint32_t y = 0; y != h; ++y) {
+		for (uint32_t x = 0; x != w; ++x) {
+			const auto& px = src[y][x];
+			tst::check_eq(transposed[x][y], px, SL) << "dims = " << dims << ", x = " << x << ", y = " << y;
+			tst::check_eq(rotated_90[x][h - 1 - y], px, SL) << "dims = " << dims << ", x = " << x << ", y = " << y;
+			tst::check_eq(rotated_270[w - 1 - x][y], px, SL) << "dims = " << dims << ", x = " << x << ", y = " << y;
+			tst::check_eq(rotated_180[h - 1 - y][w - 1 - x], px, SL)
+				<< "dims = " << dims << ", x = " << x << ", y = " << y;
+		}
+	}
+
+	auto in_place = src;
+	rasterimage::rotate_180(in_place.span());
+	tst::check(std::equal(in_place.pixels().begin(), in_place.pixels().end(), rotated_180.pixels().begin()), SL) << "dims = " << dims;
+
+	if (w == h) {
+		in_place = src;
+		rasterimage::transpose(in_place.span());
+		tst::check(std::equal(in_place.pixels().begin(), in_place.pixels().end(), transposed.pixels().begin()), SL) << "dims = " << dims;
+
+		in_place = src;
+		rasterimage::rotate_90(in_place.span());
+		tst::check(std::equal(in_place.pixels().begin(), in_place.pixels().end(), rotated_90.pixels().begin()), SL) << "dims = " << dims;
+
+		in_place = src;
+		rasterimage::rotate_270(in_place.span());
+		tst::check(std::equal(in_place.pixels().begin(), in_place.pixels().end(), rotated_270.pixels().begin()), SL) << "dims = " << dims;
+	}
+}
+
+const tst::set set("orientation", [](tst::suite& suite) {
+	suite.add<rasterimage::dimensioned::dimensions_type>("rotations__uint8_t_4", test_dims, [](const auto& p) {
+		check_rotations<rasterimage::image<uint8_t, 4>>(p);
+	});
+
+	suite.add<rasterimage::dimensioned::dimensions_type>("rotations__uint8_t_1", test_dims, [](const auto& p) {
+		check_rotations<rasterimage::image<uint8_t, 1>>(p);
+	});
+
+	suite.add<rasterimage::dimensioned::dimensions_type>("rotations__uint16_t_3", test_dims, [](const auto& p) {
+		check_rotations<rasterimage::image<uint16_t, 3>>(p);
+	});
+
+	suite.add<rasterimage::dimensioned::dimensions_type>("rotations__float_1", test_dims, [](const auto& p) {
+		check_rotations<rasterimage::image<float, 1>>(p);
+	});
+
+	suite.add<rasterimage::dimensioned::dimensions_type>("rotations__uint32_t_1", test_dims, [](const auto& p) {
+		check_rotations<rasterimage::image<uint32_t, 1>>(p);
+	});
+
+	suite.add("rotations__subspan", []() {
+		auto src = make_test_image<rasterimage::image<uint8_t, 4>>(rasterimage::dimensioned::dimensions_type{20, 30});
+		rasterimage::image<uint8_t, 4> dst(rasterimage::dimensioned::dimensions_type{40, 40});
+		dst.span().clear(0);
+
+		auto src_span = src.span().subspan({{3, 5}, {9, 13}});
+		auto dst_span = dst.span().subspan({{7, 2}, {13, 9}});
+
+		rasterimage::rotate_90(src_span, dst_span);
+
+		for (uint32_t y = 0; y != src_span.dims().y(); ++y) {
+			for (uint32_t x = 0; x != src_span.dims().x(); ++x) {
+				tst::check_eq(dst_span[x][src_span.dims().y() - 1 - y], src_span[y][x], SL);
+			}
+		}
+
+		// pixels outside of the destination subspan are untouched
+		tst::check_eq(dst[0][0], decltype(dst)::pixel_type(0), SL);
+		tst::check_eq(dst[2][6], decltype(dst)::pixel_type(0), SL);
+		tst::check_eq(dst[2][20], decltype(dst)::pixel_type(0), SL);
+		tst::check_eq(dst[11][7], decltype(dst)::pixel_type(0), SL);
+	});
+});
+} // namespace
@@ -0,0 +1,173 @@
+#include <algorithm>
+
+#include <fsif/memory_file.hpp>
+#include <rasterimage/push_decoder.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+#include <utki/util.hpp>
+
+#include <png.h>
+
+namespace {
+template <rasterimage::depth depth_enum>
+void fill(rasterimage::image_variant& im)
+{
+	using value_type = rasterimage::depth_type_t<depth_enum>;
+	auto& rgba = im.get<rasterimage::format::rgba, depth_enum>();
+	for (uint32_t y = 0; y != im.dims().y(); ++y) {
+		for (uint32_t x = 0; x != im.dims().x(); ++x) {
+			// values are truncated for 8 bit images and span the whole range of 16 bit ones
+			rgba[y][x] = {value_type(x * 1031), value_type(y * 4099), value_type(x * y * 263), value_type((x + y) * 517)};
+		}
+	}
+}
+
+rasterimage::image_variant make_image(r4::vector2<uint32_t> dims, rasterimage::depth d)
+{
+	rasterimage::image_variant im(dims, rasterimage::format::rgba, d);
+	if (d == rasterimage::depth::uint_16_bit) {
+		fill<rasterimage::depth::uint_16_bit>(im);
+	} else {
+		fill<rasterimage::depth::uint_8_bit>(im);
+	}
+	return im;
+}
+
+bool equal_pixels(const rasterimage::image_variant& a, const rasterimage::image_variant& b)
+{
+	if (a.variant.index() != b.variant.index() || a.dims() != b.dims()) {
+		return false;
+	}
+	return std::visit(
+		[](const auto& a_image, const auto& b_image) {
+			if constexpr (std::is_same_v<decltype(a_image), decltype(b_image)>) {
+				auto pa = a_image.pixels();
+				auto pb = b_image.pixels();
+				return std::equal(pa.begin(), pa.end(), pb.begin(), pb.end());
+			} else {
+				return false;
+			}
+		},
+		a.variant,
+		b.variant
+	);
+}
+
+// writes the image with libpng directly, since rasterimage does not write interlaced PNG images
+std::vector<uint8_t> make_png(const rasterimage::image_variant& im, bool interlaced)
+{
+	auto png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+	auto info_ptr = png_create_info_struct(png_ptr);
+	utki::scope_exit png_scope_exit([&png_ptr, &info_ptr]() {
+		png_destroy_write_struct(&png_ptr, &info_ptr);
+	});
+
+	std::vector<uint8_t> ret;
+	png_set_write_fn(
+		png_ptr,
+		&ret,
+		[](png_structp png_ptr, png_bytep data, png_size_t length) {
+			auto& buf = *static_cast<std::vector<uint8_t>*>(png_get_io_ptr(png_ptr));
+			// NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+			buf.insert(buf.end(), data, data + length);
+		},
+		nullptr
+	);
+
+	png_set_IHDR(
+		png_ptr,
+		info_ptr,
+		im.dims().x(),
+		im.dims().y(),
+		im.get_depth() == rasterimage::depth::uint_16_bit ? 16 : 8,
+		PNG_COLOR_TYPE_RGB_ALPHA,
+		interlaced ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE,
+		PNG_COMPRESSION_TYPE_DEFAULT,
+		PNG_FILTER_TYPE_DEFAULT
+	);
+	png_write_info(png_ptr, info_ptr);
+
+	// PNG stores 16 bit samples in big-endian byte order
+	if (im.get_depth() == rasterimage::depth::uint_16_bit) {
+		png_set_swap(png_ptr);
+	}
+
+	std::vector<png_bytep> rows;
+	std::visit(
+		[&rows](const auto& image) {
+			for (uint32_t y = 0; y != image.dims().y(); ++y) {
+				// NOLINTNEXTLINE(cppcoreguidelines-pro-type-const-cast, cppcoreguidelines-pro-type-reinterpret-cast)
+				rows.push_back(const_cast<png_bytep>(reinterpret_cast<const uint8_t*>(image[y].data())));
+			}
+		},
+		im.variant
+	);
+
+	png_write_image(png_ptr, rows.data());
+	png_write_end(png_ptr, nullptr);
+
+	return ret;
+}
+} // namespace
+
+namespace {
+const tst::set set("png", [](tst::suite& suite) {
+	suite.add<std::tuple<rasterimage::depth, bool>>(
+		"read_png",
+		{
+			{rasterimage::depth::uint_8_bit, false},
+			{rasterimage::depth::uint_8_bit, true},
+			{rasterimage::depth::uint_16_bit, false},
+			{rasterimage::depth::uint_16_bit, true},
+		},
+		[](const auto& p) {
+			auto expected = make_image({37, 23}, std::get<rasterimage::depth>(p));
+			fsif::memory_file fi(make_png(expected, std::get<bool>(p)));
+
+			auto info = rasterimage::probe_png(fi);
+			tst::check_eq(info.dims, expected.dims(), SL);
+			tst::check(info.pixel_format == rasterimage::format::rgba, SL);
+			tst::check(info.channel_depth == expected.get_depth(), SL);
+
+			auto im = rasterimage::read_png(fi);
+			tst::check(im.get_format() == rasterimage::format::rgba, SL);
+			tst::check(im.get_depth() == expected.get_depth(), SL);
+			tst::check(equal_pixels(im, expected), SL);
+		}
+	);
+
+	suite.add<size_t>(
+		"push_decoder_interlaced_final_rows",
+		{1, 13, 100},
+		[](const auto& chunk_size) {
+			auto expected = make_image({37, 23}, rasterimage::depth::uint_8_bit);
+			auto data = make_png(expected, true);
+
+			const auto& expected_rgba = expected.get<rasterimage::format::rgba, rasterimage::depth::uint_8_bit>();
+
+			rasterimage::push_decoder decoder;
+
+			uint32_t num_rows = 0;
+			decoder.callbacks.rows = [&](uint32_t begin, uint32_t end) {
+				tst::check_eq(begin, num_rows, SL);
+				num_rows = end;
+
+				// rows reported as final hold their final pixels already
+				const auto& rgba = decoder.image().get<rasterimage::format::rgba, rasterimage::depth::uint_8_bit>();
+				for (uint32_t y = begin; y != end; ++y) {
+					auto r = rgba[y];
+					auto er = expected_rgba[y];
+					tst::check(std::equal(r.begin(), r.end(), er.begin(), er.end()), SL) << "y = " << y;
+				}
+			};
+
+			for (size_t pos = 0; pos < data.size(); pos += chunk_size) {
+				decoder.push(utki::make_span(data).subspan(pos, std::min(chunk_size, data.size() - pos)));
+			}
+
+			tst::check(decoder.get_status() == rasterimage::push_decoder::status::done, SL);
+			tst::check_eq(num_rows, expected.dims().y(), SL);
+		}
+	);
+});
+} // namespace
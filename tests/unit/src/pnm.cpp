@@ -0,0 +1,270 @@
+#include <sstream>
+
+#include <fsif/memory_file.hpp>
+#include <rasterimage/compare.hpp>
+#include <rasterimage/pnm.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+#include <utki/enum_iterable.hpp>
+
+namespace {
+rasterimage::image_variant make_image(
+	r4::vector2<uint32_t> dims,
+	rasterimage::format pixel_format,
+	rasterimage::depth channel_depth
+)
+{
+	rasterimage::image_variant rgba(dims, rasterimage::format::rgba, rasterimage::depth::uint_16_bit);
+	auto& im = rgba.get<rasterimage::format::rgba, rasterimage::depth::uint_16_bit>();
+	for (uint32_t y = 0; y != dims.y(); ++y) {
+		for (uint32_t x = 0; x != dims.x(); ++x) {
+			im[y][x] = {uint16_t(x * 1000 + 1), uint16_t(y * 3000 + 2), uint16_t((x ^ y) * 517), uint16_t(x * y * 99)};
+		}
+	}
+
+	rasterimage::image_variant ret(dims, pixel_format, channel_depth);
+	rasterimage::convert(rgba.span(), ret.span());
+	return ret;
+}
+
+std::vector<uint8_t> to_bytes(const std::string& str)
+{
+	return {str.begin(), str.end()};
+}
+
+template <typename exception_type, typename function_type>
+bool throws(function_type func)
+{
+	try {
+		func();
+	} catch (exception_type&) {
+		return true;
+	}
+	return false;
+}
+} // namespace
+
+namespace {
+const tst::set set("pnm", [](tst::suite& suite) {
+	std::vector<std::tuple<rasterimage::format, rasterimage::depth, rasterimage::pnm_type>> params;
+	for (auto f : utki::enum_iterable_v<rasterimage::format>) {
+		for (auto d : {rasterimage::depth::uint_8_bit, rasterimage::depth::uint_16_bit}) {
+			for (auto t : utki::enum_iterable_v<rasterimage::pnm_type>) {
+				params.emplace_back(f, d, t);
+			}
+		}
+	}
+
+	suite.add<std::tuple<rasterimage::format, rasterimage::depth, rasterimage::pnm_type>>(
+		"write_read",
+		std::move(params),
+		[](const auto& p) {
+			auto [pixel_format, channel_depth, type] = p;
+
+			auto im = make_image({13, 7}, pixel_format, channel_depth);
+
+			// write region, so that the source span has rows with padding
+			r4::rectangle<uint32_t> rect = {{1, 2}, {11, 5}};
+			auto span = std::as_const(im).span().subspan(rect);
+
+			fsif::memory_file fi;
+			rasterimage::write_pnm(fi, span, type);
+
+			auto data = fi.load();
+			auto canonical = rasterimage::to_canonical(pixel_format);
+			char expected_kind = '7';
+			if (type == rasterimage::pnm_type::automatic) {
+				if (canonical == rasterimage::format::grey) {
+					expected_kind = '5';
+				} else if (canonical == rasterimage::format::rgb) {
+					expected_kind = '6';
+				}
+			}
+			tst::check_eq(char(data[0]), 'P', SL);
+			tst::check_eq(char(data[1]), expected_kind, SL);
+
+			// image is read in canonical channel order
+			auto read_im = rasterimage::read_pnm(fi);
+			rasterimage::image_variant expected(rect.d, canonical, channel_depth);
+			rasterimage::convert(span, expected.span());
+			tst::check(rasterimage::compare(read_im.span(), expected.span()).identical(), SL);
+
+			// memory file has no suffix, so the file format is detected by signature
+			auto info = rasterimage::probe(fi);
+			tst::check_eq(info.dims, rect.d, SL);
+			tst::check(info.pixel_format == canonical, SL);
+			tst::check(info.channel_depth == channel_depth, SL);
+
+			// channels are reordered while reading
+			tst::check(rasterimage::compare(rasterimage::read(fi, pixel_format, channel_depth).span(), span).identical(), SL);
+		}
+	);
+
+	suite.add("big_endian_samples", []() {
+		// more values than in one SIMD register and a tail
+		rasterimage::image<uint16_t, 3> im(r4::vector2<uint32_t>{5, 1});
+		for (uint32_t x = 0; x != 5; ++x) {
+			im[0][x] = {uint16_t(0x0102 + x), uint16_t(0xa0b0 + x), uint16_t(0xfe00 + x)};
+		}
+
+		fsif::memory_file fi;
+		rasterimage::write_pnm(fi, im.span());
+
+		auto expected = to_bytes("P6\n5 1\n65535\n");
+		for (uint32_t x = 0; x != 5; ++x) {
+			for (auto v : im[0][x]) {
+				expected.push_back(uint8_t(v >> 8));
+				expected.push_back(uint8_t(v & 0xff));
+			}
+		}
+		tst::check(fi.load() == expected, SL);
+
+		auto read_im = rasterimage::read_pnm(fi);
+		tst::check(rasterimage::compare(read_im.span(), im.span()).identical(), SL);
+	});
+
+	suite.add("header_with_comments", []() {
+		auto data = to_bytes("P6 # comment\n 2\t1 # another comment\n255\n");
+		data.insert(data.end(), {1, 2, 3, 4, 5, 6});
+
+		auto im = rasterimage::read_pnm(fsif::memory_file(std::move(data)));
+		tst::check(im.get_format() == rasterimage::format::rgb, SL);
+		tst::check_eq(im.dims(), r4::vector2<uint32_t>{2, 1}, SL);
+		tst::check_eq(im.get<rasterimage::format::rgb>()[0][1], r4::vector3<uint8_t>{4, 5, 6}, SL);
+
+		// pixel data starting with whitespace values
+		data = to_bytes("P7\n# comment\nWIDTH 2\nHEIGHT 1\nDEPTH 2\nMAXVAL 255\nTUPLTYPE GRAYSCALE_ALPHA\nENDHDR\n");
+		data.insert(data.end(), {' ', '\n', 10, 13});
+
+		im = rasterimage::read_pnm(fsif::memory_file(std::move(data)));
+		tst::check(im.get_format() == rasterimage::format::greya, SL);
+		tst::check_eq(im.get<rasterimage::format::greya>()[0][0], r4::vector2<uint8_t>{' ', '\n'}, SL);
+		tst::check_eq(im.get<rasterimage::format::greya>()[0][1], r4::vector2<uint8_t>{10, 13}, SL);
+	});
+
+	suite.add("maxval_scaling", []() {
+		auto data = to_bytes("P5\n3 1\n15\n");
+		data.insert(data.end(), {0, 15, 16});
+
+		auto im = rasterimage::read_pnm(fsif::memory_file(std::move(data)));
+		tst::check(im.get_depth() == rasterimage::depth::uint_8_bit, SL);
+		auto& grey = im.get<rasterimage::format::grey>();
+		tst::check_eq(unsigned(grey[0][0].x()), 0u, SL);
+		tst::check_eq(unsigned(grey[0][1].x()), 255u, SL);
+		// out of range value is clamped
+		tst::check_eq(unsigned(grey[0][2].x()), 255u, SL);
+
+		data = to_bytes("P5\n2 1\n1023\n");
+		data.insert(data.end(), {0x01, 0xff, 0x03, 0xff});
+
+		im = rasterimage::read_pnm(fsif::memory_file(std::move(data)));
+		tst::check(im.get_depth() == rasterimage::depth::uint_16_bit, SL);
+		auto& grey16 = im.get<rasterimage::format::grey, rasterimage::depth::uint_16_bit>();
+		tst::check_eq(unsigned(grey16[0][0].x()), (0x1ffu * 0xffff + 1023 / 2) / 1023, SL);
+		tst::check_eq(unsigned(grey16[0][1].x()), 0xffffu, SL);
+	});
+
+	suite.add("streams", []() {
+		auto a = make_image({4, 3}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+		auto b = make_image({5, 2}, rasterimage::format::grey, rasterimage::depth::uint_16_bit);
+
+		// two images in one stream, like in a pipe
+		std::stringstream s;
+		rasterimage::write_pnm(s, a.span());
+		rasterimage::write_pnm(s, b.span(), rasterimage::pnm_type::pam);
+
+		tst::check(rasterimage::compare(rasterimage::read_pnm(s).span(), a.span()).identical(), SL);
+		tst::check(rasterimage::compare(rasterimage::read_pnm(s).span(), b.span()).identical(), SL);
+	});
+
+	suite.add("row_by_row", []() {
+		auto im = make_image({6, 4}, rasterimage::format::bgra, rasterimage::depth::uint_16_bit);
+		auto span = std::as_const(im).span();
+
+		fsif::memory_file fi;
+		{
+			rasterimage::pnm_writer writer(fi, {im.dims(), im.get_format(), im.get_depth()});
+			for (uint32_t y = 0; y != im.dims().y(); ++y) {
+				tst::check_eq(writer.num_remaining_rows(), im.dims().y() - y, SL);
+				writer.write_rows(span.subspan({{0, y}, {6, 1}}));
+			}
+			tst::check_eq(writer.num_remaining_rows(), 0u, SL);
+		}
+
+		rasterimage::image_variant read_im(im.dims(), rasterimage::format::argb, rasterimage::depth::uint_16_bit);
+		{
+			rasterimage::pnm_reader reader(fi);
+			tst::check(reader.get_info().pixel_format == rasterimage::format::rgba, SL);
+			tst::check_eq(reader.get_info().dims, im.dims(), SL);
+
+			auto dst = read_im.span();
+			reader.read_rows(dst.subspan({{0, 0}, {6, 1}}));
+			reader.read_rows(dst.subspan({{0, 1}, {6, 3}}));
+			tst::check_eq(reader.num_remaining_rows(), 0u, SL);
+
+			// no more rows
+			tst::check(
+				throws<std::invalid_argument>([&]() {
+					reader.read_rows(dst.subspan({{0, 0}, {6, 1}}));
+				}),
+				SL
+			);
+		}
+
+		rasterimage::image_variant expected(im.dims(), rasterimage::format::argb, rasterimage::depth::uint_16_bit);
+		rasterimage::convert(span, expected.span());
+		tst::check(rasterimage::compare(read_im.span(), expected.span()).identical(), SL);
+	});
+
+	suite.add("invalid_data", []() {
+		auto im = make_image({10, 10}, rasterimage::format::rgb, rasterimage::depth::uint_8_bit);
+
+		fsif::memory_file fi;
+		rasterimage::write_pnm(fi, im.span());
+		auto data = fi.load();
+
+		auto truncated = data;
+		truncated.resize(truncated.size() - 1);
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::read_pnm(fsif::memory_file(std::move(truncated)));
+			}),
+			SL
+		);
+
+		for (const auto& header :
+			 {"P3\n1 1\n255\n", "P6\n1 1\n0\n", "P6\n1 1\n65536\n", "P6\n1 x\n255\n", "P6\n1 1\n255",
+			  "P7\nWIDTH 1\nHEIGHT 1\nDEPTH 5\nMAXVAL 255\nENDHDR\n", "P7\nWIDTH 1\nFOO 1\nENDHDR\n"})
+		{
+			auto bad = to_bytes(header);
+			bad.insert(bad.end(), 20, 0);
+			tst::check(
+				throws<std::invalid_argument>([&]() {
+					rasterimage::read_pnm(fsif::memory_file(std::move(bad)));
+				}),
+				SL
+			);
+		}
+
+		// wrong destination pixel type
+		rasterimage::image<uint8_t, 4> rgba(im.dims());
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::read_pnm(fi, rgba.span());
+			}),
+			SL
+		);
+	});
+
+	suite.add("unsupported_pixel_type", []() {
+		rasterimage::image_variant im({2, 2}, rasterimage::format::rgba, rasterimage::depth::float_32_bit);
+		fsif::memory_file fi;
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::write_pnm(fi, im.span());
+			}),
+			SL
+		);
+	});
+});
+} // namespace
@@ -0,0 +1,280 @@
+#include <algorithm>
+
+#include <fsif/memory_file.hpp>
+#include <rasterimage/push_decoder.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+std::vector<uint8_t> make_png(uint32_t width, uint32_t height)
+{
+	rasterimage::image_variant im({width, height}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+	auto& rgba = im.get<rasterimage::format::rgba, rasterimage::depth::uint_8_bit>();
+	for (uint32_t y = 0; y != height; ++y) {
+		for (uint32_t x = 0; x != width; ++x) {
+			rgba[y][x] = r4::vector4<uint8_t>{uint8_t(x), uint8_t(y), uint8_t(x * y), uint8_t(x + y)};
+		}
+	}
+
+	fsif::memory_file fi;
+	im.write_png(fi);
+	return fi.reset_data();
+}
+
+// 16x8 greyscale JPEG, horizontal gradient with step of 16
+const std::vector<uint8_t> jpeg_data = {
+	0xff, 0xd8, 0xff, 0xe0, 0x00, 0x10, 0x4a, 0x46, 0x49, 0x46, 0x00, 0x01,
+	0x01, 0x00, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0xff, 0xdb, 0x00, 0x43,
+	0x00, 0x03, 0x02, 0x02, 0x03, 0x02, 0x02, 0x03, 0x03, 0x03, 0x03, 0x04,
+	0x03, 0x03, 0x04, 0x05, 0x08, 0x05, 0x05, 0x04, 0x04, 0x05, 0x0a, 0x07,
+	0x07, 0x06, 0x08, 0x0c, 0x0a, 0x0c, 0x0c, 0x0b, 0x0a, 0x0b, 0x0b, 0x0d,
+	0x0e, 0x12, 0x10, 0x0d, 0x0e, 0x11, 0x0e, 0x0b, 0x0b, 0x10, 0x16, 0x10,
+	0x11, 0x13, 0x14, 0x15, 0x15, 0x15, 0x0c, 0x0f, 0x17, 0x18, 0x16, 0x14,
+	0x18, 0x12, 0x14, 0x15, 0x14, 0xff, 0xc0, 0x00, 0x0b, 0x08, 0x00, 0x08,
+	0x00, 0x10, 0x01, 0x01, 0x11, 0x00, 0xff, 0xc4, 0x00, 0x15, 0x00, 0x01,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x08, 0x09, 0xff, 0xc4, 0x00, 0x17, 0x10, 0x00, 0x03,
+	0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x08, 0x44, 0x81, 0xff, 0xda, 0x00, 0x08, 0x01, 0x01,
+	0x00, 0x00, 0x3f, 0x00, 0x1f, 0xad, 0xb2, 0xe1, 0x55, 0x56, 0xd9, 0x70,
+	0xff, 0xd9,
+};
+
+// pushes data in chunks and checks that callbacks are called in proper order
+rasterimage::image_variant push_in_chunks(const std::vector<uint8_t>& data, size_t chunk_size)
+{
+	rasterimage::push_decoder decoder;
+
+	size_t num_header_calls = 0;
+	uint32_t num_rows = 0;
+	bool done = false;
+
+	decoder.callbacks.header = [&](const rasterimage::image_info& info) {
+		tst::check_eq(num_header_calls, size_t(0), SL);
+		tst::check_eq(info.dims, decoder.image().dims(), SL);
+		++num_header_calls;
+	};
+	decoder.callbacks.rows = [&](uint32_t begin, uint32_t end) {
+		tst::check_eq(num_header_calls, size_t(1), SL);
+		tst::check_eq(begin, num_rows, SL);
+		tst::check(begin < end, SL);
+		num_rows = end;
+	};
+	decoder.callbacks.done = [&]() {
+		done = true;
+	};
+
+	auto status = rasterimage::push_decoder::status::need_more_data;
+	for (size_t pos = 0; pos < data.size(); pos += chunk_size) {
+		tst::check(status == rasterimage::push_decoder::status::need_more_data, SL);
+		status = decoder.push(utki::make_span(data).subspan(pos, std::min(chunk_size, data.size() - pos)));
+	}
+
+	tst::check(status == rasterimage::push_decoder::status::done, SL);
+	tst::check(done, SL);
+	tst::check_eq(num_rows, decoder.image().dims().y(), SL);
+
+	return decoder.take_image();
+}
+
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+
+// minimal coroutine type which runs eagerly and is destroyed once finished
+struct task {
+	struct promise_type {
+		task get_return_object() noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void return_void() noexcept {}
+
+		void unhandled_exception() noexcept
+		{
+			std::terminate();
+		}
+	};
+};
+
+task await_decoded(
+	rasterimage::push_decoder& decoder, //
+	std::optional<rasterimage::image_variant>& result,
+	std::exception_ptr& error
+)
+{
+	try {
+		result = co_await rasterimage::decoded(decoder);
+	} catch (...) {
+		error = std::current_exception();
+	}
+}
+
+#endif
+
+template <rasterimage::format pixel_format>
+bool pixels_equal(const rasterimage::image_variant& a, const rasterimage::image_variant& b)
+{
+	auto pa = a.get<pixel_format, rasterimage::depth::uint_8_bit>().pixels();
+	auto pb = b.get<pixel_format, rasterimage::depth::uint_8_bit>().pixels();
+	return std::equal(pa.begin(), pa.end(), pb.begin(), pb.end());
+}
+} // namespace
+
+namespace {
+const tst::set set("push_decoder", [](tst::suite& suite) {
+	suite.add<size_t>("png_in_chunks", {1, 7, 100, 100000}, [](const auto& chunk_size) {
+		auto data = make_png(31, 17);
+
+		auto im = push_in_chunks(data, chunk_size);
+
+		fsif::memory_file fi{std::vector<uint8_t>(data)};
+		auto expected = rasterimage::read(fi);
+
+		tst::check_eq(im.dims(), expected.dims(), SL);
+		tst::check(im.get_format() == rasterimage::format::rgba, SL);
+		tst::check(pixels_equal<rasterimage::format::rgba>(im, expected), SL);
+	});
+
+	suite.add<size_t>("jpeg_in_chunks", {1, 5, 1000}, [](const auto& chunk_size) {
+		auto im = push_in_chunks(jpeg_data, chunk_size);
+
+		fsif::memory_file fi{std::vector<uint8_t>(jpeg_data)};
+		auto expected = rasterimage::read(fi);
+
+		tst::check_eq(im.dims(), rasterimage::dimensioned::dimensions_type{16, 8}, SL);
+		tst::check(im.get_format() == rasterimage::format::grey, SL);
+		tst::check(pixels_equal<rasterimage::format::grey>(im, expected), SL);
+	});
+
+	suite.add("unknown_format_throws", []() {
+		rasterimage::push_decoder decoder;
+
+		std::vector<uint8_t> data = {1, 2, 3, 4};
+
+		bool thrown = false;
+		try {
+			decoder.push(data);
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+		tst::check(decoder.get_status() == rasterimage::push_decoder::status::failed, SL);
+
+		thrown = false;
+		try {
+			decoder.push(data);
+		} catch (std::logic_error&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+	});
+
+	suite.add("corrupted_data_is_reported_to_error_callback", []() {
+		auto png_data = make_png(20, 20);
+		// corrupt IHDR chunk
+		std::fill(std::next(png_data.begin(), 10), std::next(png_data.begin(), 30), uint8_t(0xaa));
+
+		auto corrupted_jpeg_data = jpeg_data;
+		{
+			// set zero image height in SOF0 segment
+			const std::array<uint8_t, 2> sof0 = {0xff, 0xc0};
+			auto i = std::search(corrupted_jpeg_data.begin(), corrupted_jpeg_data.end(), sof0.begin(), sof0.end());
+			tst::check(i != corrupted_jpeg_data.end(), SL);
+			// marker is followed by 2 bytes of segment length and 1 byte of sample precision
+			constexpr auto height_offset = 5;
+			std::fill(std::next(i, height_offset), std::next(i, height_offset + 2), uint8_t(0));
+		}
+
+		for (const auto& data : {png_data, corrupted_jpeg_data}) {
+			auto decoder = std::make_unique<rasterimage::push_decoder>();
+
+			bool error = false;
+			decoder->callbacks.error = [&](std::exception_ptr e) {
+				tst::check(e != nullptr, SL);
+				error = true;
+				// destroying the decoder from the callback is allowed
+				decoder.reset();
+			};
+
+			auto status = decoder->push(data);
+			tst::check(status == rasterimage::push_decoder::status::failed, SL);
+			tst::check(error, SL);
+			tst::check(decoder == nullptr, SL);
+		}
+	});
+
+#if __has_include(<coroutine>) && defined(__cpp_impl_coroutine)
+	suite.add<size_t>("co_await_decoded", {1, 100, 100000}, [](const auto& chunk_size) {
+		auto data = make_png(31, 17);
+
+		rasterimage::push_decoder decoder;
+
+		std::optional<rasterimage::image_variant> im;
+		std::exception_ptr error;
+		await_decoded(decoder, im, error);
+
+		for (size_t pos = 0; pos < data.size(); pos += chunk_size) {
+			tst::check(!im.has_value(), SL);
+			decoder.push(utki::make_span(data).subspan(pos, std::min(chunk_size, data.size() - pos)));
+		}
+
+		tst::check(!error, SL);
+		tst::check(im.has_value(), SL);
+
+		fsif::memory_file fi{std::vector<uint8_t>(data)};
+		auto expected = rasterimage::read(fi);
+
+		tst::check_eq(im.value().dims(), expected.dims(), SL);
+		tst::check(pixels_equal<rasterimage::format::rgba>(im.value(), expected), SL);
+	});
+
+	suite.add("co_await_decoded_already_done", []() {
+		rasterimage::push_decoder decoder;
+		decoder.push(jpeg_data);
+
+		std::optional<rasterimage::image_variant> im;
+		std::exception_ptr error;
+		await_decoded(decoder, im, error);
+
+		tst::check(!error, SL);
+		tst::check(im.has_value(), SL);
+		tst::check_eq(im.value().dims(), rasterimage::dimensioned::dimensions_type{16, 8}, SL);
+	});
+
+	suite.add("co_await_decoded_rethrows_error", []() {
+		auto data = make_png(20, 20);
+		// corrupt IHDR chunk
+		std::fill(std::next(data.begin(), 10), std::next(data.begin(), 30), uint8_t(0xaa));
+
+		rasterimage::push_decoder decoder;
+
+		std::optional<rasterimage::image_variant> im;
+		std::exception_ptr error;
+		await_decoded(decoder, im, error);
+
+		auto status = decoder.push(data);
+		tst::check(status == rasterimage::push_decoder::status::failed, SL);
+		tst::check(!im.has_value(), SL);
+		tst::check(error != nullptr, SL);
+
+		bool thrown = false;
+		try {
+			std::rethrow_exception(error);
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+	});
+#endif
+});
+} // namespace
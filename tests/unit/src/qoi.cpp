@@ -0,0 +1,215 @@
+#include <fsif/memory_file.hpp>
+#include <rasterimage/compare.hpp>
+#include <rasterimage/qoi.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+rasterimage::image_variant make_image(r4::vector2<uint32_t> dims, rasterimage::format pixel_format)
+{
+	rasterimage::image_variant rgba(dims, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+	auto& im = rgba.get<rasterimage::format::rgba>();
+
+	// mix of runs, small differences and noise, so that all QOI operations are used
+	uint32_t state = 0x12345678;
+	for (uint32_t y = 0; y != dims.y(); ++y) {
+		for (uint32_t x = 0; x != dims.x(); ++x) {
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			switch ((x / 16 + y / 4) % 4) {
+				case 0:
+					im[y][x] = {0x20, 0x40, 0x60, 0xff};
+					break;
+				case 1:
+					im[y][x] = {uint8_t(x), uint8_t(x + 1), uint8_t(x + y), 0xff};
+					break;
+				case 2:
+					im[y][x] = {uint8_t(x * 7), uint8_t(x * 3), uint8_t(x * 5), uint8_t(y)};
+					break;
+				default:
+					im[y][x] = {uint8_t(state), uint8_t(state >> 8), uint8_t(state >> 16), uint8_t(state >> 24)};
+					break;
+			}
+		}
+	}
+
+	rasterimage::image_variant ret(dims, pixel_format, rasterimage::depth::uint_8_bit);
+	rasterimage::convert(rgba.span(), ret.span());
+	return ret;
+}
+
+template <typename exception_type, typename function_type>
+bool throws(function_type func)
+{
+	try {
+		func();
+	} catch (exception_type&) {
+		return true;
+	}
+	return false;
+}
+} // namespace
+
+namespace {
+const tst::set set("qoi", [](tst::suite& suite) {
+	suite.add("encode_known_stream", []() {
+		rasterimage::image<uint8_t, 4> im(r4::vector2<uint32_t>{5, 1});
+		im[0][0] = {0, 0, 0, 0xff}; // same as initial previous pixel, run
+		im[0][1] = {1, 1, 1, 0xff}; // diff
+		im[0][2] = {0, 0, 0, 0xff}; // diff, the run pixel is not in the index
+		im[0][3] = {1, 1, 1, 0xff}; // index
+		im[0][4] = {200, 10, 20, 128}; // rgba
+
+		auto encoded = rasterimage::write_qoi(im.span());
+
+		std::vector<uint8_t> expected = {
+			'q', 'o', 'i', 'f', 0, 0, 0, 5, 0, 0, 0, 1, 4, 0, // header
+			0xc0, // run of 1
+			0x7f, // diff +1, +1, +1
+			0x55, // diff -1, -1, -1
+			0x04, // index 4
+			0xff, 200, 10, 20, 128, // rgba
+			0, 0, 0, 0, 0, 0, 0, 1 // end marker
+		};
+		tst::check(encoded == expected, SL);
+
+		auto decoded = rasterimage::read_qoi(encoded);
+		tst::check(rasterimage::compare(decoded.span(), im.span()).identical(), SL);
+	});
+
+	suite.add<rasterimage::format>("write_read_memory", {rasterimage::format::rgb, rasterimage::format::rgba}, [](const auto& f) {
+		auto im = make_image({100, 37}, f);
+
+		// write region, so that the source span has rows with padding
+		r4::rectangle<uint32_t> rect = {{3, 2}, {90, 30}};
+		auto span = std::as_const(im).span().subspan(rect);
+
+		auto encoded = rasterimage::write_qoi(span);
+
+		auto info = rasterimage::probe_qoi(encoded);
+		tst::check_eq(info.dims, rect.d, SL);
+		tst::check(info.pixel_format == f, SL);
+		tst::check(info.channel_depth == rasterimage::depth::uint_8_bit, SL);
+
+		auto decoded = rasterimage::read_qoi(encoded);
+		tst::check(rasterimage::compare(decoded.span(), span).identical(), SL);
+
+		rasterimage::image<uint8_t, 4> rgba(rect.d);
+		rasterimage::read_qoi(encoded, rgba.span());
+
+		rasterimage::image<uint8_t, 4> expected(rect.d);
+		rasterimage::convert(span, expected.span());
+		tst::check(rasterimage::compare(rgba.span(), expected.span()).identical(), SL);
+	});
+
+	suite.add<rasterimage::format>("write_read_file", {rasterimage::format::rgb, rasterimage::format::rgba}, [](const auto& f) {
+		// encoded file is bigger than the stream buffer
+		auto im = make_image({400, 300}, f);
+
+		fsif::memory_file fi;
+		rasterimage::write_qoi(fi, im.span());
+		auto data = fi.load();
+
+		// streaming and in-memory encoders produce same data
+		tst::check(data == rasterimage::write_qoi(im.span()), SL);
+
+		auto decoded = rasterimage::read_qoi(fi);
+		tst::check(rasterimage::compare(decoded.span(), im.span()).identical(), SL);
+
+		rasterimage::image<uint8_t, 3> rgb(im.dims());
+		rasterimage::read_qoi(fi, rgb.span());
+
+		rasterimage::image<uint8_t, 3> expected(im.dims());
+		rasterimage::convert(im.span(), expected.span());
+		tst::check(rasterimage::compare(rgb.span(), expected.span()).identical(), SL);
+	});
+
+	suite.add("read_detects_qoi", []() {
+		auto im = make_image({20, 10}, rasterimage::format::rgba);
+
+		// memory file has no suffix, so the file format is detected by signature
+		fsif::memory_file fi;
+		rasterimage::write_qoi(fi, im.span());
+
+		auto info = rasterimage::probe(fi);
+		tst::check_eq(info.dims, im.dims(), SL);
+		tst::check(info.pixel_format == rasterimage::format::rgba, SL);
+
+		tst::check(rasterimage::compare(rasterimage::read(fi).span(), im.span()).identical(), SL);
+
+		auto converted = rasterimage::read(fi, rasterimage::format::grey, rasterimage::depth::uint_16_bit);
+		rasterimage::image_variant expected(im.dims(), rasterimage::format::grey, rasterimage::depth::uint_16_bit);
+		rasterimage::convert(im.span(), expected.span());
+		tst::check(rasterimage::compare(converted.span(), expected.span()).identical(), SL);
+
+		auto region = rasterimage::read(fi, {{2, 3}, {5, 4}});
+		tst::check(rasterimage::compare(region.span(), std::as_const(im).span().subspan({{2, 3}, {5, 4}})).identical(), SL);
+	});
+
+	suite.add("invalid_data", []() {
+		auto encoded = rasterimage::write_qoi(make_image({50, 50}, rasterimage::format::rgba).span());
+
+		auto truncated = encoded;
+		truncated.resize(truncated.size() / 2);
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::read_qoi(truncated);
+			}),
+			SL
+		);
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::read_qoi(fsif::memory_file(std::move(truncated)));
+			}),
+			SL
+		);
+
+		auto corrupted = encoded;
+		corrupted[0] = 'x';
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::read_qoi(corrupted);
+			}),
+			SL
+		);
+
+		// invalid number of channels
+		corrupted = encoded;
+		corrupted[12] = 2;
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::probe_qoi(corrupted);
+			}),
+			SL
+		);
+	});
+
+	suite.add("unsupported_pixel_type", []() {
+		rasterimage::image_variant im({2, 2}, rasterimage::format::rgba, rasterimage::depth::uint_16_bit);
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::write_qoi(im.span());
+			}),
+			SL
+		);
+
+		auto encoded = rasterimage::write_qoi(make_image({2, 2}, rasterimage::format::rgb).span());
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::read_qoi(encoded, im.span());
+			}),
+			SL
+		);
+
+		// dimensions mismatch
+		rasterimage::image<uint8_t, 3> rgb(r4::vector2<uint32_t>{2, 3});
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::read_qoi(encoded, rgb.span());
+			}),
+			SL
+		);
+	});
+});
+} // namespace
@@ -0,0 +1,255 @@
+#include <filesystem>
+#include <fstream>
+
+#include <fsif/memory_file.hpp>
+#include <fsif/native_file.hpp>
+#include <rasterimage/compare.hpp>
+#include <rasterimage/raw.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+rasterimage::image_variant make_image(
+	r4::vector2<uint32_t> dims,
+	rasterimage::format pixel_format,
+	rasterimage::depth channel_depth
+)
+{
+	rasterimage::image_variant rgba(dims, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+	auto& im = rgba.get<rasterimage::format::rgba>();
+	for (uint32_t y = 0; y != dims.y(); ++y) {
+		for (uint32_t x = 0; x != dims.x(); ++x) {
+			im[y][x] = {uint8_t(x), uint8_t(y), uint8_t(x ^ y), uint8_t(x + y)};
+		}
+	}
+
+	rasterimage::image_variant ret(dims, pixel_format, channel_depth);
+	rasterimage::convert(rgba.span(), ret.span());
+	return ret;
+}
+
+template <typename exception_type, typename function_type>
+bool throws(function_type func)
+{
+	try {
+		func();
+	} catch (exception_type&) {
+		return true;
+	}
+	return false;
+}
+} // namespace
+
+namespace {
+const tst::set set("raw", [](tst::suite& suite) {
+	suite.add<std::tuple<rasterimage::format, rasterimage::depth, rasterimage::raw_compression>>(
+		"write_read",
+		{
+			{rasterimage::format::rgba, rasterimage::depth::uint_8_bit, rasterimage::raw_compression::none},
+			{rasterimage::format::bgr, rasterimage::depth::uint_16_bit, rasterimage::raw_compression::none},
+			{rasterimage::format::grey, rasterimage::depth::float_32_bit, rasterimage::raw_compression::none},
+			{rasterimage::format::greya, rasterimage::depth::float_16_bit, rasterimage::raw_compression::none},
+			{rasterimage::format::rgba, rasterimage::depth::uint_8_bit, rasterimage::raw_compression::deflate},
+			{rasterimage::format::argb, rasterimage::depth::uint_16_bit, rasterimage::raw_compression::deflate},
+			{rasterimage::format::rgb, rasterimage::depth::float_32_bit, rasterimage::raw_compression::deflate},
+		},
+		[](const auto& p) {
+			auto [pixel_format, channel_depth, compression] = p;
+
+			auto im = make_image({37, 23}, pixel_format, channel_depth);
+
+			// write region, so that the source span has rows with padding
+			r4::rectangle<uint32_t> rect = {{3, 2}, {30, 20}};
+			auto span = std::as_const(im).span().subspan(rect);
+
+			fsif::memory_file fi;
+			rasterimage::write_raw(fi, span, compression);
+
+			auto info = rasterimage::probe(fi);
+			tst::check_eq(info.dims, rect.d, SL);
+			tst::check(info.pixel_format == pixel_format, SL);
+			tst::check(info.channel_depth == channel_depth, SL);
+
+			// memory file has no suffix, so the file format is detected by signature
+			auto read_im = rasterimage::read(fi);
+			tst::check(rasterimage::compare(read_im.span(), span).identical(), SL);
+
+			auto region = rasterimage::read(fi, {{1, 2}, {5, 6}});
+			tst::check(rasterimage::compare(region.span(), span.subspan({{1, 2}, {5, 6}})).identical(), SL);
+		}
+	);
+
+	suite.add<unsigned>("deflate_multithreaded", {1, 4, 0}, [](const auto& num_threads) {
+		// several bands of rows
+		auto im = make_image({1024, 700}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+
+		fsif::memory_file fi;
+		rasterimage::write_raw(fi, im.span(), rasterimage::raw_compression::deflate, num_threads);
+
+		auto read_im = rasterimage::read_raw(fi, num_threads);
+		tst::check(rasterimage::compare(read_im.span(), im.span()).identical(), SL);
+	});
+
+	suite.add("read_converted", []() {
+		auto im = make_image({10, 7}, rasterimage::format::rgba, rasterimage::depth::uint_16_bit);
+
+		fsif::memory_file fi;
+		rasterimage::write_raw(fi, im.span());
+
+		auto read_im = rasterimage::read(fi, rasterimage::format::bgra, rasterimage::depth::uint_8_bit);
+
+		rasterimage::image_variant expected(im.dims(), rasterimage::format::bgra, rasterimage::depth::uint_8_bit);
+		rasterimage::convert(im.span(), expected.span());
+		tst::check(rasterimage::compare(read_im.span(), expected.span()).identical(), SL);
+	});
+
+	suite.add("mapped", []() {
+		auto path = (std::filesystem::temp_directory_path() / "rasterimage_raw_test.rimg").string();
+
+		auto im = make_image({37, 23}, rasterimage::format::rgb, rasterimage::depth::float_32_bit);
+		rasterimage::write_raw(fsif::native_file(path), im.span());
+
+		{
+			rasterimage::mapped_raw_image mapped(path);
+			auto span = mapped.span();
+
+			tst::check(rasterimage::compare(span, im.span()).identical(), SL);
+
+			// rows are aligned
+			for (uint32_t y = 0; y != span.dims().y(); ++y) {
+				tst::check_eq(reinterpret_cast<uintptr_t>(span[y].data()) % 64, uintptr_t(0), SL);
+			}
+
+			auto typed = span.get<float, 3>();
+			tst::check_eq(typed[22][36], im.get<rasterimage::format::rgb, rasterimage::depth::float_32_bit>()[22][36], SL);
+		}
+
+		// file is also detected by suffix
+		auto read_im = rasterimage::read(fsif::native_file(path));
+		tst::check(rasterimage::compare(read_im.span(), im.span()).identical(), SL);
+
+		// compressed file cannot be mapped
+		rasterimage::write_raw(fsif::native_file(path), im.span(), rasterimage::raw_compression::deflate);
+		tst::check(
+			throws<std::invalid_argument>([&]() {
+				rasterimage::mapped_raw_image mapped(path);
+			}),
+			SL
+		);
+
+		std::filesystem::remove(path);
+
+		tst::check(
+			throws<std::system_error>([&]() {
+				rasterimage::mapped_raw_image mapped(path);
+			}),
+			SL
+		);
+	});
+
+	suite.add("mapped_huge_sparse", []() {
+		// 4 GiB file cannot be mapped on 32 bit platforms
+		if (sizeof(size_t) < sizeof(uint64_t)) {
+			return;
+		}
+
+		auto path = (std::filesystem::temp_directory_path() / "rasterimage_raw_huge_test.rimg").string();
+
+		// image of more than 2^32 pixels, made by patching header of a small image and extending
+		// the file without writing the pixel data, so that the file is sparse
+		constexpr uint32_t width = 0x10001;
+		constexpr uint32_t height = 0x10000;
+		constexpr uint64_t stride = 65600; // row size aligned to 64 bytes
+		constexpr uint64_t data_offset = 64;
+		constexpr uint64_t data_size = stride * height;
+
+		auto im = make_image({1, 1}, rasterimage::format::grey, rasterimage::depth::uint_8_bit);
+		rasterimage::write_raw(fsif::native_file(path), im.span());
+
+		{
+			std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+
+			auto write_le = [&f](std::streamoff offset, auto value) {
+				std::array<char, sizeof(value)> bytes{};
+				for (auto& b : bytes) {
+					b = char(value & 0xff);
+					value >>= 8;
+				}
+				f.seekp(offset);
+				f.write(bytes.data(), bytes.size());
+			};
+
+			write_le(16, width);
+			write_le(20, height);
+			write_le(24, stride);
+			write_le(48, data_size);
+
+			// pixels beyond 4 GiB offset
+			write_le(std::streamoff(data_offset + stride * (height - 1) + width - 1), uint8_t(42));
+			write_le(std::streamoff(data_offset + stride * (height / 2)), uint8_t(13));
+		}
+		std::filesystem::resize_file(path, data_offset + data_size);
+
+		{
+			rasterimage::mapped_raw_image mapped(path);
+			auto span = mapped.span();
+
+			tst::check_eq(span.dims(), r4::vector2<uint32_t>{width, height}, SL);
+			tst::check_eq(span.stride_bytes(), size_t(stride), SL);
+			tst::check_eq(span[height - 1][width - 1], uint8_t(42), SL);
+			tst::check_eq(span[height / 2][0], uint8_t(13), SL);
+			tst::check_eq(span[height / 2][1], uint8_t(0), SL);
+
+			auto typed = span.get<uint8_t, 1>();
+			tst::check_eq(typed.stride_pixels(), size_t(stride), SL);
+			tst::check_eq(typed[height - 1][width - 1].x(), uint8_t(42), SL);
+			tst::check_eq((*std::next(typed.begin(), height / 2))[0].x(), uint8_t(13), SL);
+
+			auto sub = typed.subspan({{width - 1, height - 1}, {1, 1}});
+			tst::check_eq(sub[0][0].x(), uint8_t(42), SL);
+		}
+
+		std::filesystem::remove(path);
+	});
+
+	suite.add("invalid_file", []() {
+		auto im = make_image({10, 10}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+
+		for (auto compression : {rasterimage::raw_compression::none, rasterimage::raw_compression::deflate}) {
+			fsif::memory_file fi;
+			rasterimage::write_raw(fi, im.span(), compression);
+			auto data = fi.load();
+
+			// truncated
+			auto truncated = data;
+			truncated.resize(truncated.size() / 2);
+			tst::check(
+				throws<std::invalid_argument>([&]() {
+					rasterimage::read_raw(fsif::memory_file(std::move(truncated)));
+				}),
+				SL
+			);
+
+			// corrupted signature
+			auto corrupted = data;
+			corrupted[1] = 'X';
+			tst::check(
+				throws<std::invalid_argument>([&]() {
+					rasterimage::read_raw(fsif::memory_file(std::move(corrupted)));
+				}),
+				SL
+			);
+
+			// invalid pixel format
+			corrupted = data;
+			corrupted[12] = uint8_t(rasterimage::format::enum_size);
+			tst::check(
+				throws<std::invalid_argument>([&]() {
+					rasterimage::read_raw(fsif::memory_file(std::move(corrupted)));
+				}),
+				SL
+			);
+		}
+	});
+});
+} // namespace
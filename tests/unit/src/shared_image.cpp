@@ -0,0 +1,129 @@
+#include <array>
+#include <thread>
+
+#include <rasterimage/shared_image.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+rasterimage::image_variant make_image()
+{
+	rasterimage::image_variant im({20, 10}, rasterimage::format::rgba, rasterimage::depth::uint_8_bit);
+	auto& rgba = im.get<rasterimage::format::rgba>();
+	for (uint32_t y = 0; y != rgba.dims().y(); ++y) {
+		for (uint32_t x = 0; x != rgba.dims().x(); ++x) {
+			rgba[y][x] = {uint8_t(x), uint8_t(y), 0, 0xff};
+		}
+	}
+	return im;
+}
+
+r4::vector4<uint8_t> pixel(rasterimage::const_any_image_span span, uint32_t x, uint32_t y)
+{
+	return span.get<uint8_t, 4>()[y][x];
+}
+} // namespace
+
+namespace {
+const tst::set set("shared_image", [](tst::suite& suite) {
+	suite.add("default_constructor", []() {
+		rasterimage::shared_image im;
+		tst::check(im.empty(), SL);
+		tst::check(im.span().empty(), SL);
+	});
+
+	suite.add("copy_shares_pixels", []() {
+		rasterimage::shared_image a(make_image());
+		auto b = a;
+
+		tst::check_eq(a.use_count(), long(2), SL);
+		tst::check(std::as_const(a).span().data() == std::as_const(b).span().data(), SL);
+		tst::check(b.get_format() == rasterimage::format::rgba, SL);
+		tst::check_eq(b.dims(), r4::vector2<uint32_t>{20, 10}, SL);
+	});
+
+	suite.add("copy_on_write", []() {
+		rasterimage::shared_image a(make_image());
+		auto b = a;
+
+		auto span = b.span();
+		span.get<uint8_t, 4>()[3][5] = {1, 2, 3, 4};
+
+		tst::check_eq(a.use_count(), long(1), SL);
+		tst::check_eq(b.use_count(), long(1), SL);
+		tst::check_eq(pixel(b.span(), 5, 3), r4::vector4<uint8_t>{1, 2, 3, 4}, SL);
+		tst::check_eq(pixel(std::as_const(a).span(), 5, 3), r4::vector4<uint8_t>{5, 3, 0, 0xff}, SL);
+		tst::check_eq(pixel(std::as_const(a).span(), 6, 3), pixel(std::as_const(b).span(), 6, 3), SL);
+
+		// unique image is modified in place
+		auto data = std::as_const(a).span().data();
+		tst::check(a.span().data() == data, SL);
+	});
+
+	suite.add("subimage", []() {
+		rasterimage::shared_image sub;
+		{
+			rasterimage::shared_image im(make_image());
+			sub = im.subimage({{4, 2}, {10, 5}}).subimage({{1, 1}, {3, 3}});
+		}
+
+		// view keeps the pixels alive
+		tst::check_eq(sub.dims(), r4::vector2<uint32_t>{3, 3}, SL);
+		tst::check_eq(pixel(std::as_const(sub).span(), 0, 0), r4::vector4<uint8_t>{5, 3, 0, 0xff}, SL);
+		tst::check_eq(pixel(std::as_const(sub).span(), 2, 2), r4::vector4<uint8_t>{7, 5, 0, 0xff}, SL);
+
+		auto copy = sub.to_image_variant();
+		tst::check_eq(copy.dims(), sub.dims(), SL);
+		tst::check_eq(copy.get<rasterimage::format::rgba>()[1][1], r4::vector4<uint8_t>{6, 4, 0, 0xff}, SL);
+	});
+
+	suite.add("subimage_copy_on_write", []() {
+		rasterimage::shared_image im(make_image());
+		auto sub = im.subimage({{4, 2}, {10, 5}});
+
+		// only the region is copied
+		sub.span().get<uint8_t, 4>()[0][0] = {0, 0, 0, 0};
+
+		tst::check_eq(sub.use_count(), long(1), SL);
+		tst::check_eq(sub.to_image_variant().dims(), r4::vector2<uint32_t>{10, 5}, SL);
+		tst::check_eq(pixel(std::as_const(sub).span(), 0, 0), r4::vector4<uint8_t>{0, 0, 0, 0}, SL);
+		tst::check_eq(pixel(std::as_const(sub).span(), 1, 0), r4::vector4<uint8_t>{5, 2, 0, 0xff}, SL);
+		tst::check_eq(pixel(std::as_const(im).span(), 4, 2), r4::vector4<uint8_t>{4, 2, 0, 0xff}, SL);
+	});
+
+	suite.add("subimage_out_of_image", []() {
+		rasterimage::shared_image im(make_image());
+		bool thrown = false;
+		try {
+			im.subimage({{15, 0}, {6, 1}});
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+	});
+
+	suite.add("concurrent_copies", []() {
+		rasterimage::shared_image im(make_image());
+
+		std::vector<std::thread> threads;
+		// not std::vector<bool>, since its elements cannot be written from different threads
+		std::array<bool, 4> ok{};
+		for (size_t i = 0; i != ok.size(); ++i) {
+			threads.emplace_back([im, i, &ok]() mutable {
+				// each thread gets private copy of the pixels on write
+				auto span = im.span().get<uint8_t, 4>();
+				span[0][0] = {uint8_t(i), 0, 0, 0};
+				ok[i] = span[0][0].r() == uint8_t(i) && span[9][19] == r4::vector4<uint8_t>{19, 9, 0, 0xff};
+			});
+		}
+		for (auto& t : threads) {
+			t.join();
+		}
+
+		for (auto v : ok) {
+			tst::check(v, SL);
+		}
+		tst::check_eq(pixel(std::as_const(im).span(), 0, 0), r4::vector4<uint8_t>{0, 0, 0, 0xff}, SL);
+	});
+});
+} // namespace
@@ -0,0 +1,219 @@
+#include <rasterimage/image_variant.hpp>
+#include <rasterimage/statistics.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+const tst::set set("statistics", [](tst::suite& suite) {
+	suite.add<unsigned>("get_statistics__uint8_t_4", {1, 0}, [](const auto& num_threads) {
+		// big enough image to be split to several bands
+		rasterimage::image<uint8_t, 4> img(rasterimage::dimensioned::dimensions_type{300, 700});
+		img.span().clear({10, 20, 30, 40});
+
+		img[0][0] = {0, 20, 30, 40};
+		img[699][299] = {20, 255, 30, 40};
+		img[350][150] = {10, 20, 30, 0};
+
+		auto s = rasterimage::get_statistics(img.span(), num_threads);
+
+		tst::check_eq(s.min, r4::vector4<uint8_t>{0, 20, 30, 0}, SL);
+		tst::check_eq(s.max, r4::vector4<uint8_t>{20, 255, 30, 40}, SL);
+
+		auto num_pixels = double(img.pixels().size());
+
+		tst::check_eq(s.mean[0], (10.0 * (num_pixels - 2) + 20) / num_pixels, SL);
+		tst::check_eq(s.mean[1], (20.0 * (num_pixels - 1) + 255) / num_pixels, SL);
+		tst::check_eq(s.mean[2], 30.0, SL);
+		tst::check_eq(s.mean[3], (40.0 * (num_pixels - 1)) / num_pixels, SL);
+	});
+
+	suite.add("get_statistics__float_1", []() {
+		rasterimage::image<float, 1> img(rasterimage::dimensioned::dimensions_type{2, 2});
+		img[0][0] = 0.25f;
+		img[0][1] = 0.5f;
+		img[1][0] = 0.75f;
+		img[1][1] = 1.0f;
+
+		auto s = rasterimage::get_statistics(img.span());
+
+		tst::check_eq(s.min[0], 0.25f, SL);
+		tst::check_eq(s.max[0], 1.0f, SL);
+		tst::check_eq(s.mean[0], 0.625, SL);
+	});
+
+	suite.add("get_statistics__empty", []() {
+		rasterimage::image<uint16_t, 3> img;
+
+		auto s = rasterimage::get_statistics(img.span());
+
+		tst::check_eq(s.min, r4::vector3<uint16_t>(0), SL);
+		tst::check_eq(s.max, r4::vector3<uint16_t>(0), SL);
+		tst::check_eq(s.mean, r4::vector3<double>(0), SL);
+	});
+
+	suite.add<unsigned>("make_histogram__uint8_t_2", {1, 0}, [](const auto& num_threads) {
+		rasterimage::image<uint8_t, 2> img(rasterimage::dimensioned::dimensions_type{400, 500}, r4::vector2<uint8_t>{7, 255});
+		img[10][10] = {0, 128};
+		img[499][399] = {0, 128};
+
+		auto h = rasterimage::make_histogram(img.span(), 256, num_threads);
+
+		tst::check_eq(h[0].size(), size_t(256), SL);
+		tst::check_eq(h[0][0], size_t(2), SL);
+		tst::check_eq(h[0][7], size_t(img.pixels().size() - 2), SL);
+		tst::check_eq(h[1][128], size_t(2), SL);
+		tst::check_eq(h[1][255], size_t(img.pixels().size() - 2), SL);
+
+		auto h4 = rasterimage::make_histogram(img.span(), 4, num_threads);
+		tst::check_eq(h4[0][0], img.pixels().size(), SL);
+		tst::check_eq(h4[1][0], size_t(0), SL);
+		tst::check_eq(h4[1][2], size_t(2), SL);
+		tst::check_eq(h4[1][3], size_t(img.pixels().size() - 2), SL);
+	});
+
+	suite.add("make_histogram__float_1", []() {
+		rasterimage::image<float, 1> img(rasterimage::dimensioned::dimensions_type{5, 1});
+		img[0][0] = -1.0f;
+		img[0][1] = 0.0f;
+		img[0][2] = 0.5f;
+		img[0][3] = 1.0f;
+		img[0][4] = 2.0f;
+
+		auto h = rasterimage::make_histogram(img.span(), 2);
+
+		tst::check_eq(h[0][0], size_t(2), SL);
+		tst::check_eq(h[0][1], size_t(3), SL);
+	});
+
+	suite.add("non_transparent_bounding_box__rgba", []() {
+		rasterimage::image<uint8_t, 4> img(rasterimage::dimensioned::dimensions_type{200, 100}, r4::vector4<uint8_t>(0));
+
+		tst::check_eq(
+			rasterimage::non_transparent_bounding_box(img.span()),
+			r4::rectangle<uint32_t>{0, 0},
+			SL
+		);
+
+		img[20][100] = {0, 0, 0, 1};
+		img[30][10] = {0, 0, 0, 1};
+		img[40][150] = {0, 0, 0, 1};
+		img[50][120] = {0, 0, 0, 1};
+
+		tst::check_eq(
+			rasterimage::non_transparent_bounding_box(img.span()),
+			r4::rectangle<uint32_t>({10, 20}, {141, 31}),
+			SL
+		);
+
+		img[99][199] = {0, 0, 0, 1};
+		img[0][0] = {0, 0, 0, 1};
+
+		tst::check_eq(
+			rasterimage::non_transparent_bounding_box(img.span()),
+			r4::rectangle<uint32_t>{0, img.dims()},
+			SL
+		);
+	});
+
+	suite.add("non_transparent_bounding_box__rgb", []() {
+		rasterimage::image<float, 3> img(rasterimage::dimensioned::dimensions_type{20, 10}, r4::vector3<float>(0));
+
+		tst::check_eq(
+			rasterimage::non_transparent_bounding_box(img.span()),
+			r4::rectangle<uint32_t>{0, img.dims()},
+			SL
+		);
+	});
+
+	suite.add("image_variant", []() {
+		rasterimage::image_variant im({10, 20}, rasterimage::format::greya, rasterimage::depth::uint_16_bit);
+
+		auto& img = im.get<rasterimage::format::greya, rasterimage::depth::uint_16_bit>();
+		img.span().clear({0xffff, 0});
+		img[5][3] = {0, 0xffff};
+
+		auto s = rasterimage::get_statistics(im);
+		tst::check_eq(s.min, r4::vector4<float>{0, 0, 0, 0}, SL);
+		tst::check_eq(s.max, r4::vector4<float>{1, 1, 0, 0}, SL);
+
+		auto h = rasterimage::make_histogram(im, 2);
+		tst::check_eq(h.size(), size_t(2), SL);
+		tst::check_eq(h[0][1], size_t(199), SL);
+		tst::check_eq(h[1][1], size_t(1), SL);
+
+		tst::check_eq(
+			rasterimage::non_transparent_bounding_box(im),
+			r4::rectangle<uint32_t>({3, 5}, {1, 1}),
+			SL
+		);
+	});
+
+	suite.add("image_variant__argb", []() {
+		rasterimage::image_variant im({4, 4}, rasterimage::format::argb, rasterimage::depth::uint_8_bit);
+
+		auto& img = im.get<rasterimage::format::argb, rasterimage::depth::uint_8_bit>();
+		img.span().clear({0, 0xff, 0xff, 0xff});
+		img[1][2] = {0xff, 0, 0xff, 0};
+
+		tst::check_eq(
+			rasterimage::non_transparent_bounding_box(im),
+			r4::rectangle<uint32_t>({2, 1}, {1, 1}),
+			SL
+		);
+
+		auto s = rasterimage::get_statistics(im);
+		tst::check_eq(s.min, r4::vector4<float>{0, 1, 0, 0}, SL);
+		tst::check_eq(s.max, r4::vector4<float>{1, 1, 1, 1}, SL);
+		tst::check_eq(s.mean, r4::vector4<double>{15.0 / 16, 1, 15.0 / 16, 1.0 / 16}, SL);
+
+		auto h = rasterimage::make_histogram(im, 2);
+		tst::check_eq(h.size(), size_t(4), SL);
+		tst::check_eq(h[0][0], size_t(1), SL);
+		tst::check_eq(h[1][0], size_t(0), SL);
+		tst::check_eq(h[2][0], size_t(1), SL);
+		tst::check_eq(h[3][0], size_t(15), SL);
+	});
+
+	suite.add("image_variant__bgra", []() {
+		rasterimage::image_variant im({4, 4}, rasterimage::format::bgra, rasterimage::depth::uint_8_bit);
+
+		auto& img = im.get<rasterimage::format::bgra, rasterimage::depth::uint_8_bit>();
+		img.span().clear({0xff, 0, 0, 0});
+		img[3][1] = {0, 0, 0xff, 0xff};
+
+		tst::check_eq(
+			rasterimage::non_transparent_bounding_box(im),
+			r4::rectangle<uint32_t>({1, 3}, {1, 1}),
+			SL
+		);
+
+		auto s = rasterimage::get_statistics(im);
+		tst::check_eq(s.min, r4::vector4<float>{0, 0, 0, 0}, SL);
+		tst::check_eq(s.max, r4::vector4<float>{1, 0, 1, 1}, SL);
+		tst::check_eq(s.mean, r4::vector4<double>{1.0 / 16, 0, 15.0 / 16, 1.0 / 16}, SL);
+
+		auto h = rasterimage::make_histogram(im, 2);
+		tst::check_eq(h.size(), size_t(4), SL);
+		tst::check_eq(h[0][1], size_t(1), SL);
+		tst::check_eq(h[2][1], size_t(15), SL);
+		tst::check_eq(h[3][1], size_t(1), SL);
+	});
+
+	suite.add("image_variant__bgr", []() {
+		rasterimage::image_variant im({2, 1}, rasterimage::format::bgr, rasterimage::depth::uint_8_bit);
+
+		auto& img = im.get<rasterimage::format::bgr, rasterimage::depth::uint_8_bit>();
+		img[0][0] = {0xff, 0, 0};
+		img[0][1] = {0xff, 0xff, 0};
+
+		auto s = rasterimage::get_statistics(im);
+		tst::check_eq(s.min, r4::vector4<float>{0, 0, 1, 0}, SL);
+		tst::check_eq(s.max, r4::vector4<float>{0, 1, 1, 0}, SL);
+
+		auto h = rasterimage::make_histogram(im, 2);
+		tst::check_eq(h.size(), size_t(3), SL);
+		tst::check_eq(h[0][0], size_t(2), SL);
+		tst::check_eq(h[2][1], size_t(2), SL);
+	});
+});
+} // namespace
@@ -0,0 +1,89 @@
+#include <rasterimage/image.hpp>
+#include <rasterimage/transform.hpp>
+#include <tst/check.hpp>
+#include <tst/set.hpp>
+
+namespace {
+const tst::set set("transform", [](tst::suite& suite) {
+	suite.add("compose", []() {
+		auto p = rasterimage::compose(
+			rasterimage::op::swap_red_blue(),
+			rasterimage::op::swizzle<0, 1, 2>(),
+			rasterimage::op::to<uint16_t>()
+		);
+
+		auto res = p(r4::vector4<uint8_t>{0xff, 0, 0x80, 1});
+
+		tst::check_eq(res, r4::vector3<uint16_t>{0x8080, 0, 0xffff}, SL);
+	});
+
+	suite.add<unsigned>("fused_pipeline_equals_separate_passes", {1, 0}, [](const auto& num_threads) {
+		rasterimage::image<uint8_t, 4> src(rasterimage::dimensioned::dimensions_type{301, 403});
+		for (uint32_t y = 0; y != src.dims().y(); ++y) {
+			for (uint32_t x = 0; x != src.dims().x(); ++x) {
+				auto a = uint8_t((x * 7 + y) % 256);
+				src[y][x] = {uint8_t(std::min(x % 256, unsigned(a))), uint8_t(a / 2), uint8_t(y % (a + 1)), a};
+			}
+		}
+
+		// separate passes
+		auto expected_tmp = src;
+		expected_tmp.span().swap_red_blue();
+		expected_tmp.span().unpremultiply_alpha();
+		rasterimage::image<float, 4> expected(expected_tmp.dims());
+		for (uint32_t y = 0; y != src.dims().y(); ++y) {
+			for (uint32_t x = 0; x != src.dims().x(); ++x) {
+				expected[y][x] = rasterimage::to<float>(expected_tmp[y][x]);
+			}
+		}
+
+		rasterimage::image<float, 4> dst(src.dims());
+		rasterimage::transform(
+			num_threads,
+			src.span(),
+			dst.span(),
+			rasterimage::op::swap_red_blue(),
+			rasterimage::op::unpremultiply_alpha(),
+			rasterimage::op::to<float>()
+		);
+
+		tst::check(std::equal(dst.pixels().begin(), dst.pixels().end(), expected.pixels().begin()), SL);
+	});
+
+	suite.add("in_place_with_lambda", []() {
+		rasterimage::image<uint8_t, 3> im(rasterimage::dimensioned::dimensions_type{10, 5}, r4::vector3<uint8_t>{10, 20, 30});
+
+		rasterimage::transform(im.span(), im.span(), [](const r4::vector3<uint8_t>& px) {
+			return px + r4::vector3<uint8_t>{1, 2, 3};
+		});
+
+		for (const auto& px : im.pixels()) {
+			tst::check_eq(px, r4::vector3<uint8_t>{11, 22, 33}, SL);
+		}
+	});
+
+	suite.add("to_fewer_channels", []() {
+		rasterimage::image<uint8_t, 4> src(rasterimage::dimensioned::dimensions_type{4, 3}, r4::vector4<uint8_t>{100, 100, 100, 50});
+		rasterimage::image<uint8_t, 1> dst(src.dims());
+
+		rasterimage::transform(src.span(), dst.span(), rasterimage::op::luminance());
+
+		for (const auto& px : dst.pixels()) {
+			tst::check_eq(px, r4::vector<uint8_t, 1>{rasterimage::luminance(r4::vector4<uint8_t>{100, 100, 100, 50})}, SL);
+		}
+	});
+
+	suite.add("dimensions_mismatch", []() {
+		rasterimage::image<uint8_t, 3> src(rasterimage::dimensioned::dimensions_type{10, 5});
+		rasterimage::image<uint8_t, 3> dst(rasterimage::dimensioned::dimensions_type{5, 10});
+
+		bool thrown = false;
+		try {
+			rasterimage::transform(src.span(), dst.span());
+		} catch (std::invalid_argument&) {
+			thrown = true;
+		}
+		tst::check(thrown, SL);
+	});
+});
+} // namespace